@@ -4,11 +4,14 @@
 #include <atomic>
 #include <cstdint>
 #include <cstdio>
+#include <cstring>
 #include <thread>
 
 #define NOMINMAX
 #define WIN32_LEAN_AND_MEAN
 #include <Windows.h>
+#include <immintrin.h>
+#include <intrin.h>
 #include <malloc.h>
 
 using namespace std;
@@ -24,6 +27,109 @@ static const uint64_t NUM_THREADS = 3; // NOTE: This can not be changed, it is v
 static const uint64_t CODE_ALLOCATION_BATCH_SIZE = 4096;
 static const uint64_t NUM_CODES_MULTI_THREADED_THRESHOLD = 600000;
 
+// Files with at most this many codes are checked with the hash set instead of the bitset, the
+// threshold is measured in src/SmallInputAlgorithm.cpp
+static const uint64_t NUM_CODES_HASH_SET_THRESHOLD = 65536;
+
+// Hash set constants
+static const uint32_t HASH_SET_EMPTY_SLOT = 0xFFFFFFFFu;
+static const uint64_t HASH_SET_SLOTS_PER_BUCKET = 8;
+static const uint64_t HASH_SET_MIN_NUM_BUCKETS = 8;
+
+// Helpers
+// ------------------------------------------------------------------------------------------------
+
+// Number of codes in numBytes of text, a last line without a line ending still counts if all 6
+// characters are there
+static uint64_t numCodesInText(uint64_t numBytes, uint64_t bytesPerCode) noexcept
+{
+	return (numBytes + bytesPerCode - 6) / bytesPerCode;
+}
+
+// Small input variant
+// ------------------------------------------------------------------------------------------------
+
+// Open addressing hash set of code numbers. Each bucket is 8 slots (32 bytes), which are probed
+// together with AVX2 by comparing against both the number and the empty marker. Full buckets are
+// resolved with linear probing to the next bucket. The number of slots is a power of two at least
+// twice the number of codes, so buckets rarely fill up.
+static bool hashSetSearch(const uint8_t* __restrict fileView, uint64_t numCodes) noexcept
+{
+	// Calculate number of buckets, power of two with at least 2 slots per code
+	uint64_t numBuckets = HASH_SET_MIN_NUM_BUCKETS;
+	while ((numBuckets * HASH_SET_SLOTS_PER_BUCKET) < (numCodes * 2)) numBuckets *= 2;
+	const uint64_t bucketIndexMask = numBuckets - 1;
+
+	// Number of bits to shift the hash down to get a bucket index
+	unsigned long log2NumBuckets = 0;
+	_BitScanForward64(&log2NumBuckets, numBuckets);
+	const uint32_t hashShift = 32u - uint32_t(log2NumBuckets);
+
+	// Allocate slots and mark them as empty
+	const uint64_t numSlotBytes = numBuckets * HASH_SET_SLOTS_PER_BUCKET * sizeof(uint32_t);
+	uint32_t* slots = static_cast<uint32_t*>(_aligned_malloc(numSlotBytes, 32));
+	memset(slots, 0xFF, numSlotBytes);
+
+	// Variable containing whether a copy was found or not
+	bool foundCopy = false;
+
+	const __m256i EMPTY_SLOTS = _mm256_set1_epi32(int32_t(HASH_SET_EMPTY_SLOT));
+	for (uint64_t i = 0; i < (numCodes * BYTES_PER_CODE); i += BYTES_PER_CODE) {
+		uint8_t let3 = fileView[i];
+		uint8_t let2 = fileView[i + 1];
+		uint8_t let1 = fileView[i + 2];
+		uint8_t no3 = fileView[i + 3];
+		uint8_t no2 = fileView[i + 4];
+		uint8_t no1 = fileView[i + 5];
+
+		// Calculate corresponding number for code
+		uint32_t number = uint32_t(let3 - 'A') * 676000u +
+		                  uint32_t(let2 - 'A') * 26000u +
+		                  uint32_t(let1 - 'A') * 1000u +
+		                  uint32_t(no3 - '0') * 100u +
+		                  uint32_t(no2 - '0') * 10u +
+		                  uint32_t(no1 - '0');
+
+		// Fibonacci hashing, the high bits of the product are the best mixed
+		uint64_t bucketIndex = (number * 0x9E3779B1u) >> hashShift;
+		const __m256i numberVec = _mm256_set1_epi32(int32_t(number));
+
+		while (true) {
+			uint32_t* bucket = slots + bucketIndex * HASH_SET_SLOTS_PER_BUCKET;
+			const __m256i bucketVec = _mm256_load_si256(reinterpret_cast<const __m256i*>(bucket));
+
+			// Number already in set
+			const __m256i equal = _mm256_cmpeq_epi32(bucketVec, numberVec);
+			if (!_mm256_testz_si256(equal, equal)) {
+				foundCopy = true;
+				break;
+			}
+
+			// Insert number in first empty slot if there is one, slots are filled in order so
+			// there can't be a copy after an empty slot
+			uint32_t emptyMask = uint32_t(_mm256_movemask_ps(
+				_mm256_castsi256_ps(_mm256_cmpeq_epi32(bucketVec, EMPTY_SLOTS))));
+			if (emptyMask != 0) {
+				unsigned long slotIndex = 0;
+				_BitScanForward(&slotIndex, emptyMask);
+				bucket[slotIndex] = number;
+				break;
+			}
+
+			// Bucket full, try next one
+			bucketIndex = (bucketIndex + 1) & bucketIndexMask;
+		}
+
+		if (foundCopy) break;
+	}
+
+	// Free allocated hash set memory
+	_aligned_free(slots);
+
+	// Return result
+	return foundCopy;
+}
+
 // Single threaded variant
 // ------------------------------------------------------------------------------------------------
 
@@ -231,9 +337,14 @@ static bool hasDuplicates(const char* filePath) noexcept
 	// Result variable
 	bool foundCopy = false;
 
+	// Small input path
+	uint64_t numCodes = numCodesInText(fileSize, BYTES_PER_CODE);
+	if (numCodes <= NUM_CODES_HASH_SET_THRESHOLD) {
+		foundCopy = hashSetSearch(static_cast<const uint8_t*>(fileView), numCodes);
+	}
+
 	// Single threaded path
-	uint64_t numCodes = fileSize / BYTES_PER_CODE;
-	if (numCodes <= NUM_CODES_MULTI_THREADED_THRESHOLD) {
+	else if (numCodes <= NUM_CODES_MULTI_THREADED_THRESHOLD) {
 		foundCopy = singleThreadedSearch(static_cast<const uint8_t*>(fileView), fileSize);
 	}
 	
@@ -0,0 +1,141 @@
+// Copyright(c) Peter Hillerstrm(skipifzero.com, peter@hstroem.se)
+
+#include "AsyncCheckBenchmark.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+#include "CancellationToken.hpp"
+#include "PlateChecker.hpp"
+
+using namespace std;
+
+// Constants
+// ------------------------------------------------------------------------------------------------
+
+static const uint32_t NUM_SYNC_CHECKS = 16;
+static const uint32_t CONCURRENCY_LEVELS[] = { 1, 16, 128 };
+static const uint32_t NUM_CANCELLED_CHECKS = 64;
+
+typedef chrono::high_resolution_clock Clock;
+
+// Helpers
+// ------------------------------------------------------------------------------------------------
+
+static double microsecondsBetween(Clock::time_point start, Clock::time_point end) noexcept
+{
+	return chrono::duration<double, micro>(end - start).count();
+}
+
+static void waitForCount(const atomic_uint& count, uint32_t target) noexcept
+{
+	while (count.load(memory_order_acquire) < target) {
+		this_thread::yield();
+	}
+}
+
+// Benchmarks
+// ------------------------------------------------------------------------------------------------
+
+static void benchmarkConcurrentChecks(PlateChecker& checker, const vector<char>& text, bool expectedResult,
+                                      double syncMicroseconds, uint32_t numRequests) noexcept
+{
+	vector<Clock::time_point> submitTimes(numRequests);
+	vector<double> latencies(numRequests, 0.0);
+	atomic_uint numCompleted(0);
+	atomic_uint numIncorrect(0);
+	double maxSubmitMicroseconds = 0.0;
+
+	Clock::time_point startTime = Clock::now();
+	for (uint32_t i = 0; i < numRequests; i++) {
+		submitTimes[i] = Clock::now();
+		PlateCheckerStatus status = checker.checkTextAsync(text.data(), text.size(),
+			[&, i](const PlateCheckOutcome& outcome) {
+				latencies[i] = microsecondsBetween(submitTimes[i], Clock::now());
+				bool correct = outcome.status == PLATE_CHECKER_OK && (outcome.result.hasCopy != 0) == expectedResult;
+				if (!correct) numIncorrect++;
+				numCompleted.fetch_add(1, memory_order_release);
+			});
+		maxSubmitMicroseconds = max(maxSubmitMicroseconds, microsecondsBetween(submitTimes[i], Clock::now()));
+		if (status != PLATE_CHECKER_OK) {
+			numIncorrect++;
+			numCompleted++;
+		}
+	}
+	waitForCount(numCompleted, numRequests);
+	double totalMicroseconds = microsecondsBetween(startTime, Clock::now());
+
+	sort(latencies.begin(), latencies.end());
+	auto percentile = [&](double p) { return latencies[size_t(p * double(latencies.size() - 1))]; };
+	printf("  %3u concurrent: submit max %.1f us, overhead %.1f us/check, latency p50 %.0f us, "
+	       "p99 %.0f us, max %.0f us%s\n",
+	       numRequests, maxSubmitMicroseconds, totalMicroseconds / double(numRequests) - syncMicroseconds,
+	       percentile(0.5), percentile(0.99), latencies.back(), numIncorrect == 0 ? "" : " (INCORRECT)");
+}
+
+static void benchmarkCancellation(PlateChecker& checker, const vector<char>& text) noexcept
+{
+	CancellationToken token;
+	atomic_uint numCompleted(0);
+	atomic_uint numCancelled(0);
+
+	Clock::time_point startTime = Clock::now();
+	for (uint32_t i = 0; i < NUM_CANCELLED_CHECKS; i++) {
+		checker.checkTextAsync(text.data(), text.size(), [&](const PlateCheckOutcome& outcome) {
+			if (outcome.status == PLATE_CHECKER_CANCELLED) numCancelled++;
+			numCompleted.fetch_add(1, memory_order_release);
+		}, &token);
+	}
+	token.cancel();
+	waitForCount(numCompleted, NUM_CANCELLED_CHECKS);
+	double totalMicroseconds = microsecondsBetween(startTime, Clock::now());
+
+	printf("  Cancelled %u of %u queued checks, all completed after %.0f us\n",
+	       numCancelled.load(), NUM_CANCELLED_CHECKS, totalMicroseconds);
+}
+
+// Exposed function
+// ------------------------------------------------------------------------------------------------
+
+void benchmarkAsyncChecks(const char* filePath) noexcept
+{
+	// Read file
+	FILE* file = fopen(filePath, "rb");
+	if (file == nullptr) {
+		printf("Could not open \"%s\" for async check benchmark\n", filePath);
+		return;
+	}
+	vector<char> text;
+	char buffer[4096];
+	size_t numRead;
+	while ((numRead = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+		text.insert(text.end(), buffer, buffer + numRead);
+	}
+	fclose(file);
+
+	PlateChecker checker;
+	if (!checker.isValid()) {
+		printf("plateCheckerCreate() failed\n");
+		return;
+	}
+
+	// Synchronous baseline, also warms up the context
+	bool expectedResult = checker.hasCopy(text.data(), text.size());
+	Clock::time_point startTime = Clock::now();
+	for (uint32_t i = 0; i < NUM_SYNC_CHECKS; i++) {
+		checker.hasCopy(text.data(), text.size());
+	}
+	double syncMicroseconds = microsecondsBetween(startTime, Clock::now()) / double(NUM_SYNC_CHECKS);
+
+	printf("Async checks, \"%s\" (sync check %.0f us):\n", filePath, syncMicroseconds);
+	for (uint32_t numRequests : CONCURRENCY_LEVELS) {
+		benchmarkConcurrentChecks(checker, text, expectedResult, syncMicroseconds, numRequests);
+	}
+	benchmarkCancellation(checker, text);
+	printf("\n");
+}
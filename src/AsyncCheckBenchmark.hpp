@@ -0,0 +1,9 @@
+// Copyright(c) Peter Hillerstrm(skipifzero.com, peter@hstroem.se)
+
+#pragma once
+
+// Benchmarks the async checks of PlateChecker.hpp with the codes in the specified file. Prints how
+// long submitting a check blocks the caller, the scheduling overhead per check compared to
+// synchronous checks, and the completion latency percentiles with many concurrent requests. Also
+// verifies that all checks return the synchronous result and that cancellation stops queued checks.
+void benchmarkAsyncChecks(const char* filePath) noexcept;
@@ -0,0 +1,540 @@
+// Copyright(c) Peter Hillerstrm(skipifzero.com, peter@hstroem.se)
+
+#include "BinaryPlateFormat.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#include <malloc.h>
+
+#include "Crc32c.hpp"
+
+using namespace std;
+
+// Constants
+// ------------------------------------------------------------------------------------------------
+
+static const uint64_t MAX_NUMBER_CODES = 17576000;
+static const uint64_t NUM_BITSET_BYTES = (MAX_NUMBER_CODES / 8);
+static const uint64_t NUM_PADDING_BYTES = 8;
+
+static const uint64_t NUM_THREADS = 3;
+static const uint64_t CODE_ALLOCATION_BATCH_SIZE = 4096;
+static const uint64_t NUM_CODES_MULTI_THREADED_THRESHOLD = 600000;
+
+// Number of indices loaded and validated at a time before being inserted into the bitset
+static const uint64_t LOAD_BLOCK_SIZE = 64;
+static_assert((CODE_ALLOCATION_BATCH_SIZE % LOAD_BLOCK_SIZE) == 0, "Must be multiple of block size");
+
+static const uint64_t MAX_BYTES_PER_WRITE = uint64_t(1) << 30;
+
+// Memory mapped files
+// ------------------------------------------------------------------------------------------------
+
+struct MappedFile final {
+	HANDLE file = NULL;
+	HANDLE mappedFile = NULL;
+	const uint8_t* view = nullptr;
+	uint64_t size = 0;
+};
+
+static bool mapFile(const char* path, MappedFile& mapped) noexcept
+{
+	// Open file
+	mapped.file = CreateFile(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+	                         FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (mapped.file == INVALID_HANDLE_VALUE) {
+		printf("CreateFile() failed\n");
+		return false;
+	}
+
+	// Get size of file
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(mapped.file, &fileSize) || fileSize.QuadPart == 0) {
+		printf("GetFileSizeEx() failed or file is empty\n");
+		CloseHandle(mapped.file);
+		return false;
+	}
+	mapped.size = uint64_t(fileSize.QuadPart);
+
+	// Create mapped file
+	mapped.mappedFile = CreateFileMapping(mapped.file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (!mapped.mappedFile) {
+		printf("CreateFileMapping() failed\n");
+		CloseHandle(mapped.file);
+		return false;
+	}
+
+	// Create mapped file view
+	void* view = MapViewOfFile(mapped.mappedFile, FILE_MAP_READ, 0, 0, mapped.size);
+	if (!view) {
+		printf("MapViewOfFile() failed\n");
+		CloseHandle(mapped.mappedFile);
+		CloseHandle(mapped.file);
+		return false;
+	}
+	mapped.view = static_cast<const uint8_t*>(view);
+
+	return true;
+}
+
+static void unmapFile(MappedFile& mapped) noexcept
+{
+	if (!UnmapViewOfFile(mapped.view)) {
+		printf("UnmapViewOfFile() failed\n");
+	}
+	if (!CloseHandle(mapped.mappedFile)) {
+		printf("CloseHandle() failed for mappedFile\n");
+	}
+	if (!CloseHandle(mapped.file)) {
+		printf("CloseHandle() failed for file\n");
+	}
+	mapped = MappedFile();
+}
+
+// Encoding and decoding
+// ------------------------------------------------------------------------------------------------
+
+static uint32_t decodeTextCode(const uint8_t* __restrict code) noexcept
+{
+	return uint32_t(code[0] - 'A') * 676000u +
+	       uint32_t(code[1] - 'A') * 26000u +
+	       uint32_t(code[2] - 'A') * 1000u +
+	       uint32_t(code[3] - '0') * 100u +
+	       uint32_t(code[4] - '0') * 10u +
+	       uint32_t(code[5] - '0');
+}
+
+static uint64_t payloadBytesFor(uint64_t numCodes, uint32_t bitsPerCode) noexcept
+{
+	return ((numCodes * bitsPerCode + 7) / 8) + NUM_PADDING_BYTES;
+}
+
+template<uint32_t BITS_PER_CODE>
+static void storeIndex(uint8_t* __restrict payload, uint64_t codeIndex, uint32_t index) noexcept
+{
+	if (BITS_PER_CODE == 32) {
+		memcpy(payload + codeIndex * sizeof(uint32_t), &index, sizeof(uint32_t));
+	}
+	else {
+		// A 25 bit index shifted by at most 7 bits always fits in the 8 bytes read here. The
+		// payload is zero initialized, so OR:ing in the index is enough.
+		uint64_t bitOffset = codeIndex * BITS_PER_CODE;
+		uint64_t bits;
+		memcpy(&bits, payload + (bitOffset >> 3u), sizeof(uint64_t));
+		bits |= uint64_t(index) << (bitOffset & 7u);
+		memcpy(payload + (bitOffset >> 3u), &bits, sizeof(uint64_t));
+	}
+}
+
+template<uint32_t BITS_PER_CODE>
+static uint32_t loadIndex(const uint8_t* __restrict payload, uint64_t codeIndex) noexcept
+{
+	if (BITS_PER_CODE == 32) {
+		uint32_t index;
+		memcpy(&index, payload + codeIndex * sizeof(uint32_t), sizeof(uint32_t));
+		return index;
+	}
+	else {
+		const uint64_t MASK = (uint64_t(1) << BITS_PER_CODE) - 1;
+		uint64_t bitOffset = codeIndex * BITS_PER_CODE;
+		uint64_t bits;
+		memcpy(&bits, payload + (bitOffset >> 3u), sizeof(uint64_t));
+		return uint32_t((bits >> (bitOffset & 7u)) & MASK);
+	}
+}
+
+// Returns false if any line decodes to an index outside [0, MAX_NUMBER_CODES), which would
+// otherwise overflow into the neighbouring indices of a PACKED_25 payload
+template<uint32_t BITS_PER_CODE>
+static bool encodeCodes(const uint8_t* __restrict textView, uint64_t bytesPerCode, uint64_t numCodes,
+                        uint8_t* __restrict payload) noexcept
+{
+	uint32_t maxIndex = 0;
+	for (uint64_t i = 0; i < numCodes; i++) {
+		uint32_t index = decodeTextCode(textView + i * bytesPerCode);
+		maxIndex = max(maxIndex, index);
+		storeIndex<BITS_PER_CODE>(payload, i, index);
+	}
+	return maxIndex < MAX_NUMBER_CODES;
+}
+
+// Loads the indices in [first, first + numIndices) and validates them with a max reduction, so an
+// untrusted payload can't make the scanners write outside their bitsets. Returns false if any
+// index is invalid.
+template<uint32_t BITS_PER_CODE>
+static bool loadBlock(const uint8_t* __restrict payload, uint64_t first, uint64_t numIndices,
+                      uint32_t* __restrict numbersOut) noexcept
+{
+	uint32_t maxNumber = 0;
+	for (uint64_t i = 0; i < numIndices; i++) {
+		uint32_t number = loadIndex<BITS_PER_CODE>(payload, first + i);
+		maxNumber = max(maxNumber, number);
+		numbersOut[i] = number;
+	}
+	return maxNumber < MAX_NUMBER_CODES;
+}
+
+template<uint32_t BITS_PER_CODE>
+static bool validateIndices(const uint8_t* __restrict payload, uint64_t numCodes) noexcept
+{
+	uint32_t numbers[LOAD_BLOCK_SIZE];
+	for (uint64_t blockStart = 0; blockStart < numCodes; blockStart += LOAD_BLOCK_SIZE) {
+		uint64_t numNumbers = min(LOAD_BLOCK_SIZE, numCodes - blockStart);
+		if (!loadBlock<BITS_PER_CODE>(payload, blockStart, numNumbers, numbers)) return false;
+	}
+	return true;
+}
+
+// Scan result
+// ------------------------------------------------------------------------------------------------
+
+enum class ScanResult {
+	NO_COPY,
+	COPY,
+	INVALID_INDEX
+};
+
+// Single threaded variant
+// ------------------------------------------------------------------------------------------------
+
+// Checks the codes in range [firstCode, lastCode) against and inserts them into the bitset
+template<uint32_t BITS_PER_CODE>
+static ScanResult searchRange(const uint8_t* __restrict payload,
+                              uint64_t* __restrict isFoundBitset,
+                              uint64_t firstCode,
+                              uint64_t lastCode) noexcept
+{
+	uint32_t numbers[LOAD_BLOCK_SIZE];
+	for (uint64_t blockStart = firstCode; blockStart < lastCode; blockStart += LOAD_BLOCK_SIZE) {
+		uint64_t numNumbers = min(LOAD_BLOCK_SIZE, lastCode - blockStart);
+		if (!loadBlock<BITS_PER_CODE>(payload, blockStart, numNumbers, numbers)) {
+			return ScanResult::INVALID_INDEX;
+		}
+
+		for (uint64_t i = 0; i < numNumbers; i++) {
+			uint32_t number = numbers[i];
+
+			uint32_t bitsetChunkIndex = number >> 6u; // number / 64;
+			uint32_t bitIndex = number & 0x0000003Fu; // number % 64;
+
+			uint64_t chunk = isFoundBitset[bitsetChunkIndex];
+			uint64_t bitMask = uint64_t(1) << bitIndex;
+
+			if ((bitMask & chunk) != uint64_t(0)) {
+				return ScanResult::COPY;
+			}
+
+			chunk = bitMask | chunk;
+			isFoundBitset[bitsetChunkIndex] = chunk;
+		}
+	}
+	return ScanResult::NO_COPY;
+}
+
+template<uint32_t BITS_PER_CODE>
+static ScanResult singleThreadedSearch(const uint8_t* __restrict payload, uint64_t numCodes) noexcept
+{
+	// Allocate bitset buffer for whether a number is found or not, and clear it
+	uint64_t* isFoundBitset = static_cast<uint64_t*>(_aligned_malloc(NUM_BITSET_BYTES, 32));
+	memset(isFoundBitset, 0, NUM_BITSET_BYTES);
+
+	// Check all codes in file
+	ScanResult result = searchRange<BITS_PER_CODE>(payload, isFoundBitset, 0, numCodes);
+
+	// Free allocated bitset memory
+	_aligned_free(isFoundBitset);
+
+	// Return result
+	return result;
+}
+
+// Multi-threaded variant
+// ------------------------------------------------------------------------------------------------
+
+static bool mergeBitsets(uint64_t* bitsets[NUM_THREADS]) noexcept
+{
+	if (NUM_THREADS == 2) {
+		for (size_t i = 0; i < (NUM_BITSET_BYTES / sizeof(uint64_t)); i++) {
+			uint64_t b1 = bitsets[0][i];
+			uint64_t b2 = bitsets[1][i];
+			if ((b1 & b2) != uint64_t(0)) return true;
+		}
+	}
+
+	else if (NUM_THREADS == 3) {
+		for (size_t i = 0; i < (NUM_BITSET_BYTES / sizeof(uint64_t)); i++) {
+			uint64_t b1 = bitsets[0][i];
+			uint64_t b2 = bitsets[1][i];
+			uint64_t b3 = bitsets[2][i];
+			bool found = ((b1 & b2) | (b1 & b3) | (b2 & b3)) != uint64_t(0);
+			if (found) return true;
+		}
+	}
+
+	else if (NUM_THREADS == 4) {
+		for (size_t i = 0; i < (NUM_BITSET_BYTES / sizeof(uint64_t)); i++) {
+			uint64_t b1 = bitsets[0][i];
+			uint64_t b2 = bitsets[1][i];
+			uint64_t b3 = bitsets[2][i];
+			uint64_t b4 = bitsets[3][i];
+
+			bool found = ((b1 & b2) | (b1 & b3) | (b1 & b4) | (b2 & b3) | (b2 & b4) | (b3 & b4)) != uint64_t(0);
+			if (found) {
+				return true;
+			}
+		}
+	}
+
+	else {
+		printf("FATAL ERROR: NUM_THREADS may only be 2, 3 or 4\n");
+	}
+
+	return false;
+}
+
+template<uint32_t BITS_PER_CODE>
+static void workerFunction(const uint8_t* __restrict payload,
+                           uint64_t* __restrict isFoundBitset,
+                           atomic_bool* foundCopy,
+                           atomic_bool* foundInvalidIndex,
+                           size_t numCodes,
+                           atomic_size_t* nextFreeCodeIndex) noexcept
+{
+	// Clear bitset
+	memset(isFoundBitset, 0, NUM_BITSET_BYTES);
+
+	while (true) {
+
+		// Allocate codes from shared array
+		size_t codeIndex = atomic_fetch_add(nextFreeCodeIndex, CODE_ALLOCATION_BATCH_SIZE);
+		if (codeIndex >= numCodes) return;
+		size_t codesToCheck = min(size_t(CODE_ALLOCATION_BATCH_SIZE), numCodes - codeIndex);
+
+		// Check all allocated codes
+		ScanResult result = searchRange<BITS_PER_CODE>(payload, isFoundBitset, codeIndex,
+		                                               codeIndex + codesToCheck);
+		if (result != ScanResult::NO_COPY) {
+
+			// Allocate rest of codes so the other threads can stop
+			atomic_fetch_add(nextFreeCodeIndex, numCodes);
+
+			// Signal what was found and exit thread
+			if (result == ScanResult::COPY) *foundCopy = true;
+			else *foundInvalidIndex = true;
+			return;
+		}
+	}
+}
+
+template<uint32_t BITS_PER_CODE>
+static ScanResult multiThreadedSearch(const uint8_t* __restrict payload, uint64_t numCodes) noexcept
+{
+	// Variables containing whether a copy or an invalid index was found or not
+	atomic_bool foundCopy(false);
+	atomic_bool foundInvalidIndex(false);
+
+	// Counter used for allocating codes
+	atomic_size_t nextFreeCodeIndex(0);
+
+	// Start threads
+	uint64_t* bitsets[NUM_THREADS];
+	thread threads[NUM_THREADS];
+	for (size_t i = 0; i < NUM_THREADS; i++) {
+
+		// Allocate memory for bitset, cleared in worker function
+		bitsets[i] = static_cast<uint64_t*>(_aligned_malloc(NUM_BITSET_BYTES, 32));
+
+		// Start worker thread
+		threads[i] = thread(workerFunction<BITS_PER_CODE>, payload, bitsets[i], &foundCopy,
+		                    &foundInvalidIndex, numCodes, &nextFreeCodeIndex);
+	}
+
+	// Wait for threads to finish working
+	for (thread& t : threads) {
+		t.join();
+	}
+
+	// Compare all threads tables, an invalid index takes precedence over a copy
+	ScanResult result = ScanResult::NO_COPY;
+	if (foundInvalidIndex) {
+		result = ScanResult::INVALID_INDEX;
+	}
+	else if (foundCopy || mergeBitsets(bitsets)) {
+		result = ScanResult::COPY;
+	}
+
+	// Free memory
+	for (uint64_t* bitset : bitsets) {
+		_aligned_free(bitset);
+	}
+
+	// Return result
+	return result;
+}
+
+template<uint32_t BITS_PER_CODE>
+static ScanResult search(const uint8_t* __restrict payload, uint64_t numCodes) noexcept
+{
+	if (numCodes <= NUM_CODES_MULTI_THREADED_THRESHOLD) {
+		return singleThreadedSearch<BITS_PER_CODE>(payload, numCodes);
+	}
+	return multiThreadedSearch<BITS_PER_CODE>(payload, numCodes);
+}
+
+// Exposed functions
+// ------------------------------------------------------------------------------------------------
+
+bool convertTextToBinary(const char* textPath, const char* binaryPath,
+                         PlateFileEncoding encoding) noexcept
+{
+	// Map text file
+	MappedFile text;
+	if (!mapFile(textPath, text)) return false;
+
+	// Detect line endings from the first line, "AAA000\r\n" or "AAA000\n"
+	uint64_t bytesPerCode = (text.size > 6 && text.view[6] == '\r') ? 8 : 7;
+
+	// The last line may lack its line ending, any other partial line is an error
+	uint64_t numTrailingBytes = text.size % bytesPerCode;
+	if (numTrailingBytes != 0 && numTrailingBytes < 6) {
+		printf("Text file ends with a partial code\n");
+		unmapFile(text);
+		return false;
+	}
+	uint64_t numCodes = (text.size + bytesPerCode - 6) / bytesPerCode;
+
+	// Allocate and clear payload, clearing is required by PACKED_25 and gives us the padding
+	uint32_t bitsPerCode = uint32_t(encoding);
+	uint64_t payloadBytes = payloadBytesFor(numCodes, bitsPerCode);
+	uint8_t* payload = static_cast<uint8_t*>(_aligned_malloc(payloadBytes, 32));
+	if (payload == nullptr) {
+		printf("_aligned_malloc() failed\n");
+		unmapFile(text);
+		return false;
+	}
+	memset(payload, 0, payloadBytes);
+
+	// Encode codes
+	bool validCodes = encoding == PlateFileEncoding::PLAIN_32 ?
+		encodeCodes<32>(text.view, bytesPerCode, numCodes, payload) :
+		encodeCodes<25>(text.view, bytesPerCode, numCodes, payload);
+	unmapFile(text);
+	if (!validCodes) {
+		printf("Text file contains an invalid code\n");
+		_aligned_free(payload);
+		return false;
+	}
+
+	// Create header
+	PlateFileHeader header;
+	header.magic = PLATE_FILE_MAGIC;
+	header.version = PLATE_FILE_VERSION;
+	header.numCodes = numCodes;
+	header.bitsPerCode = bitsPerCode;
+	header.checksum = crc32c(payload, payloadBytes);
+	header.payloadBytes = payloadBytes;
+
+	// Write binary file
+	HANDLE file = CreateFile(binaryPath, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL,
+	                         NULL);
+	if (file == INVALID_HANDLE_VALUE) {
+		printf("CreateFile() failed\n");
+		_aligned_free(payload);
+		return false;
+	}
+
+	DWORD numWritten = 0;
+	bool success = WriteFile(file, &header, sizeof(PlateFileHeader), &numWritten, NULL) &&
+	               numWritten == sizeof(PlateFileHeader);
+	for (uint64_t offset = 0; success && offset < payloadBytes; offset += MAX_BYTES_PER_WRITE) {
+		DWORD numBytes = DWORD(min(MAX_BYTES_PER_WRITE, payloadBytes - offset));
+		success = WriteFile(file, payload + offset, numBytes, &numWritten, NULL) &&
+		          numWritten == numBytes;
+	}
+	if (!success) {
+		printf("WriteFile() failed\n");
+	}
+
+	CloseHandle(file);
+	_aligned_free(payload);
+	return success;
+}
+
+bool binaryPlateAlgorithm(const char* binaryPath) noexcept
+{
+	bool valid = false;
+	return binaryPlateAlgorithm(binaryPath, valid);
+}
+
+bool binaryPlateAlgorithm(const char* binaryPath, bool& validOut) noexcept
+{
+	validOut = false;
+
+	// Map binary file
+	MappedFile binary;
+	if (!mapFile(binaryPath, binary)) return false;
+
+	// Validate header
+	PlateFileHeader header;
+	if (binary.size < sizeof(PlateFileHeader)) {
+		printf("File too small to be a binary plate file\n");
+		unmapFile(binary);
+		return false;
+	}
+	memcpy(&header, binary.view, sizeof(PlateFileHeader));
+	// numCodes is bounded by the bits available in the file before payloadBytesFor() is called,
+	// otherwise numCodes * bitsPerCode can wrap around and a crafted header passes the size check.
+	uint64_t maxPayloadBits = binary.size >= sizeof(PlateFileHeader) + NUM_PADDING_BYTES ?
+	                          (binary.size - sizeof(PlateFileHeader) - NUM_PADDING_BYTES) * 8 : 0;
+	bool validHeader = header.magic == PLATE_FILE_MAGIC &&
+	                   header.version == PLATE_FILE_VERSION &&
+	                   (header.bitsPerCode == 32 || header.bitsPerCode == 25) &&
+	                   header.numCodes <= maxPayloadBits / header.bitsPerCode &&
+	                   header.payloadBytes == payloadBytesFor(header.numCodes, header.bitsPerCode) &&
+	                   header.payloadBytes == (binary.size - sizeof(PlateFileHeader));
+	if (!validHeader) {
+		printf("Invalid binary plate file header\n");
+		unmapFile(binary);
+		return false;
+	}
+
+	// Validate payload
+	const uint8_t* payload = binary.view + sizeof(PlateFileHeader);
+	if (crc32c(payload, header.payloadBytes) != header.checksum) {
+		printf("Binary plate file checksum mismatch\n");
+		unmapFile(binary);
+		return false;
+	}
+
+	// Large file fast path
+	// There are a total of 17 576 000 different codes. If the file contains more codes than that
+	// it must also by definition contain a copy, but its indices are still validated.
+	ScanResult result;
+	if (header.numCodes > MAX_NUMBER_CODES) {
+		bool validIndices = header.bitsPerCode == 32 ? validateIndices<32>(payload, header.numCodes) :
+		                                              validateIndices<25>(payload, header.numCodes);
+		result = validIndices ? ScanResult::COPY : ScanResult::INVALID_INDEX;
+	}
+	else if (header.bitsPerCode == 32) {
+		result = search<32>(payload, header.numCodes);
+	}
+	else {
+		result = search<25>(payload, header.numCodes);
+	}
+
+	unmapFile(binary);
+	if (result == ScanResult::INVALID_INDEX) {
+		printf("Binary plate file contains an invalid index\n");
+		return false;
+	}
+	validOut = true;
+	return result == ScanResult::COPY;
+}
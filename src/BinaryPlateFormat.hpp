@@ -0,0 +1,51 @@
+// Copyright(c) Peter Hillerstrm(skipifzero.com, peter@hstroem.se)
+
+#pragma once
+
+#include <cstdint>
+
+// Binary plate file format
+// ------------------------------------------------------------------------------------------------
+
+// A binary plate file consists of a PlateFileHeader followed by a payload containing each code
+// stored as its decoded index in the range [0, 17576000). The index is calculated the same way as
+// in all the text based algorithms, i.e. "AAA000" is 0 and "ZZZ999" is 17575999.
+//
+// Two encodings are available:
+// * PLAIN_32: Each index is stored as a little endian uint32_t.
+// * PACKED_25: The indices are packed into a little endian bit stream, 25 bits per index.
+//
+// The payload is always followed by 8 bytes of zero padding (included in payloadBytes), so a
+// reader may load 8 bytes starting at any index without reading past the end of the file.
+
+static const uint32_t PLATE_FILE_MAGIC = 0x54414C50u; // "PLAT"
+static const uint32_t PLATE_FILE_VERSION = 1;
+
+enum class PlateFileEncoding : uint32_t {
+	PLAIN_32 = 32,
+	PACKED_25 = 25
+};
+
+struct PlateFileHeader final {
+	uint32_t magic;
+	uint32_t version;
+	uint64_t numCodes;
+	uint32_t bitsPerCode; // The stride, 32 for PLAIN_32 and 25 for PACKED_25
+	uint32_t checksum; // CRC-32C of the payload (including padding)
+	uint64_t payloadBytes;
+};
+static_assert(sizeof(PlateFileHeader) == 32, "PlateFileHeader is padded");
+
+// Converts a text file (one code per line, CR+LF or LF line endings) into a binary plate file. The
+// last line may lack its line ending. Fails if the file ends with a partial code or if a line
+// decodes to an index outside [0, 17576000), other formatting errors are not detected.
+bool convertTextToBinary(const char* textPath, const char* binaryPath,
+                         PlateFileEncoding encoding) noexcept;
+
+// Checks a binary plate file for duplicates, the binary counterpart of optimizedSmartAlgorithm7().
+// The payload is untrusted, every index is validated before use. An invalid file (bad header,
+// checksum mismatch or an index outside [0, 17576000)) is reported as no duplicates.
+bool binaryPlateAlgorithm(const char* binaryPath) noexcept;
+
+// Same as above, but validOut is set to false if the file could not be read or is invalid
+bool binaryPlateAlgorithm(const char* binaryPath, bool& validOut) noexcept;
@@ -0,0 +1,276 @@
+// Copyright(c) Peter Hillerstrm(skipifzero.com, peter@hstroem.se)
+
+#include "CacheBlockedAlgorithm.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#include <immintrin.h>
+#include <malloc.h>
+
+#include "PlateDecoders.hpp"
+#include "ThreadPlacement.hpp"
+
+using namespace std;
+
+// Constants
+// ------------------------------------------------------------------------------------------------
+
+static const uint64_t MAX_NUMBER_CODES = 17576000;
+static const uint64_t BYTES_PER_CODE = 8; // Assumes Windows file endings (2 bytes per newline)
+
+// Pass ranges are whole cache lines of the bitset
+static const uint64_t RANGE_GRANULARITY = 512;
+
+// Number of codes between each check of whether another thread found a copy
+static const uint64_t COPY_CHECK_INTERVAL = 4096;
+
+// Cost model, nanoseconds on the original 4 core machine. The scan cost is per code and pass
+// (streaming, AVX2 decode and range test), the probe costs are per code in range of the pass.
+static const double SCAN_NS_PER_CODE = 1.0;
+static const double PROBE_HIT_NS = 1.5;
+static const double PROBE_MISS_NS = 12.0;
+
+static const uint64_t PRINTED_BUDGETS[] = { 16 * 1024, 64 * 1024, 256 * 1024, 1024 * 1024, 8 * 1024 * 1024 };
+
+// Cost model
+// ------------------------------------------------------------------------------------------------
+
+CacheBlockedPlan planCacheBlockedSearch(uint64_t numCodes, uint64_t memoryBudgetBytes, uint64_t cacheBytes,
+                                        uint32_t maxThreads) noexcept
+{
+	CacheBlockedPlan best;
+	maxThreads = max(1u, min(maxThreads, CACHE_BLOCKED_MAX_THREADS));
+	for (uint32_t numPasses = 1; numPasses <= CACHE_BLOCKED_MAX_PASSES; numPasses++) {
+		uint64_t codesPerPass = (MAX_NUMBER_CODES + numPasses - 1) / numPasses;
+		codesPerPass = ((codesPerPass + RANGE_GRANULARITY - 1) / RANGE_GRANULARITY) * RANGE_GRANULARITY;
+		uint64_t sliceBytes = codesPerPass / 8;
+
+		// Rounding up to whole cache lines may leave the last passes empty
+		if ((codesPerPass * (numPasses - 1)) >= MAX_NUMBER_CODES) continue;
+
+		for (uint32_t numThreads = 1; numThreads <= min(maxThreads, numPasses); numThreads++) {
+			if ((sliceBytes * numThreads) > memoryBudgetBytes) break;
+
+			// Each thread runs ceil(K / T) passes, each probing 1/K of the codes on average
+			double passesPerThread = double((numPasses + numThreads - 1) / numThreads);
+			double missRate = sliceBytes <= cacheBytes ? 0.0 : 1.0 - double(cacheBytes) / double(sliceBytes);
+			double probeNs = PROBE_HIT_NS + missRate * PROBE_MISS_NS;
+			double estimatedNs = passesPerThread * double(numCodes) * (SCAN_NS_PER_CODE + probeNs / double(numPasses));
+
+			double estimatedMs = estimatedNs / 1000000.0;
+			if (best.numPasses == 0 || estimatedMs < best.estimatedMs) {
+				best.numPasses = numPasses;
+				best.numThreads = numThreads;
+				best.codesPerPass = codesPerPass;
+				best.sliceBytes = sliceBytes;
+				best.estimatedMs = estimatedMs;
+			}
+		}
+	}
+	return best;
+}
+
+// Search
+// ------------------------------------------------------------------------------------------------
+
+// Checks the codes in the range [firstIndex, firstIndex + codesPerPass) against and inserts them
+// into the cleared slice, ignoring all other codes. Returns true if a copy is found.
+static bool searchPass(const uint8_t* __restrict fileView, uint64_t numCodes, uint64_t* __restrict slice,
+                       uint32_t firstIndex, uint32_t codesPerPass, const atomic_bool& foundCopy) noexcept
+{
+	const __m256i FIRST = _mm256_set1_epi32(int32_t(firstIndex));
+	const __m256i LAST_OFFSET = _mm256_set1_epi32(int32_t(codesPerPass - 1));
+
+	auto insert = [&](uint32_t offset) {
+		uint64_t& chunk = slice[offset >> 6u];
+		uint64_t bitMask = uint64_t(1) << (offset & 0x0000003Fu);
+		if ((chunk & bitMask) != uint64_t(0)) return true;
+		chunk |= bitMask;
+		return false;
+	};
+
+	uint64_t numVectorCodes = numCodes & ~uint64_t(7);
+	for (uint64_t intervalStart = 0; intervalStart < numVectorCodes; intervalStart += COPY_CHECK_INTERVAL) {
+		if (foundCopy.load(memory_order_relaxed)) return false;
+		uint64_t intervalEnd = min(intervalStart + COPY_CHECK_INTERVAL, numVectorCodes);
+		for (uint64_t i = intervalStart; i < intervalEnd; i += 8) {
+
+			// Offsets into the pass range, out of range codes wrap around to large unsigned values
+			__m256i offsets = _mm256_sub_epi32(decode8Avx2<BYTES_PER_CODE>(fileView + i * BYTES_PER_CODE), FIRST);
+			__m256i inRange = _mm256_cmpeq_epi32(_mm256_min_epu32(offsets, LAST_OFFSET), offsets);
+			uint32_t inRangeMask = uint32_t(_mm256_movemask_ps(_mm256_castsi256_ps(inRange)));
+			if (inRangeMask == 0) continue;
+
+			alignas(32) uint32_t offsetArray[8];
+			_mm256_store_si256(reinterpret_cast<__m256i*>(offsetArray), offsets);
+			while (inRangeMask != 0) {
+				if (insert(offsetArray[_tzcnt_u32(inRangeMask)])) return true;
+				inRangeMask = _blsr_u32(inRangeMask);
+			}
+		}
+	}
+	for (uint64_t i = numVectorCodes; i < numCodes; i++) {
+		uint32_t offset = decodeScalar(fileView + i * BYTES_PER_CODE) - firstIndex;
+		if (offset < codesPerPass && insert(offset)) return true;
+	}
+	return false;
+}
+
+static void workerFunction(const uint8_t* __restrict fileView, uint64_t numCodes, const CacheBlockedPlan* plan,
+                           atomic_uint* nextPass, atomic_bool* foundCopy, atomic_bool* allocationFailed) noexcept
+{
+	uint64_t* slice = static_cast<uint64_t*>(_aligned_malloc(plan->sliceBytes, 64));
+	if (slice == nullptr) {
+		printf("_aligned_malloc() failed\n");
+
+		// Claim the remaining passes so the other threads stop
+		*allocationFailed = true;
+		nextPass->fetch_add(plan->numPasses);
+		return;
+	}
+	while (true) {
+
+		// Claim next pass
+		uint32_t pass = nextPass->fetch_add(1);
+		if (pass >= plan->numPasses || foundCopy->load(memory_order_relaxed)) break;
+
+		memset(slice, 0, plan->sliceBytes);
+		uint64_t firstIndex = uint64_t(pass) * plan->codesPerPass;
+		if (searchPass(fileView, numCodes, slice, uint32_t(firstIndex), uint32_t(plan->codesPerPass), *foundCopy)) {
+			*foundCopy = true;
+			break;
+		}
+	}
+	_aligned_free(slice);
+}
+
+static bool multiPassSearch(const uint8_t* __restrict fileView, uint64_t numCodes, const CacheBlockedPlan& plan) noexcept
+{
+	atomic_bool foundCopy(false);
+	atomic_uint nextPass(0);
+	atomic_bool allocationFailed(false);
+
+	// The calling thread runs passes too
+	thread threads[CACHE_BLOCKED_MAX_THREADS];
+	for (uint32_t i = 1; i < plan.numThreads; i++) {
+		threads[i] = thread(workerFunction, fileView, numCodes, &plan, &nextPass, &foundCopy, &allocationFailed);
+	}
+	workerFunction(fileView, numCodes, &plan, &nextPass, &foundCopy, &allocationFailed);
+	for (uint32_t i = 1; i < plan.numThreads; i++) {
+		threads[i].join();
+	}
+
+	// Passes skipped by a thread without a slice leave the search incomplete
+	if (allocationFailed) return false;
+	return foundCopy;
+}
+
+// Exposed functions
+// ------------------------------------------------------------------------------------------------
+
+bool cacheBlockedSearch(const char* filePath, uint64_t memoryBudgetBytes, CacheBlockedPlan* planOut) noexcept
+{
+	// Open file
+	HANDLE file = CreateFile(filePath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+	                         FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (file == INVALID_HANDLE_VALUE) {
+		printf("CreateFile() failed\n");
+		return false;
+	}
+
+	// Get size of file
+	uint64_t fileSize = static_cast<uint64_t>(GetFileSize(file, NULL));
+
+	// Large file fast path
+	// There are a total of 17 576 000 different codes. If the file contains more codes than that
+	// it must also by definition contain a copy.
+	if (fileSize >= ((MAX_NUMBER_CODES + 1) * BYTES_PER_CODE)) {
+		CloseHandle(file);
+		return true;
+	}
+
+	// Plan passes
+	uint64_t numCodes = numCodesInText(fileSize, BYTES_PER_CODE);
+	uint64_t cacheBytes = cpuTopology().l2CacheBytes != 0 ? cpuTopology().l2CacheBytes : CACHE_BLOCKED_DEFAULT_CACHE_BYTES;
+	uint32_t maxThreads = max(1u, uint32_t(cpuTopology().processors.size()));
+	CacheBlockedPlan plan = planCacheBlockedSearch(numCodes, memoryBudgetBytes, cacheBytes, maxThreads);
+	if (planOut != nullptr) *planOut = plan;
+	if (plan.numPasses == 0) {
+		printf("Memory budget of %llu bytes is too small\n", (unsigned long long)memoryBudgetBytes);
+		CloseHandle(file);
+		return false;
+	}
+
+	// Create mapped file
+	HANDLE mappedFile = CreateFileMapping(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (!mappedFile) {
+		printf("CreateFileMapping() failed\n");
+		CloseHandle(file);
+		return false;
+	}
+
+	// Create mapped file view
+	void* fileView = MapViewOfFile(mappedFile, FILE_MAP_READ, 0, 0, fileSize);
+	if (!fileView) {
+		printf("MapViewOfFile() failed\n");
+		CloseHandle(mappedFile);
+		CloseHandle(file);
+		return false;
+	}
+
+	// Search
+	bool foundCopy = multiPassSearch(static_cast<const uint8_t*>(fileView), numCodes, plan);
+
+	// Unmap mapped file view
+	if (!UnmapViewOfFile(fileView)) {
+		printf("UnmapViewOfFile() failed\n");
+		CloseHandle(mappedFile);
+		CloseHandle(file);
+		return false;
+	}
+
+	// Close mapped file
+	if (!CloseHandle(mappedFile)) {
+		printf("CloseHandle() failed for mappedFile\n");
+		return false;
+	}
+
+	// Close file
+	if (!CloseHandle(file)) {
+		printf("CloseHandle() failed for file\n");
+		return false;
+	}
+
+	// Return result
+	return foundCopy;
+}
+
+bool cacheBlockedAlgorithm(const char* filePath) noexcept
+{
+	return cacheBlockedSearch(filePath, CACHE_BLOCKED_DEFAULT_BUDGET_BYTES);
+}
+
+void printCacheBlockedPlans(const char* filePath) noexcept
+{
+	printf("Cache-blocked plans on \"%s\":\n", filePath);
+	for (uint64_t budget : PRINTED_BUDGETS) {
+		CacheBlockedPlan plan;
+		auto startTime = chrono::high_resolution_clock::now();
+		bool foundCopy = cacheBlockedSearch(filePath, budget, &plan);
+		double measuredMs = chrono::duration<double, milli>(chrono::high_resolution_clock::now() - startTime).count();
+		printf("  Budget %5llu KiB: %4u passes, %u threads, %4llu KiB slices, estimated %.2f ms, measured %.2f ms%s\n",
+		       (unsigned long long)(budget / 1024), plan.numPasses, plan.numThreads,
+		       (unsigned long long)(plan.sliceBytes / 1024), plan.estimatedMs, measuredMs,
+		       foundCopy ? " (copy found)" : "");
+	}
+	printf("\n");
+}
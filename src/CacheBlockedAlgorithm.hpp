@@ -0,0 +1,48 @@
+// Copyright(c) Peter Hillerstrm(skipifzero.com, peter@hstroem.se)
+
+#pragma once
+
+#include <cstdint>
+
+// Cache-blocked multi-pass search for machines with small caches and strict memory limits. The
+// index space is split into K equal ranges and the file is streamed K times, each pass checking
+// only the codes in its range against a bitset slice of 1/K of the full size. With a slice that
+// fits in L2 every probe is a cache hit, at the cost of K sequential passes over the file.
+//
+// Passes are independent, so up to CACHE_BLOCKED_MAX_THREADS threads (at most one per logical
+// processor) run different passes concurrently, each with its own slice. The memory budget bounds
+// the total size of all slices.
+
+static const uint32_t CACHE_BLOCKED_MAX_THREADS = 3;
+static const uint32_t CACHE_BLOCKED_MAX_PASSES = 1024;
+
+// Budget used by cacheBlockedAlgorithm()
+static const uint64_t CACHE_BLOCKED_DEFAULT_BUDGET_BYTES = 512 * 1024;
+
+// Cache size assumed if it can't be discovered
+static const uint64_t CACHE_BLOCKED_DEFAULT_CACHE_BYTES = 256 * 1024;
+
+struct CacheBlockedPlan final {
+	uint32_t numPasses = 0; // K
+	uint32_t numThreads = 0;
+	uint64_t codesPerPass = 0; // Size of the index range of each pass, multiple of 512
+	uint64_t sliceBytes = 0; // Bitset bytes per thread
+	double estimatedMs = 0.0;
+};
+
+// Cost model, picks the number of passes and threads with the lowest estimated time. Each pass
+// costs a sequential scan and decode of every code, and each probe costs an L2 hit or, for the
+// fraction of the slice that doesn't fit in cacheBytes, a miss. Returns a plan with 0 passes if
+// even CACHE_BLOCKED_MAX_PASSES passes don't fit in the budget.
+CacheBlockedPlan planCacheBlockedSearch(uint64_t numCodes, uint64_t memoryBudgetBytes,
+                                        uint64_t cacheBytes, uint32_t maxThreads) noexcept;
+
+// Searches with CACHE_BLOCKED_DEFAULT_BUDGET_BYTES and the L2 size of the machine
+bool cacheBlockedAlgorithm(const char* filePath) noexcept;
+
+// Searches with the plan for the specified budget, planOut receives the plan if not null
+bool cacheBlockedSearch(const char* filePath, uint64_t memoryBudgetBytes,
+                        CacheBlockedPlan* planOut = nullptr) noexcept;
+
+// Prints the plan and measured time for a range of memory budgets on the specified file
+void printCacheBlockedPlans(const char* filePath) noexcept;
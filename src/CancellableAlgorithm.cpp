@@ -0,0 +1,522 @@
+// Copyright(c) Peter Hillerstrm(skipifzero.com, peter@hstroem.se)
+
+#include "CancellableAlgorithm.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#include <malloc.h>
+
+#include "PlateDecoders.hpp"
+
+using namespace std;
+
+// Constants
+// ------------------------------------------------------------------------------------------------
+
+static const uint64_t MAX_NUMBER_CODES = 17576000;
+static const uint64_t BYTES_PER_CODE = 8; // Assumes Windows file endings (2 bytes per newline)
+static const uint64_t NUM_BITSET_BYTES = (MAX_NUMBER_CODES / 8);
+
+static const uint64_t NUM_THREADS = 3;
+static const uint64_t CODE_ALLOCATION_BATCH_SIZE = 4096;
+static const uint64_t NUM_CODES_MULTI_THREADED_THRESHOLD = 600000;
+
+// Number of codes between each poll of the cancellation tokens inside a batch
+static const uint64_t CANCELLATION_CHECK_INTERVAL = 256;
+static_assert((CODE_ALLOCATION_BATCH_SIZE % CANCELLATION_CHECK_INTERVAL) == 0, "Must be multiple");
+
+// Search
+// ------------------------------------------------------------------------------------------------
+
+// The tokens a search polls, the internal one is cancelled by the algorithm itself (e.g. when a
+// copy is found) and the external one is the caller's (may be nullptr)
+struct StopTokens final {
+	const CancellationToken* internal = nullptr;
+	const CancellationToken* external = nullptr;
+
+	bool isCancelled() const noexcept
+	{
+		return internal->isCancelled() || (external != nullptr && external->isCancelled());
+	}
+};
+
+enum class RangeResult {
+	NO_COPY,
+	COPY_FOUND,
+	CANCELLED
+};
+
+static uint32_t decodeCode(const uint8_t* __restrict code) noexcept
+{
+	return uint32_t(code[0] - 'A') * 676000u +
+	       uint32_t(code[1] - 'A') * 26000u +
+	       uint32_t(code[2] - 'A') * 1000u +
+	       uint32_t(code[3] - '0') * 100u +
+	       uint32_t(code[4] - '0') * 10u +
+	       uint32_t(code[5] - '0');
+}
+
+// Checks the codes in range [firstCode, lastCode) against and inserts them into the bitset. The
+// tokens are polled before every checkInterval codes. If a copy is found its index is written to
+// copyIndexOut.
+static RangeResult searchRange(const uint8_t* __restrict fileView,
+                               uint64_t* __restrict isFoundBitset,
+                               uint64_t firstCode,
+                               uint64_t lastCode,
+                               const StopTokens& tokens,
+                               uint64_t checkInterval,
+                               uint64_t& copyIndexOut) noexcept
+{
+	for (uint64_t chunkStart = firstCode; chunkStart < lastCode; chunkStart += checkInterval) {
+		if (tokens.isCancelled()) return RangeResult::CANCELLED;
+
+		uint64_t chunkEnd = min(chunkStart + checkInterval, lastCode);
+		for (uint64_t i = chunkStart; i < chunkEnd; i++) {
+			uint32_t number = decodeCode(fileView + i * BYTES_PER_CODE);
+
+			uint32_t bitsetChunkIndex = number >> 6u; // number / 64;
+			uint32_t bitIndex = number & 0x0000003Fu; // number % 64;
+
+			uint64_t chunk = isFoundBitset[bitsetChunkIndex];
+			uint64_t bitMask = uint64_t(1) << bitIndex;
+
+			if ((bitMask & chunk) != uint64_t(0)) {
+				copyIndexOut = i;
+				return RangeResult::COPY_FOUND;
+			}
+
+			chunk = bitMask | chunk;
+			isFoundBitset[bitsetChunkIndex] = chunk;
+		}
+	}
+	return RangeResult::NO_COPY;
+}
+
+// Finds the first code in [firstCode, lastCode) which is set in the bitset, without modifying it
+static RangeResult findInBitset(const uint8_t* __restrict fileView,
+                                const uint64_t* __restrict bitset,
+                                uint64_t firstCode,
+                                uint64_t lastCode,
+                                const StopTokens& tokens,
+                                uint64_t& copyIndexOut) noexcept
+{
+	for (uint64_t chunkStart = firstCode; chunkStart < lastCode; chunkStart += CODE_ALLOCATION_BATCH_SIZE) {
+		if (tokens.isCancelled()) return RangeResult::CANCELLED;
+
+		uint64_t chunkEnd = min(chunkStart + CODE_ALLOCATION_BATCH_SIZE, lastCode);
+		for (uint64_t i = chunkStart; i < chunkEnd; i++) {
+			uint32_t number = decodeCode(fileView + i * BYTES_PER_CODE);
+			if ((bitset[number >> 6u] & (uint64_t(1) << (number & 0x0000003Fu))) != uint64_t(0)) {
+				copyIndexOut = i;
+				return RangeResult::COPY_FOUND;
+			}
+		}
+	}
+	return RangeResult::NO_COPY;
+}
+
+// Single threaded variant
+// ------------------------------------------------------------------------------------------------
+
+static CancellableResult singleThreadedSearch(const uint8_t* __restrict fileView,
+                                              uint64_t numCodes,
+                                              CancellableMode mode,
+                                              const CancellationToken* externalToken,
+                                              uint64_t checkInterval) noexcept
+{
+	// Allocate bitset buffer for whether a number is found or not, and clear it
+	uint64_t* isFoundBitset = static_cast<uint64_t*>(_aligned_malloc(NUM_BITSET_BYTES, 32));
+	memset(isFoundBitset, 0, NUM_BITSET_BYTES);
+
+	// Check all codes in file, the first copy found is the first copy in the file
+	CancellationToken internalToken;
+	StopTokens tokens;
+	tokens.internal = &internalToken;
+	tokens.external = externalToken;
+	uint64_t copyIndex = 0;
+	RangeResult rangeResult =
+		searchRange(fileView, isFoundBitset, 0, numCodes, tokens, checkInterval, copyIndex);
+
+	// Free allocated bitset memory
+	_aligned_free(isFoundBitset);
+
+	// Return result
+	CancellableResult result;
+	result.foundCopy = rangeResult == RangeResult::COPY_FOUND;
+	result.cancelled = rangeResult == RangeResult::CANCELLED;
+	if (result.foundCopy && mode == CancellableMode::FIRST_COPY) {
+		result.firstCopyOffset = copyIndex * BYTES_PER_CODE;
+	}
+	return result;
+}
+
+// Multi-threaded variant, any copy
+// ------------------------------------------------------------------------------------------------
+
+static bool mergeBitsets(uint64_t* bitsets[NUM_THREADS]) noexcept
+{
+	static_assert(NUM_THREADS == 3, "mergeBitsets() assumes 3 threads");
+	for (size_t i = 0; i < (NUM_BITSET_BYTES / sizeof(uint64_t)); i++) {
+		uint64_t b1 = bitsets[0][i];
+		uint64_t b2 = bitsets[1][i];
+		uint64_t b3 = bitsets[2][i];
+		bool found = ((b1 & b2) | (b1 & b3) | (b2 & b3)) != uint64_t(0);
+		if (found) return true;
+	}
+	return false;
+}
+
+static void anyCopyWorkerFunction(const uint8_t* __restrict fileView,
+                                  uint64_t* __restrict isFoundBitset,
+                                  CancellationToken* copyFoundToken,
+                                  const CancellationToken* externalToken,
+                                  uint64_t checkInterval,
+                                  size_t numCodes,
+                                  atomic_size_t* nextFreeCodeIndex) noexcept
+{
+	// Clear bitset
+	memset(isFoundBitset, 0, NUM_BITSET_BYTES);
+
+	StopTokens tokens;
+	tokens.internal = copyFoundToken;
+	tokens.external = externalToken;
+
+	while (true) {
+
+		// Allocate codes from shared array
+		size_t codeIndex = atomic_fetch_add(nextFreeCodeIndex, CODE_ALLOCATION_BATCH_SIZE);
+		if (codeIndex >= numCodes) return;
+		size_t codesToCheck = min(size_t(CODE_ALLOCATION_BATCH_SIZE), numCodes - codeIndex);
+
+		// Check all allocated codes, tokens are polled at least once per batch
+		uint64_t copyIndex = 0;
+		RangeResult result = searchRange(fileView, isFoundBitset, codeIndex, codeIndex + codesToCheck,
+		                                 tokens, checkInterval, copyIndex);
+		if (result == RangeResult::COPY_FOUND) {
+			copyFoundToken->cancel();
+			return;
+		}
+		if (result == RangeResult::CANCELLED) return;
+	}
+}
+
+static CancellableResult anyCopySearch(const uint8_t* __restrict fileView,
+                                       uint64_t numCodes,
+                                       const CancellationToken* externalToken,
+                                       uint64_t checkInterval) noexcept
+{
+	// Cancelled by the thread that finds a copy
+	CancellationToken copyFoundToken;
+
+	// Counter used for allocating codes
+	atomic_size_t nextFreeCodeIndex(0);
+
+	// Start threads
+	uint64_t* bitsets[NUM_THREADS];
+	thread threads[NUM_THREADS];
+	for (size_t i = 0; i < NUM_THREADS; i++) {
+
+		// Allocate memory for bitset, cleared in worker function
+		bitsets[i] = static_cast<uint64_t*>(_aligned_malloc(NUM_BITSET_BYTES, 32));
+
+		// Start worker thread
+		threads[i] = thread(anyCopyWorkerFunction, fileView, bitsets[i], &copyFoundToken,
+		                    externalToken, checkInterval, numCodes, &nextFreeCodeIndex);
+	}
+
+	// Wait for threads to finish working
+	for (thread& t : threads) {
+		t.join();
+	}
+
+	CancellableResult result;
+	result.foundCopy = copyFoundToken.isCancelled();
+
+	// Compare all threads tables, unless cancelled by caller in which case they are incomplete
+	if (!result.foundCopy) {
+		if (externalToken != nullptr && externalToken->isCancelled()) {
+			result.cancelled = true;
+		}
+		else {
+			result.foundCopy = mergeBitsets(bitsets);
+		}
+	}
+
+	// Free memory
+	for (uint64_t* bitset : bitsets) {
+		_aligned_free(bitset);
+	}
+
+	// Return result
+	return result;
+}
+
+// Multi-threaded variant, first copy
+// ------------------------------------------------------------------------------------------------
+
+// The file is split into one contiguous range per thread. The first copy in the file is the first
+// code that is either a copy within its own range, or a copy of a code in an earlier range.
+//
+// 1. Each thread fills a bitset with its range and records the first copy within the range. When
+//    a range finds a copy all later ranges are cancelled, since the answer can't be in them.
+// 2. The bitsets are OR:ed together in order so bitset t contains all codes in ranges [0, t].
+// 3. Each range t (up to the first range with a copy) is rescanned against bitset t - 1. For the
+//    range with the copy only the codes before its copy are rescanned.
+//
+// The first hit in range order is the answer, which does not depend on scheduling or the number
+// of threads since it is simply the lowest index with an earlier equal code.
+
+static void codeRange(uint64_t rangeIndex, uint64_t numCodes, uint64_t& firstOut, uint64_t& lastOut) noexcept
+{
+	uint64_t codesPerRange = (numCodes + NUM_THREADS - 1) / NUM_THREADS;
+	firstOut = min(rangeIndex * codesPerRange, numCodes);
+	lastOut = min(firstOut + codesPerRange, numCodes);
+}
+
+static void firstCopyWorkerFunction(const uint8_t* __restrict fileView,
+                                    uint64_t* __restrict isFoundBitset,
+                                    uint64_t rangeIndex,
+                                    uint64_t numCodes,
+                                    CancellationToken* rangeTokens,
+                                    const CancellationToken* externalToken,
+                                    uint64_t checkInterval,
+                                    RangeResult* resultOut,
+                                    uint64_t* copyIndexOut) noexcept
+{
+	// Clear bitset
+	memset(isFoundBitset, 0, NUM_BITSET_BYTES);
+
+	uint64_t first, last;
+	codeRange(rangeIndex, numCodes, first, last);
+
+	StopTokens tokens;
+	tokens.internal = &rangeTokens[rangeIndex];
+	tokens.external = externalToken;
+	*resultOut = searchRange(fileView, isFoundBitset, first, last, tokens, checkInterval, *copyIndexOut);
+
+	// Later ranges can't contain the first copy
+	if (*resultOut == RangeResult::COPY_FOUND) {
+		for (uint64_t i = rangeIndex + 1; i < NUM_THREADS; i++) {
+			rangeTokens[i].cancel();
+		}
+	}
+}
+
+static void rescanWorkerFunction(const uint8_t* __restrict fileView,
+                                 const uint64_t* __restrict earlierCodesBitset,
+                                 uint64_t firstCode,
+                                 uint64_t lastCode,
+                                 uint64_t rangeIndex,
+                                 CancellationToken* rangeTokens,
+                                 const CancellationToken* externalToken,
+                                 RangeResult* resultOut,
+                                 uint64_t* copyIndexOut) noexcept
+{
+	StopTokens tokens;
+	tokens.internal = &rangeTokens[rangeIndex];
+	tokens.external = externalToken;
+	*resultOut = findInBitset(fileView, earlierCodesBitset, firstCode, lastCode, tokens, *copyIndexOut);
+
+	// Later ranges can't contain the first copy
+	if (*resultOut == RangeResult::COPY_FOUND) {
+		for (uint64_t i = rangeIndex + 1; i < NUM_THREADS; i++) {
+			rangeTokens[i].cancel();
+		}
+	}
+}
+
+static CancellableResult firstCopySearch(const uint8_t* __restrict fileView,
+                                         uint64_t numCodes,
+                                         const CancellationToken* externalToken,
+                                         uint64_t checkInterval) noexcept
+{
+	CancellableResult result;
+	uint64_t* bitsets[NUM_THREADS];
+	thread threads[NUM_THREADS];
+	RangeResult rangeResults[NUM_THREADS];
+	uint64_t copyIndices[NUM_THREADS];
+
+	// 1. Fill bitsets and find first copy within each range
+	CancellationToken rangeTokens[NUM_THREADS];
+	for (uint64_t i = 0; i < NUM_THREADS; i++) {
+		bitsets[i] = static_cast<uint64_t*>(_aligned_malloc(NUM_BITSET_BYTES, 32));
+		threads[i] = thread(firstCopyWorkerFunction, fileView, bitsets[i], i, numCodes, rangeTokens,
+		                    externalToken, checkInterval, &rangeResults[i], &copyIndices[i]);
+	}
+	for (thread& t : threads) {
+		t.join();
+	}
+
+	// First range with a copy within itself, all ranges before it must have completed
+	uint64_t firstRangeWithCopy = NUM_THREADS;
+	for (uint64_t i = 0; i < NUM_THREADS; i++) {
+		if (rangeResults[i] == RangeResult::COPY_FOUND) {
+			firstRangeWithCopy = i;
+			break;
+		}
+		if (rangeResults[i] == RangeResult::CANCELLED) {
+			result.cancelled = true;
+			break;
+		}
+	}
+
+	// 2. Accumulate bitsets, only needed up to the range before the last range to rescan
+	uint64_t lastRangeToRescan = min(firstRangeWithCopy, NUM_THREADS - 1);
+	for (uint64_t i = 1; !result.cancelled && i < lastRangeToRescan; i++) {
+		for (size_t j = 0; j < (NUM_BITSET_BYTES / sizeof(uint64_t)); j++) {
+			bitsets[i][j] |= bitsets[i - 1][j];
+		}
+	}
+
+	// 3. Rescan ranges against the codes in all earlier ranges
+	RangeResult rescanResults[NUM_THREADS];
+	uint64_t rescanCopyIndices[NUM_THREADS];
+	CancellationToken rescanTokens[NUM_THREADS];
+	uint64_t numRescanThreads = 0;
+	for (uint64_t i = 1; !result.cancelled && i <= lastRangeToRescan; i++) {
+		uint64_t first, last;
+		codeRange(i, numCodes, first, last);
+		if (i == firstRangeWithCopy) last = copyIndices[i];
+		rescanResults[i] = RangeResult::NO_COPY;
+		threads[i - 1] = thread(rescanWorkerFunction, fileView, bitsets[i - 1], first, last, i,
+		                        rescanTokens, externalToken, &rescanResults[i], &rescanCopyIndices[i]);
+		numRescanThreads += 1;
+	}
+	for (uint64_t i = 0; i < numRescanThreads; i++) {
+		threads[i].join();
+	}
+
+	// The first hit in range order is the first copy in the file
+	for (uint64_t i = 1; !result.cancelled && i <= lastRangeToRescan; i++) {
+		if (rescanResults[i] == RangeResult::COPY_FOUND) {
+			result.foundCopy = true;
+			result.firstCopyOffset = rescanCopyIndices[i] * BYTES_PER_CODE;
+			break;
+		}
+		if (rescanResults[i] == RangeResult::CANCELLED) {
+			result.cancelled = true;
+		}
+	}
+	if (!result.cancelled && !result.foundCopy && firstRangeWithCopy < NUM_THREADS) {
+		result.foundCopy = true;
+		result.firstCopyOffset = copyIndices[firstRangeWithCopy] * BYTES_PER_CODE;
+	}
+
+	// Free memory
+	for (uint64_t* bitset : bitsets) {
+		_aligned_free(bitset);
+	}
+
+	// Return result
+	return result;
+}
+
+// Exposed functions
+// ------------------------------------------------------------------------------------------------
+
+CancellableResult cancellableSearch(const char* filePath, CancellableMode mode,
+                                    CancellationToken* token, bool checkInsideBatches) noexcept
+{
+	CancellableResult result;
+
+	// Open file
+	HANDLE file = CreateFile(filePath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+	                         FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (file == INVALID_HANDLE_VALUE) {
+		printf("CreateFile() failed\n");
+		return result;
+	}
+
+	// Get size of file
+	uint64_t fileSize = static_cast<uint64_t>(GetFileSize(file, NULL));
+
+	// Large file fast path
+	// There are a total of 17 576 000 different codes. If the file contains more codes than that
+	// it must also by definition contain a copy. The position of the first copy is still unknown.
+	if (mode == CancellableMode::ANY_COPY && fileSize >= ((MAX_NUMBER_CODES + 1) * BYTES_PER_CODE)) {
+		CloseHandle(file);
+		result.foundCopy = true;
+		return result;
+	}
+
+	// The first copy must be within the first 17 576 001 codes, no need to look further
+	uint64_t numCodes = numCodesInText(fileSize, BYTES_PER_CODE);
+	if (mode == CancellableMode::FIRST_COPY) {
+		numCodes = min(numCodes, MAX_NUMBER_CODES + 1);
+	}
+
+	// Create mapped file
+	HANDLE mappedFile = CreateFileMapping(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (!mappedFile) {
+		printf("CreateFileMapping() failed\n");
+		CloseHandle(file);
+		return result;
+	}
+
+	// Create mapped file view
+	void* fileView = MapViewOfFile(mappedFile, FILE_MAP_READ, 0, 0, fileSize);
+	if (!fileView) {
+		printf("MapViewOfFile() failed\n");
+		CloseHandle(mappedFile);
+		CloseHandle(file);
+		return result;
+	}
+
+	// Poll tokens every batch, or more often if requested
+	uint64_t checkInterval = checkInsideBatches ? CANCELLATION_CHECK_INTERVAL : CODE_ALLOCATION_BATCH_SIZE;
+
+	// Single threaded path
+	const uint8_t* codes = static_cast<const uint8_t*>(fileView);
+	if (numCodes <= NUM_CODES_MULTI_THREADED_THRESHOLD) {
+		result = singleThreadedSearch(codes, numCodes, mode, token, checkInterval);
+	}
+
+	// Multi-threaded path
+	else if (mode == CancellableMode::ANY_COPY) {
+		result = anyCopySearch(codes, numCodes, token, checkInterval);
+	}
+	else {
+		result = firstCopySearch(codes, numCodes, token, checkInterval);
+	}
+
+	// Unmap mapped file view
+	if (!UnmapViewOfFile(fileView)) {
+		printf("UnmapViewOfFile() failed\n");
+		CloseHandle(mappedFile);
+		CloseHandle(file);
+		return CancellableResult();
+	}
+
+	// Close mapped file
+	if (!CloseHandle(mappedFile)) {
+		printf("CloseHandle() failed for mappedFile\n");
+		return CancellableResult();
+	}
+
+	// Close file
+	if (!CloseHandle(file)) {
+		printf("CloseHandle() failed for file\n");
+		return CancellableResult();
+	}
+
+	// Return result
+	return result;
+}
+
+bool cancellableAlgorithm(const char* filePath) noexcept
+{
+	return cancellableSearch(filePath, CancellableMode::ANY_COPY).foundCopy;
+}
+
+bool cancellableFirstCopyAlgorithm(const char* filePath) noexcept
+{
+	return cancellableSearch(filePath, CancellableMode::FIRST_COPY).foundCopy;
+}
@@ -0,0 +1,44 @@
+// Copyright(c) Peter Hillerstrm(skipifzero.com, peter@hstroem.se)
+
+#pragma once
+
+#include <cstdint>
+
+#include "CancellationToken.hpp"
+
+// Same as optimizedSmartAlgorithm7(), but the worker threads are stopped through a
+// CancellationToken instead of exhausting the shared code counter. Can also find the first copy in
+// the file, i.e. the lowest file offset at which a copy becomes detectable.
+
+enum class CancellableMode : uint8_t {
+	// Stop as soon as any thread finds a copy, which copy is found depends on scheduling
+	ANY_COPY,
+
+	// Find the first code in the file which is a copy of an earlier code. The result is the same
+	// regardless of number of threads or scheduling, at the cost of a second pass over the file.
+	FIRST_COPY
+};
+
+struct CancellableResult final {
+	bool foundCopy = false;
+
+	// Whether the search was cancelled through the caller's token before it completed, the other
+	// members are not valid if set
+	bool cancelled = false;
+
+	// File offset of the start of the first line containing a copy, only set in FIRST_COPY mode
+	uint64_t firstCopyOffset = ~uint64_t(0);
+};
+
+// Searches the file for copies. The optional token can be used to cancel the search from another
+// thread. If checkInsideBatches is set the token is also polled inside each batch of codes, which
+// reduces latency of cancellation at a small cost in throughput.
+CancellableResult cancellableSearch(const char* filePath, CancellableMode mode,
+                                    CancellationToken* token = nullptr,
+                                    bool checkInsideBatches = false) noexcept;
+
+// ANY_COPY search
+bool cancellableAlgorithm(const char* filePath) noexcept;
+
+// FIRST_COPY search
+bool cancellableFirstCopyAlgorithm(const char* filePath) noexcept;
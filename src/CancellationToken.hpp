@@ -0,0 +1,27 @@
+// Copyright(c) Peter Hillerstrm(skipifzero.com, peter@hstroem.se)
+
+#pragma once
+
+#include <atomic>
+
+// Cancellation token
+// ------------------------------------------------------------------------------------------------
+
+// Flag used to cooperatively stop worker threads. Workers poll isCancelled() at batch boundaries
+// (and optionally inside batches) and return early once it is set.
+//
+// Relaxed memory order is used on purpose. The token only signals that remaining work may be
+// skipped, it does not publish any data. Results are communicated through the thread joins.
+class CancellationToken final {
+public:
+	CancellationToken() noexcept : mCancelled(false) { }
+	CancellationToken(const CancellationToken&) = delete;
+	CancellationToken& operator= (const CancellationToken&) = delete;
+
+	void cancel() noexcept { mCancelled.store(true, std::memory_order_relaxed); }
+	bool isCancelled() const noexcept { return mCancelled.load(std::memory_order_relaxed); }
+	void reset() noexcept { mCancelled.store(false, std::memory_order_relaxed); }
+
+private:
+	std::atomic_bool mCancelled;
+};
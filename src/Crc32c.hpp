@@ -0,0 +1,32 @@
+// Copyright(c) Peter Hillerstrm(skipifzero.com, peter@hstroem.se)
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+#include <nmmintrin.h>
+
+// Calculates the CRC-32C (Castagnoli) checksum of the specified bytes using the SSE 4.2 crc32
+// instruction. An existing checksum can be passed as initial value to continue a calculation.
+inline uint32_t crc32c(const void* data, uint64_t numBytes, uint32_t initial = 0) noexcept
+{
+	const uint8_t* bytes = static_cast<const uint8_t*>(data);
+	uint64_t crc = ~initial;
+
+	// 8 bytes at a time
+	uint64_t numLongs = numBytes / 8;
+	for (uint64_t i = 0; i < numLongs; i++) {
+		uint64_t value;
+		memcpy(&value, bytes + i * 8, sizeof(uint64_t));
+		crc = _mm_crc32_u64(crc, value);
+	}
+
+	// Remaining bytes
+	uint32_t crc32 = uint32_t(crc);
+	for (uint64_t i = numLongs * 8; i < numBytes; i++) {
+		crc32 = _mm_crc32_u8(crc32, bytes[i]);
+	}
+
+	return ~crc32;
+}
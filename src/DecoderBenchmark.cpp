@@ -0,0 +1,150 @@
+// Copyright(c) Peter Hillerstrm(skipifzero.com, peter@hstroem.se)
+
+#include "DecoderBenchmark.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "PlateDecoders.hpp"
+
+using namespace std;
+
+// Constants
+// ------------------------------------------------------------------------------------------------
+
+static const uint64_t NUM_BENCHMARK_ITERATIONS = 64;
+
+// Extra bytes at end of code buffers, the LF variant of decode8Avx2() reads past the last code
+static const uint64_t CODE_BUFFER_PADDING = 32;
+
+// Decoder loops
+// ------------------------------------------------------------------------------------------------
+
+// Each loop writes the decoded indices to the output array so the decoding can't be optimized away
+// and so the result can be compared against the scalar decoder.
+
+template<uint64_t BYTES_PER_CODE>
+static void decodeAllScalar(const uint8_t* codes, uint64_t numCodes, uint32_t* numbersOut) noexcept
+{
+	for (uint64_t i = 0; i < numCodes; i++) {
+		numbersOut[i] = decodeScalar(codes + i * BYTES_PER_CODE);
+	}
+}
+
+template<uint64_t BYTES_PER_CODE>
+static void decodeAllSse(const uint8_t* codes, uint64_t numCodes, uint32_t* numbersOut) noexcept
+{
+	for (uint64_t i = 0; i < numCodes; i++) {
+		numbersOut[i] = decodeSse(codes + i * BYTES_PER_CODE);
+	}
+}
+
+template<uint64_t BYTES_PER_CODE>
+static void decodeAllPairLookup(const uint8_t* codes, uint64_t numCodes, uint32_t* numbersOut) noexcept
+{
+	for (uint64_t i = 0; i < numCodes; i++) {
+		numbersOut[i] = decodePairLookup(codes + i * BYTES_PER_CODE);
+	}
+}
+
+template<uint64_t BYTES_PER_CODE>
+static void decodeAllAvx2(const uint8_t* codes, uint64_t numCodes, uint32_t* numbersOut) noexcept
+{
+	uint64_t numVectorCodes = numCodes & ~uint64_t(7);
+	for (uint64_t i = 0; i < numVectorCodes; i += 8) {
+		__m256i numbers = decode8Avx2<BYTES_PER_CODE>(codes + i * BYTES_PER_CODE);
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(numbersOut + i), numbers);
+	}
+	for (uint64_t i = numVectorCodes; i < numCodes; i++) {
+		numbersOut[i] = decodeScalar(codes + i * BYTES_PER_CODE);
+	}
+}
+
+// Benchmark
+// ------------------------------------------------------------------------------------------------
+
+typedef void DecodeAllFunction(const uint8_t* codes, uint64_t numCodes, uint32_t* numbersOut);
+
+static void benchmarkDecoder(const char* name, DecodeAllFunction* decodeAll, const uint8_t* codes,
+                             uint64_t numCodes, const uint32_t* referenceNumbers,
+                             uint32_t* numbersOut) noexcept
+{
+	memset(numbersOut, 0, numCodes * sizeof(uint32_t));
+
+	auto startTime = chrono::high_resolution_clock::now();
+	for (uint64_t i = 0; i < NUM_BENCHMARK_ITERATIONS; i++) {
+		decodeAll(codes, numCodes, numbersOut);
+	}
+	auto endTime = chrono::high_resolution_clock::now();
+
+	double nanoseconds = chrono::duration<double, nano>(endTime - startTime).count();
+	double nanosecondsPerCode = nanoseconds / double(NUM_BENCHMARK_ITERATIONS * numCodes);
+	bool correct = memcmp(numbersOut, referenceNumbers, numCodes * sizeof(uint32_t)) == 0;
+
+	printf("  %-12s %.3f ns/code%s\n", name, nanosecondsPerCode, correct ? "" : " (INCORRECT)");
+}
+
+template<uint64_t BYTES_PER_CODE>
+static void benchmarkDecoders(const char* lineEndingName, const uint8_t* codes, uint64_t numCodes) noexcept
+{
+	printf("Decoders, %s (%llu codes):\n", lineEndingName, (unsigned long long)numCodes);
+
+	vector<uint32_t> referenceNumbers(numCodes);
+	vector<uint32_t> numbers(numCodes);
+	decodeAllScalar<BYTES_PER_CODE>(codes, numCodes, referenceNumbers.data());
+
+	benchmarkDecoder("Scalar", decodeAllScalar<BYTES_PER_CODE>, codes, numCodes,
+	                 referenceNumbers.data(), numbers.data());
+	benchmarkDecoder("SSE", decodeAllSse<BYTES_PER_CODE>, codes, numCodes,
+	                 referenceNumbers.data(), numbers.data());
+	benchmarkDecoder("Pair lookup", decodeAllPairLookup<BYTES_PER_CODE>, codes, numCodes,
+	                 referenceNumbers.data(), numbers.data());
+	benchmarkDecoder("AVX2", decodeAllAvx2<BYTES_PER_CODE>, codes, numCodes,
+	                 referenceNumbers.data(), numbers.data());
+}
+
+// Exposed function
+// ------------------------------------------------------------------------------------------------
+
+void benchmarkDecoders(const char* filePath) noexcept
+{
+	// Read file
+	FILE* file = fopen(filePath, "rb");
+	if (file == nullptr) {
+		printf("Could not open \"%s\" for decoder benchmark\n", filePath);
+		return;
+	}
+	vector<uint8_t> fileContents;
+	uint8_t buffer[4096];
+	size_t numRead;
+	while ((numRead = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+		fileContents.insert(fileContents.end(), buffer, buffer + numRead);
+	}
+	fclose(file);
+
+	// Create CR+LF and LF versions of the codes, regardless of line endings in the file
+	vector<uint8_t> crlfCodes;
+	vector<uint8_t> lfCodes;
+	uint64_t numCodes = 0;
+	for (size_t i = 0; i + 6 <= fileContents.size(); numCodes++) {
+		const uint8_t* code = fileContents.data() + i;
+		crlfCodes.insert(crlfCodes.end(), code, code + 6);
+		crlfCodes.push_back('\r');
+		crlfCodes.push_back('\n');
+		lfCodes.insert(lfCodes.end(), code, code + 6);
+		lfCodes.push_back('\n');
+
+		i += 6;
+		if (i < fileContents.size() && fileContents[i] == '\r') i++;
+		if (i < fileContents.size() && fileContents[i] == '\n') i++;
+	}
+	crlfCodes.resize(crlfCodes.size() + CODE_BUFFER_PADDING, 0);
+	lfCodes.resize(lfCodes.size() + CODE_BUFFER_PADDING, 0);
+
+	benchmarkDecoders<8>("CR+LF", crlfCodes.data(), numCodes);
+	benchmarkDecoders<7>("LF", lfCodes.data(), numCodes);
+	printf("\n");
+}
@@ -0,0 +1,8 @@
+// Copyright(c) Peter Hillerstrm(skipifzero.com, peter@hstroem.se)
+
+#pragma once
+
+// Benchmarks the decoders in PlateDecoders.hpp (scalar, SSE, pair lookup and AVX2) against each
+// other on the codes in the specified file, both with CR+LF and LF line endings. Prints the average
+// time per code for each decoder and whether it agrees with the scalar decoder.
+void benchmarkDecoders(const char* filePath) noexcept;
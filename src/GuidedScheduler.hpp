@@ -0,0 +1,141 @@
+// Copyright(c) Peter Hillerstrm(skipifzero.com, peter@hstroem.se)
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+
+// Guided scheduler
+// ------------------------------------------------------------------------------------------------
+
+// Distributes the items [0, numItems) over a number of threads.
+//
+// Each thread starts out owning a large contiguous range, an equal share of all items. A thread
+// claims chunks from the front of its own range, and the chunk size shrinks as the range runs out
+// (remaining / GUIDED_CHUNK_DIVISOR, but at least the minimum chunk size). When its own range is
+// empty a thread steals the back half of the range of the thread with the most remaining items.
+//
+// Compared to claiming fixed size batches from one shared atomic counter, threads mostly touch
+// their own cache line, and threads that fall behind get work taken off their hands.
+//
+// Each range is packed into a single 64 bit atomic, [begin, end) as (begin << 32) | end, so a
+// range can be claimed from or stolen from with a single compare and swap.
+
+static const uint32_t GUIDED_SCHEDULER_MAX_THREADS = 64;
+static const uint64_t GUIDED_CHUNK_DIVISOR = 8;
+
+struct GuidedSchedulerStats final {
+	uint64_t numClaims = 0; // Number of chunks claimed from own range
+	uint64_t numSteals = 0; // Number of successful steals from other threads
+	uint64_t numItems = 0; // Number of items processed
+	double busyTimeMs = 0.0; // Time spent processing claimed chunks, filled in by user
+	double idleTimeMs = 0.0; // Time spent not processing, filled in by user
+};
+
+class GuidedScheduler final {
+public:
+	GuidedScheduler(const GuidedScheduler&) = delete;
+	GuidedScheduler& operator= (const GuidedScheduler&) = delete;
+
+	GuidedScheduler(uint64_t numItems, uint32_t numThreads, uint32_t minChunkSize) noexcept
+	:
+		mNumThreads(std::min(numThreads, GUIDED_SCHEDULER_MAX_THREADS)),
+		mMinChunkSize(std::max(minChunkSize, 1u))
+	{
+		uint64_t itemsPerThread = (numItems + mNumThreads - 1) / mNumThreads;
+		for (uint32_t i = 0; i < mNumThreads; i++) {
+			uint64_t begin = std::min(i * itemsPerThread, numItems);
+			uint64_t end = std::min(begin + itemsPerThread, numItems);
+			mThreads[i].range.store(pack(begin, end), std::memory_order_relaxed);
+		}
+	}
+
+	// Claims the next chunk [firstOut, lastOut) for the specified thread. Returns false when there
+	// is no work left to claim or steal.
+	bool claim(uint32_t threadIndex, uint64_t& firstOut, uint64_t& lastOut) noexcept
+	{
+		ThreadState& self = mThreads[threadIndex];
+		while (true) {
+			if (claimOwn(self, firstOut, lastOut)) {
+				self.stats.numClaims += 1;
+				self.stats.numItems += lastOut - firstOut;
+				return true;
+			}
+			if (!steal(threadIndex)) return false;
+			self.stats.numSteals += 1;
+		}
+	}
+
+	uint32_t numThreads() const noexcept { return mNumThreads; }
+
+	// Stats of a thread, should only be modified by the thread itself while scheduling is running
+	GuidedSchedulerStats& stats(uint32_t threadIndex) noexcept { return mThreads[threadIndex].stats; }
+
+private:
+	struct alignas(64) ThreadState final {
+		std::atomic<uint64_t> range;
+		GuidedSchedulerStats stats;
+	};
+
+	static uint64_t pack(uint64_t begin, uint64_t end) noexcept { return (begin << 32) | end; }
+	static uint64_t begin(uint64_t range) noexcept { return range >> 32; }
+	static uint64_t end(uint64_t range) noexcept { return range & uint64_t(0xFFFFFFFF); }
+
+	bool claimOwn(ThreadState& self, uint64_t& firstOut, uint64_t& lastOut) noexcept
+	{
+		uint64_t range = self.range.load(std::memory_order_relaxed);
+		while (true) {
+			uint64_t first = begin(range);
+			uint64_t last = end(range);
+			if (first >= last) return false;
+
+			uint64_t remaining = last - first;
+			uint64_t chunkSize = std::min(remaining, std::max(uint64_t(mMinChunkSize),
+			                                                  remaining / GUIDED_CHUNK_DIVISOR));
+			if (self.range.compare_exchange_weak(range, pack(first + chunkSize, last),
+			                                     std::memory_order_relaxed)) {
+				firstOut = first;
+				lastOut = first + chunkSize;
+				return true;
+			}
+		}
+	}
+
+	// Steals the back half of the largest remaining range into the thread's own (empty) range.
+	// Only non-empty ranges are ever modified by other threads, so the thread's own range can be
+	// written directly.
+	bool steal(uint32_t threadIndex) noexcept
+	{
+		while (true) {
+
+			// Find victim with the most remaining items, not worth stealing less than 2 chunks
+			uint32_t victimIndex = mNumThreads;
+			uint64_t victimRange = 0;
+			uint64_t victimRemaining = 2 * uint64_t(mMinChunkSize) - 1;
+			for (uint32_t i = 0; i < mNumThreads; i++) {
+				if (i == threadIndex) continue;
+				uint64_t range = mThreads[i].range.load(std::memory_order_relaxed);
+				uint64_t remaining = begin(range) < end(range) ? end(range) - begin(range) : 0;
+				if (remaining > victimRemaining) {
+					victimIndex = i;
+					victimRange = range;
+					victimRemaining = remaining;
+				}
+			}
+			if (victimIndex == mNumThreads) return false;
+
+			// Try to take the back half, retry from start if victim changed in between
+			uint64_t middle = begin(victimRange) + victimRemaining / 2;
+			if (mThreads[victimIndex].range.compare_exchange_strong(victimRange,
+			    pack(begin(victimRange), middle), std::memory_order_relaxed)) {
+				mThreads[threadIndex].range.store(pack(middle, end(victimRange)), std::memory_order_relaxed);
+				return true;
+			}
+		}
+	}
+
+	uint32_t mNumThreads;
+	uint32_t mMinChunkSize;
+	ThreadState mThreads[GUIDED_SCHEDULER_MAX_THREADS];
+};
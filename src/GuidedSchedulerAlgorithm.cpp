@@ -0,0 +1,355 @@
+// Copyright(c) Peter Hillerstrm(skipifzero.com, peter@hstroem.se)
+
+#include "GuidedSchedulerAlgorithm.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#include <malloc.h>
+
+#include "CancellationToken.hpp"
+#include "PlateDecoders.hpp"
+
+using namespace std;
+
+// Constants
+// ------------------------------------------------------------------------------------------------
+
+static const uint64_t MAX_NUMBER_CODES = 17576000;
+static const uint64_t BYTES_PER_CODE = 8; // Assumes Windows file endings (2 bytes per newline)
+static const uint64_t NUM_BITSET_BYTES = (MAX_NUMBER_CODES / 8);
+
+static const uint64_t NUM_THREADS = GUIDED_SCHEDULER_ALGORITHM_NUM_THREADS;
+static const uint64_t CODE_ALLOCATION_BATCH_SIZE = 4096;
+static const uint64_t NUM_CODES_MULTI_THREADED_THRESHOLD = 600000;
+
+// Smallest chunk claimed by the guided scheduler
+static const uint32_t GUIDED_MIN_CHUNK_SIZE = 1024;
+
+// Number of codes between each poll of the cancellation token, guided chunks can be large
+static const uint64_t CANCELLATION_CHECK_INTERVAL = 4096;
+
+// Search
+// ------------------------------------------------------------------------------------------------
+
+static uint32_t decodeCode(const uint8_t* __restrict code) noexcept
+{
+	return uint32_t(code[0] - 'A') * 676000u +
+	       uint32_t(code[1] - 'A') * 26000u +
+	       uint32_t(code[2] - 'A') * 1000u +
+	       uint32_t(code[3] - '0') * 100u +
+	       uint32_t(code[4] - '0') * 10u +
+	       uint32_t(code[5] - '0');
+}
+
+// Checks the codes in range [firstCode, lastCode) against and inserts them into the bitset. Stops
+// early and returns false if the token is cancelled.
+static bool searchRange(const uint8_t* __restrict fileView,
+                        uint64_t* __restrict isFoundBitset,
+                        uint64_t firstCode,
+                        uint64_t lastCode,
+                        const CancellationToken& copyFoundToken) noexcept
+{
+	for (uint64_t chunkStart = firstCode; chunkStart < lastCode; chunkStart += CANCELLATION_CHECK_INTERVAL) {
+		if (copyFoundToken.isCancelled()) return false;
+
+		uint64_t chunkEnd = min(chunkStart + CANCELLATION_CHECK_INTERVAL, lastCode);
+		for (uint64_t i = chunkStart; i < chunkEnd; i++) {
+			uint32_t number = decodeCode(fileView + i * BYTES_PER_CODE);
+
+			uint32_t bitsetChunkIndex = number >> 6u; // number / 64;
+			uint32_t bitIndex = number & 0x0000003Fu; // number % 64;
+
+			uint64_t chunk = isFoundBitset[bitsetChunkIndex];
+			uint64_t bitMask = uint64_t(1) << bitIndex;
+
+			if ((bitMask & chunk) != uint64_t(0)) {
+				return true;
+			}
+
+			chunk = bitMask | chunk;
+			isFoundBitset[bitsetChunkIndex] = chunk;
+		}
+	}
+	return false;
+}
+
+// Single threaded variant
+// ------------------------------------------------------------------------------------------------
+
+static bool singleThreadedSearch(const uint8_t* __restrict fileView, uint64_t numCodes) noexcept
+{
+	// Allocate bitset buffer for whether a number is found or not, and clear it
+	uint64_t* isFoundBitset = static_cast<uint64_t*>(_aligned_malloc(NUM_BITSET_BYTES, 32));
+	memset(isFoundBitset, 0, NUM_BITSET_BYTES);
+
+	// Check all codes in file
+	CancellationToken neverCancelled;
+	bool foundCopy = searchRange(fileView, isFoundBitset, 0, numCodes, neverCancelled);
+
+	// Free allocated bitset memory
+	_aligned_free(isFoundBitset);
+
+	// Return result
+	return foundCopy;
+}
+
+// Multi-threaded variant
+// ------------------------------------------------------------------------------------------------
+
+using time_point = chrono::high_resolution_clock::time_point;
+
+static double millisecondsBetween(time_point start, time_point end) noexcept
+{
+	return chrono::duration<double, milli>(end - start).count();
+}
+
+static bool mergeBitsets(uint64_t* bitsets[NUM_THREADS]) noexcept
+{
+	static_assert(NUM_THREADS == 3, "mergeBitsets() assumes 3 threads");
+	for (size_t i = 0; i < (NUM_BITSET_BYTES / sizeof(uint64_t)); i++) {
+		uint64_t b1 = bitsets[0][i];
+		uint64_t b2 = bitsets[1][i];
+		uint64_t b3 = bitsets[2][i];
+		bool found = ((b1 & b2) | (b1 & b3) | (b2 & b3)) != uint64_t(0);
+		if (found) return true;
+	}
+	return false;
+}
+
+static void sharedCounterWorkerFunction(const uint8_t* __restrict fileView,
+                                        uint64_t* __restrict isFoundBitset,
+                                        CancellationToken* copyFoundToken,
+                                        size_t numCodes,
+                                        atomic_size_t* nextFreeCodeIndex,
+                                        GuidedSchedulerStats* stats) noexcept
+{
+	// Clear bitset
+	memset(isFoundBitset, 0, NUM_BITSET_BYTES);
+
+	while (!copyFoundToken->isCancelled()) {
+
+		// Allocate codes from shared array
+		size_t codeIndex = atomic_fetch_add(nextFreeCodeIndex, CODE_ALLOCATION_BATCH_SIZE);
+		if (codeIndex >= numCodes) return;
+		size_t codesToCheck = min(size_t(CODE_ALLOCATION_BATCH_SIZE), numCodes - codeIndex);
+		stats->numClaims += 1;
+		stats->numItems += codesToCheck;
+
+		// Check all allocated codes
+		time_point startTime = chrono::high_resolution_clock::now();
+		bool found = searchRange(fileView, isFoundBitset, codeIndex, codeIndex + codesToCheck, *copyFoundToken);
+		stats->busyTimeMs += millisecondsBetween(startTime, chrono::high_resolution_clock::now());
+
+		if (found) {
+			copyFoundToken->cancel();
+			return;
+		}
+	}
+}
+
+static void guidedWorkerFunction(const uint8_t* __restrict fileView,
+                                 uint64_t* __restrict isFoundBitset,
+                                 CancellationToken* copyFoundToken,
+                                 GuidedScheduler* scheduler,
+                                 uint32_t threadIndex) noexcept
+{
+	// Clear bitset
+	memset(isFoundBitset, 0, NUM_BITSET_BYTES);
+
+	GuidedSchedulerStats& stats = scheduler->stats(threadIndex);
+	uint64_t firstCode = 0, lastCode = 0;
+	while (!copyFoundToken->isCancelled() && scheduler->claim(threadIndex, firstCode, lastCode)) {
+
+		// Check all claimed codes
+		time_point startTime = chrono::high_resolution_clock::now();
+		bool found = searchRange(fileView, isFoundBitset, firstCode, lastCode, *copyFoundToken);
+		stats.busyTimeMs += millisecondsBetween(startTime, chrono::high_resolution_clock::now());
+
+		if (found) {
+			copyFoundToken->cancel();
+			return;
+		}
+	}
+}
+
+static bool multiThreadedSearch(const uint8_t* __restrict fileView, uint64_t numCodes,
+                                SchedulingMode mode, GuidedSchedulerStats* statsOut) noexcept
+{
+	// Cancelled by the thread that finds a copy
+	CancellationToken copyFoundToken;
+
+	// Schedulers, only the one for the current mode is used
+	atomic_size_t nextFreeCodeIndex(0);
+	GuidedSchedulerStats sharedCounterStats[NUM_THREADS];
+	GuidedScheduler* scheduler = new GuidedScheduler(numCodes, NUM_THREADS, GUIDED_MIN_CHUNK_SIZE);
+
+	// Start threads
+	time_point startTime = chrono::high_resolution_clock::now();
+	uint64_t* bitsets[NUM_THREADS];
+	thread threads[NUM_THREADS];
+	for (uint32_t i = 0; i < NUM_THREADS; i++) {
+
+		// Allocate memory for bitset, cleared in worker function
+		bitsets[i] = static_cast<uint64_t*>(_aligned_malloc(NUM_BITSET_BYTES, 32));
+
+		// Start worker thread
+		if (mode == SchedulingMode::SHARED_COUNTER) {
+			threads[i] = thread(sharedCounterWorkerFunction, fileView, bitsets[i], &copyFoundToken,
+			                    numCodes, &nextFreeCodeIndex, &sharedCounterStats[i]);
+		}
+		else {
+			threads[i] = thread(guidedWorkerFunction, fileView, bitsets[i], &copyFoundToken,
+			                    scheduler, i);
+		}
+	}
+
+	// Wait for threads to finish working
+	for (thread& t : threads) {
+		t.join();
+	}
+	double totalTimeMs = millisecondsBetween(startTime, chrono::high_resolution_clock::now());
+
+	// Compare all threads tables
+	bool foundCopy = copyFoundToken.isCancelled() || mergeBitsets(bitsets);
+
+	// Write stats, idle time is everything between start of search and the last thread finishing
+	// that wasn't spent searching
+	if (statsOut != nullptr) {
+		for (uint32_t i = 0; i < NUM_THREADS; i++) {
+			statsOut[i] = mode == SchedulingMode::SHARED_COUNTER ? sharedCounterStats[i] : scheduler->stats(i);
+			statsOut[i].idleTimeMs = max(0.0, totalTimeMs - statsOut[i].busyTimeMs);
+		}
+	}
+
+	// Free memory
+	delete scheduler;
+	for (uint64_t* bitset : bitsets) {
+		_aligned_free(bitset);
+	}
+
+	// Return result
+	return foundCopy;
+}
+
+// Search
+// ------------------------------------------------------------------------------------------------
+
+static bool guidedSchedulerSearch(const char* filePath, bool forceMultiThreaded, SchedulingMode mode,
+                                  GuidedSchedulerStats* statsOut) noexcept
+{
+	// Open file
+	HANDLE file = CreateFile(filePath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+	                         FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (file == INVALID_HANDLE_VALUE) {
+		printf("CreateFile() failed\n");
+		return false;
+	}
+
+	// Get size of file
+	uint64_t fileSize = static_cast<uint64_t>(GetFileSize(file, NULL));
+
+	// Large file fast path
+	// There are a total of 17 576 000 different codes. If the file contains more codes than that
+	// it must also by definition contain a copy.
+	if (!forceMultiThreaded && fileSize >= ((MAX_NUMBER_CODES + 1) * BYTES_PER_CODE)) {
+		CloseHandle(file);
+		return true;
+	}
+
+	// Create mapped file
+	HANDLE mappedFile = CreateFileMapping(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (!mappedFile) {
+		printf("CreateFileMapping() failed\n");
+		CloseHandle(file);
+		return false;
+	}
+
+	// Create mapped file view
+	void* fileView = MapViewOfFile(mappedFile, FILE_MAP_READ, 0, 0, fileSize);
+	if (!fileView) {
+		printf("MapViewOfFile() failed\n");
+		CloseHandle(mappedFile);
+		CloseHandle(file);
+		return false;
+	}
+
+	// Result variable
+	bool foundCopy = false;
+
+	// Single threaded path
+	uint64_t numCodes = numCodesInText(fileSize, BYTES_PER_CODE);
+	if (!forceMultiThreaded && numCodes <= NUM_CODES_MULTI_THREADED_THRESHOLD) {
+		foundCopy = singleThreadedSearch(static_cast<const uint8_t*>(fileView), numCodes);
+	}
+
+	// Multi-threaded path
+	else {
+		foundCopy = multiThreadedSearch(static_cast<const uint8_t*>(fileView), numCodes, mode, statsOut);
+	}
+
+	// Unmap mapped file view
+	if (!UnmapViewOfFile(fileView)) {
+		printf("UnmapViewOfFile() failed\n");
+		CloseHandle(mappedFile);
+		CloseHandle(file);
+		return false;
+	}
+
+	// Close mapped file
+	if (!CloseHandle(mappedFile)) {
+		printf("CloseHandle() failed for mappedFile\n");
+		return false;
+	}
+
+	// Close file
+	if (!CloseHandle(file)) {
+		printf("CloseHandle() failed for file\n");
+		return false;
+	}
+
+	// Return result
+	return foundCopy;
+}
+
+// Exposed functions
+// ------------------------------------------------------------------------------------------------
+
+bool guidedSchedulerAlgorithm(const char* filePath) noexcept
+{
+	return guidedSchedulerSearch(filePath, false, SchedulingMode::GUIDED, nullptr);
+}
+
+bool guidedSchedulerSearchWithStats(const char* filePath, SchedulingMode mode,
+                                    GuidedSchedulerStats* statsOut) noexcept
+{
+	for (uint32_t i = 0; i < NUM_THREADS; i++) {
+		statsOut[i] = GuidedSchedulerStats();
+	}
+	return guidedSchedulerSearch(filePath, true, mode, statsOut);
+}
+
+void printSchedulerStats(const char* filePath) noexcept
+{
+	for (SchedulingMode mode : { SchedulingMode::SHARED_COUNTER, SchedulingMode::GUIDED }) {
+		GuidedSchedulerStats stats[NUM_THREADS];
+		guidedSchedulerSearchWithStats(filePath, mode, stats);
+
+		printf("Scheduler stats, %s on \"%s\":\n",
+		       mode == SchedulingMode::SHARED_COUNTER ? "shared counter" : "guided", filePath);
+		for (uint32_t i = 0; i < NUM_THREADS; i++) {
+			printf("  Thread %u: %llu claims, %llu steals, %llu codes, busy %.3f ms, idle %.3f ms\n", i,
+			       (unsigned long long)stats[i].numClaims, (unsigned long long)stats[i].numSteals,
+			       (unsigned long long)stats[i].numItems, stats[i].busyTimeMs, stats[i].idleTimeMs);
+		}
+	}
+	printf("\n");
+}
@@ -0,0 +1,30 @@
+// Copyright(c) Peter Hillerstrm(skipifzero.com, peter@hstroem.se)
+
+#pragma once
+
+#include <cstdint>
+
+#include "GuidedScheduler.hpp"
+
+// Same as optimizedSmartAlgorithm7(), but work is distributed with the GuidedScheduler instead of
+// fixed size batches from one shared atomic counter.
+
+static const uint32_t GUIDED_SCHEDULER_ALGORITHM_NUM_THREADS = 3;
+
+enum class SchedulingMode : uint8_t {
+	// Fixed size batches from one shared atomic counter, as in optimizedSmartAlgorithm7()
+	SHARED_COUNTER,
+
+	// GuidedScheduler
+	GUIDED
+};
+
+bool guidedSchedulerAlgorithm(const char* filePath) noexcept;
+
+// Runs the multi-threaded search regardless of file size with the specified scheduling, and
+// writes the stats of each thread to statsOut (GUIDED_SCHEDULER_ALGORITHM_NUM_THREADS elements)
+bool guidedSchedulerSearchWithStats(const char* filePath, SchedulingMode mode,
+                                    GuidedSchedulerStats* statsOut) noexcept;
+
+// Prints per thread stats for both scheduling modes on the specified file
+void printSchedulerStats(const char* filePath) noexcept;
@@ -0,0 +1,444 @@
+// Copyright(c) Peter Hillerstrm(skipifzero.com, peter@hstroem.se)
+
+#include "HugePageAlgorithm.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+
+using namespace std;
+
+// Constants
+// ------------------------------------------------------------------------------------------------
+
+static const uint64_t MAX_NUMBER_CODES = 17576000;
+static const uint64_t BYTES_PER_CODE = 8; // Assumes Windows file endings (2 bytes per newline)
+static const uint64_t NUM_BITSET_BYTES = (MAX_NUMBER_CODES / 8);
+
+static const uint64_t NUM_THREADS = 3;
+static const uint64_t CODE_ALLOCATION_BATCH_SIZE = 4096;
+static const uint64_t NUM_CODES_MULTI_THREADED_THRESHOLD = 600000;
+
+// Distance between the bitsets when several are packed into the same allocation, rounded up to a
+// cache line so that threads never share a line.
+static const uint64_t BITSET_STRIDE_BYTES = ((NUM_BITSET_BYTES + 63) / 64) * 64;
+
+// Large page allocation
+// ------------------------------------------------------------------------------------------------
+
+// Whether the last allocation was backed by large pages
+static bool lastAllocationUsedLargePages = false;
+
+// Large pages can only be allocated if the process holds SeLockMemoryPrivilege. The privilege
+// must be granted to the user by an administrator, here we can only enable it for the process.
+static bool enableLockMemoryPrivilege() noexcept
+{
+	HANDLE token = NULL;
+	if (!OpenProcessToken(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &token)) {
+		return false;
+	}
+
+	TOKEN_PRIVILEGES privileges;
+	privileges.PrivilegeCount = 1;
+	privileges.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+	if (!LookupPrivilegeValue(NULL, SE_LOCK_MEMORY_NAME, &privileges.Privileges[0].Luid)) {
+		CloseHandle(token);
+		return false;
+	}
+
+	// AdjustTokenPrivileges() succeeds even if the privilege is not held, must check last error
+	BOOL adjusted = AdjustTokenPrivileges(token, FALSE, &privileges, 0, NULL, NULL);
+	DWORD error = GetLastError();
+	CloseHandle(token);
+	return adjusted && error == ERROR_SUCCESS;
+}
+
+// Allocates zero-initialized memory, backed by large pages (2 MiB on x64) if possible. Otherwise
+// falls back to regular 4 KiB pages. Memory must be freed with freeBitsetMemory().
+static void* allocateBitsetMemory(uint64_t numBytes) noexcept
+{
+	static const bool largePagesEnabled = enableLockMemoryPrivilege();
+	static const uint64_t largePageSize = uint64_t(GetLargePageMinimum());
+	static bool hasReported = false;
+
+	void* memory = nullptr;
+	if (largePagesEnabled && largePageSize != 0) {
+		uint64_t numLargePageBytes = ((numBytes + largePageSize - 1) / largePageSize) * largePageSize;
+		memory = VirtualAlloc(NULL, numLargePageBytes, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES,
+		                      PAGE_READWRITE);
+	}
+	lastAllocationUsedLargePages = memory != nullptr;
+
+	if (!hasReported) {
+		hasReported = true;
+		if (memory != nullptr) {
+			printf("HugePageAlgorithm: Bitsets are backed by %llu KiB large pages\n",
+			       (unsigned long long)(largePageSize / 1024));
+		}
+		else {
+			printf("HugePageAlgorithm: Large pages unavailable, falling back to 4 KiB pages\n");
+		}
+	}
+
+	if (memory == nullptr) {
+		memory = VirtualAlloc(NULL, numBytes, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+	}
+	return memory;
+}
+
+static void freeBitsetMemory(void* memory) noexcept
+{
+	if (!VirtualFree(memory, 0, MEM_RELEASE)) {
+		printf("VirtualFree() failed\n");
+	}
+}
+
+// Single threaded variant
+// ------------------------------------------------------------------------------------------------
+
+static bool singleThreadedSearch(const uint8_t* __restrict fileView, uint64_t fileSize) noexcept
+{
+	// Allocate bitset buffer for whether a number is found or not, VirtualAlloc() clears it
+	uint64_t* isFoundBitset = static_cast<uint64_t*>(allocateBitsetMemory(NUM_BITSET_BYTES));
+	if (isFoundBitset == nullptr) {
+		printf("VirtualAlloc() failed\n");
+		return false;
+	}
+
+	// Variable containing whether a copy was found or not
+	bool foundCopy = false;
+
+	for (size_t i = 0; i < fileSize; i += BYTES_PER_CODE) {
+		char let3 = fileView[i];
+		char let2 = fileView[i + 1];
+		char let1 = fileView[i + 2];
+		char no3 = fileView[i + 3];
+		char no2 = fileView[i + 4];
+		char no1 = fileView[i + 5];
+
+		// Calculate corresponding number for code
+		uint32_t number = uint32_t(let3 - 'A') * 676000u +
+		                  uint32_t(let2 - 'A') * 26000u +
+		                  uint32_t(let1 - 'A') * 1000u +
+		                  uint32_t(no3 - '0') * 100u +
+		                  uint32_t(no2 - '0') * 10u +
+		                  uint32_t(no1 - '0');
+
+		uint32_t bitsetChunkIndex = number >> 6u; // number / 64;
+		uint32_t bitIndex = number & 0x0000003Fu; // number % 64;
+
+		uint64_t chunk = isFoundBitset[bitsetChunkIndex];
+		uint64_t bitMask = uint64_t(1) << bitIndex;
+		
+		bool exists = (bitMask & chunk) != 0;
+
+		if (exists) {
+			foundCopy = true;
+			break;
+		}
+
+		chunk = bitMask | chunk;
+		isFoundBitset[bitsetChunkIndex] = chunk;
+	}
+
+	// Free allocated bitset memory
+	freeBitsetMemory(isFoundBitset);
+
+	// Return result
+	return foundCopy;
+}
+
+// Multi-threaded variant
+// ------------------------------------------------------------------------------------------------
+
+static bool mergeBitsets(uint64_t* bitsets[NUM_THREADS]) noexcept
+{
+	if (NUM_THREADS == 2) {
+		for (size_t i = 0; i < (NUM_BITSET_BYTES / sizeof(uint64_t)); i++) {
+			uint64_t b1 = bitsets[0][i];
+			uint64_t b2 = bitsets[1][i];
+			if ((b1 & b2) != uint64_t(0)) return true;
+		}
+	}
+
+	else if (NUM_THREADS == 3) {
+		for (size_t i = 0; i < (NUM_BITSET_BYTES / sizeof(uint64_t)); i++) {
+			uint64_t b1 = bitsets[0][i];
+			uint64_t b2 = bitsets[1][i];
+			uint64_t b3 = bitsets[2][i];
+			bool found = ((b1 & b2) | (b1 & b3) | (b2 & b3)) != uint64_t(0);
+			if (found) return true;
+		}
+	}
+
+	else if (NUM_THREADS == 4) {
+		for (size_t i = 0; i < (NUM_BITSET_BYTES / sizeof(uint64_t)); i++) {
+			uint64_t b1 = bitsets[0][i];
+			uint64_t b2 = bitsets[1][i];
+			uint64_t b3 = bitsets[2][i];
+			uint64_t b4 = bitsets[3][i];
+			
+			bool found = ((b1 & b2) | (b1 & b3) | (b1 & b4) | (b2 & b3) | (b2 & b4) | (b3 & b4)) != uint64_t(0);
+			if (found) {
+				return true;
+			}
+		}
+	}
+		
+	else if (NUM_THREADS == 8) {
+		for (size_t i = 0; i < (NUM_BITSET_BYTES / sizeof(uint64_t)); i++) {
+			uint64_t b1 = bitsets[0][i];
+			uint64_t b2 = bitsets[1][i];
+			uint64_t b3 = bitsets[2][i];
+			uint64_t b4 = bitsets[3][i];
+			uint64_t b5 = bitsets[4][i];
+			uint64_t b6 = bitsets[5][i];
+			uint64_t b7 = bitsets[6][i];
+			uint64_t b8 = bitsets[7][i];
+
+			uint64_t val =
+			(b1 & b2) |
+			(b1 & b3) |
+			(b1 & b4) |
+			(b1 & b5) |
+			(b1 & b6) |
+			(b1 & b7) |
+			(b1 & b8) |
+
+			(b2 & b3) |
+			(b2 & b4) |
+			(b2 & b5) |
+			(b2 & b6) |
+			(b2 & b7) |
+			(b2 & b8) |
+			
+			(b3 & b4) |
+			(b3 & b5) |
+			(b3 & b6) |
+			(b3 & b7) |
+			(b3 & b8) |
+
+			(b4 & b5) |
+			(b4 & b6) |
+			(b4 & b7) |
+			(b4 & b8) |
+			
+			(b5 & b6) |
+			(b5 & b7) |
+			(b5 & b8) |
+
+			(b6 & b7) |
+			(b6 & b8) |
+
+			(b7 & b8);
+
+			if (val != uint64_t(0)) {
+				return true;
+			}
+		}
+	}
+
+	else {
+		printf("FATAL ERROR: NUM_THREADS may only be 2, 3, 4 or 8\n");
+	}
+
+	return false;
+}
+
+static void workerFunction(const uint8_t* __restrict fileView,
+                           uint64_t* __restrict isFoundBitset,
+                           bool* foundCopy,
+                           size_t numCodes,
+                           atomic_size_t* nextFreeCodeIndex) noexcept
+{
+	// Bitset is already cleared by VirtualAlloc()
+	while (true) {
+
+		// Allocate codes from shared array
+		size_t codeIndex = atomic_fetch_add(nextFreeCodeIndex, CODE_ALLOCATION_BATCH_SIZE);
+		if (codeIndex >= numCodes) return;
+		size_t codesToCheck = min(size_t(CODE_ALLOCATION_BATCH_SIZE), numCodes - codeIndex);
+		
+		// Loop over all allocated codes
+		size_t start = codeIndex * BYTES_PER_CODE;
+		size_t end = (codeIndex + codesToCheck) * BYTES_PER_CODE;
+		for (size_t i = start; i < end; i += BYTES_PER_CODE) {
+			
+			uint8_t let3 = fileView[i];
+			uint8_t let2 = fileView[i + 1];
+			uint8_t let1 = fileView[i + 2];
+			uint8_t no3 = fileView[i + 3];
+			uint8_t no2 = fileView[i + 4];
+			uint8_t no1 = fileView[i + 5];
+
+			// Calculate corresponding number for code
+			uint32_t number = uint32_t(let3 - 'A') * 676000u +
+			                  uint32_t(let2 - 'A') * 26000u +
+			                  uint32_t(let1 - 'A') * 1000u +
+			                  uint32_t(no3 - '0') * 100u +
+			                  uint32_t(no2 - '0') * 10u +
+			                  uint32_t(no1 - '0');
+
+			uint32_t bitsetChunkIndex = number >> 6u; // number / 64;
+			uint32_t bitIndex = number & 0x0000003Fu; // number % 64;
+
+			uint64_t chunk = isFoundBitset[bitsetChunkIndex];
+			uint64_t bitMask = uint64_t(1) << bitIndex;
+		
+			bool exists = (bitMask & chunk) != 0;
+
+			if (exists) {
+
+				// Allocate rest of rays so the other threads can stop
+				atomic_fetch_add(nextFreeCodeIndex, numCodes);
+
+				// Signal that the copy is found and exit thread
+				*foundCopy = true;
+				return;
+			}
+
+			chunk = bitMask | chunk;
+			isFoundBitset[bitsetChunkIndex] = chunk;
+		}
+	}
+}
+
+static bool multiThreadedSearch(const uint8_t* __restrict fileView, uint64_t numCodes) noexcept
+{
+	// Variable containing whether a copy was found or not
+	bool foundCopy = false;
+
+	// Counter used for allocating codes
+	atomic_size_t nextFreeCodeIndex = 0;
+
+	// Allocate memory for all bitsets in one go, VirtualAlloc() clears it. Packing them into a
+	// single allocation means 3 bitsets fit in 4 large pages instead of 6.
+	uint8_t* bitsetMemory = static_cast<uint8_t*>(allocateBitsetMemory(NUM_THREADS * BITSET_STRIDE_BYTES));
+	if (bitsetMemory == nullptr) {
+		printf("VirtualAlloc() failed\n");
+		return false;
+	}
+
+	// Start threads
+	uint64_t* bitsets[NUM_THREADS];
+	thread threads[NUM_THREADS];
+	for (size_t i = 0; i < NUM_THREADS; i++) {
+
+		// Retrieve thread's bitset
+		bitsets[i] = reinterpret_cast<uint64_t*>(bitsetMemory + i * BITSET_STRIDE_BYTES);
+
+		// Start worker thread
+		threads[i] = thread(workerFunction, fileView, bitsets[i], &foundCopy, numCodes, &nextFreeCodeIndex);
+	}
+
+	// Wait for threads to finish working
+	for (thread& t : threads) {
+		t.join();
+	}
+
+	// Compare all threads tables
+	if (!foundCopy) {
+		foundCopy = mergeBitsets(bitsets);
+	}
+
+	// Free memory
+	freeBitsetMemory(bitsetMemory);
+
+	// Return result
+	return foundCopy;
+}
+
+// Exposed function
+// ------------------------------------------------------------------------------------------------
+
+bool hugePageAlgorithm(const char* filePath) noexcept
+{
+	// Open file
+	HANDLE file = CreateFile(filePath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+	                         FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (!file) {
+		printf("CreateFile() failed\n");
+		return false;
+	}
+
+	// Get size of file
+	uint64_t fileSize = static_cast<uint64_t>(GetFileSize(file, NULL));
+
+	// Large file fast path
+	// There are a total of 17 576 000 different codes. If the file contains more codes than that
+	// it must also by definition contain a copy.
+	if (fileSize >= ((MAX_NUMBER_CODES + 1) * BYTES_PER_CODE)) {
+		CloseHandle(file);
+		return true;
+	}
+
+	// Create mapped file
+	HANDLE mappedFile = CreateFileMapping(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (!mappedFile) {
+		printf("CreateFileMapping() failed\n");
+		CloseHandle(file);
+		return false;
+	}
+
+	// Create mapped file view
+	uint64_t offset = 0;
+	uint32_t offsetLow  = uint32_t(offset & uint64_t(0xFFFFFFFF));
+	uint32_t offsetHigh = uint32_t(offset >> uint64_t(32));
+	uint64_t numBytesToMap = fileSize;
+	void* fileView = MapViewOfFile(mappedFile, FILE_MAP_READ, offsetLow, offsetHigh, numBytesToMap);
+	if (!fileView) {
+		printf("MapViewOfFile() failed\n");
+		CloseHandle(mappedFile);
+		CloseHandle(file);
+		return false;
+	}
+
+	// Result variable
+	bool foundCopy = false;
+
+	// Single threaded path
+	uint64_t numCodes = fileSize / BYTES_PER_CODE;
+	if (numCodes <= NUM_CODES_MULTI_THREADED_THRESHOLD) {
+		foundCopy = singleThreadedSearch(static_cast<const uint8_t*>(fileView), fileSize);
+	}
+	
+	// Multi-threaded path
+	else {
+		foundCopy = multiThreadedSearch(static_cast<const uint8_t*>(fileView), numCodes);
+	}
+
+	// Unmap mapped file view
+	if (!UnmapViewOfFile(fileView)) {
+		printf("UnmapViewOfFile() failed\n");
+		CloseHandle(mappedFile);
+		CloseHandle(file);
+		return false;
+	}
+
+	// Close mapped file
+	if (!CloseHandle(mappedFile)) {
+		printf("CloseHandle() failed for mappedFile\n");
+		return false;
+	}
+
+	// Close file
+	if (!CloseHandle(file)) {
+		printf("CloseHandle() failed for file\n");
+		return false;
+	}
+
+	// Return result
+	return foundCopy;
+}
+
+bool hugePageAlgorithmUsedLargePages() noexcept
+{
+	return lastAllocationUsedLargePages;
+}
@@ -0,0 +1,8 @@
+// Copyright(c) Peter Hillerstrm(skipifzero.com, peter@hstroem.se)
+
+#pragma once
+
+bool hugePageAlgorithm(const char* filePath) noexcept;
+
+// Returns whether the bitsets of the last call to hugePageAlgorithm() were backed by large pages
+bool hugePageAlgorithmUsedLargePages() noexcept;
@@ -1,11 +1,24 @@
 // Copyright(c) Peter Hillerstrm(skipifzero.com, peter@hstroem.se)
 
+#include <algorithm>
 #include <cstdio>
 #include <chrono>
 #include <iostream>
+#include <string>
 #include <vector>
 
+#include "AsyncCheckBenchmark.hpp"
+#include "BinaryPlateFormat.hpp"
+#include "CacheBlockedAlgorithm.hpp"
+#include "CancellableAlgorithm.hpp"
+#include "Crc32c.hpp"
+#include "DecoderBenchmark.hpp"
+#include "GuidedSchedulerAlgorithm.hpp"
+#include "HugePageAlgorithm.hpp"
+#include "MultiProcessAlgorithm.hpp"
 #include "NaiveSmartAlgorithm.hpp"
+#include "NumaAlgorithm.hpp"
+#include "OccurrenceCounter.hpp"
 #include "OptimizedSmartAlgorithm.hpp"
 #include "OptimizedSmartAlgorithm2.hpp"
 #include "OptimizedSmartAlgorithm3.hpp"
@@ -13,7 +26,24 @@
 #include "OptimizedSmartAlgorithm5.hpp"
 #include "OptimizedSmartAlgorithm6.hpp"
 #include "OptimizedSmartAlgorithm7.hpp"
+#include "PairLookupAlgorithm.hpp"
+#include "PinnedAlgorithm.hpp"
+#include "PlateDecoders.hpp"
+#include "PlateSchema.hpp"
+#include "PlateCheckerAlgorithm.hpp"
+#include "PlateRingBenchmark.hpp"
+#include "PrefetchAlgorithm.hpp"
+#include "RadixSortAlgorithm.hpp"
+#include "SchemaAlgorithm.hpp"
+#include "SeenSetCheckpointBenchmark.hpp"
+#include "SeenSetRankIndex.hpp"
+#include "SeenSetSnapshotBenchmark.hpp"
+#include "SlidingWindowAlgorithm.hpp"
+#include "SmallInputAlgorithm.hpp"
+#include "SortedInputAlgorithm.hpp"
 #include "StdSortAlgorithm.hpp"
+#include "TouchedBlockAlgorithm.hpp"
+#include "ValidatingAlgorithm.hpp"
 
 // Statics
 // ------------------------------------------------------------------------------------------------
@@ -32,8 +62,217 @@ static double timeSinceLastCall(time_point& previousTime) noexcept
 	return delta;
 }
 
+// Reads a whole file, empty if it could not be read
+static std::vector<uint8_t> readFile(const char* path) noexcept
+{
+	std::vector<uint8_t> bytes;
+	FILE* file = fopen(path, "rb");
+	if (file == nullptr) return bytes;
+	uint8_t buffer[4096];
+	size_t numRead;
+	while ((numRead = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+		bytes.insert(bytes.end(), buffer, buffer + numRead);
+	}
+	fclose(file);
+	return bytes;
+}
+
+// Returns the path of the LF version of a test file, e.g. "Rgn00.txt" -> "Rgn00.txt.lf"
+static std::string lfTestFilePath(const char* textPath) noexcept
+{
+	return std::string(textPath) + ".lf";
+}
+
+// Writes a copy of a CR+LF text file with LF line endings, returns false on failure
+static bool convertTextToLF(const char* textPath, const char* lfPath) noexcept
+{
+	std::vector<uint8_t> text = readFile(textPath);
+	if (text.empty()) return false;
+	text.erase(std::remove(text.begin(), text.end(), uint8_t('\r')), text.end());
+
+	FILE* file = fopen(lfPath, "wb");
+	if (file == nullptr) return false;
+	bool success = fwrite(text.data(), 1, text.size(), file) == text.size();
+	fclose(file);
+	return success;
+}
+
+// Returns the path of a test file in another schema, e.g. "Rgn00.txt" -> "Rgn00.txt.AAA00A"
+static std::string schemaTestFilePath(const char* textPath, const char* schemaName) noexcept
+{
+	return std::string(textPath) + "." + schemaName;
+}
+
+// Writes a copy of a test file with each code re-encoded in the schema. Codes keep their index,
+// which fits in every schema, so the file has the same copies as the original. Returns false on
+// failure.
+template<typename Schema>
+static bool convertTextToSchema(const char* textPath, const char* schemaPath) noexcept
+{
+	static_assert(Schema::MAX_NUMBER_CODES >= SwedishPlateSchema::MAX_NUMBER_CODES,
+	              "All indices of the test files must fit in the schema");
+	std::vector<uint8_t> text = readFile(textPath);
+	if (text.empty()) return false;
+
+	uint64_t numCodes = numCodesInText(text.size(), 8);
+	std::vector<uint8_t> schemaText(numCodes * Schema::BYTES_PER_CODE);
+	for (uint64_t i = 0; i < numCodes; i++) {
+		uint8_t* code = schemaText.data() + i * Schema::BYTES_PER_CODE;
+		Schema::encode(decodeScalar(text.data() + i * 8), code);
+		code[Schema::NUM_CHARS] = '\r';
+		code[Schema::NUM_CHARS + 1] = '\n';
+	}
+
+	FILE* file = fopen(schemaPath, "wb");
+	if (file == nullptr) return false;
+	bool success = fwrite(schemaText.data(), 1, schemaText.size(), file) == schemaText.size();
+	fclose(file);
+	return success;
+}
+
+// Returns the path of the binary version of a test file, e.g. "Rgn00.txt" -> "Rgn00.txt.plain"
+static std::string binaryTestFilePath(const char* textPath, PlateFileEncoding encoding) noexcept
+{
+	return std::string(textPath) + (encoding == PlateFileEncoding::PLAIN_32 ? ".plain" : ".packed");
+}
+
+// Converts a text file without a trailing newline, whose last code is a copy, and scans a binary
+// file with a valid header and checksum but an out of range index. Prints a warning on failure.
+static void testBinaryEdgeCases() noexcept
+{
+	const char* TEXT_PATH = "Unterminated.txt";
+	const char* BINARY_PATH = "Unterminated.txt.plain";
+	const char* INVALID_PATH = "InvalidIndex.plain";
+
+	// Last line lacks its line ending
+	const char TEXT[] = "ABC123\r\nXYZ999\r\nABC123";
+	FILE* textFile = fopen(TEXT_PATH, "wb");
+	if (textFile != nullptr) {
+		fwrite(TEXT, 1, sizeof(TEXT) - 1, textFile);
+		fclose(textFile);
+	}
+	bool valid = false;
+	bool foundCopy = convertTextToBinary(TEXT_PATH, BINARY_PATH, PlateFileEncoding::PLAIN_32) &&
+	                 binaryPlateAlgorithm(BINARY_PATH, valid);
+	if (!foundCopy || !valid) {
+		printf("WARNING: Copy on unterminated last line of \"%s\" not found\n", TEXT_PATH);
+	}
+
+	// Second index is one past the last valid index
+	const uint32_t INDICES[4] = { 5, 17576000, 0, 0 }; // Including 8 bytes of padding
+	PlateFileHeader header;
+	header.magic = PLATE_FILE_MAGIC;
+	header.version = PLATE_FILE_VERSION;
+	header.numCodes = 2;
+	header.bitsPerCode = uint32_t(PlateFileEncoding::PLAIN_32);
+	header.checksum = crc32c(INDICES, sizeof(INDICES));
+	header.payloadBytes = sizeof(INDICES);
+	FILE* invalidFile = fopen(INVALID_PATH, "wb");
+	if (invalidFile != nullptr) {
+		fwrite(&header, sizeof(PlateFileHeader), 1, invalidFile);
+		fwrite(INDICES, sizeof(INDICES), 1, invalidFile);
+		fclose(invalidFile);
+	}
+	binaryPlateAlgorithm(INVALID_PATH, valid);
+	if (valid) {
+		printf("WARNING: Out of range index in \"%s\" not rejected\n", INVALID_PATH);
+	}
+
+	remove(TEXT_PATH);
+	remove(BINARY_PATH);
+	remove(INVALID_PATH);
+}
+
+// Checks radixSortCodes() against std::sort() of the same codes, for each test file and a file with
+// an unterminated last line. The unique codes must be the distinct codes in ascending order and the
+// duplicate groups the codes occurring more than once with their counts. Prints a warning on
+// mismatch.
+static void testRadixSortCodes(const char* const* testFilePaths, size_t numTests) noexcept
+{
+	const char* UNTERMINATED_PATH = "UnterminatedSort.txt";
+	const char TEXT[] = "XYZ999\r\nABC123\r\nXYZ999\r\nAAA000\r\nABC123\r\nXYZ999";
+	FILE* textFile = fopen(UNTERMINATED_PATH, "wb");
+	if (textFile != nullptr) {
+		fwrite(TEXT, 1, sizeof(TEXT) - 1, textFile);
+		fclose(textFile);
+	}
+
+	std::vector<const char*> paths(testFilePaths, testFilePaths + numTests);
+	paths.push_back(UNTERMINATED_PATH);
+	for (const char* path : paths) {
+
+		// Reference, all codes of the file sorted
+		std::vector<uint8_t> text = readFile(path);
+		std::vector<uint32_t> reference(numCodesInText(text.size(), 8));
+		for (size_t i = 0; i < reference.size(); i++) {
+			reference[i] = decodeScalar(text.data() + i * 8);
+		}
+		std::sort(reference.begin(), reference.end());
+
+		// Walk the runs of equal codes in the reference
+		std::vector<uint32_t> unique;
+		std::vector<DuplicateGroup> duplicates;
+		bool correct = !text.empty() && radixSortCodes(path, unique, duplicates);
+		size_t numUnique = 0;
+		size_t numDuplicates = 0;
+		for (size_t i = 0; correct && i < reference.size();) {
+			size_t runEnd = i;
+			while (runEnd < reference.size() && reference[runEnd] == reference[i]) runEnd++;
+			correct = numUnique < unique.size() && unique[numUnique++] == reference[i];
+			if (correct && (runEnd - i) > 1) {
+				correct = numDuplicates < duplicates.size() &&
+				          duplicates[numDuplicates].number == reference[i] &&
+				          duplicates[numDuplicates].count == (runEnd - i);
+				numDuplicates++;
+			}
+			i = runEnd;
+		}
+		correct = correct && numUnique == unique.size() && numDuplicates == duplicates.size();
+		if (!correct) {
+			printf("WARNING: radixSortCodes() returned incorrect codes for \"%s\"\n", path);
+		}
+	}
+
+	remove(UNTERMINATED_PATH);
+}
+
+static bool binaryPlainAlgorithm(const char* path) noexcept
+{
+	return binaryPlateAlgorithm(binaryTestFilePath(path, PlateFileEncoding::PLAIN_32).c_str());
+}
+
+static bool binaryPackedAlgorithm(const char* path) noexcept
+{
+	return binaryPlateAlgorithm(binaryTestFilePath(path, PlateFileEncoding::PACKED_25).c_str());
+}
+
+static bool schemaAAA00AAlgorithm(const char* path) noexcept
+{
+	return schemaAlgorithmAAA00A(schemaTestFilePath(path, "AAA00A").c_str());
+}
+
+static bool schemaAA00000Algorithm(const char* path) noexcept
+{
+	return schemaAlgorithmAA00000(schemaTestFilePath(path, "AA00000").c_str());
+}
+
+static bool pairLookupLFAlgorithm(const char* path) noexcept
+{
+	return pairLookupAlgorithmLF(lfTestFilePath(path).c_str());
+}
+
+static bool numaSimulatedAlgorithm(const char* path) noexcept
+{
+	return numaSearch(path, 2);
+}
+
 int main(int argc, char** argv)
 {
+	// Worker process started by multiProcessAlgorithm()
+	if (isMultiProcessWorker(argc, argv)) {
+		return multiProcessWorkerMain(argc, argv);
+	}
+
 	const size_t NUM_TESTS = 3;
 	const char* TEST_FILE_PATHS[NUM_TESTS] = {
 		"Rgn00.txt",
@@ -46,9 +285,9 @@ int main(int argc, char** argv)
 		false
 	};
 
-	const size_t NUM_ALGORITHMS = 2;
+	const size_t NUM_ALGORITHMS = 27;
 	const char* ALGORITHM_NAMES[NUM_ALGORITHMS] = {
-		//"StdSortAlgorithm",
+		"StdSortAlgorithm",
 		//"NaiveSmartAlgorithm",
 		//"OptimizedSmartAlgorithm",
 		//"OptimizedSmartAlgorithm2",
@@ -56,10 +295,34 @@ int main(int argc, char** argv)
 		//"OptimizedSmartAlgorithm4",
 		"OptimizedSmartAlgorithm5",
 		//"OptimizedSmartAlgorithm6",
-		"OptimizedSmartAlgorithm7"
+		"OptimizedSmartAlgorithm7",
+		"HugePageAlgorithm",
+		"PrefetchAlgorithm",
+		"BinaryPlateAlgorithm (plain)",
+		"BinaryPlateAlgorithm (packed)",
+		"SortedInputAlgorithm",
+		"ValidatingAlgorithm",
+		"SchemaAlgorithm (AAA000)",
+		"SchemaAlgorithm (AAA00A)",
+		"SchemaAlgorithm (AA00000)",
+		"PairLookupAlgorithm",
+		"PairLookupAlgorithm (LF)",
+		"SmallInputAlgorithm",
+		"RadixSortAlgorithm",
+		"CancellableAlgorithm",
+		"CancellableAlgorithm (first copy)",
+		"GuidedSchedulerAlgorithm",
+		"PinnedAlgorithm",
+		"NumaAlgorithm",
+		"NumaAlgorithm (2 simulated nodes)",
+		"MultiProcessAlgorithm",
+		"PlateCheckerAlgorithm",
+		"TouchedBlockAlgorithm",
+		"CacheBlockedAlgorithm",
+		"SlidingWindowAlgorithm"
 	};
 	bool(*ALGORITHMS[NUM_ALGORITHMS])(const char* path) = {
-		//stdSortAlgorithm,
+		stdSortAlgorithm,
 		//naiveSmartAlgorithm,
 		//optimizedSmartAlgorithm,
 		//optimizedSmartAlgorithm2,
@@ -67,11 +330,89 @@ int main(int argc, char** argv)
 		//optimizedSmartAlgorithm4,
 		optimizedSmartAlgorithm5,
 		//optimizedSmartAlgorithm6,
-		optimizedSmartAlgorithm7
+		optimizedSmartAlgorithm7,
+		hugePageAlgorithm,
+		prefetchAlgorithm,
+		binaryPlainAlgorithm,
+		binaryPackedAlgorithm,
+		sortedInputAlgorithm,
+		validatingAlgorithm,
+		schemaAlgorithmAAA000,
+		schemaAAA00AAlgorithm,
+		schemaAA00000Algorithm,
+		pairLookupAlgorithm,
+		pairLookupLFAlgorithm,
+		smallInputAlgorithm,
+		radixSortAlgorithm,
+		cancellableAlgorithm,
+		cancellableFirstCopyAlgorithm,
+		guidedSchedulerAlgorithm,
+		pinnedAlgorithm,
+		numaAlgorithm,
+		numaSimulatedAlgorithm,
+		multiProcessAlgorithm,
+		plateCheckerAlgorithm,
+		touchedBlockAlgorithm,
+		cacheBlockedAlgorithm,
+		slidingWindowAlgorithm
 	};
 	
 	const size_t NUM_TEST_ITERATIONS = 128;
 
+	// Create binary, LF and other schema versions of the test files
+	for (size_t testIndex = 0; testIndex < NUM_TESTS; testIndex++) {
+		const char* testFilePath = TEST_FILE_PATHS[testIndex];
+		if (!convertTextToLF(testFilePath, lfTestFilePath(testFilePath).c_str())) {
+			printf("WARNING: Could not convert \"%s\" to LF\n", testFilePath);
+		}
+		std::string letterPath = schemaTestFilePath(testFilePath, "AAA00A");
+		std::string norwegianPath = schemaTestFilePath(testFilePath, "AA00000");
+		if (!convertTextToSchema<SwedishLetterPlateSchema>(testFilePath, letterPath.c_str()) ||
+		    !convertTextToSchema<NorwegianPlateSchema>(testFilePath, norwegianPath.c_str())) {
+			printf("WARNING: Could not convert \"%s\" to the other schemas\n", testFilePath);
+		}
+		for (PlateFileEncoding encoding : { PlateFileEncoding::PLAIN_32, PlateFileEncoding::PACKED_25 }) {
+			if (!convertTextToBinary(testFilePath, binaryTestFilePath(testFilePath, encoding).c_str(), encoding)) {
+				printf("WARNING: Could not convert \"%s\" to binary\n", testFilePath);
+			}
+		}
+	}
+	testBinaryEdgeCases();
+	testRadixSortCodes(TEST_FILE_PATHS, NUM_TESTS);
+
+	// Compare the different code decoders in isolation
+	benchmarkDecoders(TEST_FILE_PATHS[0]);
+
+	// Compare load balance of the schedulers, on a file without copies so all codes are checked
+	printSchedulerStats(TEST_FILE_PATHS[2]);
+
+	// Cost of merge, stats and clear passes restricted to touched blocks, for growing inputs
+	printTouchedBlockStats(TEST_FILE_PATHS[2]);
+
+	// Passes, slice sizes and time of the cache-blocked search for a range of memory budgets
+	printCacheBlockedPlans(TEST_FILE_PATHS[2]);
+
+	// Repeats within a window of records instead of anywhere in the file
+	printSlidingWindowStats(TEST_FILE_PATHS[0]);
+
+	// Most common codes, counted with 4 bit saturating counters
+	printHeavyHitters(TEST_FILE_PATHS[0]);
+
+	// Throughput and latency of checking codes streamed through shared memory instead of a file
+	benchmarkPlateRing(TEST_FILE_PATHS[0]);
+
+	// Scheduling overhead and tail latency of async checks with many concurrent requests
+	benchmarkAsyncChecks(TEST_FILE_PATHS[0]);
+
+	// Reloading a seen-set from a snapshot instead of rebuilding it from the text file
+	benchmarkSeenSetSnapshots(TEST_FILE_PATHS[2]);
+
+	// Write amplification of incremental checkpoints of a long-running seen-set
+	benchmarkCheckpointing(TEST_FILE_PATHS[2]);
+
+	// Range counts and ordered queries on a built seen-set, answered by a rank/select index
+	printRankIndexStats(TEST_FILE_PATHS[2]);
+
 	for (size_t algorithmIndex = 0; algorithmIndex < NUM_ALGORITHMS; algorithmIndex++) {
 		
 		printf("Testing algorithm: %s\n", ALGORITHM_NAMES[algorithmIndex]);
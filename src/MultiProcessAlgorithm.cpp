@@ -0,0 +1,405 @@
+// Copyright(c) Peter Hillerstrm(skipifzero.com, peter@hstroem.se)
+
+#include "MultiProcessAlgorithm.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#include <malloc.h>
+
+#include "PlateDecoders.hpp"
+
+using namespace std;
+
+// Constants
+// ------------------------------------------------------------------------------------------------
+
+static const uint64_t MAX_NUMBER_CODES = 17576000;
+static const uint64_t BYTES_PER_CODE = 8; // Assumes Windows file endings (2 bytes per newline)
+static const uint64_t NUM_BITSET_BYTES = (MAX_NUMBER_CODES / 8);
+
+static const uint32_t NUM_PROCESSES = 3;
+static const uint64_t CODE_ALLOCATION_BATCH_SIZE = 4096;
+static const uint64_t NUM_CODES_MULTI_THREADED_THRESHOLD = 600000;
+
+// First argument of a worker process, followed by: <shared mapping name> <file> <first> <last>
+static const char* WORKER_ARGUMENT = "--plate-worker";
+static const int WORKER_NUM_ARGUMENTS = 6;
+
+// Exit codes of worker processes
+static const DWORD WORKER_EXIT_NO_COPY = 0;
+static const DWORD WORKER_EXIT_COPY_FOUND = 1;
+static const DWORD WORKER_EXIT_ERROR = 2;
+
+// Shared seen-set
+// ------------------------------------------------------------------------------------------------
+
+// Layout of the shared mapping, the bitset directly follows the header
+struct alignas(64) SharedSeenSetHeader final {
+	// Set by the worker that finds a copy (or the coordinator), polled by workers between batches
+	volatile LONG64 copyFound;
+};
+
+static const uint64_t SHARED_SEEN_SET_BYTES = sizeof(SharedSeenSetHeader) + NUM_BITSET_BYTES;
+
+static volatile LONG64* sharedBitset(SharedSeenSetHeader* header) noexcept
+{
+	return reinterpret_cast<volatile LONG64*>(reinterpret_cast<uint8_t*>(header) + sizeof(SharedSeenSetHeader));
+}
+
+// Unique name of the shared mapping for a search
+static string sharedSeenSetName() noexcept
+{
+	static atomic_uint counter(0);
+	return "Local\\PlateSeenSet_" + to_string(GetCurrentProcessId()) + "_" + to_string(counter++);
+}
+
+// Single threaded variant
+// ------------------------------------------------------------------------------------------------
+
+static bool singleThreadedSearch(const uint8_t* __restrict fileView, uint64_t numCodes) noexcept
+{
+	// Allocate bitset buffer for whether a number is found or not, and clear it
+	uint64_t* isFoundBitset = static_cast<uint64_t*>(_aligned_malloc(NUM_BITSET_BYTES, 32));
+	memset(isFoundBitset, 0, NUM_BITSET_BYTES);
+
+	// Variable containing whether a copy was found or not
+	bool foundCopy = false;
+
+	for (uint64_t i = 0; i < numCodes * BYTES_PER_CODE; i += BYTES_PER_CODE) {
+		uint32_t number = uint32_t(fileView[i] - 'A') * 676000u +
+		                  uint32_t(fileView[i + 1] - 'A') * 26000u +
+		                  uint32_t(fileView[i + 2] - 'A') * 1000u +
+		                  uint32_t(fileView[i + 3] - '0') * 100u +
+		                  uint32_t(fileView[i + 4] - '0') * 10u +
+		                  uint32_t(fileView[i + 5] - '0');
+
+		uint32_t bitsetChunkIndex = number >> 6u; // number / 64;
+		uint64_t bitMask = uint64_t(1) << (number & 0x0000003Fu); // number % 64;
+
+		uint64_t chunk = isFoundBitset[bitsetChunkIndex];
+		if ((bitMask & chunk) != uint64_t(0)) {
+			foundCopy = true;
+			break;
+		}
+		isFoundBitset[bitsetChunkIndex] = bitMask | chunk;
+	}
+
+	// Free allocated bitset memory
+	_aligned_free(isFoundBitset);
+
+	// Return result
+	return foundCopy;
+}
+
+// Worker process
+// ------------------------------------------------------------------------------------------------
+
+// Inserts the codes in [firstCode, lastCode) into the shared bitset, codes points to firstCode
+static DWORD workerSearch(const uint8_t* __restrict codes, uint64_t numCodes,
+                          SharedSeenSetHeader* header) noexcept
+{
+	volatile LONG64* bitset = sharedBitset(header);
+	for (uint64_t batchStart = 0; batchStart < numCodes; batchStart += CODE_ALLOCATION_BATCH_SIZE) {
+
+		// Stop if another worker already found a copy
+		if (header->copyFound != 0) return WORKER_EXIT_NO_COPY;
+
+		uint64_t batchEnd = min(batchStart + CODE_ALLOCATION_BATCH_SIZE, numCodes);
+		for (uint64_t i = batchStart * BYTES_PER_CODE; i < batchEnd * BYTES_PER_CODE; i += BYTES_PER_CODE) {
+			uint32_t number = uint32_t(codes[i] - 'A') * 676000u +
+			                  uint32_t(codes[i + 1] - 'A') * 26000u +
+			                  uint32_t(codes[i + 2] - 'A') * 1000u +
+			                  uint32_t(codes[i + 3] - '0') * 100u +
+			                  uint32_t(codes[i + 4] - '0') * 10u +
+			                  uint32_t(codes[i + 5] - '0');
+
+			// Set bit, if it was already set by any worker the code is a copy
+			LONG64 bitMask = LONG64(uint64_t(1) << (number & 0x0000003Fu));
+			LONG64 previous = InterlockedOr64(&bitset[number >> 6u], bitMask);
+			if ((previous & bitMask) != 0) {
+				InterlockedOr64(&header->copyFound, 1);
+				return WORKER_EXIT_COPY_FOUND;
+			}
+		}
+	}
+	return WORKER_EXIT_NO_COPY;
+}
+
+bool isMultiProcessWorker(int argc, char** argv) noexcept
+{
+	return argc == WORKER_NUM_ARGUMENTS && strcmp(argv[1], WORKER_ARGUMENT) == 0;
+}
+
+int multiProcessWorkerMain(int argc, char** argv) noexcept
+{
+	if (!isMultiProcessWorker(argc, argv)) return int(WORKER_EXIT_ERROR);
+	const char* sharedName = argv[2];
+	const char* filePath = argv[3];
+	uint64_t firstCode = strtoull(argv[4], nullptr, 10);
+	uint64_t lastCode = strtoull(argv[5], nullptr, 10);
+	if (lastCode <= firstCode) return int(WORKER_EXIT_NO_COPY);
+
+	// Map shared seen-set
+	HANDLE sharedMapping = OpenFileMapping(FILE_MAP_ALL_ACCESS, FALSE, sharedName);
+	if (!sharedMapping) {
+		printf("OpenFileMapping() failed\n");
+		return int(WORKER_EXIT_ERROR);
+	}
+	SharedSeenSetHeader* header = static_cast<SharedSeenSetHeader*>(
+		MapViewOfFile(sharedMapping, FILE_MAP_ALL_ACCESS, 0, 0, SHARED_SEEN_SET_BYTES));
+	if (!header) {
+		printf("MapViewOfFile() failed for shared seen-set\n");
+		CloseHandle(sharedMapping);
+		return int(WORKER_EXIT_ERROR);
+	}
+
+	// Open file
+	HANDLE file = CreateFile(filePath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+	                         FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	HANDLE mappedFile = file != INVALID_HANDLE_VALUE ?
+		CreateFileMapping(file, NULL, PAGE_READONLY, 0, 0, NULL) : NULL;
+	if (!mappedFile) {
+		printf("Could not open \"%s\" in worker\n", filePath);
+		if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+		UnmapViewOfFile(header);
+		CloseHandle(sharedMapping);
+		return int(WORKER_EXIT_ERROR);
+	}
+
+	// Map only the assigned range, offset must be a multiple of the allocation granularity. The
+	// last code may lack its line ending, so the view can't extend past the end of the file.
+	SYSTEM_INFO systemInfo;
+	GetSystemInfo(&systemInfo);
+	uint64_t fileSize = static_cast<uint64_t>(GetFileSize(file, NULL));
+	uint64_t firstByte = firstCode * BYTES_PER_CODE;
+	uint64_t offset = firstByte - (firstByte % uint64_t(systemInfo.dwAllocationGranularity));
+	uint32_t offsetLow  = uint32_t(offset & uint64_t(0xFFFFFFFF));
+	uint32_t offsetHigh = uint32_t(offset >> uint64_t(32));
+	uint64_t numBytesToMap = min(lastCode * BYTES_PER_CODE, fileSize) - offset;
+	void* fileView = MapViewOfFile(mappedFile, FILE_MAP_READ, offsetHigh, offsetLow, numBytesToMap);
+	if (!fileView) {
+		printf("MapViewOfFile() failed in worker\n");
+		CloseHandle(mappedFile);
+		CloseHandle(file);
+		UnmapViewOfFile(header);
+		CloseHandle(sharedMapping);
+		return int(WORKER_EXIT_ERROR);
+	}
+
+	// Search assigned range
+	const uint8_t* codes = static_cast<const uint8_t*>(fileView) + (firstByte - offset);
+	DWORD result = workerSearch(codes, lastCode - firstCode, header);
+
+	// Clean up
+	UnmapViewOfFile(fileView);
+	CloseHandle(mappedFile);
+	CloseHandle(file);
+	UnmapViewOfFile(header);
+	CloseHandle(sharedMapping);
+	return int(result);
+}
+
+// Coordinator
+// ------------------------------------------------------------------------------------------------
+
+static void terminateWorkers(vector<HANDLE>& processes) noexcept
+{
+	for (HANDLE process : processes) {
+		TerminateProcess(process, WORKER_EXIT_NO_COPY);
+	}
+	for (HANDLE process : processes) {
+		WaitForSingleObject(process, INFINITE);
+		CloseHandle(process);
+	}
+	processes.clear();
+}
+
+static bool multiProcessSearch(const char* filePath, uint64_t numCodes, uint32_t numProcesses,
+                               bool& errorOut) noexcept
+{
+	errorOut = false;
+
+	// Create shared seen-set, pagefile backed mappings are zero initialized
+	string sharedName = sharedSeenSetName();
+	HANDLE sharedMapping = CreateFileMapping(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE,
+		uint32_t(SHARED_SEEN_SET_BYTES >> 32), uint32_t(SHARED_SEEN_SET_BYTES & 0xFFFFFFFF), sharedName.c_str());
+	if (!sharedMapping) {
+		printf("CreateFileMapping() failed for shared seen-set\n");
+		errorOut = true;
+		return false;
+	}
+	SharedSeenSetHeader* header = static_cast<SharedSeenSetHeader*>(
+		MapViewOfFile(sharedMapping, FILE_MAP_ALL_ACCESS, 0, 0, SHARED_SEEN_SET_BYTES));
+	if (!header) {
+		printf("MapViewOfFile() failed for shared seen-set\n");
+		CloseHandle(sharedMapping);
+		errorOut = true;
+		return false;
+	}
+
+	// Path of the current executable, which is relaunched as the workers
+	char executablePath[MAX_PATH] = {};
+	GetModuleFileName(NULL, executablePath, MAX_PATH);
+
+	// Start workers, each gets a contiguous range of codes
+	vector<HANDLE> processes;
+	uint64_t codesPerProcess = (numCodes + numProcesses - 1) / numProcesses;
+	for (uint32_t i = 0; i < numProcesses; i++) {
+		uint64_t firstCode = min(i * codesPerProcess, numCodes);
+		uint64_t lastCode = min(firstCode + codesPerProcess, numCodes);
+
+		string commandLine = string("\"") + executablePath + "\" " + WORKER_ARGUMENT + " " + sharedName +
+			" \"" + filePath + "\" " + to_string(firstCode) + " " + to_string(lastCode);
+		vector<char> commandLineBuffer(commandLine.begin(), commandLine.end());
+		commandLineBuffer.push_back('\0');
+
+		STARTUPINFO startupInfo;
+		memset(&startupInfo, 0, sizeof(STARTUPINFO));
+		startupInfo.cb = sizeof(STARTUPINFO);
+		PROCESS_INFORMATION processInfo;
+		memset(&processInfo, 0, sizeof(PROCESS_INFORMATION));
+		if (!CreateProcess(executablePath, commandLineBuffer.data(), NULL, NULL, FALSE, 0, NULL, NULL,
+		                   &startupInfo, &processInfo)) {
+			printf("CreateProcess() failed\n");
+			errorOut = true;
+			break;
+		}
+		CloseHandle(processInfo.hThread);
+		processes.push_back(processInfo.hProcess);
+	}
+
+	// Wait for workers, stop all of them on first copy or error
+	bool foundCopy = false;
+	while (!errorOut && !processes.empty()) {
+		DWORD waitResult = WaitForMultipleObjects(DWORD(processes.size()), processes.data(), FALSE, INFINITE);
+		size_t index = size_t(waitResult - WAIT_OBJECT_0);
+		if (index >= processes.size()) {
+			printf("WaitForMultipleObjects() failed\n");
+			errorOut = true;
+			break;
+		}
+
+		DWORD exitCode = WORKER_EXIT_ERROR;
+		GetExitCodeProcess(processes[index], &exitCode);
+		CloseHandle(processes[index]);
+		processes.erase(processes.begin() + index);
+
+		if (exitCode == WORKER_EXIT_COPY_FOUND) {
+			foundCopy = true;
+			break;
+		}
+		if (exitCode != WORKER_EXIT_NO_COPY) {
+			printf("Worker process failed with exit code %u\n", unsigned(exitCode));
+			errorOut = true;
+		}
+	}
+
+	// Cancel remaining workers, first cooperatively through the shared flag and then forcibly
+	InterlockedOr64(&header->copyFound, 1);
+	terminateWorkers(processes);
+
+	// Free shared seen-set
+	UnmapViewOfFile(header);
+	CloseHandle(sharedMapping);
+
+	// Return result
+	return foundCopy;
+}
+
+// Exposed functions
+// ------------------------------------------------------------------------------------------------
+
+bool multiProcessSearch(const char* filePath, uint32_t numProcesses) noexcept
+{
+	// Open file
+	HANDLE file = CreateFile(filePath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+	                         FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (file == INVALID_HANDLE_VALUE) {
+		printf("CreateFile() failed\n");
+		return false;
+	}
+
+	// Get size of file
+	uint64_t fileSize = static_cast<uint64_t>(GetFileSize(file, NULL));
+	uint64_t numCodes = numCodesInText(fileSize, BYTES_PER_CODE);
+
+	// Large file fast path
+	// There are a total of 17 576 000 different codes. If the file contains more codes than that
+	// it must also by definition contain a copy.
+	if (fileSize >= ((MAX_NUMBER_CODES + 1) * BYTES_PER_CODE)) {
+		CloseHandle(file);
+		return true;
+	}
+
+	// Multi-process path, workers open the file themselves
+	if (numCodes > NUM_CODES_MULTI_THREADED_THRESHOLD && numProcesses > 1) {
+		CloseHandle(file);
+		bool error = false;
+		bool foundCopy = multiProcessSearch(filePath, numCodes, numProcesses, error);
+		if (!error) return foundCopy;
+
+		// Fall back to searching in this process if the workers failed
+		printf("Multi-process search failed, falling back to single threaded search\n");
+		file = CreateFile(filePath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+		                  FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+		if (file == INVALID_HANDLE_VALUE) {
+			printf("CreateFile() failed\n");
+			return false;
+		}
+	}
+
+	// Single threaded path
+	HANDLE mappedFile = CreateFileMapping(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (!mappedFile) {
+		printf("CreateFileMapping() failed\n");
+		CloseHandle(file);
+		return false;
+	}
+	void* fileView = MapViewOfFile(mappedFile, FILE_MAP_READ, 0, 0, fileSize);
+	if (!fileView) {
+		printf("MapViewOfFile() failed\n");
+		CloseHandle(mappedFile);
+		CloseHandle(file);
+		return false;
+	}
+
+	bool foundCopy = singleThreadedSearch(static_cast<const uint8_t*>(fileView), numCodes);
+
+	// Unmap mapped file view
+	if (!UnmapViewOfFile(fileView)) {
+		printf("UnmapViewOfFile() failed\n");
+		CloseHandle(mappedFile);
+		CloseHandle(file);
+		return false;
+	}
+
+	// Close mapped file
+	if (!CloseHandle(mappedFile)) {
+		printf("CloseHandle() failed for mappedFile\n");
+		return false;
+	}
+
+	// Close file
+	if (!CloseHandle(file)) {
+		printf("CloseHandle() failed for file\n");
+		return false;
+	}
+
+	// Return result
+	return foundCopy;
+}
+
+bool multiProcessAlgorithm(const char* filePath) noexcept
+{
+	return multiProcessSearch(filePath, NUM_PROCESSES);
+}
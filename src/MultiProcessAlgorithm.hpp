@@ -0,0 +1,26 @@
+// Copyright(c) Peter Hillerstrm(skipifzero.com, peter@hstroem.se)
+
+#pragma once
+
+#include <cstdint>
+
+// Same as optimizedSmartAlgorithm7(), but the work is split over worker processes instead of
+// threads, for fault isolation and per process memory limits. Each worker maps its own range of
+// the file and sets bits in one shared bitset (a named pagefile backed mapping) using atomic
+// InterlockedOr64(), so a copy is detected directly by the worker that inserts it and no merge is
+// needed. The coordinator terminates the other workers on the first hit.
+//
+// Workers are started by relaunching the current executable with worker arguments, so main() of
+// the executable must start with:
+//
+//	if (isMultiProcessWorker(argc, argv)) return multiProcessWorkerMain(argc, argv);
+
+bool multiProcessAlgorithm(const char* filePath) noexcept;
+
+bool multiProcessSearch(const char* filePath, uint32_t numProcesses) noexcept;
+
+// Whether the command line arguments are those of a worker process
+bool isMultiProcessWorker(int argc, char** argv) noexcept;
+
+// Entry point of a worker process, returns the exit code of the process
+int multiProcessWorkerMain(int argc, char** argv) noexcept;
@@ -0,0 +1,371 @@
+// Copyright(c) Peter Hillerstrm(skipifzero.com, peter@hstroem.se)
+
+#include "NumaAlgorithm.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#include <Psapi.h>
+#include <malloc.h>
+
+#include "CancellationToken.hpp"
+#include "PlateDecoders.hpp"
+#include "ThreadPlacement.hpp"
+
+using namespace std;
+
+// Constants
+// ------------------------------------------------------------------------------------------------
+
+static const uint64_t MAX_NUMBER_CODES = 17576000;
+static const uint64_t BYTES_PER_CODE = 8; // Assumes Windows file endings (2 bytes per newline)
+static const uint64_t NUM_BITSET_BYTES = (MAX_NUMBER_CODES / 8);
+
+static const uint64_t NUM_CODES_MULTI_THREADED_THRESHOLD = 600000;
+
+// Number of unpinned threads used if the topology couldn't be discovered
+static const uint64_t FALLBACK_NUM_THREADS = 3;
+
+// The file is split into segments of this many codes (128 KiB), which are the unit of work
+// assigned to nodes and claimed by workers
+static const uint64_t SEGMENT_NUM_CODES = 16384;
+
+// Search
+// ------------------------------------------------------------------------------------------------
+
+// Checks the codes in range [firstCode, lastCode) against and inserts them into the bitset
+static bool searchRange(const uint8_t* __restrict fileView,
+                        uint64_t* __restrict isFoundBitset,
+                        uint64_t firstCode,
+                        uint64_t lastCode) noexcept
+{
+	for (uint64_t i = firstCode * BYTES_PER_CODE; i < lastCode * BYTES_PER_CODE; i += BYTES_PER_CODE) {
+		uint32_t number = uint32_t(fileView[i] - 'A') * 676000u +
+		                  uint32_t(fileView[i + 1] - 'A') * 26000u +
+		                  uint32_t(fileView[i + 2] - 'A') * 1000u +
+		                  uint32_t(fileView[i + 3] - '0') * 100u +
+		                  uint32_t(fileView[i + 4] - '0') * 10u +
+		                  uint32_t(fileView[i + 5] - '0');
+
+		uint32_t bitsetChunkIndex = number >> 6u; // number / 64;
+		uint32_t bitIndex = number & 0x0000003Fu; // number % 64;
+
+		uint64_t chunk = isFoundBitset[bitsetChunkIndex];
+		uint64_t bitMask = uint64_t(1) << bitIndex;
+
+		if ((bitMask & chunk) != uint64_t(0)) {
+			return true;
+		}
+
+		chunk = bitMask | chunk;
+		isFoundBitset[bitsetChunkIndex] = chunk;
+	}
+	return false;
+}
+
+// Single threaded variant
+// ------------------------------------------------------------------------------------------------
+
+static bool singleThreadedSearch(const uint8_t* __restrict fileView, uint64_t numCodes) noexcept
+{
+	// Allocate bitset buffer for whether a number is found or not, and clear it
+	uint64_t* isFoundBitset = static_cast<uint64_t*>(_aligned_malloc(NUM_BITSET_BYTES, 32));
+	memset(isFoundBitset, 0, NUM_BITSET_BYTES);
+
+	// Check all codes in file
+	bool foundCopy = searchRange(fileView, isFoundBitset, 0, numCodes);
+
+	// Free allocated bitset memory
+	_aligned_free(isFoundBitset);
+
+	// Return result
+	return foundCopy;
+}
+
+// NUMA placement
+// ------------------------------------------------------------------------------------------------
+
+struct NumaWorker final {
+	LogicalProcessor processor;
+	bool pinned = false;
+	uint32_t node = 0; // Node used for scheduling, may be simulated
+};
+
+// Spreads the workers round robin over the nodes, within each node processors are taken in
+// PHYSICAL_CORES_FIRST order
+static vector<NumaWorker> placeWorkers(const CpuTopology& topology, uint32_t numNodes,
+                                       uint32_t simulatedNumNodes) noexcept
+{
+	vector<NumaWorker> workers;
+	if (topology.processors.empty()) {
+		workers.resize(FALLBACK_NUM_THREADS);
+		return workers;
+	}
+
+	// Processors available on each node
+	vector<LogicalProcessor> ordered = placeThreads(topology, PlacementPolicy::PHYSICAL_CORES_FIRST,
+	                                                vector<uint32_t>(), uint32_t(topology.processors.size()));
+	vector<vector<LogicalProcessor>> nodeProcessors(numNodes);
+	for (const LogicalProcessor& processor : ordered) {
+		uint32_t node = simulatedNumNodes != 0 ? processor.coreIndex % simulatedNumNodes : processor.numaNode;
+		nodeProcessors[node].push_back(processor);
+	}
+
+	// Default thread count, see placeThreads()
+	uint32_t numThreads = max(topology.numCores, 2u) - 1;
+	vector<size_t> nextOnNode(numNodes, 0);
+	for (uint32_t i = 0; workers.size() < numThreads && i < numThreads * numNodes; i++) {
+		uint32_t node = i % numNodes;
+		if (nextOnNode[node] >= nodeProcessors[node].size()) continue;
+		NumaWorker worker;
+		worker.processor = nodeProcessors[node][nextOnNode[node]++];
+		worker.pinned = true;
+		worker.node = node;
+		workers.push_back(worker);
+	}
+	return workers;
+}
+
+// Returns the node each segment of the file should be checked on. The node of the first page of
+// each segment is queried with QueryWorkingSetEx(). Pages of a new view are never in the working
+// set, so the first page of each segment is touched before the query. Pages already in the file
+// cache are only soft faulted and keep their node, pages not yet read are read in on the calling
+// thread's node. Segments are assigned round robin when simulating nodes or if the query fails.
+static vector<uint32_t> assignSegmentNodes(const uint8_t* fileView, uint64_t numSegments,
+                                           uint32_t numNodes, bool simulated) noexcept
+{
+	vector<uint32_t> segmentNodes(numSegments);
+	for (uint64_t i = 0; i < numSegments; i++) {
+		segmentNodes[i] = uint32_t(i % numNodes);
+	}
+	if (numNodes == 1 || simulated) return segmentNodes;
+
+	const volatile uint8_t* touchView = fileView;
+	vector<PSAPI_WORKING_SET_EX_INFORMATION> pageInfos(numSegments);
+	for (uint64_t i = 0; i < numSegments; i++) {
+		uint64_t offset = i * SEGMENT_NUM_CODES * BYTES_PER_CODE;
+		(void)touchView[offset];
+		pageInfos[i].VirtualAddress = const_cast<uint8_t*>(fileView + offset);
+	}
+	DWORD numInfoBytes = DWORD(numSegments * sizeof(PSAPI_WORKING_SET_EX_INFORMATION));
+	if (!QueryWorkingSetEx(GetCurrentProcess(), pageInfos.data(), numInfoBytes)) {
+		return segmentNodes;
+	}
+
+	for (uint64_t i = 0; i < numSegments; i++) {
+		const PSAPI_WORKING_SET_EX_BLOCK& attributes = pageInfos[i].VirtualAttributes;
+		if (attributes.Valid && attributes.Node < numNodes) {
+			segmentNodes[i] = uint32_t(attributes.Node);
+		}
+	}
+	return segmentNodes;
+}
+
+// Multi-threaded variant
+// ------------------------------------------------------------------------------------------------
+
+struct alignas(64) NodeQueue final {
+	vector<uint64_t> segments;
+	atomic_size_t nextSegment;
+	NodeQueue() noexcept : nextSegment(0) { }
+};
+
+// Merges any number of bitsets. A bit is set in "once" when seen in any bitset so far, and in
+// "twice" when seen in at least two, which means a copy.
+static bool mergeBitsets(const vector<uint64_t*>& bitsets) noexcept
+{
+	for (size_t i = 0; i < (NUM_BITSET_BYTES / sizeof(uint64_t)); i++) {
+		uint64_t once = 0;
+		uint64_t twice = 0;
+		for (const uint64_t* bitset : bitsets) {
+			uint64_t b = bitset[i];
+			twice |= once & b;
+			once |= b;
+		}
+		if (twice != uint64_t(0)) return true;
+	}
+	return false;
+}
+
+static void workerFunction(const uint8_t* __restrict fileView,
+                           uint64_t** bitsetOut,
+                           const NumaWorker* worker,
+                           NodeQueue* queues,
+                           uint32_t numNodes,
+                           CancellationToken* copyFoundToken,
+                           uint64_t numCodes) noexcept
+{
+	// Pin thread and allocate bitset on its node. VirtualAlloc() memory is already zeroed, and the
+	// pages are first touched by this thread, so they end up local even if the node hint is
+	// ignored.
+	if (worker->pinned) {
+		pinCurrentThread(worker->processor);
+		*bitsetOut = static_cast<uint64_t*>(VirtualAllocExNuma(GetCurrentProcess(), NULL,
+			NUM_BITSET_BYTES, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE, worker->processor.numaNode));
+		if (*bitsetOut == nullptr) printf("VirtualAllocExNuma() failed\n");
+	}
+	else {
+		*bitsetOut = static_cast<uint64_t*>(VirtualAlloc(NULL, NUM_BITSET_BYTES,
+			MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE));
+		if (*bitsetOut == nullptr) printf("VirtualAlloc() failed\n");
+	}
+	uint64_t* isFoundBitset = *bitsetOut;
+	if (isFoundBitset == nullptr) return;
+
+	// Claim segments from own node first, then from the other nodes
+	for (uint32_t i = 0; i < numNodes; i++) {
+		NodeQueue& queue = queues[(worker->node + i) % numNodes];
+
+		while (!copyFoundToken->isCancelled()) {
+			size_t index = atomic_fetch_add(&queue.nextSegment, size_t(1));
+			if (index >= queue.segments.size()) break;
+
+			uint64_t firstCode = queue.segments[index] * SEGMENT_NUM_CODES;
+			uint64_t lastCode = min(firstCode + SEGMENT_NUM_CODES, numCodes);
+			if (searchRange(fileView, isFoundBitset, firstCode, lastCode)) {
+				copyFoundToken->cancel();
+				return;
+			}
+		}
+	}
+}
+
+static bool multiThreadedSearch(const uint8_t* __restrict fileView, uint64_t numCodes,
+                                uint32_t simulatedNumNodes) noexcept
+{
+	const CpuTopology& topology = cpuTopology();
+	uint32_t numNodes = simulatedNumNodes != 0 ? simulatedNumNodes : max(topology.numNumaNodes, 1u);
+	vector<NumaWorker> workers = placeWorkers(topology, numNodes, simulatedNumNodes);
+
+	// Queue of segments for each node
+	uint64_t numSegments = (numCodes + SEGMENT_NUM_CODES - 1) / SEGMENT_NUM_CODES;
+	vector<uint32_t> segmentNodes = assignSegmentNodes(fileView, numSegments, numNodes, simulatedNumNodes != 0);
+	vector<NodeQueue> queues(numNodes);
+	for (uint64_t i = 0; i < numSegments; i++) {
+		queues[segmentNodes[i]].segments.push_back(i);
+	}
+
+	// Cancelled by the thread that finds a copy
+	CancellationToken copyFoundToken;
+
+	// Start threads, each allocates its own bitset
+	vector<uint64_t*> bitsets(workers.size(), nullptr);
+	vector<thread> threads(workers.size());
+	for (size_t i = 0; i < workers.size(); i++) {
+		threads[i] = thread(workerFunction, fileView, &bitsets[i], &workers[i], queues.data(),
+		                    numNodes, &copyFoundToken, numCodes);
+	}
+
+	// Wait for threads to finish working
+	for (thread& t : threads) {
+		t.join();
+	}
+
+	// Compare all threads tables, if an allocation failed the result can't be trusted so fall back
+	// to a single threaded search
+	bool allocationFailed = find(bitsets.begin(), bitsets.end(), nullptr) != bitsets.end();
+	bool foundCopy = copyFoundToken.isCancelled();
+	if (!foundCopy) {
+		foundCopy = allocationFailed ? singleThreadedSearch(fileView, numCodes) : mergeBitsets(bitsets);
+	}
+
+	// Free memory
+	for (uint64_t* bitset : bitsets) {
+		if (bitset != nullptr) VirtualFree(bitset, 0, MEM_RELEASE);
+	}
+
+	// Return result
+	return foundCopy;
+}
+
+// Exposed functions
+// ------------------------------------------------------------------------------------------------
+
+bool numaSearch(const char* filePath, uint32_t simulatedNumNodes) noexcept
+{
+	// Open file
+	HANDLE file = CreateFile(filePath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+	                         FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (file == INVALID_HANDLE_VALUE) {
+		printf("CreateFile() failed\n");
+		return false;
+	}
+
+	// Get size of file
+	uint64_t fileSize = static_cast<uint64_t>(GetFileSize(file, NULL));
+
+	// Large file fast path
+	// There are a total of 17 576 000 different codes. If the file contains more codes than that
+	// it must also by definition contain a copy.
+	if (fileSize >= ((MAX_NUMBER_CODES + 1) * BYTES_PER_CODE)) {
+		CloseHandle(file);
+		return true;
+	}
+
+	// Create mapped file
+	HANDLE mappedFile = CreateFileMapping(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (!mappedFile) {
+		printf("CreateFileMapping() failed\n");
+		CloseHandle(file);
+		return false;
+	}
+
+	// Create mapped file view
+	void* fileView = MapViewOfFile(mappedFile, FILE_MAP_READ, 0, 0, fileSize);
+	if (!fileView) {
+		printf("MapViewOfFile() failed\n");
+		CloseHandle(mappedFile);
+		CloseHandle(file);
+		return false;
+	}
+
+	// Result variable
+	bool foundCopy = false;
+
+	// Single threaded path
+	uint64_t numCodes = numCodesInText(fileSize, BYTES_PER_CODE);
+	if (numCodes <= NUM_CODES_MULTI_THREADED_THRESHOLD) {
+		foundCopy = singleThreadedSearch(static_cast<const uint8_t*>(fileView), numCodes);
+	}
+
+	// Multi-threaded path
+	else {
+		foundCopy = multiThreadedSearch(static_cast<const uint8_t*>(fileView), numCodes, simulatedNumNodes);
+	}
+
+	// Unmap mapped file view
+	if (!UnmapViewOfFile(fileView)) {
+		printf("UnmapViewOfFile() failed\n");
+		CloseHandle(mappedFile);
+		CloseHandle(file);
+		return false;
+	}
+
+	// Close mapped file
+	if (!CloseHandle(mappedFile)) {
+		printf("CloseHandle() failed for mappedFile\n");
+		return false;
+	}
+
+	// Close file
+	if (!CloseHandle(file)) {
+		printf("CloseHandle() failed for file\n");
+		return false;
+	}
+
+	// Return result
+	return foundCopy;
+}
+
+bool numaAlgorithm(const char* filePath) noexcept
+{
+	return numaSearch(filePath, 0);
+}
@@ -0,0 +1,17 @@
+// Copyright(c) Peter Hillerstrm(skipifzero.com, peter@hstroem.se)
+
+#pragma once
+
+#include <cstdint>
+
+// Same as optimizedSmartAlgorithm7(), but NUMA aware. Worker threads are spread over the NUMA
+// nodes and pinned, each worker's bitset is allocated on its own node, and the file is split into
+// segments that are preferably checked by workers on the node holding the segment's pages.
+//
+// On single node machines this falls back to one shared queue of segments and regular allocation.
+bool numaAlgorithm(const char* filePath) noexcept;
+
+// Same as numaAlgorithm(), but if simulatedNumNodes is non-zero the processors and file segments
+// are split into that many simulated nodes. Used to exercise the multi-node paths on single node
+// machines, memory is still allocated on the processors' real nodes.
+bool numaSearch(const char* filePath, uint32_t simulatedNumNodes) noexcept;
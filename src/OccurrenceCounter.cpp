@@ -0,0 +1,313 @@
+// Copyright(c) Peter Hillerstrm(skipifzero.com, peter@hstroem.se)
+
+#include "OccurrenceCounter.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <queue>
+#include <thread>
+#include <vector>
+
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#include <immintrin.h>
+#include <malloc.h>
+
+#include "PlateDecoders.hpp"
+
+using namespace std;
+
+// Constants
+// ------------------------------------------------------------------------------------------------
+
+static const uint64_t MAX_NUMBER_CODES = 17576000;
+static const uint64_t BYTES_PER_CODE = 8; // Assumes Windows file endings (2 bytes per newline)
+static const uint64_t NUM_COUNTER_BYTES = MAX_NUMBER_CODES / 2;
+static_assert((NUM_COUNTER_BYTES % 32) == 0, "Counters must be whole AVX2 vectors");
+
+static const uint32_t NUM_THREADS = 3;
+static const uint64_t NUM_CODES_MULTI_THREADED_THRESHOLD = 600000;
+
+static const uint32_t PRINTED_TOP_K = 5;
+static const uint64_t PRINTED_MIN_COUNT = 3;
+
+// Helpers
+// ------------------------------------------------------------------------------------------------
+
+// Orders the worst entry first, i.e. the lowest count and for equal counts the highest index
+struct WorseFirst final {
+	bool operator() (const CodeCount& a, const CodeCount& b) const noexcept
+	{
+		return a.count != b.count ? a.count > b.count : a.number < b.number;
+	}
+};
+
+// Occurrence counter
+// ------------------------------------------------------------------------------------------------
+
+bool OccurrenceCounter::create() noexcept
+{
+	this->destroy();
+	mCounters = static_cast<uint8_t*>(_aligned_malloc(NUM_COUNTER_BYTES, 32));
+	if (mCounters == nullptr) return false;
+	memset(mCounters, 0, NUM_COUNTER_BYTES);
+	return true;
+}
+
+void OccurrenceCounter::destroy() noexcept
+{
+	if (mCounters != nullptr) _aligned_free(mCounters);
+	mCounters = nullptr;
+	mOverflow.clear();
+}
+
+void OccurrenceCounter::clear() noexcept
+{
+	memset(mCounters, 0, NUM_COUNTER_BYTES);
+	mOverflow.clear();
+}
+
+void OccurrenceCounter::addCodes(const uint8_t* __restrict fileView, uint64_t firstCode, uint64_t lastCode) noexcept
+{
+	alignas(32) uint32_t numbers[8];
+	uint64_t i = firstCode;
+	for (; (i + 8) <= lastCode; i += 8) {
+		_mm256_store_si256(reinterpret_cast<__m256i*>(numbers), decode8Avx2<BYTES_PER_CODE>(fileView + i * BYTES_PER_CODE));
+		for (uint32_t number : numbers) {
+			this->add(number);
+		}
+	}
+	for (; i < lastCode; i++) {
+		this->add(decodeScalar(fileView + i * BYTES_PER_CODE));
+	}
+}
+
+void OccurrenceCounter::merge(const OccurrenceCounter& other) noexcept
+{
+	const __m256i NIBBLE_MASK = _mm256_set1_epi8(0x0F);
+	const __m256i MAX_COUNT = _mm256_set1_epi8(int8_t(OCCURRENCE_COUNTER_MAX));
+	for (uint64_t i = 0; i < NUM_COUNTER_BYTES; i += 32) {
+		__m256i b = _mm256_load_si256(reinterpret_cast<const __m256i*>(other.mCounters + i));
+		if (_mm256_testz_si256(b, b)) continue;
+		__m256i a = _mm256_load_si256(reinterpret_cast<const __m256i*>(mCounters + i));
+
+		// Add low and high nibbles separately, sums are at most 30 so fit in a byte
+		__m256i lo = _mm256_add_epi8(_mm256_and_si256(a, NIBBLE_MASK), _mm256_and_si256(b, NIBBLE_MASK));
+		__m256i hi = _mm256_add_epi8(_mm256_and_si256(_mm256_srli_epi16(a, 4), NIBBLE_MASK),
+		                             _mm256_and_si256(_mm256_srli_epi16(b, 4), NIBBLE_MASK));
+		__m256i saturated = _mm256_or_si256(_mm256_slli_epi16(_mm256_min_epu8(hi, MAX_COUNT), 4),
+		                                    _mm256_min_epu8(lo, MAX_COUNT));
+
+		// Sums above the max spill into the overflow map, read from the counters before storing
+		__m256i spilled = _mm256_or_si256(_mm256_cmpgt_epi8(lo, MAX_COUNT), _mm256_cmpgt_epi8(hi, MAX_COUNT));
+		uint32_t spilledMask = uint32_t(_mm256_movemask_epi8(spilled));
+		while (spilledMask != 0) {
+			uint64_t byteIndex = i + _tzcnt_u32(spilledMask);
+			spilledMask = _blsr_u32(spilledMask);
+			for (uint32_t shift = 0; shift <= 4; shift += 4) {
+				uint32_t sum = ((mCounters[byteIndex] >> shift) & 0x0Fu) + ((other.mCounters[byteIndex] >> shift) & 0x0Fu);
+				if (sum > OCCURRENCE_COUNTER_MAX) {
+					mOverflow[uint32_t(byteIndex * 2 + shift / 4)] += sum - OCCURRENCE_COUNTER_MAX;
+				}
+			}
+		}
+		_mm256_store_si256(reinterpret_cast<__m256i*>(mCounters + i), saturated);
+	}
+
+	// Overflow of the other counter, its counters are saturated so ours are now too
+	for (const auto& entry : other.mOverflow) {
+		mOverflow[entry.first] += entry.second;
+	}
+}
+
+uint64_t OccurrenceCounter::count(uint32_t number) const noexcept
+{
+	uint32_t counter = (mCounters[number >> 1u] >> ((number & 1u) * 4u)) & 0x0Fu;
+	if (counter != OCCURRENCE_COUNTER_MAX) return counter;
+	auto it = mOverflow.find(number);
+	return counter + (it != mOverflow.end() ? it->second : 0);
+}
+
+void OccurrenceCounter::report(uint32_t topK, uint64_t minCount, vector<CodeCount>& topOut,
+                               vector<CodeCount>& atLeastOut) const noexcept
+{
+	topOut.clear();
+	atLeastOut.clear();
+	priority_queue<CodeCount, vector<CodeCount>, WorseFirst> top;
+
+	// Smallest counter value that can matter, vectors with all counters below it are skipped. A
+	// value above the max means nothing can matter anymore.
+	const uint32_t NOTHING = OCCURRENCE_COUNTER_MAX + 1;
+	uint32_t atLeastCutoff = minCount == 0 ? NOTHING : uint32_t(min(minCount, uint64_t(OCCURRENCE_COUNTER_MAX)));
+	auto cutoff = [&]() {
+		uint32_t topCutoff = NOTHING;
+		if (topK != 0) {
+			topCutoff = top.size() < topK ? 1 : uint32_t(min(top.top().count + 1, uint64_t(OCCURRENCE_COUNTER_MAX)));
+		}
+		return min(atLeastCutoff, topCutoff);
+	};
+
+	const __m256i NIBBLE_MASK = _mm256_set1_epi8(0x0F);
+	uint32_t currentCutoff = cutoff();
+	for (uint64_t i = 0; i < NUM_COUNTER_BYTES && currentCutoff != NOTHING; i += 32) {
+		__m256i v = _mm256_load_si256(reinterpret_cast<const __m256i*>(mCounters + i));
+		__m256i largest = _mm256_max_epu8(_mm256_and_si256(v, NIBBLE_MASK),
+		                                  _mm256_and_si256(_mm256_srli_epi16(v, 4), NIBBLE_MASK));
+		__m256i atCutoff = _mm256_cmpeq_epi8(_mm256_max_epu8(largest, _mm256_set1_epi8(int8_t(currentCutoff))), largest);
+		uint32_t candidateMask = uint32_t(_mm256_movemask_epi8(atCutoff));
+
+		while (candidateMask != 0) {
+			uint64_t byteIndex = i + _tzcnt_u32(candidateMask);
+			candidateMask = _blsr_u32(candidateMask);
+			for (uint32_t j = 0; j < 2; j++) {
+				uint32_t number = uint32_t(byteIndex * 2 + j);
+				uint64_t count = this->count(number);
+				if (count == 0) continue;
+				if (minCount != 0 && count >= minCount) {
+					atLeastOut.push_back(CodeCount{ number, count });
+				}
+				if (topK != 0 && (top.size() < topK || count > top.top().count)) {
+					if (top.size() == topK) top.pop();
+					top.push(CodeCount{ number, count });
+				}
+			}
+			currentCutoff = cutoff();
+		}
+	}
+
+	while (!top.empty()) {
+		topOut.push_back(top.top());
+		top.pop();
+	}
+	reverse(topOut.begin(), topOut.end());
+}
+
+// Counting
+// ------------------------------------------------------------------------------------------------
+
+static bool countCodes(const uint8_t* __restrict fileView, uint64_t numCodes, uint32_t numThreads,
+                       OccurrenceCounter& countsOut) noexcept
+{
+	if (numThreads <= 1 || numCodes <= NUM_CODES_MULTI_THREADED_THRESHOLD) {
+		countsOut.addCodes(fileView, 0, numCodes);
+		return true;
+	}
+
+	// Thread 0 counts into the output counter, the others into their own which are merged after
+	vector<OccurrenceCounter> counters(numThreads - 1);
+	for (OccurrenceCounter& counter : counters) {
+		if (!counter.create()) return false;
+	}
+	uint64_t chunkSize = (numCodes + numThreads - 1) / numThreads;
+	vector<thread> threads;
+	for (uint32_t i = 1; i < numThreads; i++) {
+		uint64_t chunkStart = min(i * chunkSize, numCodes);
+		uint64_t chunkEnd = min(chunkStart + chunkSize, numCodes);
+		threads.emplace_back([&counters, fileView, i, chunkStart, chunkEnd]() {
+			counters[i - 1].addCodes(fileView, chunkStart, chunkEnd);
+		});
+	}
+	countsOut.addCodes(fileView, 0, min(chunkSize, numCodes));
+	for (thread& t : threads) {
+		t.join();
+	}
+	for (const OccurrenceCounter& counter : counters) {
+		countsOut.merge(counter);
+	}
+	return true;
+}
+
+// Exposed functions
+// ------------------------------------------------------------------------------------------------
+
+bool countOccurrences(const char* filePath, uint32_t numThreads, OccurrenceCounter& countsOut) noexcept
+{
+	if (!countsOut.create()) {
+		printf("Could not allocate occurrence counters\n");
+		return false;
+	}
+
+	// Open file
+	HANDLE file = CreateFile(filePath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+	                         FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (file == INVALID_HANDLE_VALUE) {
+		printf("CreateFile() failed\n");
+		return false;
+	}
+
+	// Get size of file
+	uint64_t fileSize = static_cast<uint64_t>(GetFileSize(file, NULL));
+	uint64_t numCodes = numCodesInText(fileSize, BYTES_PER_CODE);
+	if (numCodes == 0) {
+		CloseHandle(file);
+		return true;
+	}
+
+	// Create mapped file
+	HANDLE mappedFile = CreateFileMapping(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (!mappedFile) {
+		printf("CreateFileMapping() failed\n");
+		CloseHandle(file);
+		return false;
+	}
+
+	// Create mapped file view
+	void* fileView = MapViewOfFile(mappedFile, FILE_MAP_READ, 0, 0, fileSize);
+	if (!fileView) {
+		printf("MapViewOfFile() failed\n");
+		CloseHandle(mappedFile);
+		CloseHandle(file);
+		return false;
+	}
+
+	// Count
+	bool success = countCodes(static_cast<const uint8_t*>(fileView), numCodes, numThreads, countsOut);
+
+	// Unmap mapped file view
+	if (!UnmapViewOfFile(fileView)) {
+		printf("UnmapViewOfFile() failed\n");
+		CloseHandle(mappedFile);
+		CloseHandle(file);
+		return false;
+	}
+
+	// Close mapped file
+	if (!CloseHandle(mappedFile)) {
+		printf("CloseHandle() failed for mappedFile\n");
+		return false;
+	}
+
+	// Close file
+	if (!CloseHandle(file)) {
+		printf("CloseHandle() failed for file\n");
+		return false;
+	}
+
+	return success;
+}
+
+void printHeavyHitters(const char* filePath) noexcept
+{
+	OccurrenceCounter counts;
+	auto startTime = chrono::high_resolution_clock::now();
+	if (!countOccurrences(filePath, NUM_THREADS, counts)) return;
+	auto countEndTime = chrono::high_resolution_clock::now();
+	vector<CodeCount> top, atLeast;
+	counts.report(PRINTED_TOP_K, PRINTED_MIN_COUNT, top, atLeast);
+	auto reportEndTime = chrono::high_resolution_clock::now();
+
+	printf("Heavy hitters in \"%s\": counted in %.2f ms, reported in %.2f ms, %llu overflow codes\n", filePath,
+	       chrono::duration<double, milli>(countEndTime - startTime).count(),
+	       chrono::duration<double, milli>(reportEndTime - countEndTime).count(),
+	       (unsigned long long)counts.numOverflowCodes());
+	for (const CodeCount& entry : top) {
+		uint8_t code[7] = {};
+		encodeScalar(entry.number, code);
+		printf("  %s: %llu\n", reinterpret_cast<const char*>(code), (unsigned long long)entry.count);
+	}
+	printf("  %zu codes occur at least %llu times\n\n", atLeast.size(), (unsigned long long)PRINTED_MIN_COUNT);
+}
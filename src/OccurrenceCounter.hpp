@@ -0,0 +1,75 @@
+// Copyright(c) Peter Hillerstrm(skipifzero.com, peter@hstroem.se)
+
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+// Occurrence counter
+// ------------------------------------------------------------------------------------------------
+
+// Counts how many times each of the 17576000 codes occurs, e.g. to find cloned plates. Each code
+// has a 4 bit saturating counter, two per byte (8.8 MB). Occurrences past 15 go into an overflow
+// map, so the exact count of a code is its counter plus its overflow entry, and a code has an
+// overflow entry only if its counter is saturated. Since most codes occur a few times at most the
+// overflow map only holds the heavy hitters.
+//
+// Threads count into their own counters which are then merged with a SIMD saturating add, lanes
+// that saturate are resolved exactly through the overflow maps.
+
+static const uint32_t OCCURRENCE_COUNTER_MAX = 15;
+
+struct CodeCount final {
+	uint32_t number;
+	uint64_t count;
+};
+
+class OccurrenceCounter final {
+public:
+	OccurrenceCounter() noexcept = default;
+	OccurrenceCounter(const OccurrenceCounter&) = delete;
+	OccurrenceCounter& operator= (const OccurrenceCounter&) = delete;
+	~OccurrenceCounter() noexcept { this->destroy(); }
+
+	bool create() noexcept;
+	void destroy() noexcept;
+	void clear() noexcept;
+
+	void add(uint32_t number) noexcept
+	{
+		uint8_t& pair = mCounters[number >> 1u];
+		uint32_t shift = (number & 1u) * 4u;
+		if (((pair >> shift) & 0x0Fu) != OCCURRENCE_COUNTER_MAX) {
+			pair = uint8_t(pair + (1u << shift));
+		}
+		else {
+			mOverflow[number] += 1;
+		}
+	}
+
+	// Adds the codes in range [firstCode, lastCode) of a text file view (8 bytes per code)
+	void addCodes(const uint8_t* __restrict fileView, uint64_t firstCode, uint64_t lastCode) noexcept;
+
+	// Adds all counts of the other counter to this one
+	void merge(const OccurrenceCounter& other) noexcept;
+
+	uint64_t count(uint32_t number) const noexcept;
+
+	// In one pass over the counters, writes the topK codes with the highest counts (descending,
+	// ties by ascending index) and all codes with a count of at least minCount (ascending index)
+	void report(uint32_t topK, uint64_t minCount, std::vector<CodeCount>& topOut,
+	            std::vector<CodeCount>& atLeastOut) const noexcept;
+
+	uint64_t numOverflowCodes() const noexcept { return mOverflow.size(); }
+
+private:
+	uint8_t* mCounters = nullptr;
+	std::unordered_map<uint32_t, uint64_t> mOverflow;
+};
+
+// Counts all codes in the file using the specified number of threads, one counter per thread
+bool countOccurrences(const char* filePath, uint32_t numThreads, OccurrenceCounter& countsOut) noexcept;
+
+// Prints the most common codes and the codes occurring at least 3 times in the file
+void printHeavyHitters(const char* filePath) noexcept;
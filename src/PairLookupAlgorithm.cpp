@@ -0,0 +1,258 @@
+// Copyright(c) Peter Hillerstrm(skipifzero.com, peter@hstroem.se)
+
+#include "PairLookupAlgorithm.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#include <malloc.h>
+
+#include "PlateDecoders.hpp"
+
+using namespace std;
+
+// Constants
+// ------------------------------------------------------------------------------------------------
+
+static const uint64_t MAX_NUMBER_CODES = 17576000;
+static const uint64_t NUM_BITSET_BYTES = (MAX_NUMBER_CODES / 8);
+
+static const uint64_t NUM_THREADS = 3;
+static const uint64_t CODE_ALLOCATION_BATCH_SIZE = 4096;
+static const uint64_t NUM_CODES_MULTI_THREADED_THRESHOLD = 600000;
+
+// Search
+// ------------------------------------------------------------------------------------------------
+
+// Checks the codes in range [firstCode, lastCode) against and inserts them into the bitset
+template<uint64_t BYTES_PER_CODE>
+static bool searchRange(const uint8_t* __restrict fileView,
+                        uint64_t* __restrict isFoundBitset,
+                        uint64_t firstCode,
+                        uint64_t lastCode) noexcept
+{
+	const uint8_t* end = fileView + lastCode * BYTES_PER_CODE;
+	for (const uint8_t* code = fileView + firstCode * BYTES_PER_CODE; code < end; code += BYTES_PER_CODE) {
+		uint32_t number = decodePairLookup(code);
+
+		uint32_t bitsetChunkIndex = number >> 6u; // number / 64;
+		uint32_t bitIndex = number & 0x0000003Fu; // number % 64;
+
+		uint64_t chunk = isFoundBitset[bitsetChunkIndex];
+		uint64_t bitMask = uint64_t(1) << bitIndex;
+
+		if ((bitMask & chunk) != uint64_t(0)) {
+			return true;
+		}
+
+		chunk = bitMask | chunk;
+		isFoundBitset[bitsetChunkIndex] = chunk;
+	}
+	return false;
+}
+
+// Single threaded variant
+// ------------------------------------------------------------------------------------------------
+
+template<uint64_t BYTES_PER_CODE>
+static bool singleThreadedSearch(const uint8_t* __restrict fileView, uint64_t numCodes) noexcept
+{
+	// Allocate bitset buffer for whether a number is found or not, and clear it
+	uint64_t* isFoundBitset = static_cast<uint64_t*>(_aligned_malloc(NUM_BITSET_BYTES, 32));
+	memset(isFoundBitset, 0, NUM_BITSET_BYTES);
+
+	// Check all codes in file
+	bool foundCopy = searchRange<BYTES_PER_CODE>(fileView, isFoundBitset, 0, numCodes);
+
+	// Free allocated bitset memory
+	_aligned_free(isFoundBitset);
+
+	// Return result
+	return foundCopy;
+}
+
+// Multi-threaded variant
+// ------------------------------------------------------------------------------------------------
+
+template<uint64_t BYTES_PER_CODE>
+static bool mergeBitsets(uint64_t* bitsets[NUM_THREADS]) noexcept
+{
+	static_assert(NUM_THREADS == 3, "mergeBitsets() assumes 3 threads");
+	for (size_t i = 0; i < (NUM_BITSET_BYTES / sizeof(uint64_t)); i++) {
+		uint64_t b1 = bitsets[0][i];
+		uint64_t b2 = bitsets[1][i];
+		uint64_t b3 = bitsets[2][i];
+		bool found = ((b1 & b2) | (b1 & b3) | (b2 & b3)) != uint64_t(0);
+		if (found) return true;
+	}
+	return false;
+}
+
+template<uint64_t BYTES_PER_CODE>
+static void workerFunction(const uint8_t* __restrict fileView,
+                           uint64_t* __restrict isFoundBitset,
+                           atomic_bool* foundCopy,
+                           size_t numCodes,
+                           atomic_size_t* nextFreeCodeIndex) noexcept
+{
+	// Clear bitset
+	memset(isFoundBitset, 0, NUM_BITSET_BYTES);
+
+	while (true) {
+
+		// Allocate codes from shared array
+		size_t codeIndex = atomic_fetch_add(nextFreeCodeIndex, CODE_ALLOCATION_BATCH_SIZE);
+		if (codeIndex >= numCodes) return;
+		size_t codesToCheck = min(size_t(CODE_ALLOCATION_BATCH_SIZE), numCodes - codeIndex);
+
+		// Check all allocated codes
+		if (searchRange<BYTES_PER_CODE>(fileView, isFoundBitset, codeIndex, codeIndex + codesToCheck)) {
+
+			// Allocate rest of codes so the other threads can stop
+			atomic_fetch_add(nextFreeCodeIndex, numCodes);
+
+			// Signal that the copy is found and exit thread
+			*foundCopy = true;
+			return;
+		}
+	}
+}
+
+template<uint64_t BYTES_PER_CODE>
+static bool multiThreadedSearch(const uint8_t* __restrict fileView, uint64_t numCodes) noexcept
+{
+	// Variable containing whether a copy was found or not
+	atomic_bool foundCopy(false);
+
+	// Counter used for allocating codes
+	atomic_size_t nextFreeCodeIndex(0);
+
+	// Start threads
+	uint64_t* bitsets[NUM_THREADS];
+	thread threads[NUM_THREADS];
+	for (size_t i = 0; i < NUM_THREADS; i++) {
+
+		// Allocate memory for bitset, cleared in worker function
+		bitsets[i] = static_cast<uint64_t*>(_aligned_malloc(NUM_BITSET_BYTES, 32));
+
+		// Start worker thread
+		threads[i] = thread(workerFunction<BYTES_PER_CODE>, fileView, bitsets[i], &foundCopy, numCodes,
+		                    &nextFreeCodeIndex);
+	}
+
+	// Wait for threads to finish working
+	for (thread& t : threads) {
+		t.join();
+	}
+
+	// Compare all threads tables
+	bool result = foundCopy || mergeBitsets<BYTES_PER_CODE>(bitsets);
+
+	// Free memory
+	for (uint64_t* bitset : bitsets) {
+		_aligned_free(bitset);
+	}
+
+	// Return result
+	return result;
+}
+
+// Pair lookup algorithm
+// ------------------------------------------------------------------------------------------------
+
+template<uint64_t BYTES_PER_CODE>
+static bool pairLookupAlgorithm(const char* filePath) noexcept
+{
+	// Open file
+	HANDLE file = CreateFile(filePath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+	                         FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (file == INVALID_HANDLE_VALUE) {
+		printf("CreateFile() failed\n");
+		return false;
+	}
+
+	// Get size of file
+	uint64_t fileSize = static_cast<uint64_t>(GetFileSize(file, NULL));
+
+	// Large file fast path
+	// There are a total of 17 576 000 different codes. If the file contains more codes than that
+	// it must also by definition contain a copy.
+	if (fileSize >= ((MAX_NUMBER_CODES + 1) * BYTES_PER_CODE)) {
+		CloseHandle(file);
+		return true;
+	}
+
+	// Create mapped file
+	HANDLE mappedFile = CreateFileMapping(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (!mappedFile) {
+		printf("CreateFileMapping() failed\n");
+		CloseHandle(file);
+		return false;
+	}
+
+	// Create mapped file view
+	void* fileView = MapViewOfFile(mappedFile, FILE_MAP_READ, 0, 0, fileSize);
+	if (!fileView) {
+		printf("MapViewOfFile() failed\n");
+		CloseHandle(mappedFile);
+		CloseHandle(file);
+		return false;
+	}
+
+	// Result variable
+	bool foundCopy = false;
+
+	// Single threaded path
+	uint64_t numCodes = numCodesInText(fileSize, BYTES_PER_CODE);
+	if (numCodes <= NUM_CODES_MULTI_THREADED_THRESHOLD) {
+		foundCopy = singleThreadedSearch<BYTES_PER_CODE>(static_cast<const uint8_t*>(fileView), numCodes);
+	}
+
+	// Multi-threaded path
+	else {
+		foundCopy = multiThreadedSearch<BYTES_PER_CODE>(static_cast<const uint8_t*>(fileView), numCodes);
+	}
+
+	// Unmap mapped file view
+	if (!UnmapViewOfFile(fileView)) {
+		printf("UnmapViewOfFile() failed\n");
+		CloseHandle(mappedFile);
+		CloseHandle(file);
+		return false;
+	}
+
+	// Close mapped file
+	if (!CloseHandle(mappedFile)) {
+		printf("CloseHandle() failed for mappedFile\n");
+		return false;
+	}
+
+	// Close file
+	if (!CloseHandle(file)) {
+		printf("CloseHandle() failed for file\n");
+		return false;
+	}
+
+	// Return result
+	return foundCopy;
+}
+
+// Exposed functions
+// ------------------------------------------------------------------------------------------------
+
+bool pairLookupAlgorithm(const char* filePath) noexcept
+{
+	return pairLookupAlgorithm<8>(filePath);
+}
+
+bool pairLookupAlgorithmLF(const char* filePath) noexcept
+{
+	return pairLookupAlgorithm<7>(filePath);
+}
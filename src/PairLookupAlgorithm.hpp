@@ -0,0 +1,12 @@
+// Copyright(c) Peter Hillerstrm(skipifzero.com, peter@hstroem.se)
+
+#pragma once
+
+// Same as optimizedSmartAlgorithm7(), but decodes codes with decodePairLookup() from
+// PlateDecoders.hpp instead of per-character multiplies
+
+// Windows file endings (CR+LF)
+bool pairLookupAlgorithm(const char* filePath) noexcept;
+
+// Unix file endings (LF)
+bool pairLookupAlgorithmLF(const char* filePath) noexcept;
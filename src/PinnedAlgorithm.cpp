@@ -0,0 +1,291 @@
+// Copyright(c) Peter Hillerstrm(skipifzero.com, peter@hstroem.se)
+
+#include "PinnedAlgorithm.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#include <malloc.h>
+
+#include "CancellationToken.hpp"
+#include "PlateDecoders.hpp"
+
+using namespace std;
+
+// Constants
+// ------------------------------------------------------------------------------------------------
+
+static const uint64_t MAX_NUMBER_CODES = 17576000;
+static const uint64_t BYTES_PER_CODE = 8; // Assumes Windows file endings (2 bytes per newline)
+static const uint64_t NUM_BITSET_BYTES = (MAX_NUMBER_CODES / 8);
+
+static const uint64_t CODE_ALLOCATION_BATCH_SIZE = 4096;
+static const uint64_t NUM_CODES_MULTI_THREADED_THRESHOLD = 600000;
+
+// Number of unpinned threads used if the topology couldn't be discovered
+static const uint64_t FALLBACK_NUM_THREADS = 3;
+
+// Search
+// ------------------------------------------------------------------------------------------------
+
+// Checks the codes in range [firstCode, lastCode) against and inserts them into the bitset
+static bool searchRange(const uint8_t* __restrict fileView,
+                        uint64_t* __restrict isFoundBitset,
+                        uint64_t firstCode,
+                        uint64_t lastCode) noexcept
+{
+	for (uint64_t i = firstCode * BYTES_PER_CODE; i < lastCode * BYTES_PER_CODE; i += BYTES_PER_CODE) {
+		uint32_t number = uint32_t(fileView[i] - 'A') * 676000u +
+		                  uint32_t(fileView[i + 1] - 'A') * 26000u +
+		                  uint32_t(fileView[i + 2] - 'A') * 1000u +
+		                  uint32_t(fileView[i + 3] - '0') * 100u +
+		                  uint32_t(fileView[i + 4] - '0') * 10u +
+		                  uint32_t(fileView[i + 5] - '0');
+
+		uint32_t bitsetChunkIndex = number >> 6u; // number / 64;
+		uint32_t bitIndex = number & 0x0000003Fu; // number % 64;
+
+		uint64_t chunk = isFoundBitset[bitsetChunkIndex];
+		uint64_t bitMask = uint64_t(1) << bitIndex;
+
+		if ((bitMask & chunk) != uint64_t(0)) {
+			return true;
+		}
+
+		chunk = bitMask | chunk;
+		isFoundBitset[bitsetChunkIndex] = chunk;
+	}
+	return false;
+}
+
+// Single threaded variant
+// ------------------------------------------------------------------------------------------------
+
+// Runs on the calling thread, pinned to the processor (if any) for the duration of the search. The
+// caller's previous affinity is restored afterwards.
+static bool singleThreadedSearch(const uint8_t* __restrict fileView, uint64_t numCodes,
+                                 const LogicalProcessor* processor) noexcept
+{
+	// Pinned before the bitset is cleared, same as the workers
+	GROUP_AFFINITY previousAffinity;
+	bool pinned = false;
+	if (processor != nullptr) {
+		GROUP_AFFINITY affinity;
+		memset(&affinity, 0, sizeof(GROUP_AFFINITY));
+		affinity.Group = processor->group;
+		affinity.Mask = KAFFINITY(uint64_t(1) << processor->number);
+		pinned = SetThreadGroupAffinity(GetCurrentThread(), &affinity, &previousAffinity) != 0;
+		if (!pinned) printf("SetThreadGroupAffinity() failed\n");
+	}
+
+	// Allocate bitset buffer for whether a number is found or not, and clear it
+	uint64_t* isFoundBitset = static_cast<uint64_t*>(_aligned_malloc(NUM_BITSET_BYTES, 32));
+	memset(isFoundBitset, 0, NUM_BITSET_BYTES);
+
+	// Check all codes in file
+	bool foundCopy = searchRange(fileView, isFoundBitset, 0, numCodes);
+
+	// Free allocated bitset memory
+	_aligned_free(isFoundBitset);
+
+	// Restore affinity of calling thread
+	if (pinned) SetThreadGroupAffinity(GetCurrentThread(), &previousAffinity, nullptr);
+
+	// Return result
+	return foundCopy;
+}
+
+// Multi-threaded variant
+// ------------------------------------------------------------------------------------------------
+
+// Merges any number of bitsets. A bit is set in "once" when seen in any bitset so far, and in
+// "twice" when seen in at least two, which means a copy.
+static bool mergeBitsets(const vector<uint64_t*>& bitsets) noexcept
+{
+	for (size_t i = 0; i < (NUM_BITSET_BYTES / sizeof(uint64_t)); i++) {
+		uint64_t once = 0;
+		uint64_t twice = 0;
+		for (const uint64_t* bitset : bitsets) {
+			uint64_t b = bitset[i];
+			twice |= once & b;
+			once |= b;
+		}
+		if (twice != uint64_t(0)) return true;
+	}
+	return false;
+}
+
+static void workerFunction(const uint8_t* __restrict fileView,
+                           uint64_t* __restrict isFoundBitset,
+                           const LogicalProcessor* processor,
+                           CancellationToken* copyFoundToken,
+                           size_t numCodes,
+                           atomic_size_t* nextFreeCodeIndex) noexcept
+{
+	// Pin thread before touching its bitset, so the memory is first touched from its processor
+	if (processor != nullptr) {
+		pinCurrentThread(*processor);
+	}
+
+	// Clear bitset
+	memset(isFoundBitset, 0, NUM_BITSET_BYTES);
+
+	while (!copyFoundToken->isCancelled()) {
+
+		// Allocate codes from shared array
+		size_t codeIndex = atomic_fetch_add(nextFreeCodeIndex, CODE_ALLOCATION_BATCH_SIZE);
+		if (codeIndex >= numCodes) return;
+		size_t codesToCheck = min(size_t(CODE_ALLOCATION_BATCH_SIZE), numCodes - codeIndex);
+
+		// Check all allocated codes
+		if (searchRange(fileView, isFoundBitset, codeIndex, codeIndex + codesToCheck)) {
+			copyFoundToken->cancel();
+			return;
+		}
+	}
+}
+
+static bool multiThreadedSearch(const uint8_t* __restrict fileView, uint64_t numCodes,
+                                const vector<LogicalProcessor>& placement) noexcept
+{
+	// Cancelled by the thread that finds a copy
+	CancellationToken copyFoundToken;
+
+	// Counter used for allocating codes
+	atomic_size_t nextFreeCodeIndex(0);
+
+	// One thread per placed processor, or unpinned threads if there is no placement
+	size_t numThreads = placement.empty() ? FALLBACK_NUM_THREADS : placement.size();
+
+	// Start threads
+	vector<uint64_t*> bitsets(numThreads);
+	vector<thread> threads(numThreads);
+	for (size_t i = 0; i < numThreads; i++) {
+
+		// Allocate memory for bitset, cleared in worker function
+		bitsets[i] = static_cast<uint64_t*>(_aligned_malloc(NUM_BITSET_BYTES, 32));
+
+		// Start worker thread
+		const LogicalProcessor* processor = placement.empty() ? nullptr : &placement[i];
+		threads[i] = thread(workerFunction, fileView, bitsets[i], processor, &copyFoundToken,
+		                    numCodes, &nextFreeCodeIndex);
+	}
+
+	// Wait for threads to finish working
+	for (thread& t : threads) {
+		t.join();
+	}
+
+	// Compare all threads tables
+	bool foundCopy = copyFoundToken.isCancelled() || mergeBitsets(bitsets);
+
+	// Free memory
+	for (uint64_t* bitset : bitsets) {
+		_aligned_free(bitset);
+	}
+
+	// Return result
+	return foundCopy;
+}
+
+// Exposed functions
+// ------------------------------------------------------------------------------------------------
+
+bool pinnedSearch(const char* filePath, PlacementPolicy policy, const vector<uint32_t>& cpuSet,
+                  uint32_t maxThreads) noexcept
+{
+	// Place threads, a cpu set without any existing processor is an error instead of falling back
+	// to unpinned threads
+	vector<LogicalProcessor> placement = placeThreads(cpuTopology(), policy, cpuSet, maxThreads);
+	if (policy == PlacementPolicy::CPU_SET && placement.empty()) {
+		printf("No processor in the cpu set exists\n");
+		return false;
+	}
+
+	// Open file
+	HANDLE file = CreateFile(filePath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+	                         FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (file == INVALID_HANDLE_VALUE) {
+		printf("CreateFile() failed\n");
+		return false;
+	}
+
+	// Get size of file
+	uint64_t fileSize = static_cast<uint64_t>(GetFileSize(file, NULL));
+
+	// Large file fast path
+	// There are a total of 17 576 000 different codes. If the file contains more codes than that
+	// it must also by definition contain a copy.
+	if (fileSize >= ((MAX_NUMBER_CODES + 1) * BYTES_PER_CODE)) {
+		CloseHandle(file);
+		return true;
+	}
+
+	// Create mapped file
+	HANDLE mappedFile = CreateFileMapping(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (!mappedFile) {
+		printf("CreateFileMapping() failed\n");
+		CloseHandle(file);
+		return false;
+	}
+
+	// Create mapped file view
+	void* fileView = MapViewOfFile(mappedFile, FILE_MAP_READ, 0, 0, fileSize);
+	if (!fileView) {
+		printf("MapViewOfFile() failed\n");
+		CloseHandle(mappedFile);
+		CloseHandle(file);
+		return false;
+	}
+
+	// Result variable
+	bool foundCopy = false;
+
+	// Single threaded path, also used if the placement only allows one thread. Runs on the first
+	// placed processor.
+	uint64_t numCodes = numCodesInText(fileSize, BYTES_PER_CODE);
+	if (numCodes <= NUM_CODES_MULTI_THREADED_THRESHOLD || placement.size() == 1) {
+		const LogicalProcessor* processor = placement.empty() ? nullptr : &placement[0];
+		foundCopy = singleThreadedSearch(static_cast<const uint8_t*>(fileView), numCodes, processor);
+	}
+
+	// Multi-threaded path
+	else {
+		foundCopy = multiThreadedSearch(static_cast<const uint8_t*>(fileView), numCodes, placement);
+	}
+
+	// Unmap mapped file view
+	if (!UnmapViewOfFile(fileView)) {
+		printf("UnmapViewOfFile() failed\n");
+		CloseHandle(mappedFile);
+		CloseHandle(file);
+		return false;
+	}
+
+	// Close mapped file
+	if (!CloseHandle(mappedFile)) {
+		printf("CloseHandle() failed for mappedFile\n");
+		return false;
+	}
+
+	// Close file
+	if (!CloseHandle(file)) {
+		printf("CloseHandle() failed for file\n");
+		return false;
+	}
+
+	// Return result
+	return foundCopy;
+}
+
+bool pinnedAlgorithm(const char* filePath) noexcept
+{
+	return pinnedSearch(filePath, PlacementPolicy::PHYSICAL_CORES_FIRST, vector<uint32_t>());
+}
@@ -0,0 +1,20 @@
+// Copyright(c) Peter Hillerstrm(skipifzero.com, peter@hstroem.se)
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "ThreadPlacement.hpp"
+
+// Same as optimizedSmartAlgorithm7(), but the number of threads is derived from the CPU topology
+// and each thread is pinned to its own processor according to a placement policy.
+
+// Uses PHYSICAL_CORES_FIRST with the default thread count
+bool pinnedAlgorithm(const char* filePath) noexcept;
+
+// Uses the specified placement, see placeThreads() for the meaning of the arguments. Files too
+// small for multiple threads are checked on the calling thread, pinned to the first placed
+// processor. Fails if the policy is CPU_SET and none of the processors in the cpu set exist.
+bool pinnedSearch(const char* filePath, PlacementPolicy policy, const std::vector<uint32_t>& cpuSet,
+                  uint32_t maxThreads = 0) noexcept;
@@ -0,0 +1,821 @@
+// Copyright(c) Peter Hillerstrm(skipifzero.com, peter@hstroem.se)
+
+#include "PlateChecker.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <vector>
+
+#include <malloc.h>
+
+#include "CancellationToken.hpp"
+#include "PlateDecoders.hpp"
+
+using namespace std;
+
+// Constants
+// ------------------------------------------------------------------------------------------------
+
+static const uint64_t MAX_NUMBER_CODES = 17576000;
+static const uint64_t NUM_BITSET_BYTES = (MAX_NUMBER_CODES / 8);
+static const uint64_t NUM_BITSET_WORDS = NUM_BITSET_BYTES / sizeof(uint64_t);
+
+static const uint32_t DEFAULT_NUM_THREADS = 3;
+static const uint32_t MAX_NUM_THREADS = 64;
+static const uint64_t NUM_CODES_MULTI_THREADED_THRESHOLD = 600000;
+
+// Number of codes decoded at a time, cancellation is checked between blocks
+static const uint64_t DECODE_BLOCK_SIZE = 64;
+
+static const uint64_t NO_COPY = UINT64_MAX;
+
+// Block decoders
+// ------------------------------------------------------------------------------------------------
+
+// Decodes numCodes codes into numbersOut, numBytesAvailable is the number of readable bytes
+// starting at codes (the decoders must not read past the end of a caller's buffer).
+typedef void DecodeBlockFunction(const uint8_t* __restrict codes, uint64_t numCodes,
+                                 uint64_t numBytesAvailable, uint32_t* __restrict numbersOut);
+
+template<uint64_t BYTES_PER_CODE>
+static void decodeBlockScalar(const uint8_t* __restrict codes, uint64_t numCodes, uint64_t,
+                              uint32_t* __restrict numbersOut) noexcept
+{
+	for (uint64_t i = 0; i < numCodes; i++) {
+		numbersOut[i] = decodeScalar(codes + i * BYTES_PER_CODE);
+	}
+}
+
+template<uint64_t BYTES_PER_CODE>
+static void decodeBlockPairLookup(const uint8_t* __restrict codes, uint64_t numCodes, uint64_t,
+                                  uint32_t* __restrict numbersOut) noexcept
+{
+	for (uint64_t i = 0; i < numCodes; i++) {
+		numbersOut[i] = decodePairLookup(codes + i * BYTES_PER_CODE);
+	}
+}
+
+template<uint64_t BYTES_PER_CODE>
+static void decodeBlockAvx2(const uint8_t* __restrict codes, uint64_t numCodes,
+                            uint64_t numBytesAvailable, uint32_t* __restrict numbersOut) noexcept
+{
+	// Bytes read by decode8Avx2(), the LF variant reads 2 bytes past the 8th code
+	const uint64_t NUM_BYTES_READ = BYTES_PER_CODE == 8 ? 64 : 58;
+
+	uint64_t i = 0;
+	for (; (i + 8) <= numCodes && (i * BYTES_PER_CODE + NUM_BYTES_READ) <= numBytesAvailable; i += 8) {
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(numbersOut + i),
+		                    decode8Avx2<BYTES_PER_CODE>(codes + i * BYTES_PER_CODE));
+	}
+	for (; i < numCodes; i++) {
+		numbersOut[i] = decodeScalar(codes + i * BYTES_PER_CODE);
+	}
+}
+
+template<uint64_t BYTES_PER_CODE>
+static DecodeBlockFunction* selectDecoder(PlateEngine engine) noexcept
+{
+	switch (engine) {
+	case PLATE_ENGINE_SCALAR: return decodeBlockScalar<BYTES_PER_CODE>;
+	case PLATE_ENGINE_PAIR_LOOKUP: return decodeBlockPairLookup<BYTES_PER_CODE>;
+	case PLATE_ENGINE_AUTO:
+	case PLATE_ENGINE_AVX2: return decodeBlockAvx2<BYTES_PER_CODE>;
+	}
+	return nullptr;
+}
+
+// Text validation
+// ------------------------------------------------------------------------------------------------
+
+// Returns false if any of numCodes codes is not a valid line, using the range compares shared with
+// ValidatingAlgorithm (see PlateDecoders.hpp). The last line of the input may lack its line ending,
+// numBytesAvailable is the number of readable bytes starting at codes.
+typedef bool ValidateBlockFunction(const uint8_t* __restrict codes, uint64_t numCodes,
+                                   uint64_t numBytesAvailable);
+
+template<uint64_t BYTES_PER_CODE>
+static bool validateBlock(const uint8_t* __restrict codes, uint64_t numCodes,
+                          uint64_t numBytesAvailable) noexcept
+{
+	uint64_t i = 0;
+	if (BYTES_PER_CODE == 8) {
+		uint32_t validMask = 0xFF;
+		for (; (i + 8) <= numCodes && (i * BYTES_PER_CODE + 64) <= numBytesAvailable; i += 8) {
+			validMask &= validCodesMask8Avx2(codes + i * BYTES_PER_CODE);
+		}
+		if (validMask != 0xFF) return false;
+	}
+
+	const uint8_t LINE_ENDING[2] = { BYTES_PER_CODE == 8 ? uint8_t('\r') : uint8_t('\n'), uint8_t('\n') };
+	bool valid = true;
+	for (; i < numCodes; i++) {
+		const uint8_t* code = codes + i * BYTES_PER_CODE;
+		for (uint64_t j = 0; j < 6; j++) {
+			valid &= uint8_t(code[j] - CODE_MIN_CHARS[j]) <= CODE_CHAR_RANGES[j];
+		}
+		uint64_t numLineEndingBytes = min(BYTES_PER_CODE, numBytesAvailable - i * BYTES_PER_CODE) - 6;
+		for (uint64_t j = 0; j < numLineEndingBytes; j++) {
+			valid &= code[6 + j] == LINE_ENDING[j];
+		}
+	}
+	return valid;
+}
+
+// Worker pool
+// ------------------------------------------------------------------------------------------------
+
+// Persistent worker threads, a task is run on the calling thread (thread index 0) and on the
+// workers (thread index 1 and up) and run() returns once all of them have finished.
+template<typename Context>
+class WorkerPool final {
+public:
+	typedef void TaskFunction(Context& context, uint32_t threadIndex);
+
+	WorkerPool() noexcept = default;
+	WorkerPool(const WorkerPool&) = delete;
+	WorkerPool& operator= (const WorkerPool&) = delete;
+	~WorkerPool() noexcept { this->stop(); }
+
+	void start(uint32_t numWorkers) noexcept
+	{
+		for (uint32_t i = 0; i < numWorkers; i++) {
+			mThreads.emplace_back(&WorkerPool::workerLoop, this, i + 1);
+		}
+	}
+
+	void stop() noexcept
+	{
+		{
+			lock_guard<mutex> lock(mMutex);
+			mStopping = true;
+		}
+		mStartCondition.notify_all();
+		for (thread& t : mThreads) {
+			t.join();
+		}
+		mThreads.clear();
+	}
+
+	// Runs the task on numThreads threads, at most the number of workers + 1
+	void run(TaskFunction* task, Context& context, uint32_t numThreads) noexcept
+	{
+		numThreads = min(numThreads, uint32_t(mThreads.size()) + 1);
+		if (numThreads > 1) {
+			{
+				lock_guard<mutex> lock(mMutex);
+				mTask = task;
+				mContext = &context;
+				mNumActive = numThreads;
+				mNumRemaining = numThreads - 1;
+				mGeneration += 1;
+			}
+			mStartCondition.notify_all();
+		}
+
+		task(context, 0);
+
+		if (numThreads > 1) {
+			unique_lock<mutex> lock(mMutex);
+			mDoneCondition.wait(lock, [this]() { return mNumRemaining == 0; });
+		}
+	}
+
+private:
+	void workerLoop(uint32_t threadIndex) noexcept
+	{
+		uint64_t lastGeneration = 0;
+		unique_lock<mutex> lock(mMutex);
+		while (true) {
+			mStartCondition.wait(lock, [&]() { return mStopping || mGeneration != lastGeneration; });
+			if (mStopping) return;
+			lastGeneration = mGeneration;
+			if (threadIndex >= mNumActive) continue;
+
+			TaskFunction* task = mTask;
+			Context* context = mContext;
+			lock.unlock();
+			task(*context, threadIndex);
+			lock.lock();
+
+			mNumRemaining -= 1;
+			if (mNumRemaining == 0) mDoneCondition.notify_one();
+		}
+	}
+
+	mutex mMutex;
+	condition_variable mStartCondition, mDoneCondition;
+	vector<thread> mThreads;
+	TaskFunction* mTask = nullptr;
+	Context* mContext = nullptr;
+	uint32_t mNumActive = 0;
+	uint32_t mNumRemaining = 0;
+	uint64_t mGeneration = 0;
+	bool mStopping = false;
+};
+
+// Context
+// ------------------------------------------------------------------------------------------------
+
+enum class InputKind : uint8_t {
+	TEXT,
+	INDICES
+};
+
+struct Input final {
+	InputKind kind = InputKind::TEXT;
+	const PlateBuffer* buffers = nullptr; // TEXT
+	size_t numBuffers = 0;
+	const uint32_t* indices = nullptr; // INDICES
+	uint64_t numCodes = 0;
+	bool hasPartialLine = false; // TEXT, a buffer ends with 1 to 5 bytes that can't be a code
+};
+
+// A queued asynchronous check
+struct AsyncRequest final {
+	Input input;
+	PlateBuffer buffer; // The buffer of single buffer text checks, input.buffers points here
+	bool usesOwnBuffer = false;
+	const CancellationToken* token = nullptr;
+	PlateCheckerCallback* callback = nullptr;
+	void* userData = nullptr;
+};
+
+struct PlateCheckerContext final {
+	PlateCheckerOptions options;
+	uint64_t bytesPerCode = 8;
+	DecodeBlockFunction* decodeBlock = nullptr;
+	ValidateBlockFunction* validateBlock = nullptr;
+	uint32_t numThreads = 0;
+
+	// Owned memory, allocated once on creation
+	vector<uint64_t*> bitsets; // One per thread
+	unique_ptr<atomic_bool[]> rangeCancelled; // One per range (i.e. thread)
+	unique_ptr<uint64_t[]> copyIndices; // First copy found in each range, or NO_COPY
+	unique_ptr<uint64_t[]> threadCounts; // Per thread counts when merging
+	WorkerPool<PlateCheckerContext> pool;
+
+	// Held during a check, sync and async checks on the same context are serialized
+	mutex checkMutex;
+
+	// State of the current check
+	Input input;
+	const CancellationToken* token = nullptr;
+	uint32_t numRanges = 0;
+	uint32_t lastMergedRange = 0; // Ranges [0, lastMergedRange] are merged by merge tasks
+	atomic_bool invalidInput { false }; // An index was out of range or a line was not a valid code
+
+	// Async dispatcher, started on first async check
+	mutex asyncMutex;
+	condition_variable asyncCondition;
+	deque<AsyncRequest> asyncQueue;
+	thread asyncDispatcher;
+	bool asyncStopping = false;
+};
+
+// Number of codes in a text buffer, the last line may lack its line ending
+static uint64_t numCodesInBuffer(const PlateCheckerContext& c, size_t size) noexcept
+{
+	return (uint64_t(size) + c.bytesPerCode - 6) / c.bytesPerCode;
+}
+
+static void splitRange(uint64_t index, uint64_t numParts, uint64_t numItems, uint64_t& firstOut,
+                       uint64_t& lastOut) noexcept
+{
+	uint64_t itemsPerPart = (numItems + numParts - 1) / numParts;
+	firstOut = min(index * itemsPerPart, numItems);
+	lastOut = min(firstOut + itemsPerPart, numItems);
+}
+
+// Calls blockFunction(numbers, numNumbers, firstIndex) for the codes in [first, last) in blocks of
+// at most DECODE_BLOCK_SIZE, in order. Stops and returns true if blockFunction returns true or if
+// an invalid index or line is found.
+//
+// Both kinds of input are in caller memory, so every block is validated before it is used since an
+// invalid index or code would write outside the bitsets.
+template<typename BlockFunction>
+static bool forEachBlock(PlateCheckerContext& c, uint64_t first, uint64_t last,
+                         BlockFunction&& blockFunction) noexcept
+{
+	const Input& input = c.input;
+
+	// Already decoded indices, validated so they can't write outside the bitsets
+	if (input.kind == InputKind::INDICES) {
+		for (uint64_t blockStart = first; blockStart < last; blockStart += DECODE_BLOCK_SIZE) {
+			uint64_t numNumbers = min(DECODE_BLOCK_SIZE, last - blockStart);
+			const uint32_t* numbers = input.indices + blockStart;
+			uint32_t maxNumber = 0;
+			for (uint64_t i = 0; i < numNumbers; i++) {
+				maxNumber = max(maxNumber, numbers[i]);
+			}
+			if (maxNumber >= MAX_NUMBER_CODES) {
+				c.invalidInput = true;
+				return true;
+			}
+			if (blockFunction(numbers, numNumbers, blockStart)) return true;
+		}
+		return false;
+	}
+
+	// Text, decode the part of each buffer that overlaps the range
+	alignas(32) uint32_t numbers[DECODE_BLOCK_SIZE];
+	uint64_t bufferFirst = 0;
+	for (size_t bufferIndex = 0; bufferIndex < input.numBuffers && bufferFirst < last; bufferIndex++) {
+		const PlateBuffer& buffer = input.buffers[bufferIndex];
+		uint64_t bufferLast = bufferFirst + numCodesInBuffer(c, buffer.size);
+		uint64_t rangeFirst = max(first, bufferFirst);
+		uint64_t rangeLast = min(last, bufferLast);
+		for (uint64_t blockStart = rangeFirst; blockStart < rangeLast; blockStart += DECODE_BLOCK_SIZE) {
+			uint64_t numNumbers = min(DECODE_BLOCK_SIZE, rangeLast - blockStart);
+			uint64_t offset = (blockStart - bufferFirst) * c.bytesPerCode;
+			const uint8_t* codes = static_cast<const uint8_t*>(buffer.data) + offset;
+			if (!c.validateBlock(codes, numNumbers, uint64_t(buffer.size) - offset)) {
+				c.invalidInput = true;
+				return true;
+			}
+			c.decodeBlock(codes, numNumbers, uint64_t(buffer.size) - offset, numbers);
+			if (blockFunction(numbers, numNumbers, blockStart)) return true;
+		}
+		bufferFirst = bufferLast;
+	}
+	return false;
+}
+
+// Whether a thread should stop working on its range
+static bool isStopped(const PlateCheckerContext& c, uint32_t threadIndex) noexcept
+{
+	return c.rangeCancelled[threadIndex].load(memory_order_relaxed) ||
+	       (c.token != nullptr && c.token->isCancelled());
+}
+
+static void cancelRangesFrom(PlateCheckerContext& c, uint32_t firstRange) noexcept
+{
+	for (uint32_t i = firstRange; i < c.numRanges; i++) {
+		c.rangeCancelled[i].store(true, memory_order_relaxed);
+	}
+}
+
+// Tasks
+// ------------------------------------------------------------------------------------------------
+
+// Fills the bitset of the thread with its range of codes, stopping at the first copy within the
+// range unless counting. Finding a copy cancels all other ranges when only reporting whether there
+// is a copy, and all later ranges when reporting the first copy.
+static void fillTask(PlateCheckerContext& c, uint32_t threadIndex) noexcept
+{
+	uint64_t* __restrict bitset = c.bitsets[threadIndex];
+	memset(bitset, 0, NUM_BITSET_BYTES);
+	c.copyIndices[threadIndex] = NO_COPY;
+
+	uint64_t first, last;
+	splitRange(threadIndex, c.numRanges, c.input.numCodes, first, last);
+
+	// Count mode, insert everything
+	if (c.options.reportMode == PLATE_REPORT_COUNT) {
+		forEachBlock(c, first, last, [&](const uint32_t* numbers, uint64_t numNumbers, uint64_t) {
+			if (isStopped(c, threadIndex)) return true;
+			for (uint64_t i = 0; i < numNumbers; i++) {
+				uint32_t number = numbers[i];
+				bitset[number >> 6u] |= uint64_t(1) << (number & 0x0000003Fu);
+			}
+			return false;
+		});
+		return;
+	}
+
+	forEachBlock(c, first, last, [&](const uint32_t* numbers, uint64_t numNumbers, uint64_t blockStart) {
+		if (isStopped(c, threadIndex)) return true;
+		for (uint64_t i = 0; i < numNumbers; i++) {
+			uint32_t number = numbers[i];
+			uint32_t bitsetChunkIndex = number >> 6u; // number / 64;
+			uint64_t bitMask = uint64_t(1) << (number & 0x0000003Fu); // number % 64;
+
+			uint64_t chunk = bitset[bitsetChunkIndex];
+			if ((bitMask & chunk) != uint64_t(0)) {
+				c.copyIndices[threadIndex] = blockStart + i;
+				return true;
+			}
+			bitset[bitsetChunkIndex] = bitMask | chunk;
+		}
+		return false;
+	});
+
+	if (c.copyIndices[threadIndex] != NO_COPY || c.invalidInput) {
+		bool firstMode = c.options.reportMode == PLATE_REPORT_FIRST && !c.invalidInput;
+		cancelRangesFrom(c, firstMode ? threadIndex + 1 : 0);
+	}
+}
+
+// Rescans range t up to its own first copy against the bitset of ranges [0, t - 1], see check()
+static void rescanTask(PlateCheckerContext& c, uint32_t threadIndex) noexcept
+{
+	if (threadIndex == 0 || threadIndex > c.lastMergedRange + 1) return;
+	const uint64_t* __restrict earlierCodesBitset = c.bitsets[threadIndex - 1];
+
+	uint64_t first, last;
+	splitRange(threadIndex, c.numRanges, c.input.numCodes, first, last);
+	last = min(last, c.copyIndices[threadIndex]);
+
+	forEachBlock(c, first, last, [&](const uint32_t* numbers, uint64_t numNumbers, uint64_t blockStart) {
+		if (isStopped(c, threadIndex)) return true;
+		for (uint64_t i = 0; i < numNumbers; i++) {
+			uint32_t number = numbers[i];
+			uint64_t bitMask = uint64_t(1) << (number & 0x0000003Fu);
+			if ((earlierCodesBitset[number >> 6u] & bitMask) != uint64_t(0)) {
+				c.copyIndices[threadIndex] = blockStart + i;
+				cancelRangesFrom(c, threadIndex + 1);
+				return true;
+			}
+		}
+		return false;
+	});
+}
+
+// The merge tasks each process a slice of the bitset words of ranges [0, lastMergedRange]
+
+// Counts words with a bit set in more than one bitset
+static void anyCopyMergeTask(PlateCheckerContext& c, uint32_t threadIndex) noexcept
+{
+	uint64_t first, last;
+	splitRange(threadIndex, c.numThreads, NUM_BITSET_WORDS, first, last);
+	uint64_t numCopyWords = 0;
+	for (uint64_t i = first; i < last; i++) {
+		uint64_t once = 0, twice = 0;
+		for (uint32_t r = 0; r <= c.lastMergedRange; r++) {
+			uint64_t b = c.bitsets[r][i];
+			twice |= once & b;
+			once |= b;
+		}
+		numCopyWords += twice != uint64_t(0) ? 1 : 0;
+	}
+	c.threadCounts[threadIndex] = numCopyWords;
+}
+
+// Accumulates the bitsets in order, so bitset t contains all codes in ranges [0, t]
+static void prefixOrMergeTask(PlateCheckerContext& c, uint32_t threadIndex) noexcept
+{
+	uint64_t first, last;
+	splitRange(threadIndex, c.numThreads, NUM_BITSET_WORDS, first, last);
+	for (uint32_t r = 1; r <= c.lastMergedRange; r++) {
+		const uint64_t* __restrict previous = c.bitsets[r - 1];
+		uint64_t* __restrict current = c.bitsets[r];
+		for (uint64_t i = first; i < last; i++) {
+			current[i] |= previous[i];
+		}
+	}
+}
+
+// Counts the number of distinct codes
+static void distinctCountMergeTask(PlateCheckerContext& c, uint32_t threadIndex) noexcept
+{
+	uint64_t first, last;
+	splitRange(threadIndex, c.numThreads, NUM_BITSET_WORDS, first, last);
+	uint64_t numDistinct = 0;
+	for (uint64_t i = first; i < last; i++) {
+		uint64_t word = 0;
+		for (uint32_t r = 0; r <= c.lastMergedRange; r++) {
+			word |= c.bitsets[r][i];
+		}
+		numDistinct += uint64_t(_mm_popcnt_u64(word));
+	}
+	c.threadCounts[threadIndex] = numDistinct;
+}
+
+static uint64_t sumThreadCounts(const PlateCheckerContext& c) noexcept
+{
+	uint64_t sum = 0;
+	for (uint32_t i = 0; i < c.numThreads; i++) {
+		sum += c.threadCounts[i];
+	}
+	return sum;
+}
+
+// Check
+// ------------------------------------------------------------------------------------------------
+
+// The input is split into one contiguous range per thread, each thread fills its own bitset.
+//
+// ANY: A copy within a range is found directly, copies between ranges by merging the bitsets.
+// FIRST: The first copy is the first code that is either a copy within its own range or a copy of
+//        a code in an earlier range. After filling, the bitsets are accumulated in order and each
+//        range t (up to the first range with a copy) is rescanned against bitset t - 1, the first
+//        hit in range order is the answer. See also CancellableAlgorithm.
+// COUNT: The number of copies is the number of codes minus the number of distinct codes, i.e. the
+//        population count of the union of the bitsets.
+//
+// The token is polled between blocks of codes, a cancelled check returns PLATE_CHECKER_CANCELLED.
+static PlateCheckerStatus check(PlateCheckerContext* c, const Input& input, const CancellationToken* token,
+                                PlateCheckerResult* resultOut) noexcept
+{
+	if (c == nullptr || resultOut == nullptr) return PLATE_CHECKER_INVALID_ARGUMENT;
+	lock_guard<mutex> lock(c->checkMutex);
+	resultOut->hasCopy = 0;
+	resultOut->firstCopyIndex = NO_COPY;
+	resultOut->numCopies = 0;
+
+	// A trailing fragment of a line is not counted as a code, so it is rejected up front instead of
+	// being silently ignored
+	if (input.hasPartialLine) return PLATE_CHECKER_INVALID_TEXT;
+
+	// Large input fast path
+	// There are a total of 17 576 000 different codes. If the input contains more codes than that
+	// it must also by definition contain a copy.
+	PlateReportMode mode = c->options.reportMode;
+	if (mode == PLATE_REPORT_ANY && input.numCodes > MAX_NUMBER_CODES) {
+		resultOut->hasCopy = 1;
+		return PLATE_CHECKER_OK;
+	}
+
+	if (token != nullptr && token->isCancelled()) return PLATE_CHECKER_CANCELLED;
+
+	// Small inputs are checked on the calling thread only
+	c->input = input;
+	c->token = token;
+	c->numRanges = input.numCodes <= NUM_CODES_MULTI_THREADED_THRESHOLD ? 1 : c->numThreads;
+	c->invalidInput = false;
+	for (uint32_t i = 0; i < c->numThreads; i++) {
+		c->rangeCancelled[i].store(false, memory_order_relaxed);
+	}
+
+	// Fill bitsets
+	c->pool.run(fillTask, *c, c->numRanges);
+	if (c->invalidInput) {
+		return input.kind == InputKind::INDICES ? PLATE_CHECKER_INVALID_INDEX : PLATE_CHECKER_INVALID_TEXT;
+	}
+	if (token != nullptr && token->isCancelled()) return PLATE_CHECKER_CANCELLED;
+
+	uint32_t firstRangeWithCopy = c->numRanges;
+	for (uint32_t i = 0; i < c->numRanges; i++) {
+		if (c->copyIndices[i] != NO_COPY) {
+			firstRangeWithCopy = i;
+			break;
+		}
+	}
+
+	if (mode == PLATE_REPORT_ANY) {
+		resultOut->hasCopy = firstRangeWithCopy != c->numRanges ? 1 : 0;
+		if (!resultOut->hasCopy && c->numRanges > 1) {
+			c->lastMergedRange = c->numRanges - 1;
+			c->pool.run(anyCopyMergeTask, *c, c->numThreads);
+			resultOut->hasCopy = sumThreadCounts(*c) != 0 ? 1 : 0;
+		}
+	}
+	else if (mode == PLATE_REPORT_FIRST) {
+		// Accumulate bitsets up to the range before the last range to rescan, then rescan
+		uint32_t lastRangeToRescan = min(firstRangeWithCopy, c->numRanges - 1);
+		if (lastRangeToRescan > 0) {
+			c->lastMergedRange = lastRangeToRescan - 1;
+			if (c->lastMergedRange > 0) c->pool.run(prefixOrMergeTask, *c, c->numThreads);
+			c->pool.run(rescanTask, *c, lastRangeToRescan + 1);
+			if (token != nullptr && token->isCancelled()) return PLATE_CHECKER_CANCELLED;
+		}
+		for (uint32_t i = 0; i < c->numRanges; i++) {
+			if (c->copyIndices[i] != NO_COPY) {
+				resultOut->hasCopy = 1;
+				resultOut->firstCopyIndex = c->copyIndices[i];
+				break;
+			}
+		}
+	}
+	else {
+		c->lastMergedRange = c->numRanges - 1;
+		c->pool.run(distinctCountMergeTask, *c, c->numThreads);
+		resultOut->numCopies = input.numCodes - sumThreadCounts(*c);
+		resultOut->hasCopy = resultOut->numCopies != 0 ? 1 : 0;
+	}
+	return PLATE_CHECKER_OK;
+}
+
+// Async dispatcher
+// ------------------------------------------------------------------------------------------------
+
+// Runs queued checks in order on a dedicated thread, each check uses the context's worker pool as
+// usual. When the context is destroyed the remaining requests are completed as cancelled.
+static void asyncDispatcherLoop(PlateCheckerContext* c) noexcept
+{
+	unique_lock<mutex> lock(c->asyncMutex);
+	while (true) {
+		c->asyncCondition.wait(lock, [c]() { return c->asyncStopping || !c->asyncQueue.empty(); });
+		if (c->asyncQueue.empty()) return;
+		AsyncRequest request = c->asyncQueue.front();
+		c->asyncQueue.pop_front();
+		bool stopping = c->asyncStopping;
+		lock.unlock();
+
+		if (request.usesOwnBuffer) request.input.buffers = &request.buffer;
+		PlateCheckerResult result;
+		result.hasCopy = 0;
+		result.firstCopyIndex = NO_COPY;
+		result.numCopies = 0;
+		PlateCheckerStatus status = stopping ? PLATE_CHECKER_CANCELLED :
+		                            check(c, request.input, request.token, &result);
+		request.callback(request.userData, status, &result);
+
+		lock.lock();
+	}
+}
+
+static PlateCheckerStatus queueAsync(PlateCheckerContext* c, const AsyncRequest& request) noexcept
+{
+	if (c == nullptr || request.callback == nullptr) return PLATE_CHECKER_INVALID_ARGUMENT;
+	{
+		lock_guard<mutex> lock(c->asyncMutex);
+		if (c->asyncStopping) return PLATE_CHECKER_CANCELLED;
+		if (!c->asyncDispatcher.joinable()) {
+			c->asyncDispatcher = thread(asyncDispatcherLoop, c);
+		}
+		c->asyncQueue.push_back(request);
+	}
+	c->asyncCondition.notify_one();
+	return PLATE_CHECKER_OK;
+}
+
+static void stopAsyncDispatcher(PlateCheckerContext* c) noexcept
+{
+	{
+		lock_guard<mutex> lock(c->asyncMutex);
+		c->asyncStopping = true;
+	}
+	c->asyncCondition.notify_one();
+	if (c->asyncDispatcher.joinable()) c->asyncDispatcher.join();
+}
+
+// Exposed functions
+// ------------------------------------------------------------------------------------------------
+
+void plateCheckerDefaultOptions(PlateCheckerOptions* optionsOut)
+{
+	optionsOut->engine = PLATE_ENGINE_AUTO;
+	optionsOut->reportMode = PLATE_REPORT_ANY;
+	optionsOut->lineEnding = PLATE_LINE_ENDING_CRLF;
+	optionsOut->numThreads = 0;
+}
+
+PlateCheckerContext* plateCheckerCreate(const PlateCheckerOptions* options)
+{
+	PlateCheckerOptions actualOptions;
+	plateCheckerDefaultOptions(&actualOptions);
+	if (options != nullptr) actualOptions = *options;
+	if (actualOptions.reportMode > PLATE_REPORT_COUNT) return nullptr;
+
+	DecodeBlockFunction* decodeBlock = nullptr;
+	if (actualOptions.lineEnding == PLATE_LINE_ENDING_CRLF) decodeBlock = selectDecoder<8>(actualOptions.engine);
+	else if (actualOptions.lineEnding == PLATE_LINE_ENDING_LF) decodeBlock = selectDecoder<7>(actualOptions.engine);
+	if (decodeBlock == nullptr) return nullptr;
+
+	PlateCheckerContext* c = new (nothrow) PlateCheckerContext();
+	if (c == nullptr) return nullptr;
+	c->options = actualOptions;
+	c->bytesPerCode = actualOptions.lineEnding == PLATE_LINE_ENDING_CRLF ? 8 : 7;
+	c->decodeBlock = decodeBlock;
+	c->validateBlock = c->bytesPerCode == 8 ? validateBlock<8> : validateBlock<7>;
+	c->numThreads = actualOptions.numThreads == 0 ? DEFAULT_NUM_THREADS :
+	                min(actualOptions.numThreads, MAX_NUM_THREADS);
+
+	// Allocate all memory used by checks
+	c->rangeCancelled.reset(new (nothrow) atomic_bool[c->numThreads]);
+	c->copyIndices.reset(new (nothrow) uint64_t[c->numThreads]);
+	c->threadCounts.reset(new (nothrow) uint64_t[c->numThreads]);
+	bool allocated = c->rangeCancelled && c->copyIndices && c->threadCounts;
+	for (uint32_t i = 0; allocated && i < c->numThreads; i++) {
+		uint64_t* bitset = static_cast<uint64_t*>(_aligned_malloc(NUM_BITSET_BYTES, 64));
+		if (bitset != nullptr) c->bitsets.push_back(bitset);
+		else allocated = false;
+	}
+	if (!allocated) {
+		plateCheckerDestroy(c);
+		return nullptr;
+	}
+
+	c->pool.start(c->numThreads - 1);
+	return c;
+}
+
+void plateCheckerDestroy(PlateCheckerContext* context)
+{
+	if (context == nullptr) return;
+	stopAsyncDispatcher(context);
+	context->pool.stop();
+	for (uint64_t* bitset : context->bitsets) {
+		_aligned_free(bitset);
+	}
+	delete context;
+}
+
+PlateCheckerStatus plateCheckerCheckText(PlateCheckerContext* context, const void* data, size_t size,
+                                         PlateCheckerResult* resultOut)
+{
+	PlateBuffer buffer;
+	buffer.data = data;
+	buffer.size = size;
+	return plateCheckerCheckTextBuffers(context, &buffer, 1, resultOut);
+}
+
+static PlateCheckerStatus textInput(const PlateCheckerContext* context, const PlateBuffer* buffers,
+                                    size_t numBuffers, Input& inputOut) noexcept
+{
+	if (context == nullptr || (buffers == nullptr && numBuffers != 0)) return PLATE_CHECKER_INVALID_ARGUMENT;
+	inputOut.kind = InputKind::TEXT;
+	inputOut.buffers = buffers;
+	inputOut.numBuffers = numBuffers;
+	inputOut.numCodes = 0;
+	inputOut.hasPartialLine = false;
+	for (size_t i = 0; i < numBuffers; i++) {
+		if (buffers[i].data == nullptr && buffers[i].size != 0) return PLATE_CHECKER_INVALID_ARGUMENT;
+		uint64_t numCodes = numCodesInBuffer(*context, buffers[i].size);
+		inputOut.numCodes += numCodes;
+		inputOut.hasPartialLine |= uint64_t(buffers[i].size) > numCodes * context->bytesPerCode;
+	}
+	return PLATE_CHECKER_OK;
+}
+
+static PlateCheckerStatus indicesInput(const uint32_t* indices, size_t numIndices, Input& inputOut) noexcept
+{
+	if (indices == nullptr && numIndices != 0) return PLATE_CHECKER_INVALID_ARGUMENT;
+	inputOut.kind = InputKind::INDICES;
+	inputOut.indices = indices;
+	inputOut.numCodes = numIndices;
+	return PLATE_CHECKER_OK;
+}
+
+PlateCheckerStatus plateCheckerCheckTextBuffers(PlateCheckerContext* context, const PlateBuffer* buffers,
+                                                size_t numBuffers, PlateCheckerResult* resultOut)
+{
+	Input input;
+	PlateCheckerStatus status = textInput(context, buffers, numBuffers, input);
+	if (status != PLATE_CHECKER_OK) return status;
+	return check(context, input, nullptr, resultOut);
+}
+
+PlateCheckerStatus plateCheckerCheckIndices(PlateCheckerContext* context, const uint32_t* indices,
+                                            size_t numIndices, PlateCheckerResult* resultOut)
+{
+	Input input;
+	PlateCheckerStatus status = indicesInput(indices, numIndices, input);
+	if (status != PLATE_CHECKER_OK) return status;
+	return check(context, input, nullptr, resultOut);
+}
+
+PlateCheckerStatus plateCheckerCheckTextAsync(PlateCheckerContext* context, const void* data, size_t size,
+                                              PlateCancellationToken* token, PlateCheckerCallback* callback,
+                                              void* userData)
+{
+	AsyncRequest request;
+	request.buffer.data = data;
+	request.buffer.size = size;
+	request.usesOwnBuffer = true;
+	PlateCheckerStatus status = textInput(context, &request.buffer, 1, request.input);
+	if (status != PLATE_CHECKER_OK) return status;
+	request.token = reinterpret_cast<const CancellationToken*>(token);
+	request.callback = callback;
+	request.userData = userData;
+	return queueAsync(context, request);
+}
+
+PlateCheckerStatus plateCheckerCheckTextBuffersAsync(PlateCheckerContext* context, const PlateBuffer* buffers,
+                                                     size_t numBuffers, PlateCancellationToken* token,
+                                                     PlateCheckerCallback* callback, void* userData)
+{
+	AsyncRequest request;
+	PlateCheckerStatus status = textInput(context, buffers, numBuffers, request.input);
+	if (status != PLATE_CHECKER_OK) return status;
+	request.token = reinterpret_cast<const CancellationToken*>(token);
+	request.callback = callback;
+	request.userData = userData;
+	return queueAsync(context, request);
+}
+
+PlateCheckerStatus plateCheckerCheckIndicesAsync(PlateCheckerContext* context, const uint32_t* indices,
+                                                 size_t numIndices, PlateCancellationToken* token,
+                                                 PlateCheckerCallback* callback, void* userData)
+{
+	AsyncRequest request;
+	PlateCheckerStatus status = indicesInput(indices, numIndices, request.input);
+	if (status != PLATE_CHECKER_OK) return status;
+	request.token = reinterpret_cast<const CancellationToken*>(token);
+	request.callback = callback;
+	request.userData = userData;
+	return queueAsync(context, request);
+}
+
+PlateCancellationToken* plateCheckerCreateCancellationToken(void)
+{
+	return reinterpret_cast<PlateCancellationToken*>(new (nothrow) CancellationToken());
+}
+
+void plateCheckerDestroyCancellationToken(PlateCancellationToken* token)
+{
+	delete reinterpret_cast<CancellationToken*>(token);
+}
+
+void plateCheckerCancel(PlateCancellationToken* token)
+{
+	if (token != nullptr) reinterpret_cast<CancellationToken*>(token)->cancel();
+}
@@ -0,0 +1,128 @@
+/* Copyright(c) Peter Hillerstrm(skipifzero.com, peter@hstroem.se) */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* PlateChecker
+ * ------------------------------------------------------------------------------------------------
+ *
+ * Embeddable duplicate checker for codes in caller owned memory, no file I/O is performed. All
+ * memory (the bitsets) and the worker threads are owned by a context which is created once and
+ * reused for every check, so a check performs no allocations. Checks on the same context are
+ * serialized, use one context per calling thread for concurrent checks.
+ *
+ * Three input forms are accepted:
+ * - Text: codes as the lines of a text file ("ABC123\r\n" or "ABC123\n"), in one buffer.
+ * - Text buffers: an array of PlateBuffer (like iovec), each containing whole lines. The codes are
+ *   checked as if the buffers were concatenated, and indices in the result are over all buffers.
+ * - Indices: already decoded indices in [0, 17576000), e.g. the payload of a PLAIN_32 binary plate
+ *   file (see BinaryPlateFormat.hpp).
+ *
+ * The last line of text may lack its line ending, but a buffer ending with a partial code (1 to 5
+ * bytes) is reported as PLATE_CHECKER_INVALID_TEXT. All input is validated in blocks before use,
+ * since an out of range index or malformed code would write outside the bitsets. Input after the
+ * first copy is not necessarily validated.
+ *
+ * Each check is also available as an asynchronous variant which queues the check and returns
+ * immediately. Queued checks are run in order by a dispatcher thread owned by the context (started
+ * on the first async check) using the context's worker threads, and the callback is invoked on the
+ * dispatcher thread when the check completes. The input must stay valid until the callback. The
+ * callback should return quickly since it delays the next check, and must not destroy the
+ * context. Destroying the context completes all queued checks as cancelled. */
+
+typedef struct PlateCheckerContext PlateCheckerContext;
+
+/* A CancellationToken (see CancellationToken.hpp), may be cast from CancellationToken* in C++ */
+typedef struct PlateCancellationToken PlateCancellationToken;
+
+typedef enum PlateEngine {
+	PLATE_ENGINE_AUTO = 0, /* Currently AVX2 */
+	PLATE_ENGINE_SCALAR, /* decodeScalar() in PlateDecoders.hpp */
+	PLATE_ENGINE_PAIR_LOOKUP, /* decodePairLookup() */
+	PLATE_ENGINE_AVX2 /* decode8Avx2() */
+} PlateEngine;
+
+typedef enum PlateReportMode {
+	PLATE_REPORT_ANY = 0, /* Only whether there is a copy, stops as soon as any thread finds one */
+	PLATE_REPORT_FIRST, /* Also the index of the first code that is a copy of an earlier code */
+	PLATE_REPORT_COUNT /* Also the number of codes that are copies of an earlier code */
+} PlateReportMode;
+
+typedef enum PlateLineEnding {
+	PLATE_LINE_ENDING_CRLF = 0, /* 8 bytes per code */
+	PLATE_LINE_ENDING_LF /* 7 bytes per code */
+} PlateLineEnding;
+
+typedef struct PlateCheckerOptions {
+	PlateEngine engine;
+	PlateReportMode reportMode;
+	PlateLineEnding lineEnding;
+	uint32_t numThreads; /* Including the calling thread, 0 for default (3) */
+} PlateCheckerOptions;
+
+typedef struct PlateBuffer {
+	const void* data;
+	size_t size; /* In bytes */
+} PlateBuffer;
+
+typedef struct PlateCheckerResult {
+	int hasCopy;
+	uint64_t firstCopyIndex; /* PLATE_REPORT_FIRST, index of first copy or UINT64_MAX */
+	uint64_t numCopies; /* PLATE_REPORT_COUNT */
+} PlateCheckerResult;
+
+typedef enum PlateCheckerStatus {
+	PLATE_CHECKER_OK = 0,
+	PLATE_CHECKER_INVALID_ARGUMENT,
+	PLATE_CHECKER_INVALID_INDEX, /* An index was outside [0, 17576000) */
+	PLATE_CHECKER_CANCELLED, /* The cancellation token was cancelled or the context was destroyed */
+	PLATE_CHECKER_INVALID_TEXT /* A line of text was not a code on the form "ABC123" + line ending */
+} PlateCheckerStatus;
+
+/* Invoked when an async check completes, result is only valid during the call */
+typedef void PlateCheckerCallback(void* userData, PlateCheckerStatus status, const PlateCheckerResult* result);
+
+void plateCheckerDefaultOptions(PlateCheckerOptions* optionsOut);
+
+/* Returns NULL on failure, options may be NULL for default options */
+PlateCheckerContext* plateCheckerCreate(const PlateCheckerOptions* options);
+void plateCheckerDestroy(PlateCheckerContext* context);
+
+PlateCheckerStatus plateCheckerCheckText(PlateCheckerContext* context, const void* data, size_t size,
+                                         PlateCheckerResult* resultOut);
+
+PlateCheckerStatus plateCheckerCheckTextBuffers(PlateCheckerContext* context, const PlateBuffer* buffers,
+                                                size_t numBuffers, PlateCheckerResult* resultOut);
+
+PlateCheckerStatus plateCheckerCheckIndices(PlateCheckerContext* context, const uint32_t* indices,
+                                            size_t numIndices, PlateCheckerResult* resultOut);
+
+/* Async variants, return PLATE_CHECKER_OK if the check was queued in which case the callback is
+ * always invoked exactly once. The token may be NULL. */
+
+PlateCheckerStatus plateCheckerCheckTextAsync(PlateCheckerContext* context, const void* data, size_t size,
+                                              PlateCancellationToken* token, PlateCheckerCallback* callback,
+                                              void* userData);
+
+PlateCheckerStatus plateCheckerCheckTextBuffersAsync(PlateCheckerContext* context, const PlateBuffer* buffers,
+                                                     size_t numBuffers, PlateCancellationToken* token,
+                                                     PlateCheckerCallback* callback, void* userData);
+
+PlateCheckerStatus plateCheckerCheckIndicesAsync(PlateCheckerContext* context, const uint32_t* indices,
+                                                 size_t numIndices, PlateCancellationToken* token,
+                                                 PlateCheckerCallback* callback, void* userData);
+
+/* Cancellation tokens for C, cancelling a token stops all checks using it */
+PlateCancellationToken* plateCheckerCreateCancellationToken(void);
+void plateCheckerDestroyCancellationToken(PlateCancellationToken* token);
+void plateCheckerCancel(PlateCancellationToken* token);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
@@ -0,0 +1,224 @@
+// Copyright(c) Peter Hillerstrm(skipifzero.com, peter@hstroem.se)
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <vector>
+
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+#include <coroutine>
+#define PLATE_CHECKER_COROUTINES 1
+#endif
+
+#include "CancellationToken.hpp"
+#include "PlateChecker.h"
+
+// Async helpers
+// ------------------------------------------------------------------------------------------------
+
+struct PlateCheckOutcome final {
+	PlateCheckerStatus status = PLATE_CHECKER_OK;
+	PlateCheckerResult result = {};
+};
+
+typedef std::function<void(const PlateCheckOutcome& outcome)> PlateCheckCallback;
+
+inline PlateCancellationToken* plateCancellationToken(const CancellationToken* token) noexcept
+{
+	return reinterpret_cast<PlateCancellationToken*>(const_cast<CancellationToken*>(token));
+}
+
+#ifdef PLATE_CHECKER_COROUTINES
+// Awaitable async text check for C++20 coroutines, "PlateCheckOutcome outcome = co_await
+// checker.checkTextAwaitable(data, size);". The coroutine is resumed on the dispatcher thread of
+// the context.
+class PlateCheckAwaitable final {
+public:
+	PlateCheckAwaitable(PlateCheckerContext* context, const void* data, size_t size,
+	                    const CancellationToken* token) noexcept
+	:
+		mContext(context), mData(data), mSize(size), mToken(token)
+	{ }
+
+	bool await_ready() const noexcept { return false; }
+
+	bool await_suspend(std::coroutine_handle<> handle) noexcept
+	{
+		// The coroutine may be resumed on the dispatcher thread before this returns, so no members
+		// may be touched after a successful queue
+		mHandle = handle;
+		PlateCheckerStatus status = plateCheckerCheckTextAsync(mContext, mData, mSize,
+			plateCancellationToken(mToken), &PlateCheckAwaitable::complete, this);
+		if (status == PLATE_CHECKER_OK) return true;
+		mOutcome.status = status;
+		return false;
+	}
+
+	PlateCheckOutcome await_resume() const noexcept { return mOutcome; }
+
+private:
+	static void complete(void* userData, PlateCheckerStatus status, const PlateCheckerResult* result) noexcept
+	{
+		PlateCheckAwaitable* awaitable = static_cast<PlateCheckAwaitable*>(userData);
+		awaitable->mOutcome.status = status;
+		awaitable->mOutcome.result = *result;
+		awaitable->mHandle.resume();
+	}
+
+	PlateCheckerContext* mContext;
+	const void* mData;
+	size_t mSize;
+	const CancellationToken* mToken;
+	std::coroutine_handle<> mHandle;
+	PlateCheckOutcome mOutcome;
+};
+#endif
+
+// PlateChecker
+// ------------------------------------------------------------------------------------------------
+
+// C++ owner of a PlateCheckerContext, see PlateChecker.h for the semantics of the checks
+class PlateChecker final {
+public:
+	PlateChecker() noexcept : mContext(plateCheckerCreate(nullptr)) { }
+	explicit PlateChecker(const PlateCheckerOptions& options) noexcept : mContext(plateCheckerCreate(&options)) { }
+	PlateChecker(const PlateChecker&) = delete;
+	PlateChecker& operator= (const PlateChecker&) = delete;
+	~PlateChecker() noexcept { plateCheckerDestroy(mContext); }
+
+	// Whether the context was successfully created
+	bool isValid() const noexcept { return mContext != nullptr; }
+
+	PlateCheckerStatus checkText(const void* data, size_t size, PlateCheckerResult& resultOut) noexcept
+	{
+		return plateCheckerCheckText(mContext, data, size, &resultOut);
+	}
+
+	PlateCheckerStatus checkTextBuffers(const PlateBuffer* buffers, size_t numBuffers,
+	                                    PlateCheckerResult& resultOut) noexcept
+	{
+		return plateCheckerCheckTextBuffers(mContext, buffers, numBuffers, &resultOut);
+	}
+
+	PlateCheckerStatus checkTextBuffers(const std::vector<PlateBuffer>& buffers,
+	                                    PlateCheckerResult& resultOut) noexcept
+	{
+		return plateCheckerCheckTextBuffers(mContext, buffers.data(), buffers.size(), &resultOut);
+	}
+
+	PlateCheckerStatus checkIndices(const uint32_t* indices, size_t numIndices,
+	                                PlateCheckerResult& resultOut) noexcept
+	{
+		return plateCheckerCheckIndices(mContext, indices, numIndices, &resultOut);
+	}
+
+	PlateCheckerStatus checkIndices(const std::vector<uint32_t>& indices, PlateCheckerResult& resultOut) noexcept
+	{
+		return plateCheckerCheckIndices(mContext, indices.data(), indices.size(), &resultOut);
+	}
+
+	// Async checks returning a future, the future holds the status if the check could not be queued
+	std::future<PlateCheckOutcome> checkTextAsync(const void* data, size_t size,
+	                                              const CancellationToken* token = nullptr)
+	{
+		return futureCheck([&](PlateCheckerCallback* callback, void* userData) {
+			return plateCheckerCheckTextAsync(mContext, data, size, plateCancellationToken(token), callback, userData);
+		});
+	}
+
+	std::future<PlateCheckOutcome> checkIndicesAsync(const uint32_t* indices, size_t numIndices,
+	                                                 const CancellationToken* token = nullptr)
+	{
+		return futureCheck([&](PlateCheckerCallback* callback, void* userData) {
+			return plateCheckerCheckIndicesAsync(mContext, indices, numIndices, plateCancellationToken(token),
+			                                     callback, userData);
+		});
+	}
+
+	// Async checks with completion callbacks, run on the dispatcher thread if the check is queued
+	PlateCheckerStatus checkTextAsync(const void* data, size_t size, PlateCheckCallback callback,
+	                                  const CancellationToken* token = nullptr)
+	{
+		return callbackCheck(std::move(callback), [&](PlateCheckerCallback* cCallback, void* userData) {
+			return plateCheckerCheckTextAsync(mContext, data, size, plateCancellationToken(token), cCallback, userData);
+		});
+	}
+
+	PlateCheckerStatus checkIndicesAsync(const uint32_t* indices, size_t numIndices, PlateCheckCallback callback,
+	                                     const CancellationToken* token = nullptr)
+	{
+		return callbackCheck(std::move(callback), [&](PlateCheckerCallback* cCallback, void* userData) {
+			return plateCheckerCheckIndicesAsync(mContext, indices, numIndices, plateCancellationToken(token),
+			                                     cCallback, userData);
+		});
+	}
+
+#ifdef PLATE_CHECKER_COROUTINES
+	PlateCheckAwaitable checkTextAwaitable(const void* data, size_t size,
+	                                       const CancellationToken* token = nullptr) noexcept
+	{
+		return PlateCheckAwaitable(mContext, data, size, token);
+	}
+#endif
+
+	// Convenience, whether the text contains a copy. False if the check failed.
+	bool hasCopy(const void* data, size_t size) noexcept
+	{
+		PlateCheckerResult result;
+		return this->checkText(data, size, result) == PLATE_CHECKER_OK && result.hasCopy != 0;
+	}
+
+	PlateCheckerContext* context() const noexcept { return mContext; }
+
+private:
+	template<typename QueueFunction>
+	static std::future<PlateCheckOutcome> futureCheck(QueueFunction&& queue)
+	{
+		typedef std::promise<PlateCheckOutcome> Promise;
+		std::unique_ptr<Promise> promise(new Promise());
+		std::future<PlateCheckOutcome> future = promise->get_future();
+		PlateCheckerStatus status = queue(&PlateChecker::completePromise, promise.get());
+		if (status == PLATE_CHECKER_OK) {
+			promise.release(); // Owned by completePromise()
+		}
+		else {
+			PlateCheckOutcome outcome;
+			outcome.status = status;
+			promise->set_value(outcome);
+		}
+		return future;
+	}
+
+	static void completePromise(void* userData, PlateCheckerStatus status, const PlateCheckerResult* result)
+	{
+		std::unique_ptr<std::promise<PlateCheckOutcome>> promise(
+			static_cast<std::promise<PlateCheckOutcome>*>(userData));
+		PlateCheckOutcome outcome;
+		outcome.status = status;
+		outcome.result = *result;
+		promise->set_value(outcome);
+	}
+
+	template<typename QueueFunction>
+	static PlateCheckerStatus callbackCheck(PlateCheckCallback&& callback, QueueFunction&& queue)
+	{
+		std::unique_ptr<PlateCheckCallback> ownedCallback(new PlateCheckCallback(std::move(callback)));
+		PlateCheckerStatus status = queue(&PlateChecker::completeCallback, ownedCallback.get());
+		if (status == PLATE_CHECKER_OK) ownedCallback.release(); // Owned by completeCallback()
+		return status;
+	}
+
+	static void completeCallback(void* userData, PlateCheckerStatus status, const PlateCheckerResult* result)
+	{
+		std::unique_ptr<PlateCheckCallback> callback(static_cast<PlateCheckCallback*>(userData));
+		PlateCheckOutcome outcome;
+		outcome.status = status;
+		outcome.result = *result;
+		(*callback)(outcome);
+	}
+
+	PlateCheckerContext* mContext;
+};
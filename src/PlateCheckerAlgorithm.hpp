@@ -0,0 +1,8 @@
+// Copyright(c) Peter Hillerstrm(skipifzero.com, peter@hstroem.se)
+
+#pragma once
+
+// Maps the file and checks it with the PlateChecker library (see PlateChecker.h). The checker
+// context is created on first call and reused, so after the first call no bitsets are allocated
+// and no threads are started.
+bool plateCheckerAlgorithm(const char* filePath) noexcept;
@@ -0,0 +1,32 @@
+// Copyright(c) Peter Hillerstrm(skipifzero.com, peter@hstroem.se)
+
+#include <cstdio>
+#include <cstring>
+
+#include "BinaryPlateFormat.hpp"
+
+// Main
+// ------------------------------------------------------------------------------------------------
+
+int main(int argc, char* argv[])
+{
+	// Retrieve file paths from input parameters
+	bool validArgs = argc == 3 || (argc == 4 && strcmp(argv[3], "--packed") == 0);
+	if (!validArgs) {
+		printf("Invalid arguments, proper usage: \"PlateConverter <text file> <binary file> [--packed]\"\n");
+		return 1;
+	}
+	const char* textPath = argv[1];
+	const char* binaryPath = argv[2];
+	PlateFileEncoding encoding = argc == 4 ? PlateFileEncoding::PACKED_25 : PlateFileEncoding::PLAIN_32;
+
+	// Convert file
+	if (!convertTextToBinary(textPath, binaryPath, encoding)) {
+		printf("Conversion failed\n");
+		return 1;
+	}
+
+	// Flush output and exit program
+	fflush(stdout);
+	return 0;
+}
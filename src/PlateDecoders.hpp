@@ -0,0 +1,219 @@
+// Copyright(c) Peter Hillerstrm(skipifzero.com, peter@hstroem.se)
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+#include <immintrin.h>
+
+// Decoders converting a code ("AAA000") into its index, templated on the number of bytes per
+// code. 8 for Windows file endings (CR+LF) and 7 for Unix file endings (LF).
+
+// Scalar decoder
+// ------------------------------------------------------------------------------------------------
+
+// The decoder used by all the original algorithms, 6 subtractions and 5 multiplications
+inline uint32_t decodeScalar(const uint8_t* __restrict code) noexcept
+{
+	return uint32_t(code[0] - 'A') * 676000u +
+	       uint32_t(code[1] - 'A') * 26000u +
+	       uint32_t(code[2] - 'A') * 1000u +
+	       uint32_t(code[3] - '0') * 100u +
+	       uint32_t(code[4] - '0') * 10u +
+	       uint32_t(code[5] - '0');
+}
+
+// Inverse of decodeScalar(), writes the 6 characters of the code with the specified index
+inline void encodeScalar(uint32_t number, uint8_t* __restrict codeOut) noexcept
+{
+	codeOut[0] = uint8_t('A' + number / 676000u);
+	codeOut[1] = uint8_t('A' + (number / 26000u) % 26u);
+	codeOut[2] = uint8_t('A' + (number / 1000u) % 26u);
+	codeOut[3] = uint8_t('0' + (number / 100u) % 10u);
+	codeOut[4] = uint8_t('0' + (number / 10u) % 10u);
+	codeOut[5] = uint8_t('0' + number % 10u);
+}
+
+// Number of codes in numBytes of text. A last line without a line ending still counts if all its
+// characters (6 unless specified) are there, as in the single threaded original algorithms. With 8
+// bytes per code such a file ends 6 or 7 bytes into the last code's slot, never on a page boundary,
+// so decoders reading the whole slot of a mapped file stay inside the mapping.
+inline uint64_t numCodesInText(uint64_t numBytes, uint64_t bytesPerCode,
+                               uint64_t numChars = 6) noexcept
+{
+	return (numBytes + bytesPerCode - numChars) / bytesPerCode;
+}
+
+// Validation
+// ------------------------------------------------------------------------------------------------
+
+// Range compares for codes with CR+LF line endings from untrusted sources, see
+// ValidatingAlgorithm. A byte minus its lowest allowed value wraps around if it is below it, so one
+// unsigned compare against the allowed range catches bytes both below and above the range.
+
+// Lowest allowed value of each byte of a code: [L3, L2, L1, N3, N2, N1, '\r', '\n']
+static const uint8_t CODE_MIN_CHARS[8] = { 'A', 'A', 'A', '0', '0', '0', '\r', '\n' };
+
+// Highest allowed value minus lowest allowed value of each byte of a code
+static const uint8_t CODE_CHAR_RANGES[8] = { 25, 25, 25, 9, 9, 9, 0, 0 };
+
+inline bool isValidCode(const uint8_t* __restrict code) noexcept
+{
+	bool valid = true;
+	for (uint64_t i = 0; i < 8; i++) {
+		valid &= uint8_t(code[i] - CODE_MIN_CHARS[i]) <= CODE_CHAR_RANGES[i];
+	}
+	return valid;
+}
+
+// Validates 8 codes (64 bytes) using AVX2, returns a mask with bit i set if code i is valid
+inline uint32_t validCodesMask8Avx2(const uint8_t* __restrict codes) noexcept
+{
+	const __m256i SUBTRACT_CHARS = _mm256_set1_epi64x(0x0A0D303030414141);
+	const __m256i CHAR_RANGES = _mm256_set1_epi64x(0x0000090909191919);
+	const __m256i raw0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(codes));
+	const __m256i raw1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(codes + 32));
+
+	// Non-zero bytes are invalid, a code is valid if its whole 64 bit lane is zero
+	const __m256i errors0 = _mm256_subs_epu8(_mm256_sub_epi8(raw0, SUBTRACT_CHARS), CHAR_RANGES);
+	const __m256i errors1 = _mm256_subs_epu8(_mm256_sub_epi8(raw1, SUBTRACT_CHARS), CHAR_RANGES);
+	const __m256i valid0 = _mm256_cmpeq_epi64(errors0, _mm256_setzero_si256());
+	const __m256i valid1 = _mm256_cmpeq_epi64(errors1, _mm256_setzero_si256());
+	return uint32_t(_mm256_movemask_pd(_mm256_castsi256_pd(valid0))) |
+	       (uint32_t(_mm256_movemask_pd(_mm256_castsi256_pd(valid1))) << 4u);
+}
+
+// Pair lookup decoder
+// ------------------------------------------------------------------------------------------------
+
+// A code is split into three pairs of characters, (L3, L2), (L1, N3) and (N2, N1). Each pair maps
+// to its pre-scaled contribution to the index through a table, so decoding a code is three loads
+// and two adds.
+//
+// The low 5 bits of a character are unique within both 'A'-'Z' (1-26) and '0'-'9' (16-25), so a
+// 16 bit pair is keyed on the low 5 bits of both its characters. This gives 1024 entry tables,
+// 12 KiB in total, which stay resident in L1.
+
+static const uint32_t PAIR_TABLE_SIZE = 1024;
+
+struct alignas(64) PairTable final {
+	uint32_t values[PAIR_TABLE_SIZE];
+};
+
+// Key of a pair of characters, first character in the low byte
+constexpr uint32_t pairKey(uint32_t pair) noexcept
+{
+	return (pair & 0x1Fu) | ((pair >> 3u) & 0x3E0u);
+}
+
+constexpr PairTable createPairTable(uint8_t firstBase, uint32_t firstRadix, uint32_t firstMultiplier,
+                                    uint8_t secondBase, uint32_t secondRadix,
+                                    uint32_t secondMultiplier) noexcept
+{
+	PairTable table = {};
+	for (uint32_t first = 0; first < firstRadix; first++) {
+		for (uint32_t second = 0; second < secondRadix; second++) {
+			uint32_t pair = uint32_t(firstBase + first) | (uint32_t(secondBase + second) << 8u);
+			table.values[pairKey(pair)] = first * firstMultiplier + second * secondMultiplier;
+		}
+	}
+	return table;
+}
+
+static constexpr PairTable LETTER_LETTER_TABLE = createPairTable('A', 26, 676000, 'A', 26, 26000);
+static constexpr PairTable LETTER_DIGIT_TABLE = createPairTable('A', 26, 1000, '0', 10, 100);
+static constexpr PairTable DIGIT_DIGIT_TABLE = createPairTable('0', 10, 10, '0', 10, 1);
+
+inline uint32_t decodePairLookup(const uint8_t* __restrict code) noexcept
+{
+	// Load the 6 characters of the code as a 4 and a 2 byte load. Loading all 6 into one integer
+	// via memcpy() goes through the stack and stalls on store forwarding.
+	uint32_t letters = 0;
+	uint16_t digits = 0;
+	memcpy(&letters, code, 4);
+	memcpy(&digits, code + 4, 2);
+
+	return LETTER_LETTER_TABLE.values[pairKey(letters)] +
+	       LETTER_DIGIT_TABLE.values[pairKey(letters >> 16u)] +
+	       DIGIT_DIGIT_TABLE.values[pairKey(digits)];
+}
+
+// SSE decoder
+// ------------------------------------------------------------------------------------------------
+
+// The decoder from optimizedSmartAlgorithm6(), one code at a time using SSE
+inline uint32_t decodeSse(const uint8_t* __restrict code) noexcept
+{
+	// high [0, 0, 0, 0, 'Z', 'Z', '9', '9'] low, u16
+	const __m128i raw = _mm_setr_epi16(code[4], code[3], code[2], code[1], 0, 0, 0, 0);
+
+	// high [0, 0, 0, 0, 25, 25, 9, 9] low, u16
+	const __m128i SUBTRACT_CHARS = _mm_setr_epi16('0', '0', 'A', 'A', 0, 0, 0, 0);
+	const __m128i tmp1 = _mm_sub_epi16(raw, SUBTRACT_CHARS);
+
+	// high [0, 0, Z*26000 + Z*1000, 9*100 + 9*10] low, u32
+	const __m128i MULT_FACTORS = _mm_setr_epi16(10, 100, 1000, 26000, 0, 0, 0, 0);
+	const __m128i tmp2 = _mm_madd_epi16(tmp1, MULT_FACTORS);
+
+	// high [0, 0, 0, Z*26000 + Z*1000, 9*100 + 9*10] low, u32
+	const __m128i tmp3 = _mm_add_epi32(tmp2, _mm_srli_si128(tmp2, 4));
+	uint32_t tmp3Val = uint32_t(_mm_cvtsi128_si32(tmp3));
+
+	// Calculate final number
+	return uint32_t(code[0] - 'A') * 676000u + tmp3Val + uint32_t(code[5] - '0');
+}
+
+// AVX2 decoder
+// ------------------------------------------------------------------------------------------------
+
+// Decodes 8 codes into 8 indices using AVX2. With LF line endings the codes are first shuffled
+// into 8 byte lanes, note that this reads 2 bytes past the end of the 8th code.
+template<uint64_t BYTES_PER_CODE>
+inline __m256i decode8Avx2(const uint8_t* __restrict codes) noexcept
+{
+	static_assert(BYTES_PER_CODE == 7 || BYTES_PER_CODE == 8, "Only CR+LF or LF supported");
+
+	__m256i raw0, raw1;
+	if (BYTES_PER_CODE == 8) {
+		raw0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(codes));
+		raw1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(codes + 32));
+	}
+	else {
+		// Each 16 byte load contains 2 codes at offsets 0 and 7, move them to offsets 0 and 8
+		const __m256i SPREAD = _mm256_setr_epi8(0, 1, 2, 3, 4, 5, -1, -1, 7, 8, 9, 10, 11, 12, -1, -1,
+		                                        0, 1, 2, 3, 4, 5, -1, -1, 7, 8, 9, 10, 11, 12, -1, -1);
+		const __m256i load0 = _mm256_inserti128_si256(_mm256_castsi128_si256(
+			_mm_loadu_si128(reinterpret_cast<const __m128i*>(codes))),
+			_mm_loadu_si128(reinterpret_cast<const __m128i*>(codes + 14)), 1);
+		const __m256i load1 = _mm256_inserti128_si256(_mm256_castsi128_si256(
+			_mm_loadu_si128(reinterpret_cast<const __m128i*>(codes + 28))),
+			_mm_loadu_si128(reinterpret_cast<const __m128i*>(codes + 42)), 1);
+		raw0 = _mm256_shuffle_epi8(load0, SPREAD);
+		raw1 = _mm256_shuffle_epi8(load1, SPREAD);
+	}
+
+	// Bytes per code: [L3, L2, L1, N3, N2, N1, x, x] -> [0-25, 0-25, 0-25, 0-9, 0-9, 0-9, x, x]
+	const __m256i SUBTRACT_CHARS = _mm256_set1_epi64x(0x0000303030414141);
+	const __m256i digits0 = _mm256_sub_epi8(raw0, SUBTRACT_CHARS);
+	const __m256i digits1 = _mm256_sub_epi8(raw1, SUBTRACT_CHARS);
+
+	// u16 pairs per code: [L3 * 26 + L2, L1 * 10 + N3, N2 * 10 + N1, 0]
+	const __m256i PAIR_FACTORS = _mm256_set1_epi64x(0x0000010A010A011A);
+	const __m256i pairs0 = _mm256_maddubs_epi16(digits0, PAIR_FACTORS);
+	const __m256i pairs1 = _mm256_maddubs_epi16(digits1, PAIR_FACTORS);
+
+	// u32 pairs per code: [(L3 * 26 + L2) * 26000 + (L1 * 10 + N3) * 100, N2 * 10 + N1]
+	const __m256i QUAD_FACTORS = _mm256_set1_epi64x(0x0000000100646590);
+	const __m256i quads0 = _mm256_madd_epi16(pairs0, QUAD_FACTORS);
+	const __m256i quads1 = _mm256_madd_epi16(pairs1, QUAD_FACTORS);
+
+	// Final number in low u32 of each u64
+	const __m256i numbers0 = _mm256_add_epi32(quads0, _mm256_srli_epi64(quads0, 32));
+	const __m256i numbers1 = _mm256_add_epi32(quads1, _mm256_srli_epi64(quads1, 32));
+
+	// Pack into [0, 1, 4, 5, 2, 3, 6, 7] and then permute into order
+	const __m256i packed = _mm256_castps_si256(_mm256_shuffle_ps(_mm256_castsi256_ps(numbers0),
+	                                           _mm256_castsi256_ps(numbers1), _MM_SHUFFLE(2, 0, 2, 0)));
+	return _mm256_permute4x64_epi64(packed, _MM_SHUFFLE(3, 1, 2, 0));
+}
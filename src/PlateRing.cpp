@@ -0,0 +1,359 @@
+// Copyright(c) Peter Hillerstrm(skipifzero.com, peter@hstroem.se)
+
+#include "PlateRing.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <new>
+#include <string>
+#include <thread>
+
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#include <malloc.h>
+
+#include "PlateDecoders.hpp"
+
+using namespace std;
+
+// Constants
+// ------------------------------------------------------------------------------------------------
+
+static const uint64_t MAX_NUMBER_CODES = 17576000;
+static const uint64_t NUM_BITSET_BYTES = (MAX_NUMBER_CODES / 8);
+static_assert(NUM_BITSET_BYTES == SEEN_SET_NUM_BYTES, "Seen-set snapshots must match the bitset");
+
+static const uint32_t MIN_CAPACITY = 64;
+static const uint32_t MAX_CAPACITY = uint32_t(1) << 24;
+
+// Max number of records checked before publishing progress, bounds the latency of the first
+// record in a large batch
+static const uint64_t CHECK_BATCH_SIZE = 1024;
+
+// Number of spins while waiting before starting to yield the processor, so waiting producers and
+// an idle checker don't starve each other when there are more threads than processors
+static const uint32_t NUM_SPINS_BEFORE_YIELD = 1024;
+
+// Helpers
+// ------------------------------------------------------------------------------------------------
+
+static string mappingName(const char* name) noexcept
+{
+	return string("Local\\PlateRing_") + name;
+}
+
+static uint64_t mappingSize(uint32_t capacity) noexcept
+{
+	return sizeof(PlateRingHeader) + uint64_t(capacity) * (sizeof(uint64_t) + sizeof(uint64_t));
+}
+
+static void backoff(uint32_t& numSpins) noexcept
+{
+	if (numSpins < NUM_SPINS_BEFORE_YIELD) {
+		numSpins++;
+		_mm_pause();
+	}
+	else {
+		this_thread::yield();
+	}
+}
+
+static const uint64_t RESPONSE_MASK = 3;
+
+static uint64_t responseSlot(uint64_t sequence, PlateRingResponse response) noexcept
+{
+	return ((sequence + 1) << 2) | uint64_t(response);
+}
+
+uint64_t plateRecord(const char* code) noexcept
+{
+	uint8_t bytes[8] = { uint8_t(code[0]), uint8_t(code[1]), uint8_t(code[2]), uint8_t(code[3]),
+	                     uint8_t(code[4]), uint8_t(code[5]), '\r', '\n' };
+	uint64_t record = 0;
+	memcpy(&record, bytes, sizeof(uint64_t));
+	return record;
+}
+
+// Checker
+// ------------------------------------------------------------------------------------------------
+
+bool PlateRingChecker::create(const char* name, uint32_t capacity) noexcept
+{
+	this->destroy();
+
+	// Round capacity up to power of two, also a multiple of 8 for the AVX2 decoder
+	uint32_t roundedCapacity = MIN_CAPACITY;
+	while (roundedCapacity < capacity && roundedCapacity < MAX_CAPACITY) roundedCapacity <<= 1;
+
+	// Create shared ring, pagefile backed mappings are zero initialized
+	uint64_t size = mappingSize(roundedCapacity);
+	HANDLE mapping = CreateFileMapping(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE,
+		uint32_t(size >> 32), uint32_t(size & 0xFFFFFFFF), mappingName(name).c_str());
+	if (!mapping) {
+		printf("CreateFileMapping() failed for plate ring\n");
+		return false;
+	}
+	if (GetLastError() == ERROR_ALREADY_EXISTS) {
+		printf("Plate ring \"%s\" already exists\n", name);
+		CloseHandle(mapping);
+		return false;
+	}
+	void* view = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, size);
+	if (!view) {
+		printf("MapViewOfFile() failed for plate ring\n");
+		CloseHandle(mapping);
+		return false;
+	}
+
+	// Initialize header, magic is written last so producers never see a partial header
+	mMapping = mapping;
+	mHeader = new (view) PlateRingHeader();
+	mHeader->capacity = roundedCapacity;
+	mHeader->claimHead.store(0, memory_order_relaxed);
+	mHeader->publishHead.store(0, memory_order_relaxed);
+	mHeader->checkedTail.store(0, memory_order_relaxed);
+	atomic_thread_fence(memory_order_release);
+	mHeader->magic = PLATE_RING_MAGIC;
+
+	uint8_t* requests = reinterpret_cast<uint8_t*>(view) + sizeof(PlateRingHeader);
+	mRequests = reinterpret_cast<const uint64_t*>(requests);
+	mResponses = reinterpret_cast<atomic<uint64_t>*>(requests + uint64_t(roundedCapacity) * sizeof(uint64_t));
+	mCapacity = roundedCapacity;
+	mCheckedTail = 0;
+
+	// Allocate and clear seen-set
+	mIsFoundBitset = static_cast<uint64_t*>(_aligned_malloc(NUM_BITSET_BYTES, 32));
+	memset(mIsFoundBitset, 0, NUM_BITSET_BYTES);
+	mNumChecked = 0;
+	mNumDuplicates = 0;
+	mNumInvalid = 0;
+	mStop.store(false, memory_order_relaxed);
+	return true;
+}
+
+void PlateRingChecker::destroy() noexcept
+{
+	if (mHeader != nullptr) {
+		UnmapViewOfFile(mHeader);
+		CloseHandle(mMapping);
+		_aligned_free(mIsFoundBitset);
+	}
+	mMapping = nullptr;
+	mHeader = nullptr;
+	mRequests = nullptr;
+	mResponses = nullptr;
+	mCapacity = 0;
+	mCheckedTail = 0;
+	mIsFoundBitset = nullptr;
+}
+
+uint64_t PlateRingChecker::poll() noexcept
+{
+	if (mHeader == nullptr) return 0;
+
+	// Capacity and tail are never re-read from the shared header, a producer could have rewritten
+	// them. The head is clamped to the records that fit in the ring.
+	const uint64_t mask = mCapacity - 1;
+	const uint64_t tail = mCheckedTail;
+	const uint64_t head = min(max(mHeader->publishHead.load(memory_order_acquire), tail),
+	                          tail + mCapacity);
+
+	uint64_t* __restrict bitset = mIsFoundBitset;
+	const uint8_t* requestBytes = reinterpret_cast<const uint8_t*>(mRequests);
+	alignas(32) uint32_t numbers[8];
+
+	uint64_t sequence = tail;
+	while (sequence < head) {
+
+		// Contiguous run of records, not wrapping around the end of the ring
+		uint64_t runEnd = min(head, sequence + CHECK_BATCH_SIZE);
+		runEnd = min(runEnd, (sequence | mask) + 1);
+
+		for (uint64_t groupStart = sequence; groupStart < runEnd; groupStart += 8) {
+
+			// Validate and decode records in place, 8 at a time when possible
+			uint64_t groupSize = min(uint64_t(8), runEnd - groupStart);
+			const uint8_t* records = requestBytes + (groupStart & mask) * 8;
+			uint32_t validMask = 0;
+			if (groupSize == 8) {
+				validMask = validCodesMask8Avx2(records);
+				_mm256_store_si256(reinterpret_cast<__m256i*>(numbers), decode8Avx2<8>(records));
+			}
+			else {
+				for (uint64_t i = 0; i < groupSize; i++) {
+					validMask |= uint32_t(isValidCode(records + i * 8)) << i;
+					numbers[i] = decodeScalar(records + i * 8);
+				}
+			}
+
+			for (uint64_t i = 0; i < groupSize; i++) {
+				uint64_t recordSequence = groupStart + i;
+				PlateRingResponse response = PlateRingResponse::INVALID;
+				if ((validMask >> i) & 1u) {
+					uint32_t number = numbers[i];
+					uint32_t bitsetChunkIndex = number >> 6u; // number / 64;
+					uint64_t bitMask = uint64_t(1) << (number & 0x0000003Fu); // number % 64;
+
+					uint64_t chunk = bitset[bitsetChunkIndex];
+					bool isDuplicate = (bitMask & chunk) != uint64_t(0);
+					bitset[bitsetChunkIndex] = bitMask | chunk;
+					mNumDuplicates += isDuplicate ? 1 : 0;
+					response = isDuplicate ? PlateRingResponse::DUPLICATE : PlateRingResponse::NEW;
+				}
+				else {
+					mNumInvalid += 1;
+				}
+				mResponses[recordSequence & mask].store(responseSlot(recordSequence, response),
+				                                        memory_order_release);
+			}
+		}
+
+		// Release the request slots, all reads of them happen before this
+		mCheckedTail = runEnd;
+		mHeader->checkedTail.store(runEnd, memory_order_release);
+		sequence = runEnd;
+	}
+
+	mNumChecked += head - tail;
+	return head - tail;
+}
+
+void PlateRingChecker::run() noexcept
+{
+	uint32_t numSpins = 0;
+	while (!mStop.load(memory_order_relaxed)) {
+		if (this->poll() != 0) {
+			numSpins = 0;
+		}
+		else {
+			backoff(numSpins);
+		}
+	}
+}
+
+bool PlateRingChecker::saveSnapshot(const char* path, SeenSetEncoding encoding) const noexcept
+{
+	if (mIsFoundBitset == nullptr) return false;
+	return saveSeenSet(path, mIsFoundBitset, encoding);
+}
+
+bool PlateRingChecker::loadSnapshot(const char* path) noexcept
+{
+	if (mIsFoundBitset == nullptr) return false;
+	return loadSeenSet(path, mIsFoundBitset);
+}
+
+// Producer
+// ------------------------------------------------------------------------------------------------
+
+bool PlateRingProducer::open(const char* name) noexcept
+{
+	this->close();
+
+	HANDLE mapping = OpenFileMapping(FILE_MAP_ALL_ACCESS, FALSE, mappingName(name).c_str());
+	if (!mapping) {
+		printf("OpenFileMapping() failed for plate ring \"%s\"\n", name);
+		return false;
+	}
+
+	// Map header first to find the capacity
+	PlateRingHeader* header = static_cast<PlateRingHeader*>(
+		MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(PlateRingHeader)));
+	if (!header || header->magic != PLATE_RING_MAGIC) {
+		printf("Plate ring \"%s\" is not initialized\n", name);
+		if (header) UnmapViewOfFile(header);
+		CloseHandle(mapping);
+		return false;
+	}
+	atomic_thread_fence(memory_order_acquire);
+	uint32_t capacity = header->capacity;
+	UnmapViewOfFile(header);
+	if (capacity < MIN_CAPACITY || capacity > MAX_CAPACITY || (capacity & (capacity - 1)) != 0) {
+		printf("Plate ring \"%s\" has an invalid capacity\n", name);
+		CloseHandle(mapping);
+		return false;
+	}
+
+	void* view = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, mappingSize(capacity));
+	if (!view) {
+		printf("MapViewOfFile() failed for plate ring\n");
+		CloseHandle(mapping);
+		return false;
+	}
+
+	mMapping = mapping;
+	mHeader = static_cast<PlateRingHeader*>(view);
+	uint8_t* requests = reinterpret_cast<uint8_t*>(view) + sizeof(PlateRingHeader);
+	mRequests = reinterpret_cast<uint64_t*>(requests);
+	mResponses = reinterpret_cast<const atomic<uint64_t>*>(requests + uint64_t(capacity) * sizeof(uint64_t));
+	mCapacity = capacity;
+	return true;
+}
+
+void PlateRingProducer::close() noexcept
+{
+	if (mHeader != nullptr) {
+		UnmapViewOfFile(mHeader);
+		CloseHandle(mMapping);
+	}
+	mMapping = nullptr;
+	mHeader = nullptr;
+	mRequests = nullptr;
+	mResponses = nullptr;
+	mCapacity = 0;
+}
+
+bool PlateRingProducer::push(const uint64_t* records, uint32_t numRecords, uint64_t& firstSequenceOut) noexcept
+{
+	if (mHeader == nullptr || numRecords > mCapacity) return false;
+	const uint64_t capacity = mCapacity;
+	const uint64_t mask = capacity - 1;
+
+	// Claim sequence numbers
+	const uint64_t first = mHeader->claimHead.fetch_add(numRecords, memory_order_relaxed);
+	const uint64_t end = first + numRecords;
+	firstSequenceOut = first;
+
+	// Wait until the claimed slots have been checked by the checker
+	uint32_t numSpins = 0;
+	while (end > mHeader->checkedTail.load(memory_order_acquire) + capacity) {
+		backoff(numSpins);
+	}
+
+	// Copy records, in two parts if the range wraps around the end of the ring
+	uint64_t firstIndex = first & mask;
+	uint64_t numBeforeWrap = min(uint64_t(numRecords), capacity - firstIndex);
+	memcpy(mRequests + firstIndex, records, numBeforeWrap * sizeof(uint64_t));
+	memcpy(mRequests, records + numBeforeWrap, (numRecords - numBeforeWrap) * sizeof(uint64_t));
+
+	// Publish in claim order, wait for producers that claimed earlier sequence numbers
+	numSpins = 0;
+	while (mHeader->publishHead.load(memory_order_acquire) != first) {
+		backoff(numSpins);
+	}
+	mHeader->publishHead.store(end, memory_order_release);
+	return true;
+}
+
+bool PlateRingProducer::waitForResponses(uint64_t firstSequence, uint32_t numRecords, bool* isDuplicateOut,
+                                         bool* isInvalidOut) noexcept
+{
+	if (mHeader == nullptr) return false;
+	const uint64_t mask = mCapacity - 1;
+	for (uint64_t i = 0; i < numRecords; i++) {
+		uint64_t sequence = firstSequence + i;
+		uint64_t expected = (sequence + 1) << 2;
+		uint64_t slot;
+		uint32_t numSpins = 0;
+		while (((slot = mResponses[sequence & mask].load(memory_order_acquire)) & ~RESPONSE_MASK) < expected) {
+			backoff(numSpins);
+		}
+		if ((slot & ~RESPONSE_MASK) != expected) return false; // Overwritten by a later record
+		PlateRingResponse response = PlateRingResponse(slot & RESPONSE_MASK);
+		isDuplicateOut[i] = response == PlateRingResponse::DUPLICATE;
+		if (isInvalidOut != nullptr) isInvalidOut[i] = response == PlateRingResponse::INVALID;
+	}
+	return true;
+}
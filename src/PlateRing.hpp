@@ -0,0 +1,137 @@
+// Copyright(c) Peter Hillerstrm(skipifzero.com, peter@hstroem.se)
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+#include "SeenSetSnapshot.hpp"
+
+// Plate ring
+// ------------------------------------------------------------------------------------------------
+
+// A shared memory ring buffer for checking codes produced by other processes on the same host,
+// without going through a file. Producers push fixed 8 byte records, each record is a code exactly
+// as it appears on a line of a text file ("ABC123\r\n"), so the checker decodes the records in
+// place in the ring with the same decoders as the file based algorithms.
+//
+// For each record the checker answers whether the code has been seen before (since the checker was
+// created) through a companion response ring with one slot per request slot. A response slot
+// stores ((sequence + 1) << 2) | PlateRingResponse, so a producer can tell its own response apart
+// from older ones and detect if it was overwritten before being read.
+//
+// Records are written by other processes and are untrusted. The checker validates each record with
+// the range compares from ValidatingAlgorithm and answers malformed ones (e.g. lowercase letters,
+// NUL bytes or a partially written record) with INVALID without touching the seen-set. The header
+// is writable by producers too, so the checker keeps its own copy of the capacity and checked tail
+// and clamps the publish head, a corrupted header can stall the ring but not move accesses outside
+// of it.
+//
+// Any number of producers may push concurrently. A push claims a range of sequence numbers with
+// one atomic add, copies its records and then publishes them in claim order. All operations are
+// lock-free except that a producer waits for earlier claims to be published, so a producer process
+// dying between claim and publish stalls the ring.
+//
+// The ring lives in a named pagefile backed mapping ("Local\PlateRing_<name>") created by the
+// checker and opened by the producers.
+
+static const uint32_t PLATE_RING_MAGIC = 0x474E4952u; // "RING"
+
+struct alignas(64) PlateRingHeader final {
+	uint32_t magic;
+	uint32_t capacity; // Number of slots in each ring, power of two
+
+	// Each counter is on its own cache line to avoid false sharing between producers and checker
+	alignas(64) std::atomic<uint64_t> claimHead; // Next sequence number to claim
+	alignas(64) std::atomic<uint64_t> publishHead; // All records before this are published
+	alignas(64) std::atomic<uint64_t> checkedTail; // All records before this are checked
+};
+
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2, "Shared atomics must be lock-free");
+
+enum class PlateRingResponse : uint64_t {
+	NEW = 0,
+	DUPLICATE = 1,
+	INVALID = 2
+};
+
+// Packs the first 6 characters of a code followed by "\r\n" into a record
+uint64_t plateRecord(const char* code) noexcept;
+
+// Checker (consumer) side
+// ------------------------------------------------------------------------------------------------
+
+class PlateRingChecker final {
+public:
+	PlateRingChecker() noexcept = default;
+	PlateRingChecker(const PlateRingChecker&) = delete;
+	PlateRingChecker& operator= (const PlateRingChecker&) = delete;
+	~PlateRingChecker() noexcept { this->destroy(); }
+
+	// Creates the shared ring and the seen-set, capacity is rounded up to a power of two
+	bool create(const char* name, uint32_t capacity) noexcept;
+	void destroy() noexcept;
+
+	// Checks all currently published records, returns the number of records checked
+	uint64_t poll() noexcept;
+
+	// Polls until stop() is called from another thread
+	void run() noexcept;
+	void stop() noexcept { mStop.store(true, std::memory_order_relaxed); }
+
+	uint64_t numChecked() const noexcept { return mNumChecked; }
+	uint64_t numDuplicates() const noexcept { return mNumDuplicates; }
+	uint64_t numInvalid() const noexcept { return mNumInvalid; }
+
+	// Saves or restores the seen-set, so a restarted checker remembers codes checked before. Must
+	// not be called concurrently with poll() or run().
+	bool saveSnapshot(const char* path, SeenSetEncoding encoding) const noexcept;
+	bool loadSnapshot(const char* path) noexcept;
+
+private:
+	void* mMapping = nullptr;
+	PlateRingHeader* mHeader = nullptr;
+	const uint64_t* mRequests = nullptr;
+	std::atomic<uint64_t>* mResponses = nullptr;
+	uint64_t mCapacity = 0;
+	uint64_t mCheckedTail = 0;
+	uint64_t* mIsFoundBitset = nullptr;
+	uint64_t mNumChecked = 0;
+	uint64_t mNumDuplicates = 0;
+	uint64_t mNumInvalid = 0;
+	std::atomic_bool mStop { false };
+};
+
+// Producer side
+// ------------------------------------------------------------------------------------------------
+
+class PlateRingProducer final {
+public:
+	PlateRingProducer() noexcept = default;
+	PlateRingProducer(const PlateRingProducer&) = delete;
+	PlateRingProducer& operator= (const PlateRingProducer&) = delete;
+	~PlateRingProducer() noexcept { this->close(); }
+
+	// Opens a ring created by a PlateRingChecker
+	bool open(const char* name) noexcept;
+	void close() noexcept;
+
+	uint32_t capacity() const noexcept { return uint32_t(mCapacity); }
+
+	// Pushes records into the ring, waiting while it is full. The records get consecutive sequence
+	// numbers starting at firstSequenceOut. Fails if numRecords is larger than the capacity.
+	bool push(const uint64_t* records, uint32_t numRecords, uint64_t& firstSequenceOut) noexcept;
+
+	// Waits for the responses of the specified pushed records. Returns false if a response was
+	// overwritten before it was read, i.e. if more than capacity records were checked after it.
+	// Invalid records are reported as not duplicates, and as invalid if isInvalidOut is not null.
+	bool waitForResponses(uint64_t firstSequence, uint32_t numRecords, bool* isDuplicateOut,
+	                      bool* isInvalidOut = nullptr) noexcept;
+
+private:
+	void* mMapping = nullptr;
+	PlateRingHeader* mHeader = nullptr;
+	uint64_t* mRequests = nullptr;
+	const std::atomic<uint64_t>* mResponses = nullptr;
+	uint64_t mCapacity = 0;
+};
@@ -0,0 +1,260 @@
+// Copyright(c) Peter Hillerstrm(skipifzero.com, peter@hstroem.se)
+
+#include "PlateRingBenchmark.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+
+#include "PlateDecoders.hpp"
+#include "PlateRing.hpp"
+
+using namespace std;
+
+// Constants
+// ------------------------------------------------------------------------------------------------
+
+static const uint64_t MAX_NUMBER_CODES = 17576000;
+
+static const uint32_t RING_CAPACITY = 65536;
+static const uint32_t MAX_NUM_PRODUCERS = 3;
+static const uint32_t BATCH_SIZES[] = { 16, 256, 4096 };
+static const uint64_t NUM_LATENCY_SAMPLES = 100000;
+
+// Helpers
+// ------------------------------------------------------------------------------------------------
+
+static string uniqueRingName() noexcept
+{
+	static atomic_uint counter(0);
+	return "Benchmark_" + to_string(GetCurrentProcessId()) + "_" + to_string(counter++);
+}
+
+static bool readRecords(const char* filePath, vector<uint64_t>& recordsOut) noexcept
+{
+	FILE* file = fopen(filePath, "rb");
+	if (file == nullptr) return false;
+	vector<char> contents;
+	char buffer[4096];
+	size_t numRead;
+	while ((numRead = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+		contents.insert(contents.end(), buffer, buffer + numRead);
+	}
+	fclose(file);
+
+	// One record per line regardless of line endings in the file
+	recordsOut.clear();
+	for (size_t i = 0; i + 6 <= contents.size();) {
+		recordsOut.push_back(plateRecord(contents.data() + i));
+		i += 6;
+		if (i < contents.size() && contents[i] == '\r') i++;
+		if (i < contents.size() && contents[i] == '\n') i++;
+	}
+	return true;
+}
+
+// Number of records that are copies of an earlier record
+static uint64_t countDuplicates(const vector<uint64_t>& records) noexcept
+{
+	vector<bool> isFound(MAX_NUMBER_CODES, false);
+	uint64_t numDuplicates = 0;
+	for (uint64_t record : records) {
+		uint32_t number = decodeScalar(reinterpret_cast<const uint8_t*>(&record));
+		if (isFound[number]) numDuplicates++;
+		isFound[number] = true;
+	}
+	return numDuplicates;
+}
+
+// Throughput
+// ------------------------------------------------------------------------------------------------
+
+static void producerFunction(const char* ringName, const uint64_t* records, uint64_t numRecords,
+                             uint32_t batchSize, atomic<uint64_t>* numFlaggedOut,
+                             atomic_bool* errorOut) noexcept
+{
+	PlateRingProducer producer;
+	if (!producer.open(ringName)) {
+		*errorOut = true;
+		return;
+	}
+
+	unique_ptr<bool[]> isDuplicate(new bool[batchSize]);
+	uint64_t numFlagged = 0;
+	for (uint64_t i = 0; i < numRecords; i += batchSize) {
+		uint32_t numToPush = uint32_t(min(uint64_t(batchSize), numRecords - i));
+		uint64_t firstSequence = 0;
+		if (!producer.push(records + i, numToPush, firstSequence) ||
+		    !producer.waitForResponses(firstSequence, numToPush, isDuplicate.get())) {
+			*errorOut = true;
+			return;
+		}
+		for (uint32_t j = 0; j < numToPush; j++) {
+			numFlagged += isDuplicate[j] ? 1 : 0;
+		}
+	}
+	*numFlaggedOut += numFlagged;
+}
+
+static void benchmarkThroughput(const vector<uint64_t>& records, uint64_t expectedDuplicates,
+                                uint32_t numProducers, uint32_t batchSize) noexcept
+{
+	string ringName = uniqueRingName();
+	PlateRingChecker checker;
+	if (!checker.create(ringName.c_str(), RING_CAPACITY)) return;
+	thread checkerThread([&checker]() { checker.run(); });
+
+	atomic<uint64_t> numFlagged(0);
+	atomic_bool error(false);
+	uint64_t recordsPerProducer = (records.size() + numProducers - 1) / numProducers;
+
+	auto startTime = chrono::high_resolution_clock::now();
+	vector<thread> producers;
+	for (uint32_t i = 0; i < numProducers; i++) {
+		uint64_t first = min(i * recordsPerProducer, uint64_t(records.size()));
+		uint64_t last = min(first + recordsPerProducer, uint64_t(records.size()));
+		producers.emplace_back(producerFunction, ringName.c_str(), records.data() + first, last - first,
+		                       batchSize, &numFlagged, &error);
+	}
+	for (thread& t : producers) {
+		t.join();
+	}
+	auto endTime = chrono::high_resolution_clock::now();
+
+	checker.stop();
+	checkerThread.join();
+
+	double seconds = chrono::duration<double>(endTime - startTime).count();
+	bool correct = !error && numFlagged == expectedDuplicates && checker.numDuplicates() == expectedDuplicates;
+	printf("  %u producer(s), batch %4u: %7.2f M records/s%s\n", numProducers, batchSize,
+	       double(records.size()) / seconds / 1000000.0, correct ? "" : " (INCORRECT)");
+}
+
+// Latency
+// ------------------------------------------------------------------------------------------------
+
+static void benchmarkLatency(const vector<uint64_t>& records) noexcept
+{
+	string ringName = uniqueRingName();
+	PlateRingChecker checker;
+	if (!checker.create(ringName.c_str(), RING_CAPACITY)) return;
+	thread checkerThread([&checker]() { checker.run(); });
+
+	PlateRingProducer producer;
+	vector<double> latencies;
+	if (producer.open(ringName.c_str())) {
+		uint64_t numSamples = min(NUM_LATENCY_SAMPLES, uint64_t(records.size()));
+		latencies.reserve(numSamples);
+		for (uint64_t i = 0; i < numSamples; i++) {
+			auto startTime = chrono::high_resolution_clock::now();
+			uint64_t sequence = 0;
+			bool isDuplicate = false;
+			if (!producer.push(&records[i], 1, sequence) ||
+			    !producer.waitForResponses(sequence, 1, &isDuplicate)) break;
+			auto endTime = chrono::high_resolution_clock::now();
+			latencies.push_back(chrono::duration<double, nano>(endTime - startTime).count());
+		}
+		producer.close();
+	}
+
+	checker.stop();
+	checkerThread.join();
+
+	if (latencies.empty()) {
+		printf("  Latency benchmark failed\n");
+		return;
+	}
+	sort(latencies.begin(), latencies.end());
+	auto percentile = [&](double p) { return latencies[size_t(p * double(latencies.size() - 1))]; };
+	printf("  Round trip latency, 1 record: median %.0f ns, p99 %.0f ns, p99.9 %.0f ns, max %.0f ns\n",
+	       percentile(0.5), percentile(0.99), percentile(0.999), latencies.back());
+}
+
+// Malformed records
+// ------------------------------------------------------------------------------------------------
+
+// Pushes a mix of valid and malformed records, covering both the AVX2 and the scalar path of the
+// checker, and verifies that the malformed ones are answered as invalid
+static void checkMalformedRecords() noexcept
+{
+	string ringName = uniqueRingName();
+	PlateRingChecker checker;
+	if (!checker.create(ringName.c_str(), RING_CAPACITY)) return;
+	thread checkerThread([&checker]() { checker.run(); });
+
+	const uint32_t NUM_RECORDS = 11;
+	uint64_t records[NUM_RECORDS] = {
+		plateRecord("ABC123"),
+		plateRecord("abc123"), // Lowercase
+		0, // NUL, e.g. never written
+		plateRecord("ABC123"), // Duplicate
+		plateRecord("ABC12\0"), // Partial write
+		plateRecord("ZZZ999"),
+		plateRecord("ABC1:3"),
+		plateRecord("[BC123"),
+		plateRecord("AAA000"),
+		plateRecord("AA@000"),
+		plateRecord("ZZZ999") // Duplicate
+	};
+	records[5] &= ~(uint64_t(0xFF) << 56u); // Valid code, but '\n' missing
+	const bool EXPECTED_INVALID[NUM_RECORDS] = {
+		false, true, true, false, true, true, true, true, false, true, false
+	};
+	const bool EXPECTED_DUPLICATE[NUM_RECORDS] = {
+		false, false, false, true, false, false, false, false, false, false, false
+	};
+
+	bool correct = false;
+	PlateRingProducer producer;
+	if (producer.open(ringName.c_str())) {
+		bool isDuplicate[NUM_RECORDS] = {};
+		bool isInvalid[NUM_RECORDS] = {};
+		uint64_t sequence = 0;
+		correct = producer.push(records, NUM_RECORDS, sequence) &&
+		          producer.waitForResponses(sequence, NUM_RECORDS, isDuplicate, isInvalid);
+		for (uint32_t i = 0; i < NUM_RECORDS; i++) {
+			correct = correct && isInvalid[i] == EXPECTED_INVALID[i] && isDuplicate[i] == EXPECTED_DUPLICATE[i];
+		}
+		producer.close();
+	}
+
+	checker.stop();
+	checkerThread.join();
+	correct = correct && checker.numInvalid() == 7;
+	printf("  Malformed records: %llu of %u answered as invalid%s\n", (unsigned long long)checker.numInvalid(),
+	       NUM_RECORDS, correct ? "" : " (INCORRECT)");
+}
+
+// Exposed function
+// ------------------------------------------------------------------------------------------------
+
+void benchmarkPlateRing(const char* filePath) noexcept
+{
+	vector<uint64_t> records;
+	if (!readRecords(filePath, records)) {
+		printf("Could not open \"%s\" for plate ring benchmark\n", filePath);
+		return;
+	}
+	uint64_t expectedDuplicates = countDuplicates(records);
+
+	printf("Plate ring, \"%s\" (%llu records, %llu duplicates):\n", filePath,
+	       (unsigned long long)records.size(), (unsigned long long)expectedDuplicates);
+	for (uint32_t numProducers = 1; numProducers <= MAX_NUM_PRODUCERS; numProducers += 2) {
+		for (uint32_t batchSize : BATCH_SIZES) {
+			benchmarkThroughput(records, expectedDuplicates, numProducers, batchSize);
+		}
+	}
+	benchmarkLatency(records);
+	checkMalformedRecords();
+	printf("\n");
+}
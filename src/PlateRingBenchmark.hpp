@@ -0,0 +1,9 @@
+// Copyright(c) Peter Hillerstrm(skipifzero.com, peter@hstroem.se)
+
+#pragma once
+
+// Benchmarks the shared memory plate ring in PlateRing.hpp with the codes in the specified file.
+// Prints the throughput for different numbers of producers and batch sizes, and the round trip
+// latency (push to response) of single records. Also verifies that the number of records flagged
+// as duplicates matches the number of copies in the file.
+void benchmarkPlateRing(const char* filePath) noexcept;
@@ -0,0 +1,214 @@
+// Copyright(c) Peter Hillerstrm(skipifzero.com, peter@hstroem.se)
+
+#pragma once
+
+#include <cstdint>
+#include <type_traits>
+
+#include <immintrin.h>
+
+// Plate schema
+// ------------------------------------------------------------------------------------------------
+
+// A plate schema describes the format of a code as a sequence of character classes, e.g. "AAA000"
+// is <LETTER, LETTER, LETTER, DIGIT, DIGIT, DIGIT>. Everything derived from the schema (index
+// function, universe size, bitset size and SIMD decode tables) is calculated at compile time, so
+// each schema compiles into its own specialized scanner.
+//
+// The index of a code is its value as a mixed radix number where each character is a digit, with
+// the first character being the most significant. For "AAA000" this gives the same index as the
+// hardcoded algorithms, i.e. "AAA000" is 0 and "ZZZ999" is 17575999.
+
+enum class CharClass : uint8_t {
+	LETTER,
+	DIGIT
+};
+
+constexpr uint8_t charClassBase(CharClass charClass) noexcept
+{
+	return charClass == CharClass::LETTER ? uint8_t('A') : uint8_t('0');
+}
+
+constexpr uint32_t charClassRadix(CharClass charClass) noexcept
+{
+	return charClass == CharClass::LETTER ? 26u : 10u;
+}
+
+template<CharClass... CLASSES>
+struct PlateSchema final {
+
+	static constexpr uint32_t NUM_CHARS = uint32_t(sizeof...(CLASSES));
+	static_assert(NUM_CHARS > 0, "Schema must contain at least one character");
+
+	static constexpr CharClass charClass(uint32_t i) noexcept
+	{
+		const CharClass classes[NUM_CHARS] = { CLASSES... };
+		return classes[i];
+	}
+
+	static constexpr uint8_t base(uint32_t i) noexcept { return charClassBase(charClass(i)); }
+	static constexpr uint32_t radix(uint32_t i) noexcept { return charClassRadix(charClass(i)); }
+
+	// The value of a unit of the specified character in the index
+	static constexpr uint64_t multiplier(uint32_t i) noexcept
+	{
+		uint64_t product = 1;
+		for (uint32_t j = i + 1; j < NUM_CHARS; j++) {
+			product *= radix(j);
+		}
+		return product;
+	}
+
+	// Assumes Windows file endings (2 bytes per newline)
+	static constexpr uint64_t BYTES_PER_CODE = NUM_CHARS + 2;
+	static constexpr uint64_t MAX_NUMBER_CODES = multiplier(0) * charClassRadix(charClass(0));
+	static constexpr uint64_t NUM_BITSET_BYTES = ((MAX_NUMBER_CODES + 63) / 64) * 8;
+
+	static_assert(MAX_NUMBER_CODES <= (uint64_t(1) << 32), "Indices must fit in 32 bits");
+
+	// Inverse of the index function, writes the NUM_CHARS characters of the code with the index
+	static void encode(uint64_t index, uint8_t* __restrict codeOut) noexcept
+	{
+		for (uint32_t i = 0; i < NUM_CHARS; i++) {
+			codeOut[i] = uint8_t(base(i) + (index / multiplier(i)) % radix(i));
+		}
+	}
+};
+
+// Scalar decoding
+// ------------------------------------------------------------------------------------------------
+
+template<typename Schema, uint32_t I = 0, bool DONE = (I == Schema::NUM_CHARS)>
+struct ScalarDecoder final {
+	static uint32_t decode(const uint8_t* __restrict code) noexcept
+	{
+		const uint32_t MULTIPLIER = std::integral_constant<uint32_t, uint32_t(Schema::multiplier(I))>::value;
+		const uint8_t BASE = std::integral_constant<uint8_t, Schema::base(I)>::value;
+		return uint32_t(code[I] - BASE) * MULTIPLIER + ScalarDecoder<Schema, I + 1>::decode(code);
+	}
+};
+
+template<typename Schema, uint32_t I>
+struct ScalarDecoder<Schema, I, true> final {
+	static uint32_t decode(const uint8_t* __restrict) noexcept { return 0; }
+};
+
+// SIMD decoding
+// ------------------------------------------------------------------------------------------------
+
+// Tables for decoding 6 character schemas (8 bytes per code including newline) with AVX2. Each
+// code is decoded in three steps, all tables are derived from the schema:
+//
+// 1. Subtract base char from each byte: [c0, c1, c2, c3, c4, c5, '\r', '\n'] -> [d0, ..., d5, 0, 0]
+// 2. maddubs, pairs of digits: [d0 * r1 + d1, d2 * r3 + d3, d4 * r5 + d5, 0]
+// 3. madd, pairs of pairs: [(d0 * r1 + d1) * r2 * r3 + (d2 * r3 + d3), d4 * r5 + d5]
+//
+// The final index is the first u32 times multiplier(3) plus the second u32 times multiplier(5).
+// This works for any schema since each multiplier is the product of the radices after it, i.e.
+// all intermediate weights are small enough to fit in the 8 and 16 bit lanes.
+template<typename Schema>
+struct SimdDecodeTables final {
+	static_assert(Schema::BYTES_PER_CODE == 8, "SIMD decoding requires 8 bytes per code");
+
+	static constexpr uint64_t SUBTRACT_CHARS =
+		(uint64_t(Schema::base(0)) << 0) | (uint64_t(Schema::base(1)) << 8) |
+		(uint64_t(Schema::base(2)) << 16) | (uint64_t(Schema::base(3)) << 24) |
+		(uint64_t(Schema::base(4)) << 32) | (uint64_t(Schema::base(5)) << 40) |
+		(uint64_t('\r') << 48) | (uint64_t('\n') << 56);
+
+	static constexpr uint64_t PAIR_FACTORS =
+		(uint64_t(Schema::radix(1)) << 0) | (uint64_t(1) << 8) |
+		(uint64_t(Schema::radix(3)) << 16) | (uint64_t(1) << 24) |
+		(uint64_t(Schema::radix(5)) << 32) | (uint64_t(1) << 40);
+
+	static constexpr uint64_t QUAD_FACTORS =
+		(uint64_t(Schema::radix(2) * Schema::radix(3)) << 0) | (uint64_t(1) << 16) |
+		(uint64_t(1) << 32);
+
+	static constexpr uint64_t FINAL_FACTORS =
+		(Schema::multiplier(3) << 0) | (Schema::multiplier(5) << 32);
+
+	static_assert(Schema::radix(2) * Schema::radix(3) <= 32767, "Quad factor must fit in int16");
+};
+
+// Decodes 8 codes (64 bytes) of a 6 character schema into 8 indices using AVX2
+template<typename Schema>
+inline __m256i decode8Codes(const uint8_t* __restrict codes) noexcept
+{
+	typedef SimdDecodeTables<Schema> Tables;
+
+	const __m256i SUBTRACT_CHARS = _mm256_set1_epi64x(int64_t(Tables::SUBTRACT_CHARS));
+	const __m256i raw0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(codes));
+	const __m256i raw1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(codes + 32));
+	const __m256i digits0 = _mm256_sub_epi8(raw0, SUBTRACT_CHARS);
+	const __m256i digits1 = _mm256_sub_epi8(raw1, SUBTRACT_CHARS);
+
+	const __m256i PAIR_FACTORS = _mm256_set1_epi64x(int64_t(Tables::PAIR_FACTORS));
+	const __m256i pairs0 = _mm256_maddubs_epi16(digits0, PAIR_FACTORS);
+	const __m256i pairs1 = _mm256_maddubs_epi16(digits1, PAIR_FACTORS);
+
+	const __m256i QUAD_FACTORS = _mm256_set1_epi64x(int64_t(Tables::QUAD_FACTORS));
+	const __m256i quads0 = _mm256_madd_epi16(pairs0, QUAD_FACTORS);
+	const __m256i quads1 = _mm256_madd_epi16(pairs1, QUAD_FACTORS);
+
+	// Scale both halves by their multipliers, final index in low u32 of each u64
+	const __m256i FINAL_FACTORS = _mm256_set1_epi64x(int64_t(Tables::FINAL_FACTORS));
+	const __m256i scaled0 = _mm256_mullo_epi32(quads0, FINAL_FACTORS);
+	const __m256i scaled1 = _mm256_mullo_epi32(quads1, FINAL_FACTORS);
+	const __m256i indices0 = _mm256_add_epi32(scaled0, _mm256_srli_epi64(scaled0, 32));
+	const __m256i indices1 = _mm256_add_epi32(scaled1, _mm256_srli_epi64(scaled1, 32));
+
+	// Pack into [0, 1, 4, 5, 2, 3, 6, 7] and then permute into order
+	const __m256i packed = _mm256_castps_si256(_mm256_shuffle_ps(_mm256_castsi256_ps(indices0),
+	                                           _mm256_castsi256_ps(indices1), _MM_SHUFFLE(2, 0, 2, 0)));
+	return _mm256_permute4x64_epi64(packed, _MM_SHUFFLE(3, 1, 2, 0));
+}
+
+// Block decoding
+// ------------------------------------------------------------------------------------------------
+
+// Decodes numCodes codes into indices, using AVX2 when the schema allows it
+template<typename Schema, bool USE_SIMD = (Schema::NUM_CHARS == 6)>
+struct BlockDecoder final {
+	static void decode(const uint8_t* __restrict codes, uint64_t numCodes,
+	                   uint32_t* __restrict indicesOut) noexcept
+	{
+		for (uint64_t i = 0; i < numCodes; i++) {
+			indicesOut[i] = ScalarDecoder<Schema>::decode(codes + i * Schema::BYTES_PER_CODE);
+		}
+	}
+};
+
+template<typename Schema>
+struct BlockDecoder<Schema, true> final {
+	static void decode(const uint8_t* __restrict codes, uint64_t numCodes,
+	                   uint32_t* __restrict indicesOut) noexcept
+	{
+		uint64_t numVectorCodes = numCodes & ~uint64_t(7);
+		for (uint64_t i = 0; i < numVectorCodes; i += 8) {
+			const __m256i indices = decode8Codes<Schema>(codes + i * Schema::BYTES_PER_CODE);
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(indicesOut + i), indices);
+		}
+		for (uint64_t i = numVectorCodes; i < numCodes; i++) {
+			indicesOut[i] = ScalarDecoder<Schema>::decode(codes + i * Schema::BYTES_PER_CODE);
+		}
+	}
+};
+
+// Schemas
+// ------------------------------------------------------------------------------------------------
+
+// Swedish plates, "ABC123"
+typedef PlateSchema<CharClass::LETTER, CharClass::LETTER, CharClass::LETTER,
+                    CharClass::DIGIT, CharClass::DIGIT, CharClass::DIGIT> SwedishPlateSchema;
+
+// Swedish plates with a letter in the last position, "ABC12D"
+typedef PlateSchema<CharClass::LETTER, CharClass::LETTER, CharClass::LETTER,
+                    CharClass::DIGIT, CharClass::DIGIT, CharClass::LETTER> SwedishLetterPlateSchema;
+
+// Norwegian plates, "AB12345"
+typedef PlateSchema<CharClass::LETTER, CharClass::LETTER, CharClass::DIGIT, CharClass::DIGIT,
+                    CharClass::DIGIT, CharClass::DIGIT, CharClass::DIGIT> NorwegianPlateSchema;
+
+static_assert(SwedishPlateSchema::MAX_NUMBER_CODES == 17576000, "Must match hardcoded algorithms");
+static_assert(SwedishPlateSchema::NUM_BITSET_BYTES == 2197000, "Must match hardcoded algorithms");
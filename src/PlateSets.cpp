@@ -0,0 +1,257 @@
+// Copyright(c) Peter Hillerstrm(skipifzero.com, peter@hstroem.se)
+
+#include "PlateSets.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#include <immintrin.h>
+#include <malloc.h>
+
+#include "PlateDecoders.hpp"
+
+using namespace std;
+
+// Constants
+// ------------------------------------------------------------------------------------------------
+
+static const uint64_t BYTES_PER_CODE = 8; // Assumes Windows file endings (2 bytes per newline)
+static const uint64_t NUM_SET_BYTES = PLATE_SET_NUM_WORDS * sizeof(uint64_t);
+
+// Larger than in optimizedSmartAlgorithm7() since a batch may be the tail of a file
+static const uint64_t CODE_ALLOCATION_BATCH_SIZE = 65536;
+
+// Plate set
+// ------------------------------------------------------------------------------------------------
+
+bool PlateSet::create() noexcept
+{
+	this->destroy();
+	mWords = static_cast<uint64_t*>(_aligned_malloc(NUM_SET_BYTES, 32));
+	if (mWords == nullptr) return false;
+	memset(mWords, 0, NUM_SET_BYTES);
+	return true;
+}
+
+void PlateSet::destroy() noexcept
+{
+	if (mWords != nullptr) _aligned_free(mWords);
+	mWords = nullptr;
+}
+
+void PlateSet::swap(PlateSet& other) noexcept
+{
+	std::swap(mWords, other.mWords);
+}
+
+uint64_t PlateSet::count() const noexcept
+{
+	uint64_t numCodes = 0;
+	for (uint64_t i = 0; i < PLATE_SET_NUM_WORDS; i++) {
+		numCodes += uint64_t(_mm_popcnt_u64(mWords[i]));
+	}
+	return numCodes;
+}
+
+// Parallel build
+// ------------------------------------------------------------------------------------------------
+
+struct MappedTextFile final {
+	HANDLE file = INVALID_HANDLE_VALUE;
+	HANDLE mapping = NULL;
+	const uint8_t* view = nullptr;
+	uint64_t numCodes = 0;
+	uint64_t firstBatch = 0; // Index of the first batch of this file among the batches of all files
+};
+
+static bool mapTextFile(const char* filePath, MappedTextFile& mappedOut) noexcept
+{
+	mappedOut.file = CreateFile(filePath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+	                            FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (mappedOut.file == INVALID_HANDLE_VALUE) {
+		printf("CreateFile() failed for \"%s\"\n", filePath);
+		return false;
+	}
+	uint64_t fileSize = static_cast<uint64_t>(GetFileSize(mappedOut.file, NULL));
+	mappedOut.numCodes = numCodesInText(fileSize, BYTES_PER_CODE);
+	if (mappedOut.numCodes == 0) return true;
+
+	mappedOut.mapping = CreateFileMapping(mappedOut.file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (!mappedOut.mapping) {
+		printf("CreateFileMapping() failed for \"%s\"\n", filePath);
+		return false;
+	}
+	mappedOut.view = static_cast<const uint8_t*>(MapViewOfFile(mappedOut.mapping, FILE_MAP_READ, 0, 0, fileSize));
+	if (!mappedOut.view) {
+		printf("MapViewOfFile() failed for \"%s\"\n", filePath);
+		return false;
+	}
+	return true;
+}
+
+static void unmapTextFile(MappedTextFile& mapped) noexcept
+{
+	if (mapped.view != nullptr) UnmapViewOfFile(mapped.view);
+	if (mapped.mapping) CloseHandle(mapped.mapping);
+	if (mapped.file != INVALID_HANDLE_VALUE) CloseHandle(mapped.file);
+	mapped = MappedTextFile();
+}
+
+// Sets are shared between threads, bits are set atomically but only if not already set
+static void insertShared(uint64_t* words, uint32_t number) noexcept
+{
+	volatile LONG64* word = reinterpret_cast<volatile LONG64*>(words) + (number >> 6u);
+	LONG64 bitMask = LONG64(uint64_t(1) << (number & 0x0000003Fu));
+	if ((*word & bitMask) == 0) InterlockedOr64(word, bitMask);
+}
+
+static void buildWorkerFunction(const vector<MappedTextFile>* files, vector<PlateSet>* sets,
+                                uint64_t numBatches, atomic_uint64_t* nextBatch) noexcept
+{
+	alignas(32) uint32_t numbers[8];
+	while (true) {
+
+		// Claim batch and find its file, the last file whose first batch is not after it
+		uint64_t batch = nextBatch->fetch_add(1);
+		if (batch >= numBatches) return;
+		auto fileIt = upper_bound(files->begin(), files->end(), batch,
+			[](uint64_t b, const MappedTextFile& f) { return b < f.firstBatch; }) - 1;
+		const MappedTextFile& file = *fileIt;
+		uint64_t* words = (*sets)[fileIt - files->begin()].words();
+
+		uint64_t firstCode = (batch - file.firstBatch) * CODE_ALLOCATION_BATCH_SIZE;
+		uint64_t lastCode = min(firstCode + CODE_ALLOCATION_BATCH_SIZE, file.numCodes);
+		uint64_t i = firstCode;
+		for (; (i + 8) <= lastCode; i += 8) {
+			_mm256_store_si256(reinterpret_cast<__m256i*>(numbers), decode8Avx2<BYTES_PER_CODE>(file.view + i * BYTES_PER_CODE));
+			for (uint32_t number : numbers) {
+				insertShared(words, number);
+			}
+		}
+		for (; i < lastCode; i++) {
+			insertShared(words, decodeScalar(file.view + i * BYTES_PER_CODE));
+		}
+	}
+}
+
+bool buildPlateSets(const vector<const char*>& filePaths, vector<PlateSet>& setsOut, uint32_t numThreads) noexcept
+{
+	// Map all files and allocate sets
+	vector<MappedTextFile> files(filePaths.size());
+	setsOut.clear();
+	setsOut.resize(filePaths.size());
+	bool success = true;
+	uint64_t numBatches = 0;
+	for (size_t i = 0; i < filePaths.size() && success; i++) {
+		success = mapTextFile(filePaths[i], files[i]) && setsOut[i].create();
+		files[i].firstBatch = numBatches;
+		numBatches += (files[i].numCodes + CODE_ALLOCATION_BATCH_SIZE - 1) / CODE_ALLOCATION_BATCH_SIZE;
+	}
+
+	// Scan all files in parallel
+	if (success) {
+		atomic_uint64_t nextBatch(0);
+		vector<thread> threads;
+		for (uint32_t i = 1; i < numThreads; i++) {
+			threads.emplace_back(buildWorkerFunction, &files, &setsOut, numBatches, &nextBatch);
+		}
+		buildWorkerFunction(&files, &setsOut, numBatches, &nextBatch);
+		for (thread& t : threads) {
+			t.join();
+		}
+	}
+
+	for (MappedTextFile& file : files) {
+		unmapTextFile(file);
+	}
+	return success;
+}
+
+// Set operations
+// ------------------------------------------------------------------------------------------------
+
+template<SetOperation OP>
+static __m256i combineVectors(__m256i a, __m256i b) noexcept
+{
+	return OP == SetOperation::AND ? _mm256_and_si256(a, b) :
+	       OP == SetOperation::ANDNOT ? _mm256_andnot_si256(b, a) :
+	       _mm256_or_si256(a, b);
+}
+
+template<SetOperation OP>
+static uint64_t combineWords(uint64_t a, uint64_t b) noexcept
+{
+	return OP == SetOperation::AND ? (a & b) : OP == SetOperation::ANDNOT ? (a & ~b) : (a | b);
+}
+
+static uint64_t popcount256(__m256i v) noexcept
+{
+	return uint64_t(_mm_popcnt_u64(uint64_t(_mm256_extract_epi64(v, 0)))) +
+	       uint64_t(_mm_popcnt_u64(uint64_t(_mm256_extract_epi64(v, 1)))) +
+	       uint64_t(_mm_popcnt_u64(uint64_t(_mm256_extract_epi64(v, 2)))) +
+	       uint64_t(_mm_popcnt_u64(uint64_t(_mm256_extract_epi64(v, 3))));
+}
+
+// Combines a and b, storing the result in out if not null. Returns the number of set bits. Out may
+// be a or b, each word is read before the result is stored to it, so nothing is __restrict.
+template<SetOperation OP>
+static uint64_t combine(const uint64_t* a, const uint64_t* b, uint64_t* out) noexcept
+{
+	uint64_t numCodes = 0;
+	const uint64_t numVectorWords = PLATE_SET_NUM_WORDS & ~uint64_t(3);
+	for (uint64_t i = 0; i < numVectorWords; i += 4) {
+		__m256i result = combineVectors<OP>(_mm256_load_si256(reinterpret_cast<const __m256i*>(a + i)),
+		                                    _mm256_load_si256(reinterpret_cast<const __m256i*>(b + i)));
+		if (out != nullptr) _mm256_store_si256(reinterpret_cast<__m256i*>(out + i), result);
+		numCodes += popcount256(result);
+	}
+	for (uint64_t i = numVectorWords; i < PLATE_SET_NUM_WORDS; i++) {
+		uint64_t result = combineWords<OP>(a[i], b[i]);
+		if (out != nullptr) out[i] = result;
+		numCodes += uint64_t(_mm_popcnt_u64(result));
+	}
+	return numCodes;
+}
+
+static uint64_t combineDispatch(SetOperation op, const uint64_t* a, const uint64_t* b, uint64_t* out) noexcept
+{
+	switch (op) {
+	case SetOperation::AND: return combine<SetOperation::AND>(a, b, out);
+	case SetOperation::ANDNOT: return combine<SetOperation::ANDNOT>(a, b, out);
+	case SetOperation::OR: return combine<SetOperation::OR>(a, b, out);
+	}
+	return 0;
+}
+
+uint64_t combinePlateSets(SetOperation op, const PlateSet& a, const PlateSet& b, PlateSet& out) noexcept
+{
+	return combineDispatch(op, a.words(), b.words(), out.words());
+}
+
+uint64_t countCombined(SetOperation op, const PlateSet& a, const PlateSet& b) noexcept
+{
+	return combineDispatch(op, a.words(), b.words(), nullptr);
+}
+
+// Set bit iterator
+// ------------------------------------------------------------------------------------------------
+
+bool SetBitIterator::next(uint32_t& numberOut) noexcept
+{
+	while (mWord == 0) {
+		mWordIndex += 1;
+		if (mWordIndex >= PLATE_SET_NUM_WORDS) return false;
+		mWord = mWords[mWordIndex];
+	}
+	numberOut = uint32_t(mWordIndex * 64 + _tzcnt_u64(mWord));
+	mWord = _blsr_u64(mWord);
+	return true;
+}
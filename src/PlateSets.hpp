@@ -0,0 +1,88 @@
+// Copyright(c) Peter Hillerstrm(skipifzero.com, peter@hstroem.se)
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// Plate sets
+// ------------------------------------------------------------------------------------------------
+
+// A plate set is a bitset over the 17576000 codes, as used by the algorithms, with operations for
+// comparing the codes of different files. E.g. the plates seen in both region A and region B
+// (AND), or in today's file but not in yesterday's (ANDNOT).
+
+static const uint64_t PLATE_SET_NUM_WORDS = 17576000 / 64;
+
+class PlateSet final {
+public:
+	PlateSet() noexcept = default;
+	PlateSet(const PlateSet&) = delete;
+	PlateSet& operator= (const PlateSet&) = delete;
+	PlateSet(PlateSet&& other) noexcept { this->swap(other); }
+	PlateSet& operator= (PlateSet&& other) noexcept { this->swap(other); return *this; }
+	~PlateSet() noexcept { this->destroy(); }
+
+	// Allocates an empty set
+	bool create() noexcept;
+	void destroy() noexcept;
+	void swap(PlateSet& other) noexcept;
+
+	bool isValid() const noexcept { return mWords != nullptr; }
+	uint64_t* words() noexcept { return mWords; }
+	const uint64_t* words() const noexcept { return mWords; }
+
+	bool contains(uint32_t number) const noexcept
+	{
+		return (mWords[number >> 6u] & (uint64_t(1) << (number & 0x0000003Fu))) != uint64_t(0);
+	}
+
+	void insert(uint32_t number) noexcept
+	{
+		mWords[number >> 6u] |= uint64_t(1) << (number & 0x0000003Fu);
+	}
+
+	// Number of codes in the set
+	uint64_t count() const noexcept;
+
+private:
+	uint64_t* mWords = nullptr;
+};
+
+// Builds one set per text file (8 bytes per code). All files are scanned in parallel by a shared
+// pool of threads claiming batches of codes from any file, as in optimizedSmartAlgorithm7().
+bool buildPlateSets(const std::vector<const char*>& filePaths, std::vector<PlateSet>& setsOut,
+                    uint32_t numThreads = 3) noexcept;
+
+// Set operations
+// ------------------------------------------------------------------------------------------------
+
+enum class SetOperation : uint8_t {
+	AND, // Codes in both sets
+	ANDNOT, // Codes in the first set but not in the second
+	OR // Codes in any of the sets
+};
+
+// out = a <op> b using AVX2, returns the number of codes in the result. out may be a or b.
+uint64_t combinePlateSets(SetOperation op, const PlateSet& a, const PlateSet& b, PlateSet& out) noexcept;
+
+// Number of codes in a <op> b, without storing the result
+uint64_t countCombined(SetOperation op, const PlateSet& a, const PlateSet& b) noexcept;
+
+// Set bit iterator
+// ------------------------------------------------------------------------------------------------
+
+// Iterates over the codes in a set in ascending order, skipping zero words and finding each set
+// bit with tzcnt
+class SetBitIterator final {
+public:
+	explicit SetBitIterator(const PlateSet& set) noexcept : mWords(set.words()), mWord(set.words()[0]) {}
+
+	// Writes the next code in the set to numberOut, returns false when there are no more codes
+	bool next(uint32_t& numberOut) noexcept;
+
+private:
+	const uint64_t* mWords;
+	uint64_t mWordIndex = 0;
+	uint64_t mWord; // Bits of the current word not yet returned
+};
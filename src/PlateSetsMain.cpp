@@ -0,0 +1,72 @@
+// Copyright(c) Peter Hillerstrm(skipifzero.com, peter@hstroem.se)
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "PlateDecoders.hpp"
+#include "PlateSets.hpp"
+
+// Main
+// ------------------------------------------------------------------------------------------------
+
+int main(int argc, char* argv[])
+{
+	// Parse operation, optional list flag and at least two file paths
+	const char* USAGE = "Invalid arguments, proper usage: \"PlateSets <and|andnot|or> [--list] <file A> <file B> [more files]\"\n";
+	if (argc < 4) {
+		printf("%s", USAGE);
+		return 1;
+	}
+	SetOperation op;
+	if (strcmp(argv[1], "and") == 0) op = SetOperation::AND;
+	else if (strcmp(argv[1], "andnot") == 0) op = SetOperation::ANDNOT;
+	else if (strcmp(argv[1], "or") == 0) op = SetOperation::OR;
+	else {
+		printf("%s", USAGE);
+		return 1;
+	}
+	bool listCodes = strcmp(argv[2], "--list") == 0;
+	int firstPathArg = listCodes ? 3 : 2;
+	if ((argc - firstPathArg) < 2) {
+		printf("%s", USAGE);
+		return 1;
+	}
+	std::vector<const char*> filePaths(argv + firstPathArg, argv + argc);
+
+	// Build a set per file
+	std::vector<PlateSet> sets;
+	if (!buildPlateSets(filePaths, sets)) {
+		printf("Building sets failed\n");
+		return 1;
+	}
+
+	// Fold left, ((A op B) op C) ...
+	// Only the last combination is counted without being stored, unless the codes are listed
+	uint64_t numCodes = 0;
+	for (size_t i = 1; i < sets.size(); i++) {
+		bool last = (i + 1) == sets.size();
+		if (last && !listCodes) numCodes = countCombined(op, sets[0], sets[i]);
+		else numCodes = combinePlateSets(op, sets[0], sets[i], sets[0]);
+	}
+
+	// Print result
+	if (listCodes) {
+		SetBitIterator it(sets[0]);
+		uint32_t number = 0;
+		char code[8] = {};
+		code[6] = '\n';
+		while (it.next(number)) {
+			encodeScalar(number, reinterpret_cast<uint8_t*>(code));
+			fputs(code, stdout);
+		}
+	}
+	else {
+		printf("%llu\n", static_cast<unsigned long long>(numCodes));
+	}
+
+	// Flush output and exit program
+	fflush(stdout);
+	return 0;
+}
@@ -0,0 +1,375 @@
+// Copyright(c) Peter Hillerstrm(skipifzero.com, peter@hstroem.se)
+
+#include "PrefetchAlgorithm.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#include <malloc.h>
+
+#include <xmmintrin.h>
+
+#include "PlateDecoders.hpp"
+
+using namespace std;
+
+// Constants
+// ------------------------------------------------------------------------------------------------
+
+static const uint64_t MAX_NUMBER_CODES = 17576000;
+static const uint64_t BYTES_PER_CODE = 8; // Assumes Windows file endings (2 bytes per newline)
+static const uint64_t NUM_BITSET_BYTES = (MAX_NUMBER_CODES / 8);
+
+static const uint64_t NUM_THREADS = 3;
+static const uint64_t CODE_ALLOCATION_BATCH_SIZE = 4096;
+static const uint64_t NUM_CODES_MULTI_THREADED_THRESHOLD = 600000;
+
+// Number of codes decoded (and their bitset chunks prefetched) ahead of the code currently being
+// tested. Should be large enough to cover memory latency, but small enough that the prefetched
+// lines are not evicted before they are used. Must be a power of two.
+static const uint64_t PREFETCH_DISTANCE = 16;
+static_assert((PREFETCH_DISTANCE & (PREFETCH_DISTANCE - 1)) == 0, "Must be power of two");
+
+// Pipelined search
+// ------------------------------------------------------------------------------------------------
+
+static uint32_t decodeCode(const uint8_t* __restrict code) noexcept
+{
+	uint8_t let3 = code[0];
+	uint8_t let2 = code[1];
+	uint8_t let1 = code[2];
+	uint8_t no3 = code[3];
+	uint8_t no2 = code[4];
+	uint8_t no1 = code[5];
+
+	// Calculate corresponding number for code
+	return uint32_t(let3 - 'A') * 676000u +
+	       uint32_t(let2 - 'A') * 26000u +
+	       uint32_t(let1 - 'A') * 1000u +
+	       uint32_t(no3 - '0') * 100u +
+	       uint32_t(no2 - '0') * 10u +
+	       uint32_t(no1 - '0');
+}
+
+// Checks the codes in range [firstCode, lastCode) against and inserts them into the bitset.
+// Codes are decoded PREFETCH_DISTANCE codes ahead so their bitset chunks can be prefetched, but
+// the test-and-set is still performed in file order. I.e. it returns at exactly the same code as
+// the non-pipelined loop would.
+static bool pipelinedSearch(const uint8_t* __restrict fileView,
+                            uint64_t* __restrict isFoundBitset,
+                            size_t firstCode,
+                            size_t lastCode) noexcept
+{
+	// Ring buffer of decoded numbers that have been prefetched but not yet tested
+	uint32_t pipeline[PREFETCH_DISTANCE];
+
+	// Fill pipeline
+	size_t numAhead = min(size_t(PREFETCH_DISTANCE), lastCode - firstCode);
+	for (size_t i = 0; i < numAhead; i++) {
+		uint32_t number = decodeCode(fileView + (firstCode + i) * BYTES_PER_CODE);
+		_mm_prefetch(reinterpret_cast<const char*>(isFoundBitset + (number >> 6u)), _MM_HINT_T0);
+		pipeline[i] = number;
+	}
+
+	for (size_t i = firstCode; i < lastCode; i++) {
+		uint32_t slot = uint32_t(i - firstCode) & uint32_t(PREFETCH_DISTANCE - 1);
+		uint32_t number = pipeline[slot];
+
+		// Decode and prefetch code PREFETCH_DISTANCE ahead, reusing the slot just emptied
+		size_t aheadIndex = i + PREFETCH_DISTANCE;
+		if (aheadIndex < lastCode) {
+			uint32_t aheadNumber = decodeCode(fileView + aheadIndex * BYTES_PER_CODE);
+			_mm_prefetch(reinterpret_cast<const char*>(isFoundBitset + (aheadNumber >> 6u)), _MM_HINT_T0);
+			pipeline[slot] = aheadNumber;
+		}
+
+		uint32_t bitsetChunkIndex = number >> 6u; // number / 64;
+		uint32_t bitIndex = number & 0x0000003Fu; // number % 64;
+
+		uint64_t chunk = isFoundBitset[bitsetChunkIndex];
+		uint64_t bitMask = uint64_t(1) << bitIndex;
+
+		if ((bitMask & chunk) != uint64_t(0)) {
+			return true;
+		}
+
+		chunk = bitMask | chunk;
+		isFoundBitset[bitsetChunkIndex] = chunk;
+	}
+
+	return false;
+}
+
+// Single threaded variant
+// ------------------------------------------------------------------------------------------------
+
+static bool singleThreadedSearch(const uint8_t* __restrict fileView, uint64_t numCodes) noexcept
+{
+	// Allocate bitset buffer for whether a number is found or not, and clear it
+	uint64_t* isFoundBitset = static_cast<uint64_t*>(_aligned_malloc(NUM_BITSET_BYTES, 32));
+	memset(isFoundBitset, 0, NUM_BITSET_BYTES);
+
+	// Check all codes in file
+	bool foundCopy = pipelinedSearch(fileView, isFoundBitset, 0, numCodes);
+
+	// Free allocated bitset memory
+	_aligned_free(isFoundBitset);
+
+	// Return result
+	return foundCopy;
+}
+
+// Multi-threaded variant
+// ------------------------------------------------------------------------------------------------
+
+static bool mergeBitsets(uint64_t* bitsets[NUM_THREADS]) noexcept
+{
+	if (NUM_THREADS == 2) {
+		for (size_t i = 0; i < (NUM_BITSET_BYTES / sizeof(uint64_t)); i++) {
+			uint64_t b1 = bitsets[0][i];
+			uint64_t b2 = bitsets[1][i];
+			if ((b1 & b2) != uint64_t(0)) return true;
+		}
+	}
+
+	else if (NUM_THREADS == 3) {
+		for (size_t i = 0; i < (NUM_BITSET_BYTES / sizeof(uint64_t)); i++) {
+			uint64_t b1 = bitsets[0][i];
+			uint64_t b2 = bitsets[1][i];
+			uint64_t b3 = bitsets[2][i];
+			bool found = ((b1 & b2) | (b1 & b3) | (b2 & b3)) != uint64_t(0);
+			if (found) return true;
+		}
+	}
+
+	else if (NUM_THREADS == 4) {
+		for (size_t i = 0; i < (NUM_BITSET_BYTES / sizeof(uint64_t)); i++) {
+			uint64_t b1 = bitsets[0][i];
+			uint64_t b2 = bitsets[1][i];
+			uint64_t b3 = bitsets[2][i];
+			uint64_t b4 = bitsets[3][i];
+			
+			bool found = ((b1 & b2) | (b1 & b3) | (b1 & b4) | (b2 & b3) | (b2 & b4) | (b3 & b4)) != uint64_t(0);
+			if (found) {
+				return true;
+			}
+		}
+	}
+		
+	else if (NUM_THREADS == 8) {
+		for (size_t i = 0; i < (NUM_BITSET_BYTES / sizeof(uint64_t)); i++) {
+			uint64_t b1 = bitsets[0][i];
+			uint64_t b2 = bitsets[1][i];
+			uint64_t b3 = bitsets[2][i];
+			uint64_t b4 = bitsets[3][i];
+			uint64_t b5 = bitsets[4][i];
+			uint64_t b6 = bitsets[5][i];
+			uint64_t b7 = bitsets[6][i];
+			uint64_t b8 = bitsets[7][i];
+
+			uint64_t val =
+			(b1 & b2) |
+			(b1 & b3) |
+			(b1 & b4) |
+			(b1 & b5) |
+			(b1 & b6) |
+			(b1 & b7) |
+			(b1 & b8) |
+
+			(b2 & b3) |
+			(b2 & b4) |
+			(b2 & b5) |
+			(b2 & b6) |
+			(b2 & b7) |
+			(b2 & b8) |
+			
+			(b3 & b4) |
+			(b3 & b5) |
+			(b3 & b6) |
+			(b3 & b7) |
+			(b3 & b8) |
+
+			(b4 & b5) |
+			(b4 & b6) |
+			(b4 & b7) |
+			(b4 & b8) |
+			
+			(b5 & b6) |
+			(b5 & b7) |
+			(b5 & b8) |
+
+			(b6 & b7) |
+			(b6 & b8) |
+
+			(b7 & b8);
+
+			if (val != uint64_t(0)) {
+				return true;
+			}
+		}
+	}
+
+	else {
+		printf("FATAL ERROR: NUM_THREADS may only be 2, 3, 4 or 8\n");
+	}
+
+	return false;
+}
+
+static void workerFunction(const uint8_t* __restrict fileView,
+                           uint64_t* __restrict isFoundBitset,
+                           bool* foundCopy,
+                           size_t numCodes,
+                           atomic_size_t* nextFreeCodeIndex) noexcept
+{
+	// Clear bitset
+	memset(isFoundBitset, 0, NUM_BITSET_BYTES);
+
+	while (true) {
+
+		// Allocate codes from shared array
+		size_t codeIndex = atomic_fetch_add(nextFreeCodeIndex, CODE_ALLOCATION_BATCH_SIZE);
+		if (codeIndex >= numCodes) return;
+		size_t codesToCheck = min(size_t(CODE_ALLOCATION_BATCH_SIZE), numCodes - codeIndex);
+		
+		// Check all allocated codes
+		if (pipelinedSearch(fileView, isFoundBitset, codeIndex, codeIndex + codesToCheck)) {
+
+			// Allocate rest of rays so the other threads can stop
+			atomic_fetch_add(nextFreeCodeIndex, numCodes);
+
+			// Signal that the copy is found and exit thread
+			*foundCopy = true;
+			return;
+		}
+	}
+}
+
+static bool multiThreadedSearch(const uint8_t* __restrict fileView, uint64_t numCodes) noexcept
+{
+	// Variable containing whether a copy was found or not
+	bool foundCopy = false;
+
+	// Counter used for allocating codes
+	atomic_size_t nextFreeCodeIndex = 0;
+
+	// Start threads
+	uint64_t* bitsets[NUM_THREADS];
+	thread threads[NUM_THREADS];
+	for (size_t i = 0; i < NUM_THREADS; i++) {
+
+		// Allocate memory for bitset, cleared in worker function
+		bitsets[i] = static_cast<uint64_t*>(_aligned_malloc(NUM_BITSET_BYTES, 32));
+
+		// Start worker thread
+		threads[i] = thread(workerFunction, fileView, bitsets[i], &foundCopy, numCodes, &nextFreeCodeIndex);
+	}
+
+	// Wait for threads to finish working
+	for (thread& t : threads) {
+		t.join();
+	}
+
+	// Compare all threads tables
+	if (!foundCopy) {
+		foundCopy = mergeBitsets(bitsets);
+	}
+
+	// Free memory
+	for (uint64_t* bitset : bitsets) {
+		_aligned_free(bitset);
+	}
+
+	// Return result
+	return foundCopy;
+}
+
+// Exposed function
+// ------------------------------------------------------------------------------------------------
+
+bool prefetchAlgorithm(const char* filePath) noexcept
+{
+	// Open file
+	HANDLE file = CreateFile(filePath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+	                         FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (!file) {
+		printf("CreateFile() failed\n");
+		return false;
+	}
+
+	// Get size of file
+	uint64_t fileSize = static_cast<uint64_t>(GetFileSize(file, NULL));
+
+	// Large file fast path
+	// There are a total of 17 576 000 different codes. If the file contains more codes than that
+	// it must also by definition contain a copy.
+	if (fileSize >= ((MAX_NUMBER_CODES + 1) * BYTES_PER_CODE)) {
+		CloseHandle(file);
+		return true;
+	}
+
+	// Create mapped file
+	HANDLE mappedFile = CreateFileMapping(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (!mappedFile) {
+		printf("CreateFileMapping() failed\n");
+		CloseHandle(file);
+		return false;
+	}
+
+	// Create mapped file view
+	uint64_t offset = 0;
+	uint32_t offsetLow  = uint32_t(offset & uint64_t(0xFFFFFFFF));
+	uint32_t offsetHigh = uint32_t(offset >> uint64_t(32));
+	uint64_t numBytesToMap = fileSize;
+	void* fileView = MapViewOfFile(mappedFile, FILE_MAP_READ, offsetLow, offsetHigh, numBytesToMap);
+	if (!fileView) {
+		printf("MapViewOfFile() failed\n");
+		CloseHandle(mappedFile);
+		CloseHandle(file);
+		return false;
+	}
+
+	// Result variable
+	bool foundCopy = false;
+
+	// Single threaded path
+	uint64_t numCodes = numCodesInText(fileSize, BYTES_PER_CODE);
+	if (numCodes <= NUM_CODES_MULTI_THREADED_THRESHOLD) {
+		foundCopy = singleThreadedSearch(static_cast<const uint8_t*>(fileView), numCodes);
+	}
+	
+	// Multi-threaded path
+	else {
+		foundCopy = multiThreadedSearch(static_cast<const uint8_t*>(fileView), numCodes);
+	}
+
+	// Unmap mapped file view
+	if (!UnmapViewOfFile(fileView)) {
+		printf("UnmapViewOfFile() failed\n");
+		CloseHandle(mappedFile);
+		CloseHandle(file);
+		return false;
+	}
+
+	// Close mapped file
+	if (!CloseHandle(mappedFile)) {
+		printf("CloseHandle() failed for mappedFile\n");
+		return false;
+	}
+
+	// Close file
+	if (!CloseHandle(file)) {
+		printf("CloseHandle() failed for file\n");
+		return false;
+	}
+
+	// Return result
+	return foundCopy;
+}
@@ -0,0 +1,5 @@
+// Copyright(c) Peter Hillerstrm(skipifzero.com, peter@hstroem.se)
+
+#pragma once
+
+bool prefetchAlgorithm(const char* filePath) noexcept;
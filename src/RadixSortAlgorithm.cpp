@@ -0,0 +1,460 @@
+// Copyright(c) Peter Hillerstrm(skipifzero.com, peter@hstroem.se)
+
+#include "RadixSortAlgorithm.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#include <immintrin.h>
+#include <malloc.h>
+
+#include "PlateDecoders.hpp"
+
+using namespace std;
+
+// Constants
+// ------------------------------------------------------------------------------------------------
+
+static const uint64_t MAX_NUMBER_CODES = 17576000;
+static const uint64_t BYTES_PER_CODE = 8; // Assumes Windows file endings (2 bytes per newline)
+
+static const uint64_t NUM_THREADS = 3;
+static const uint64_t NUM_CODES_MULTI_THREADED_THRESHOLD = 600000;
+
+// The numbers are in [0, 17576000) which fits in 25 bits, sorted in 3 passes of 9, 8 and 8 bits
+static const uint32_t NUM_PASSES = 3;
+static const uint32_t PASS_SHIFTS[NUM_PASSES] = { 0, 9, 17 };
+static const uint32_t PASS_NUM_BITS[NUM_PASSES] = { 9, 8, 8 };
+static const uint32_t MAX_NUM_BUCKETS = 512;
+static_assert(MAX_NUMBER_CODES <= (uint64_t(1) << 25), "Numbers must fit in 25 bits");
+
+// Number of numbers buffered per bucket before they are written to the output array, one cache
+// line. With 512 buckets the buffers are 32 KiB per thread.
+static const uint32_t WRITE_COMBINE_SIZE = 16;
+
+// Parallel helpers
+// ------------------------------------------------------------------------------------------------
+
+// Runs function(threadIndex) for each thread index in [0, numThreads), index 0 runs on the calling
+// thread
+template<typename Function>
+static void parallelFor(uint64_t numThreads, const Function& function) noexcept
+{
+	thread threads[NUM_THREADS];
+	for (uint64_t i = 1; i < numThreads; i++) {
+		threads[i] = thread(function, i);
+	}
+	function(uint64_t(0));
+	for (uint64_t i = 1; i < numThreads; i++) {
+		threads[i].join();
+	}
+}
+
+// The range [first, last) of numbers each thread is responsible for
+static void threadRange(uint64_t threadIndex, uint64_t numThreads, uint64_t numNumbers,
+                        uint64_t& firstOut, uint64_t& lastOut) noexcept
+{
+	uint64_t numbersPerThread = (numNumbers + numThreads - 1) / numThreads;
+	firstOut = min(threadIndex * numbersPerThread, numNumbers);
+	lastOut = min(firstOut + numbersPerThread, numNumbers);
+}
+
+// Decoding
+// ------------------------------------------------------------------------------------------------
+
+static void decodeRange(const uint8_t* __restrict fileView, uint32_t* __restrict numbersOut,
+                        uint64_t first, uint64_t last) noexcept
+{
+	for (uint64_t i = first; i < last; i++) {
+		const uint8_t* code = fileView + i * BYTES_PER_CODE;
+		numbersOut[i] = uint32_t(code[0] - 'A') * 676000u +
+		                uint32_t(code[1] - 'A') * 26000u +
+		                uint32_t(code[2] - 'A') * 1000u +
+		                uint32_t(code[3] - '0') * 100u +
+		                uint32_t(code[4] - '0') * 10u +
+		                uint32_t(code[5] - '0');
+	}
+}
+
+// Radix sort
+// ------------------------------------------------------------------------------------------------
+
+struct alignas(64) ThreadHistogram final {
+	uint64_t counts[MAX_NUM_BUCKETS];
+};
+
+struct alignas(64) WriteCombineBuffers final {
+	uint32_t numbers[MAX_NUM_BUCKETS][WRITE_COMBINE_SIZE];
+	uint32_t sizes[MAX_NUM_BUCKETS];
+};
+
+static void histogramRange(const uint32_t* __restrict numbers, uint64_t first, uint64_t last,
+                           uint32_t shift, uint32_t mask, ThreadHistogram& histogram) noexcept
+{
+	memset(histogram.counts, 0, sizeof(histogram.counts));
+	for (uint64_t i = first; i < last; i++) {
+		histogram.counts[(numbers[i] >> shift) & mask] += 1;
+	}
+}
+
+// Converts each thread's counts into the offset in the output array where its numbers for each
+// bucket start. Buckets are laid out in order, and within a bucket the threads are in order, which
+// keeps the sort stable.
+static void prefixSumHistograms(ThreadHistogram* histograms, uint64_t numThreads,
+                                uint32_t numBuckets) noexcept
+{
+	uint64_t offset = 0;
+	for (uint32_t bucket = 0; bucket < numBuckets; bucket++) {
+		for (uint64_t t = 0; t < numThreads; t++) {
+			uint64_t count = histograms[t].counts[bucket];
+			histograms[t].counts[bucket] = offset;
+			offset += count;
+		}
+	}
+}
+
+// Scatters the numbers in [first, last) to their buckets in the output array. Numbers are first
+// collected in a cache line sized buffer per bucket and written out a full line at a time, so each
+// store to the output array doesn't touch a different cache line.
+static void scatterRange(const uint32_t* __restrict numbers, uint32_t* __restrict numbersOut,
+                         uint64_t first, uint64_t last, uint32_t shift, uint32_t mask,
+                         ThreadHistogram& offsets, WriteCombineBuffers& buffers) noexcept
+{
+	memset(buffers.sizes, 0, sizeof(buffers.sizes));
+
+	for (uint64_t i = first; i < last; i++) {
+		uint32_t number = numbers[i];
+		uint32_t bucket = (number >> shift) & mask;
+
+		uint32_t size = buffers.sizes[bucket];
+		buffers.numbers[bucket][size] = number;
+		size += 1;
+
+		if (size == WRITE_COMBINE_SIZE) {
+			memcpy(numbersOut + offsets.counts[bucket], buffers.numbers[bucket], sizeof(buffers.numbers[bucket]));
+			offsets.counts[bucket] += WRITE_COMBINE_SIZE;
+			size = 0;
+		}
+		buffers.sizes[bucket] = size;
+	}
+
+	// Flush partially filled buffers
+	for (uint32_t bucket = 0; bucket <= mask; bucket++) {
+		uint32_t size = buffers.sizes[bucket];
+		memcpy(numbersOut + offsets.counts[bucket], buffers.numbers[bucket], size * sizeof(uint32_t));
+		offsets.counts[bucket] += size;
+	}
+}
+
+// Sorts numbers using tmpNumbers as scratch space, the result ends up in tmpNumbers since there is
+// an odd number of passes
+static void radixSort(uint32_t* numbers, uint32_t* tmpNumbers, uint64_t numNumbers,
+                      uint64_t numThreads) noexcept
+{
+	ThreadHistogram* histograms =
+		static_cast<ThreadHistogram*>(_aligned_malloc(NUM_THREADS * sizeof(ThreadHistogram), 64));
+	WriteCombineBuffers* buffers =
+		static_cast<WriteCombineBuffers*>(_aligned_malloc(NUM_THREADS * sizeof(WriteCombineBuffers), 64));
+
+	uint32_t* src = numbers;
+	uint32_t* dst = tmpNumbers;
+	for (uint32_t pass = 0; pass < NUM_PASSES; pass++) {
+		const uint32_t shift = PASS_SHIFTS[pass];
+		const uint32_t numBuckets = uint32_t(1) << PASS_NUM_BITS[pass];
+		const uint32_t mask = numBuckets - 1;
+
+		// Per thread histograms of their part of the array
+		parallelFor(numThreads, [&](uint64_t threadIndex) {
+			uint64_t first, last;
+			threadRange(threadIndex, numThreads, numNumbers, first, last);
+			histogramRange(src, first, last, shift, mask, histograms[threadIndex]);
+		});
+
+		prefixSumHistograms(histograms, numThreads, numBuckets);
+
+		// Each thread scatters its part of the array to its own slots in each bucket
+		parallelFor(numThreads, [&](uint64_t threadIndex) {
+			uint64_t first, last;
+			threadRange(threadIndex, numThreads, numNumbers, first, last);
+			scatterRange(src, dst, first, last, shift, mask, histograms[threadIndex],
+			             buffers[threadIndex]);
+		});
+
+		swap(src, dst);
+	}
+
+	_aligned_free(buffers);
+	_aligned_free(histograms);
+}
+
+// Adjacent scan
+// ------------------------------------------------------------------------------------------------
+
+// Checks whether any number in [first, last) is equal to the number after it, 8 at a time
+static bool adjacentScan(const uint32_t* __restrict numbers, uint64_t first, uint64_t last) noexcept
+{
+	uint64_t i = first;
+	for (; (i + 8) < last; i += 8) {
+		const __m256i current = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(numbers + i));
+		const __m256i next = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(numbers + i + 1));
+		const __m256i equal = _mm256_cmpeq_epi32(current, next);
+		if (!_mm256_testz_si256(equal, equal)) {
+			return true;
+		}
+	}
+	for (; (i + 1) < last; i++) {
+		if (numbers[i] == numbers[i + 1]) {
+			return true;
+		}
+	}
+	return false;
+}
+
+// Groups
+// ------------------------------------------------------------------------------------------------
+
+struct alignas(64) ThreadGroupCounts final {
+	uint64_t numUnique;
+	uint64_t numDuplicates;
+};
+
+// Visits the runs of equal numbers that start in [first, last), a run may continue past last. Only
+// counts the runs if the outputs are null, otherwise writes them.
+static void groupRange(const uint32_t* __restrict numbers, uint64_t numNumbers, uint64_t first,
+                       uint64_t last, uint32_t* __restrict uniqueOut,
+                       DuplicateGroup* __restrict duplicatesOut, ThreadGroupCounts& counts) noexcept
+{
+	// Skip the end of a run started before first
+	uint64_t i = first;
+	if (first > 0) {
+		while (i < last && numbers[i] == numbers[first - 1]) i++;
+	}
+
+	uint64_t numUnique = 0;
+	uint64_t numDuplicates = 0;
+	while (i < last) {
+		uint32_t number = numbers[i];
+		uint64_t runEnd = i + 1;
+		while (runEnd < numNumbers && numbers[runEnd] == number) runEnd++;
+		if (uniqueOut != nullptr) uniqueOut[numUnique] = number;
+		numUnique += 1;
+		if ((runEnd - i) > 1) {
+			if (duplicatesOut != nullptr) duplicatesOut[numDuplicates] = { number, runEnd - i };
+			numDuplicates += 1;
+		}
+		i = runEnd;
+	}
+	counts.numUnique = numUnique;
+	counts.numDuplicates = numDuplicates;
+}
+
+// Writes the runs of the sorted numbers, each thread counts its runs first so it knows where in the
+// outputs to write them
+static void groupSorted(const uint32_t* numbers, uint64_t numNumbers, uint64_t numThreads,
+                        vector<uint32_t>& uniqueOut, vector<DuplicateGroup>& duplicatesOut) noexcept
+{
+	ThreadGroupCounts counts[NUM_THREADS];
+	parallelFor(numThreads, [&](uint64_t threadIndex) {
+		uint64_t first, last;
+		threadRange(threadIndex, numThreads, numNumbers, first, last);
+		groupRange(numbers, numNumbers, first, last, nullptr, nullptr, counts[threadIndex]);
+	});
+
+	uint64_t uniqueOffsets[NUM_THREADS];
+	uint64_t duplicateOffsets[NUM_THREADS];
+	uint64_t numUnique = 0;
+	uint64_t numDuplicates = 0;
+	for (uint64_t t = 0; t < numThreads; t++) {
+		uniqueOffsets[t] = numUnique;
+		duplicateOffsets[t] = numDuplicates;
+		numUnique += counts[t].numUnique;
+		numDuplicates += counts[t].numDuplicates;
+	}
+	uniqueOut.resize(numUnique);
+	duplicatesOut.resize(numDuplicates);
+
+	parallelFor(numThreads, [&](uint64_t threadIndex) {
+		uint64_t first, last;
+		threadRange(threadIndex, numThreads, numNumbers, first, last);
+		groupRange(numbers, numNumbers, first, last, uniqueOut.data() + uniqueOffsets[threadIndex],
+		           duplicatesOut.data() + duplicateOffsets[threadIndex], counts[threadIndex]);
+	});
+}
+
+// Search
+// ------------------------------------------------------------------------------------------------
+
+// Decodes and sorts all codes, returns the sorted numbers which must be freed with _aligned_free()
+static uint32_t* decodeAndSort(const uint8_t* __restrict fileView, uint64_t numCodes,
+                               uint64_t numThreads) noexcept
+{
+	// Allocate numbers and scratch space for sorting
+	const uint64_t numArrayBytes = numCodes * sizeof(uint32_t);
+	uint32_t* numbers = static_cast<uint32_t*>(_aligned_malloc(numArrayBytes, 64));
+	uint32_t* tmpNumbers = static_cast<uint32_t*>(_aligned_malloc(numArrayBytes, 64));
+
+	// Decode all codes
+	parallelFor(numThreads, [&](uint64_t threadIndex) {
+		uint64_t first, last;
+		threadRange(threadIndex, numThreads, numCodes, first, last);
+		decodeRange(fileView, numbers, first, last);
+	});
+
+	// Sort, result ends up in tmpNumbers
+	static_assert((NUM_PASSES % 2) == 1, "Sorted result assumed to be in tmpNumbers");
+	radixSort(numbers, tmpNumbers, numCodes, numThreads);
+	_aligned_free(numbers);
+	return tmpNumbers;
+}
+
+static bool radixSortSearch(const uint8_t* __restrict fileView, uint64_t numCodes,
+                            uint64_t numThreads) noexcept
+{
+	uint32_t* sortedNumbers = decodeAndSort(fileView, numCodes, numThreads);
+
+	// Look for copies, the ranges overlap by one number so pairs on thread boundaries are checked
+	atomic_bool foundCopy(false);
+	parallelFor(numThreads, [&](uint64_t threadIndex) {
+		uint64_t first, last;
+		threadRange(threadIndex, numThreads, numCodes, first, last);
+		if (adjacentScan(sortedNumbers, first, min(last + 1, numCodes))) {
+			foundCopy = true;
+		}
+	});
+
+	// Free memory
+	_aligned_free(sortedNumbers);
+
+	// Return result
+	return foundCopy;
+}
+
+// Exposed function
+// ------------------------------------------------------------------------------------------------
+
+bool radixSortAlgorithm(const char* filePath) noexcept
+{
+	// Open file
+	HANDLE file = CreateFile(filePath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+	                         FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (file == INVALID_HANDLE_VALUE) {
+		printf("CreateFile() failed\n");
+		return false;
+	}
+
+	// Get size of file
+	uint64_t fileSize = static_cast<uint64_t>(GetFileSize(file, NULL));
+
+	// Large file fast path
+	// There are a total of 17 576 000 different codes. If the file contains more codes than that
+	// it must also by definition contain a copy.
+	if (fileSize >= ((MAX_NUMBER_CODES + 1) * BYTES_PER_CODE)) {
+		CloseHandle(file);
+		return true;
+	}
+
+	// Create mapped file
+	HANDLE mappedFile = CreateFileMapping(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (!mappedFile) {
+		printf("CreateFileMapping() failed\n");
+		CloseHandle(file);
+		return false;
+	}
+
+	// Create mapped file view
+	void* fileView = MapViewOfFile(mappedFile, FILE_MAP_READ, 0, 0, fileSize);
+	if (!fileView) {
+		printf("MapViewOfFile() failed\n");
+		CloseHandle(mappedFile);
+		CloseHandle(file);
+		return false;
+	}
+
+	// Sort and search, single threaded for small files
+	uint64_t numCodes = numCodesInText(fileSize, BYTES_PER_CODE);
+	uint64_t numThreads = numCodes <= NUM_CODES_MULTI_THREADED_THRESHOLD ? 1 : NUM_THREADS;
+	bool foundCopy = radixSortSearch(static_cast<const uint8_t*>(fileView), numCodes, numThreads);
+
+	// Unmap mapped file view
+	if (!UnmapViewOfFile(fileView)) {
+		printf("UnmapViewOfFile() failed\n");
+		CloseHandle(mappedFile);
+		CloseHandle(file);
+		return false;
+	}
+
+	// Close mapped file
+	if (!CloseHandle(mappedFile)) {
+		printf("CloseHandle() failed for mappedFile\n");
+		return false;
+	}
+
+	// Close file
+	if (!CloseHandle(file)) {
+		printf("CloseHandle() failed for file\n");
+		return false;
+	}
+
+	// Return result
+	return foundCopy;
+}
+
+bool radixSortCodes(const char* filePath, vector<uint32_t>& uniqueOut,
+                    vector<DuplicateGroup>& duplicatesOut) noexcept
+{
+	uniqueOut.clear();
+	duplicatesOut.clear();
+
+	// Open file
+	HANDLE file = CreateFile(filePath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+	                         FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (file == INVALID_HANDLE_VALUE) {
+		printf("CreateFile() failed\n");
+		return false;
+	}
+
+	// Get size of file, an empty file can't be mapped
+	uint64_t fileSize = static_cast<uint64_t>(GetFileSize(file, NULL));
+	uint64_t numCodes = numCodesInText(fileSize, BYTES_PER_CODE);
+	if (numCodes == 0) {
+		CloseHandle(file);
+		return true;
+	}
+
+	// Create mapped file
+	HANDLE mappedFile = CreateFileMapping(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (!mappedFile) {
+		printf("CreateFileMapping() failed\n");
+		CloseHandle(file);
+		return false;
+	}
+
+	// Create mapped file view
+	void* fileView = MapViewOfFile(mappedFile, FILE_MAP_READ, 0, 0, fileSize);
+	if (!fileView) {
+		printf("MapViewOfFile() failed\n");
+		CloseHandle(mappedFile);
+		CloseHandle(file);
+		return false;
+	}
+
+	// Sort and group, single threaded for small files
+	uint64_t numThreads = numCodes <= NUM_CODES_MULTI_THREADED_THRESHOLD ? 1 : NUM_THREADS;
+	uint32_t* sortedNumbers = decodeAndSort(static_cast<const uint8_t*>(fileView), numCodes, numThreads);
+	groupSorted(sortedNumbers, numCodes, numThreads, uniqueOut, duplicatesOut);
+	_aligned_free(sortedNumbers);
+
+	// Unmap and close
+	bool success = UnmapViewOfFile(fileView) != 0;
+	success = CloseHandle(mappedFile) && success;
+	success = CloseHandle(file) && success;
+	if (!success) printf("Unmapping or closing \"%s\" failed\n", filePath);
+	return success;
+}
@@ -0,0 +1,24 @@
+// Copyright(c) Peter Hillerstrm(skipifzero.com, peter@hstroem.se)
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// Sort based alternative to stdSortAlgorithm(). Codes are decoded into 25 bit numbers which are
+// sorted with a parallel LSD radix sort (3 passes of 9, 8 and 8 bits). A copy is then found by
+// comparing adjacent numbers with AVX2.
+bool radixSortAlgorithm(const char* filePath) noexcept;
+
+// A code occurring more than once in a file, number is the decoded code index
+struct DuplicateGroup final {
+	uint32_t number;
+	uint64_t count;
+};
+
+// Sorts the codes of a text file (8 bytes per code) as radixSortAlgorithm() does, and writes the
+// sorted unique code indices to uniqueOut and a group per code occurring more than once, by
+// ascending index, to duplicatesOut. Unlike radixSortAlgorithm() there is no large file fast path,
+// all codes are always sorted.
+bool radixSortCodes(const char* filePath, std::vector<uint32_t>& uniqueOut,
+                    std::vector<DuplicateGroup>& duplicatesOut) noexcept;
@@ -0,0 +1,14 @@
+// Copyright(c) Peter Hillerstrm(skipifzero.com, peter@hstroem.se)
+
+#pragma once
+
+// Scanners generated from the plate schemas in PlateSchema.hpp, one per schema
+
+// "ABC123", equivalent to optimizedSmartAlgorithm7()
+bool schemaAlgorithmAAA000(const char* filePath) noexcept;
+
+// "ABC12D"
+bool schemaAlgorithmAAA00A(const char* filePath) noexcept;
+
+// "AB12345", decoded with scalar code since it is not 8 bytes per line
+bool schemaAlgorithmAA00000(const char* filePath) noexcept;
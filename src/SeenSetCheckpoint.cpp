@@ -0,0 +1,305 @@
+// Copyright(c) Peter Hillerstrm(skipifzero.com, peter@hstroem.se)
+
+#include "SeenSetCheckpoint.hpp"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#include <immintrin.h>
+#include <malloc.h>
+
+#include "Crc32c.hpp"
+
+using namespace std;
+
+// Constants
+// ------------------------------------------------------------------------------------------------
+
+static const uint64_t NUM_PADDED_BITSET_BYTES = SEEN_SET_NUM_PAGES * SEEN_SET_PAGE_BYTES;
+
+// Helpers
+// ------------------------------------------------------------------------------------------------
+
+static string snapshotPathOf(const char* basePath) noexcept
+{
+	return string(basePath) + ".snapshot";
+}
+
+static string logPathOf(const char* basePath) noexcept
+{
+	return string(basePath) + ".log";
+}
+
+static bool fileExists(const char* path) noexcept
+{
+	HANDLE file = CreateFile(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING,
+	                         FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE) return false;
+	CloseHandle(file);
+	return true;
+}
+
+// Reads the entire file, a missing file is read as empty
+static bool readWholeFile(const char* path, vector<uint8_t>& contentsOut) noexcept
+{
+	contentsOut.clear();
+	HANDLE file = CreateFile(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING,
+	                         FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (file == INVALID_HANDLE_VALUE) return true;
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize)) {
+		printf("GetFileSizeEx() failed\n");
+		CloseHandle(file);
+		return false;
+	}
+	contentsOut.resize(size_t(fileSize.QuadPart));
+	DWORD numRead = 0;
+	bool success = contentsOut.empty() ||
+	               (ReadFile(file, contentsOut.data(), DWORD(contentsOut.size()), &numRead, NULL) &&
+	                numRead == DWORD(contentsOut.size()));
+	if (!success) printf("ReadFile() failed\n");
+	CloseHandle(file);
+	return success;
+}
+
+// ORs the valid log entries onto the bitset (NUM_PADDED_BITSET_BYTES bytes), returns the number of
+// bytes before the first invalid entry
+static uint64_t replayLog(const vector<uint8_t>& log, uint64_t* bitset, uint64_t& numEntriesOut) noexcept
+{
+	uint8_t* bitsetBytes = reinterpret_cast<uint8_t*>(bitset);
+	uint64_t offset = 0;
+	numEntriesOut = 0;
+	while ((log.size() - offset) >= sizeof(SeenSetLogEntryHeader)) {
+
+		// Validate entry
+		SeenSetLogEntryHeader header;
+		memcpy(&header, log.data() + offset, sizeof(SeenSetLogEntryHeader));
+		if (header.magic != SEEN_SET_LOG_MAGIC || header.numPages == 0 || header.numPages > SEEN_SET_NUM_PAGES ||
+		    header.sequence != numEntriesOut) {
+			break;
+		}
+		uint64_t bodyBytes = header.numPages * (sizeof(uint32_t) + SEEN_SET_PAGE_BYTES);
+		if ((log.size() - offset - sizeof(SeenSetLogEntryHeader)) < bodyBytes) break;
+		const uint8_t* body = log.data() + offset + sizeof(SeenSetLogEntryHeader);
+		if (crc32c(body, bodyBytes) != header.checksum) break;
+		const uint8_t* pageIndices = body;
+		const uint8_t* pages = body + header.numPages * sizeof(uint32_t);
+		bool validIndices = true;
+		for (uint32_t i = 0; i < header.numPages; i++) {
+			uint32_t pageIndex = 0;
+			memcpy(&pageIndex, pageIndices + i * sizeof(uint32_t), sizeof(uint32_t));
+			validIndices = validIndices && pageIndex < SEEN_SET_NUM_PAGES;
+		}
+		if (!validIndices) break;
+
+		// Replay entry
+		for (uint32_t i = 0; i < header.numPages; i++) {
+			uint32_t pageIndex = 0;
+			memcpy(&pageIndex, pageIndices + i * sizeof(uint32_t), sizeof(uint32_t));
+			uint8_t* dst = bitsetBytes + pageIndex * SEEN_SET_PAGE_BYTES;
+			const uint8_t* src = pages + i * SEEN_SET_PAGE_BYTES;
+			for (uint64_t j = 0; j < SEEN_SET_PAGE_BYTES; j += 32) {
+				__m256i a = _mm256_load_si256(reinterpret_cast<const __m256i*>(dst + j));
+				__m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + j));
+				_mm256_store_si256(reinterpret_cast<__m256i*>(dst + j), _mm256_or_si256(a, b));
+			}
+		}
+
+		offset += sizeof(SeenSetLogEntryHeader) + bodyBytes;
+		numEntriesOut += 1;
+	}
+	return offset;
+}
+
+// Recovers into a page padded and 32 byte aligned bitset
+static bool recoverPadded(const char* basePath, uint64_t* paddedBitset, uint64_t& validLogBytesOut,
+                          uint64_t& numEntriesOut) noexcept
+{
+	memset(paddedBitset, 0, NUM_PADDED_BITSET_BYTES);
+	string snapshotPath = snapshotPathOf(basePath);
+	if (fileExists(snapshotPath.c_str()) && !loadSeenSet(snapshotPath.c_str(), paddedBitset)) {
+		return false;
+	}
+
+	vector<uint8_t> log;
+	if (!readWholeFile(logPathOf(basePath).c_str(), log)) return false;
+	validLogBytesOut = replayLog(log, paddedBitset, numEntriesOut);
+
+	// Padding past the end of the bitset must stay clear
+	memset(reinterpret_cast<uint8_t*>(paddedBitset) + SEEN_SET_NUM_BYTES, 0,
+	       NUM_PADDED_BITSET_BYTES - SEEN_SET_NUM_BYTES);
+	return true;
+}
+
+// Recovery
+// ------------------------------------------------------------------------------------------------
+
+bool recoverSeenSet(const char* basePath, uint64_t* bitsetOut, uint64_t* validLogBytesOut) noexcept
+{
+	uint64_t* paddedBitset = static_cast<uint64_t*>(_aligned_malloc(NUM_PADDED_BITSET_BYTES, SEEN_SET_PAGE_BYTES));
+	uint64_t validLogBytes = 0;
+	uint64_t numEntries = 0;
+	bool success = recoverPadded(basePath, paddedBitset, validLogBytes, numEntries);
+	if (success) {
+		memcpy(bitsetOut, paddedBitset, SEEN_SET_NUM_BYTES);
+		if (validLogBytesOut != nullptr) *validLogBytesOut = validLogBytes;
+	}
+	_aligned_free(paddedBitset);
+	return success;
+}
+
+// Checkpointer
+// ------------------------------------------------------------------------------------------------
+
+bool SeenSetCheckpointer::open(const char* basePath, const SeenSetCheckpointOptions& options) noexcept
+{
+	this->close();
+	mOptions = options;
+	mSnapshotPath = snapshotPathOf(basePath);
+	mLogPath = logPathOf(basePath);
+
+	// Recover existing state
+	mBitset = static_cast<uint64_t*>(_aligned_malloc(NUM_PADDED_BITSET_BYTES, SEEN_SET_PAGE_BYTES));
+	uint64_t validLogBytes = 0;
+	if (!recoverPadded(basePath, mBitset, validLogBytes, mSequence)) {
+		printf("Could not recover seen-set \"%s\"\n", basePath);
+		_aligned_free(mBitset);
+		mBitset = nullptr;
+		return false;
+	}
+
+	// Open log and drop any torn entry at its end, so new entries follow the last valid one
+	HANDLE log = CreateFile(mLogPath.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL, OPEN_ALWAYS,
+	                        FILE_ATTRIBUTE_NORMAL, NULL);
+	if (log == INVALID_HANDLE_VALUE) {
+		printf("CreateFile() failed for log\n");
+		_aligned_free(mBitset);
+		mBitset = nullptr;
+		return false;
+	}
+	LARGE_INTEGER distance;
+	distance.QuadPart = LONGLONG(validLogBytes);
+	if (!SetFilePointerEx(log, distance, NULL, FILE_BEGIN) || !SetEndOfFile(log)) {
+		printf("Could not truncate log\n");
+		CloseHandle(log);
+		_aligned_free(mBitset);
+		mBitset = nullptr;
+		return false;
+	}
+	mLog = log;
+	mLogBytes = validLogBytes;
+	return true;
+}
+
+void SeenSetCheckpointer::close() noexcept
+{
+	if (mLog != nullptr) {
+		this->checkpoint();
+		CloseHandle(mLog);
+	}
+	if (mBitset != nullptr) _aligned_free(mBitset);
+	mLog = nullptr;
+	mBitset = nullptr;
+	mLogBytes = 0;
+	mSequence = 0;
+	memset(mDirtyPages, 0, sizeof(mDirtyPages));
+	mInsertsSinceCheckpoint = 0;
+	mCheckpointFailed = false;
+	mNumInserts = 0;
+	mNumCheckpoints = 0;
+	mNumCompactions = 0;
+	mNumPagesWritten = 0;
+	mNumBytesWritten = 0;
+}
+
+bool SeenSetCheckpointer::checkpoint() noexcept
+{
+	if (mLog == nullptr) return false;
+	mInsertsSinceCheckpoint = 0;
+
+	// Gather dirty pages
+	uint32_t dirtyPages[SEEN_SET_NUM_PAGES];
+	uint32_t numPages = 0;
+	for (uint64_t i = 0; i < NUM_DIRTY_WORDS; i++) {
+		uint64_t word = mDirtyPages[i];
+		while (word != 0) {
+			dirtyPages[numPages++] = uint32_t(i * 64 + _tzcnt_u64(word));
+			word = _blsr_u64(word);
+		}
+	}
+	if (numPages == 0) return true;
+
+	// Create log entry
+	uint64_t bodyBytes = numPages * (sizeof(uint32_t) + SEEN_SET_PAGE_BYTES);
+	vector<uint8_t> entry(sizeof(SeenSetLogEntryHeader) + bodyBytes);
+	uint8_t* body = entry.data() + sizeof(SeenSetLogEntryHeader);
+	memcpy(body, dirtyPages, numPages * sizeof(uint32_t));
+	uint8_t* pages = body + numPages * sizeof(uint32_t);
+	const uint8_t* bitsetBytes = reinterpret_cast<const uint8_t*>(mBitset);
+	for (uint32_t i = 0; i < numPages; i++) {
+		memcpy(pages + i * SEEN_SET_PAGE_BYTES, bitsetBytes + dirtyPages[i] * SEEN_SET_PAGE_BYTES, SEEN_SET_PAGE_BYTES);
+	}
+	SeenSetLogEntryHeader header;
+	header.magic = SEEN_SET_LOG_MAGIC;
+	header.numPages = numPages;
+	header.sequence = mSequence;
+	header.checksum = crc32c(body, bodyBytes);
+	header.padding = 0;
+	memcpy(entry.data(), &header, sizeof(SeenSetLogEntryHeader));
+
+	// Append and flush, the entry is durable once FlushFileBuffers() returns
+	DWORD numWritten = 0;
+	if (!WriteFile(mLog, entry.data(), DWORD(entry.size()), &numWritten, NULL) ||
+	    numWritten != DWORD(entry.size()) || !FlushFileBuffers(mLog)) {
+		printf("Could not append checkpoint to log\n");
+
+		// Remove the partial entry, otherwise the next entry is appended after it and recovery,
+		// which stops at the first invalid entry, would never see it
+		LARGE_INTEGER distance;
+		distance.QuadPart = LONGLONG(mLogBytes);
+		if (!SetFilePointerEx(mLog, distance, NULL, FILE_BEGIN) || !SetEndOfFile(mLog)) {
+			printf("Could not truncate log after failed checkpoint\n");
+		}
+		return false;
+	}
+	memset(mDirtyPages, 0, sizeof(mDirtyPages));
+	mLogBytes += entry.size();
+	mSequence += 1;
+	mNumCheckpoints += 1;
+	mNumPagesWritten += numPages;
+	mNumBytesWritten += entry.size();
+
+	if (mOptions.compactionLogBytes != 0 && mLogBytes >= mOptions.compactionLogBytes) {
+		return this->compact();
+	}
+	return true;
+}
+
+bool SeenSetCheckpointer::compact() noexcept
+{
+	if (mLog == nullptr) return false;
+
+	// Write new snapshot, saveSeenSet() only replaces the old one once the new one is complete, so
+	// there is always a valid snapshot
+	if (!saveSeenSet(mSnapshotPath.c_str(), mBitset, SeenSetEncoding::RAW)) return false;
+
+	// Truncate log, the snapshot contains everything in it and all dirty pages
+	LARGE_INTEGER distance;
+	distance.QuadPart = 0;
+	if (!SetFilePointerEx(mLog, distance, NULL, FILE_BEGIN) || !SetEndOfFile(mLog) || !FlushFileBuffers(mLog)) {
+		printf("Could not truncate log\n");
+		return false;
+	}
+	memset(mDirtyPages, 0, sizeof(mDirtyPages));
+	mLogBytes = 0;
+	mSequence = 0;
+	mNumCompactions += 1;
+	mNumBytesWritten += SEEN_SET_RAW_PAYLOAD_OFFSET + SEEN_SET_NUM_BYTES;
+	return true;
+}
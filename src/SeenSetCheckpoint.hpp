@@ -0,0 +1,125 @@
+// Copyright(c) Peter Hillerstrm(skipifzero.com, peter@hstroem.se)
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "SeenSetSnapshot.hpp"
+
+// Seen-set checkpointing
+// ------------------------------------------------------------------------------------------------
+
+// Keeps a seen-set durable in a long-running process without rewriting the whole bitset. The state
+// on disk is a RAW snapshot ("<base>.snapshot", see SeenSetSnapshot.hpp) plus an append-only log
+// ("<base>.log") of the 4 KiB bitset pages modified since the snapshot was written.
+//
+// Inserts mark their page in a dirty page summary (1 bit per page, 537 pages). A checkpoint appends
+// one log entry containing all dirty pages, followed by a flush, and clears the summary. Once the
+// log grows past a threshold it is compacted, i.e. a new snapshot is written and the log truncated.
+//
+// Recovery loads the snapshot and ORs every valid log entry onto it. Since a seen-set only ever
+// gains bits, replaying a page image is idempotent and order independent, so a crash between
+// writing a new snapshot and truncating the log is harmless. A torn entry at the end of the log
+// fails its checksum and is discarded together with everything after it.
+
+static const uint32_t SEEN_SET_LOG_MAGIC = 0x54504B43u; // "CKPT"
+static const uint64_t SEEN_SET_PAGE_BYTES = 4096;
+static const uint64_t SEEN_SET_NUM_PAGES = (SEEN_SET_NUM_BYTES + SEEN_SET_PAGE_BYTES - 1) / SEEN_SET_PAGE_BYTES;
+
+// A log entry is this header, numPages u32 page indices and then numPages page images
+struct SeenSetLogEntryHeader final {
+	uint32_t magic;
+	uint32_t numPages;
+	uint64_t sequence; // Number of checkpoints before this one since the log was created
+	uint32_t checksum; // CRC-32C of the page indices and page images
+	uint32_t padding;
+};
+static_assert(sizeof(SeenSetLogEntryHeader) == 24, "SeenSetLogEntryHeader is padded");
+
+struct SeenSetCheckpointOptions final {
+	// Number of inserts between automatic checkpoints, 0 to only checkpoint when asked to
+	uint64_t checkpointInterval = 65536;
+
+	// Log size in bytes that triggers compaction after a checkpoint, 0 to never compact
+	uint64_t compactionLogBytes = 4 * SEEN_SET_NUM_BYTES;
+};
+
+// Restores the seen-set (SEEN_SET_NUM_BYTES bytes) from the snapshot and log of the specified base
+// path, a missing snapshot or log counts as empty. Outputs the number of bytes of the log that
+// contain valid entries. Fails if the snapshot exists but can't be loaded.
+bool recoverSeenSet(const char* basePath, uint64_t* bitsetOut, uint64_t* validLogBytesOut = nullptr) noexcept;
+
+class SeenSetCheckpointer final {
+public:
+	SeenSetCheckpointer() noexcept = default;
+	SeenSetCheckpointer(const SeenSetCheckpointer&) = delete;
+	SeenSetCheckpointer& operator= (const SeenSetCheckpointer&) = delete;
+	~SeenSetCheckpointer() noexcept { this->close(); }
+
+	// Recovers any existing state at the base path and opens the log for appending
+	bool open(const char* basePath, const SeenSetCheckpointOptions& options) noexcept;
+
+	// Checkpoints remaining dirty pages and closes the log
+	void close() noexcept;
+
+	// Inserts the code index, returns whether it was already in the set. If the automatic
+	// checkpoint fails, checkpointFailed() is set and the dirty pages are kept for the next one.
+	bool insert(uint32_t number) noexcept
+	{
+		uint64_t& chunk = mBitset[number >> 6u];
+		uint64_t bitMask = uint64_t(1) << (number & 0x0000003Fu);
+		bool found = (chunk & bitMask) != uint64_t(0);
+		if (!found) {
+			chunk |= bitMask;
+			uint32_t page = number >> 15u; // 32768 bits per page
+			mDirtyPages[page >> 6u] |= uint64_t(1) << (page & 0x0000003Fu);
+		}
+		mNumInserts += 1;
+		mInsertsSinceCheckpoint += 1;
+		if (mInsertsSinceCheckpoint == mOptions.checkpointInterval && !this->checkpoint()) {
+			mCheckpointFailed = true;
+		}
+		return found;
+	}
+
+	// Appends the dirty pages to the log, compacting afterwards if the log is too large. On failure
+	// the log is truncated back to its last complete entry, so later checkpoints stay recoverable.
+	bool checkpoint() noexcept;
+
+	// Writes a new snapshot and truncates the log
+	bool compact() noexcept;
+
+	const uint64_t* bitset() const noexcept { return mBitset; }
+
+	uint64_t numInserts() const noexcept { return mNumInserts; }
+	uint64_t numCheckpoints() const noexcept { return mNumCheckpoints; }
+	uint64_t numCompactions() const noexcept { return mNumCompactions; }
+	uint64_t numPagesWritten() const noexcept { return mNumPagesWritten; }
+	uint64_t numBytesWritten() const noexcept { return mNumBytesWritten; }
+
+	// Whether an automatic checkpoint in insert() failed since open() or clearCheckpointFailed()
+	bool checkpointFailed() const noexcept { return mCheckpointFailed; }
+	void clearCheckpointFailed() noexcept { mCheckpointFailed = false; }
+
+private:
+	static const uint64_t NUM_DIRTY_WORDS = (SEEN_SET_NUM_PAGES + 63) / 64;
+
+	SeenSetCheckpointOptions mOptions;
+	std::string mSnapshotPath;
+	std::string mLogPath;
+	void* mLog = nullptr;
+	uint64_t mLogBytes = 0;
+	uint64_t mSequence = 0;
+
+	uint64_t* mBitset = nullptr; // SEEN_SET_NUM_PAGES whole pages, padding is always zero
+	uint64_t mDirtyPages[NUM_DIRTY_WORDS] = {};
+	uint64_t mInsertsSinceCheckpoint = 0;
+	bool mCheckpointFailed = false;
+
+	uint64_t mNumInserts = 0;
+	uint64_t mNumCheckpoints = 0;
+	uint64_t mNumCompactions = 0;
+	uint64_t mNumPagesWritten = 0;
+	uint64_t mNumBytesWritten = 0;
+};
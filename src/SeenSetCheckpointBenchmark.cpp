@@ -0,0 +1,152 @@
+// Copyright(c) Peter Hillerstrm(skipifzero.com, peter@hstroem.se)
+
+#include "SeenSetCheckpointBenchmark.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+
+#include "PlateDecoders.hpp"
+#include "SeenSetCheckpoint.hpp"
+
+using namespace std;
+
+// Constants
+// ------------------------------------------------------------------------------------------------
+
+static const uint64_t BYTES_PER_CODE = 8;
+static const uint64_t NUM_BITSET_WORDS = SEEN_SET_NUM_BYTES / sizeof(uint64_t);
+static const uint64_t CHECKPOINT_INTERVALS[] = { 1024, 16384, 262144 };
+
+static const char* BASE_PATH = "SeenSetCheckpointBenchmark";
+
+typedef chrono::high_resolution_clock Clock;
+
+// Helpers
+// ------------------------------------------------------------------------------------------------
+
+static double millisecondsSince(Clock::time_point start) noexcept
+{
+	return chrono::duration<double, milli>(Clock::now() - start).count();
+}
+
+static void deleteCheckpointFiles() noexcept
+{
+	DeleteFile((string(BASE_PATH) + ".snapshot").c_str());
+	DeleteFile((string(BASE_PATH) + ".log").c_str());
+}
+
+// Appends half a log entry, as if the process crashed while writing a checkpoint. The log must not
+// be open by a checkpointer, which only shares it for reading.
+static bool appendTornEntry() noexcept
+{
+	FILE* log = fopen((string(BASE_PATH) + ".log").c_str(), "ab");
+	if (log == nullptr) return false;
+	SeenSetLogEntryHeader header = {};
+	header.magic = SEEN_SET_LOG_MAGIC;
+	header.numPages = 2;
+	vector<uint8_t> partialBody(SEEN_SET_PAGE_BYTES, 0xFF);
+	bool success = fwrite(&header, sizeof(header), 1, log) == 1 &&
+	               fwrite(partialBody.data(), partialBody.size(), 1, log) == 1;
+	fclose(log);
+	return success;
+}
+
+// Exposed function
+// ------------------------------------------------------------------------------------------------
+
+void benchmarkCheckpointing(const char* filePath) noexcept
+{
+	// Read and decode file
+	FILE* file = fopen(filePath, "rb");
+	if (file == nullptr) {
+		printf("Could not open \"%s\" for checkpoint benchmark\n", filePath);
+		return;
+	}
+	vector<uint8_t> text;
+	uint8_t buffer[4096];
+	size_t numRead;
+	while ((numRead = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+		text.insert(text.end(), buffer, buffer + numRead);
+	}
+	fclose(file);
+	vector<uint32_t> numbers(text.size() / BYTES_PER_CODE);
+	for (size_t i = 0; i < numbers.size(); i++) {
+		numbers[i] = decodeScalar(text.data() + i * BYTES_PER_CODE);
+	}
+
+	// Codes in file order touch random pages, sorted codes model clustered arrivals that only
+	// dirty a few pages between checkpoints
+	vector<uint32_t> sortedNumbers = numbers;
+	sort(sortedNumbers.begin(), sortedNumbers.end());
+
+	printf("Checkpointing seen-set of \"%s\" (%zu inserts)\n", filePath, numbers.size());
+	vector<uint64_t> recovered(NUM_BITSET_WORDS, 0);
+	for (bool sorted : { false, true }) {
+		printf(" %s\n", sorted ? "Sorted order" : "File order");
+		for (uint64_t interval : CHECKPOINT_INTERVALS) {
+			deleteCheckpointFiles();
+
+			// Insert all codes
+			SeenSetCheckpointOptions options;
+			options.checkpointInterval = interval;
+			SeenSetCheckpointer checkpointer;
+			if (!checkpointer.open(BASE_PATH, options)) {
+				printf("Could not open checkpointed seen-set\n");
+				return;
+			}
+			Clock::time_point startTime = Clock::now();
+			for (uint32_t number : sorted ? sortedNumbers : numbers) {
+				checkpointer.insert(number);
+			}
+			bool success = checkpointer.checkpoint();
+			double insertMilliseconds = millisecondsSince(startTime);
+			vector<uint64_t> expected(checkpointer.bitset(), checkpointer.bitset() + NUM_BITSET_WORDS);
+
+			// Write amplification, against rewriting the whole bitset at every checkpoint
+			double numInserts = double(checkpointer.numInserts());
+			double bytesPerInsert = double(checkpointer.numBytesWritten()) / numInserts;
+			double fullBytesPerInsert = double(checkpointer.numCheckpoints() * SEEN_SET_NUM_BYTES) / numInserts;
+			printf("  Interval %6llu: %.1f ms, %llu checkpoints, %llu pages, %llu compactions, %.1f bytes/insert "
+			       "(full rewrite %.1f)\n",
+			       (unsigned long long)interval, insertMilliseconds,
+			       (unsigned long long)checkpointer.numCheckpoints(), (unsigned long long)checkpointer.numPagesWritten(),
+			       (unsigned long long)checkpointer.numCompactions(), bytesPerInsert, fullBytesPerInsert);
+
+			// Recover while the checkpointer is still open, as after a crash
+			startTime = Clock::now();
+			success = success && recoverSeenSet(BASE_PATH, recovered.data());
+			double recoverMilliseconds = millisecondsSince(startTime);
+			bool correct = success && recovered == expected;
+			checkpointer.close();
+
+			// Recover with a torn entry at the end of the log, then reopen (which drops the torn
+			// entry) and check that a checkpoint appended after it is recovered too
+			success = success && appendTornEntry() && recoverSeenSet(BASE_PATH, recovered.data());
+			bool tornCorrect = success && recovered == expected;
+			success = success && checkpointer.open(BASE_PATH, options);
+			if (success) {
+				uint32_t number = 0;
+				while (checkpointer.bitset()[number >> 6u] & (uint64_t(1) << (number & 63u))) number += 1;
+				checkpointer.insert(number);
+				success = checkpointer.checkpoint();
+				expected.assign(checkpointer.bitset(), checkpointer.bitset() + NUM_BITSET_WORDS);
+				checkpointer.close();
+			}
+			success = success && recoverSeenSet(BASE_PATH, recovered.data());
+			bool reopenCorrect = success && recovered == expected;
+			printf("                  recovered in %.2f ms%s%s%s\n", recoverMilliseconds,
+			       correct ? "" : " (INCORRECT)", tornCorrect ? "" : " (INCORRECT WITH TORN ENTRY)",
+			       reopenCorrect ? "" : " (INCORRECT AFTER REOPEN)");
+		}
+	}
+	deleteCheckpointFiles();
+}
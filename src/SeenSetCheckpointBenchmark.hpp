@@ -0,0 +1,9 @@
+// Copyright(c) Peter Hillerstrm(skipifzero.com, peter@hstroem.se)
+
+#pragma once
+
+// Inserts the codes in the specified file into a checkpointed seen-set (SeenSetCheckpoint.hpp)
+// with different checkpoint intervals. Prints the bytes written per insert (write amplification)
+// against rewriting the whole bitset at every checkpoint, and the time to recover. Verifies that
+// recovery restores the seen-set, also with a torn entry at the end of the log.
+void benchmarkCheckpointing(const char* filePath) noexcept;
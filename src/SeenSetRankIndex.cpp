@@ -0,0 +1,272 @@
+// Copyright(c) Peter Hillerstrm(skipifzero.com, peter@hstroem.se)
+
+#include "SeenSetRankIndex.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include <immintrin.h>
+
+#include "PlateDecoders.hpp"
+#include "PlateSets.hpp"
+#include "SeenSetSnapshot.hpp"
+
+using namespace std;
+
+// Constants
+// ------------------------------------------------------------------------------------------------
+
+static const uint64_t NUM_WORDS = SEEN_SET_NUM_BITS / 64;
+static const uint64_t WORDS_PER_BLOCK = RANK_INDEX_BITS_PER_BLOCK / 64;
+static_assert((SEEN_SET_NUM_BITS % 64) == 0, "Seen-set must be a whole number of words");
+static_assert(RANK_INDEX_NUM_BLOCKS == ((NUM_WORDS + WORDS_PER_BLOCK - 1) / WORDS_PER_BLOCK), "Invalid number of blocks");
+
+static const uint32_t NUM_STATS_QUERIES = 100000;
+
+typedef chrono::high_resolution_clock Clock;
+
+// Helpers
+// ------------------------------------------------------------------------------------------------
+
+static uint32_t blockPopcount(const uint64_t* bitset, uint64_t block) noexcept
+{
+	uint64_t firstWord = block * WORDS_PER_BLOCK;
+	uint64_t lastWord = min(firstWord + WORDS_PER_BLOCK, NUM_WORDS);
+	uint64_t count = 0;
+	for (uint64_t i = firstWord; i < lastWord; i++) {
+		count += uint64_t(_mm_popcnt_u64(bitset[i]));
+	}
+	return uint32_t(count);
+}
+
+// Index of the n:th (0 is the lowest) set bit of the word, n must be less than its popcount
+static uint32_t selectInWord(uint64_t word, uint32_t n) noexcept
+{
+	return uint32_t(_tzcnt_u64(_pdep_u64(uint64_t(1) << n, word)));
+}
+
+static double millisecondsSince(Clock::time_point start) noexcept
+{
+	return chrono::duration<double, milli>(Clock::now() - start).count();
+}
+
+// Parallel build
+// ------------------------------------------------------------------------------------------------
+
+// Pass 1: Each thread stores the rank of its blocks relative to the start of its range
+static void relativeRanksWorker(const uint64_t* bitset, uint32_t* blockRanks, uint64_t firstBlock,
+                                uint64_t lastBlock, uint64_t* rangeTotalOut) noexcept
+{
+	uint32_t rank = 0;
+	for (uint64_t block = firstBlock; block < lastBlock; block++) {
+		blockRanks[block] = rank;
+		rank += blockPopcount(bitset, block);
+	}
+	*rangeTotalOut = rank;
+}
+
+// Pass 2: Each thread adds the total of all ranges before its own and records the select samples
+// of its blocks. Samples are indexed by set bit, so the threads write disjoint entries.
+static void absoluteRanksWorker(uint32_t* blockRanks, uint32_t* selectSamples, uint64_t firstBlock,
+                                uint64_t lastBlock, uint64_t rangeOffset, uint64_t rangeTotal) noexcept
+{
+	for (uint64_t block = firstBlock; block < lastBlock; block++) {
+		uint64_t rank = rangeOffset + blockRanks[block];
+		uint64_t nextRank = rangeOffset + ((block + 1) < lastBlock ? blockRanks[block + 1] : rangeTotal);
+		blockRanks[block] = uint32_t(rank);
+
+		uint64_t sample = (rank + RANK_INDEX_SELECT_SAMPLE_RATE - 1) / RANK_INDEX_SELECT_SAMPLE_RATE;
+		for (; (sample * RANK_INDEX_SELECT_SAMPLE_RATE) < nextRank; sample++) {
+			selectSamples[sample] = uint32_t(block);
+		}
+	}
+}
+
+// Seen-set rank index
+// ------------------------------------------------------------------------------------------------
+
+bool SeenSetRankIndex::build(const uint64_t* bitset, uint32_t numThreads) noexcept
+{
+	this->destroy();
+	if (bitset == nullptr || numThreads == 0) return false;
+	mBlockRanks.resize(RANK_INDEX_NUM_BLOCKS + 1);
+
+	// Split blocks into one contiguous range per thread
+	uint64_t blocksPerThread = (RANK_INDEX_NUM_BLOCKS + numThreads - 1) / numThreads;
+	vector<uint64_t> firstBlocks(numThreads + 1);
+	for (uint32_t i = 0; i <= numThreads; i++) {
+		firstBlocks[i] = min(i * blocksPerThread, RANK_INDEX_NUM_BLOCKS);
+	}
+
+	// Pass 1, relative ranks
+	vector<uint64_t> rangeTotals(numThreads);
+	vector<thread> threads;
+	for (uint32_t i = 1; i < numThreads; i++) {
+		threads.emplace_back(relativeRanksWorker, bitset, mBlockRanks.data(), firstBlocks[i],
+		                     firstBlocks[i + 1], &rangeTotals[i]);
+	}
+	relativeRanksWorker(bitset, mBlockRanks.data(), firstBlocks[0], firstBlocks[1], &rangeTotals[0]);
+	for (thread& t : threads) {
+		t.join();
+	}
+	threads.clear();
+
+	// Offsets of the ranges
+	vector<uint64_t> rangeOffsets(numThreads);
+	uint64_t numSetBits = 0;
+	for (uint32_t i = 0; i < numThreads; i++) {
+		rangeOffsets[i] = numSetBits;
+		numSetBits += rangeTotals[i];
+	}
+	mBlockRanks[RANK_INDEX_NUM_BLOCKS] = uint32_t(numSetBits);
+	mSelectSamples.resize((numSetBits + RANK_INDEX_SELECT_SAMPLE_RATE - 1) / RANK_INDEX_SELECT_SAMPLE_RATE);
+
+	// Pass 2, absolute ranks and select samples
+	for (uint32_t i = 1; i < numThreads; i++) {
+		threads.emplace_back(absoluteRanksWorker, mBlockRanks.data(), mSelectSamples.data(),
+		                     firstBlocks[i], firstBlocks[i + 1], rangeOffsets[i], rangeTotals[i]);
+	}
+	absoluteRanksWorker(mBlockRanks.data(), mSelectSamples.data(), firstBlocks[0], firstBlocks[1],
+	                    rangeOffsets[0], rangeTotals[0]);
+	for (thread& t : threads) {
+		t.join();
+	}
+
+	mBitset = bitset;
+	mNumSetBits = numSetBits;
+	return true;
+}
+
+void SeenSetRankIndex::destroy() noexcept
+{
+	mBitset = nullptr;
+	mBlockRanks.clear();
+	mSelectSamples.clear();
+	mNumSetBits = 0;
+}
+
+uint64_t SeenSetRankIndex::rank(uint32_t number) const noexcept
+{
+	uint64_t wordIndex = number >> 6u;
+	uint64_t rank = mBlockRanks[number / RANK_INDEX_BITS_PER_BLOCK];
+	for (uint64_t i = (wordIndex & ~(WORDS_PER_BLOCK - 1)); i < wordIndex; i++) {
+		rank += uint64_t(_mm_popcnt_u64(mBitset[i]));
+	}
+	uint32_t bitIndex = number & 0x0000003Fu;
+	if (bitIndex != 0) {
+		rank += uint64_t(_mm_popcnt_u64(_bzhi_u64(mBitset[wordIndex], bitIndex)));
+	}
+	return rank;
+}
+
+bool SeenSetRankIndex::select(uint64_t k, uint32_t& numberOut) const noexcept
+{
+	if (k >= mNumSetBits) return false;
+
+	// The block is between the blocks of the samples before and after k, find the last block
+	// starting at or before k
+	uint64_t sample = k / RANK_INDEX_SELECT_SAMPLE_RATE;
+	uint64_t firstBlock = mSelectSamples[sample];
+	uint64_t lastBlock = (sample + 1) < mSelectSamples.size() ? mSelectSamples[sample + 1] : (RANK_INDEX_NUM_BLOCKS - 1);
+	const uint32_t* blockIt = upper_bound(mBlockRanks.data() + firstBlock, mBlockRanks.data() + lastBlock + 1,
+	                                      uint32_t(k)) - 1;
+	uint64_t block = uint64_t(blockIt - mBlockRanks.data());
+
+	// Find the word within the block
+	uint32_t remaining = uint32_t(k - *blockIt);
+	uint64_t lastWord = min((block + 1) * WORDS_PER_BLOCK, NUM_WORDS);
+	for (uint64_t i = block * WORDS_PER_BLOCK; i < lastWord; i++) {
+		uint32_t count = uint32_t(_mm_popcnt_u64(mBitset[i]));
+		if (remaining < count) {
+			numberOut = uint32_t(i * 64 + selectInWord(mBitset[i], remaining));
+			return true;
+		}
+		remaining -= count;
+	}
+	return false; // Unreachable unless the bitset was modified after build()
+}
+
+// Stats
+// ------------------------------------------------------------------------------------------------
+
+static uint64_t scanCountRange(const PlateSet& set, uint32_t firstNumber, uint32_t lastNumber) noexcept
+{
+	uint64_t count = 0;
+	for (uint32_t number = firstNumber; number <= lastNumber; number++) {
+		if (set.contains(number)) count += 1;
+	}
+	return count;
+}
+
+void printRankIndexStats(const char* filePath) noexcept
+{
+	printf("Rank index stats on \"%s\":\n", filePath);
+	vector<PlateSet> sets;
+	if (!buildPlateSets(vector<const char*>(1, filePath), sets)) {
+		printf("  Building seen-set failed\n\n");
+		return;
+	}
+	const PlateSet& set = sets[0];
+
+	// Build times
+	SeenSetRankIndex index;
+	for (uint32_t numThreads : { 1u, 3u }) {
+		Clock::time_point start = Clock::now();
+		index.build(set.words(), numThreads);
+		printf("  Build with %u thread(s): %.3f ms, %llu codes\n", numThreads, millisecondsSince(start),
+		       (unsigned long long)index.numSetBits());
+	}
+	printf("  Index size: %llu bytes (bitset %llu bytes)\n",
+	       (unsigned long long)((RANK_INDEX_NUM_BLOCKS + 1) * sizeof(uint32_t) +
+	                            ((index.numSetBits() + RANK_INDEX_SELECT_SAMPLE_RATE - 1) / RANK_INDEX_SELECT_SAMPLE_RATE) * sizeof(uint32_t)),
+	       (unsigned long long)SEEN_SET_NUM_BYTES);
+
+	// Example queries, verified against scanning the bitset
+	uint32_t first = decodeScalar(reinterpret_cast<const uint8_t*>("ABC000"));
+	uint32_t last = decodeScalar(reinterpret_cast<const uint8_t*>("ABF999"));
+	uint64_t rangeCount = index.countRange(first, last);
+	printf("  Codes in ABC000-ABF999: %llu%s\n", (unsigned long long)rangeCount,
+	       rangeCount == scanCountRange(set, first, last) ? "" : " (WARNING: does not match scan)");
+	uint32_t median = 0;
+	if (index.select(index.numSetBits() / 2, median)) {
+		char code[7] = {};
+		encodeScalar(median, reinterpret_cast<uint8_t*>(code));
+		bool valid = set.contains(median) && index.rank(median) == (index.numSetBits() / 2);
+		printf("  Median code: %s%s\n", code, valid ? "" : " (WARNING: invalid select)");
+	}
+
+	// Query times on random ranges and ranks
+	mt19937 rng(1);
+	vector<uint32_t> numbers(NUM_STATS_QUERIES * 2);
+	for (uint32_t& number : numbers) {
+		number = uint32_t(rng() % SEEN_SET_NUM_BITS);
+	}
+	uint64_t checksum = 0;
+	Clock::time_point start = Clock::now();
+	for (uint32_t i = 0; i < NUM_STATS_QUERIES; i++) {
+		checksum += index.countRange(min(numbers[2 * i], numbers[2 * i + 1]), max(numbers[2 * i], numbers[2 * i + 1]));
+	}
+	double rangeTimeMs = millisecondsSince(start);
+
+	uint32_t selected = 0;
+	start = Clock::now();
+	for (uint32_t i = 0; i < NUM_STATS_QUERIES && index.numSetBits() != 0; i++) {
+		index.select(numbers[i] % index.numSetBits(), selected);
+		checksum += selected;
+	}
+	double selectTimeMs = millisecondsSince(start);
+
+	// A single range scan for comparison, the average random range is a third of the universe
+	start = Clock::now();
+	checksum += scanCountRange(set, 0, uint32_t(SEEN_SET_NUM_BITS / 3));
+	double scanTimeMs = millisecondsSince(start);
+
+	printf("  Range count: %.1f ns/query, select: %.1f ns/query, scan of a third: %.3f ms (checksum %llu)\n\n",
+	       rangeTimeMs * 1000000.0 / NUM_STATS_QUERIES, selectTimeMs * 1000000.0 / NUM_STATS_QUERIES,
+	       scanTimeMs, (unsigned long long)checksum);
+}
@@ -0,0 +1,68 @@
+// Copyright(c) Peter Hillerstrm(skipifzero.com, peter@hstroem.se)
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// Seen-set rank/select index
+// ------------------------------------------------------------------------------------------------
+
+// An index over a seen-set (see SeenSetSnapshot.hpp) answering ordered queries without rescanning
+// the bitset, e.g. the number of distinct codes in "ABC000"-"ABF999" or the k-th smallest code.
+//
+// * Rank: The number of set bits before each 512 bit (64 byte) block is stored, so a rank is one
+//         table lookup plus at most 8 popcounts, constant time.
+// * Select: The block of every SELECT_SAMPLE_RATE:th set bit is stored, so a select is a binary
+//           search over the block ranks between two samples, followed by a scan of one block and
+//           a pdep+tzcnt within a word.
+//
+// The index references the bitset, which must outlive it and not be modified while it is in use.
+// After modifying the bitset the index has to be rebuilt.
+
+static const uint64_t RANK_INDEX_BITS_PER_BLOCK = 512;
+static const uint64_t RANK_INDEX_NUM_BLOCKS = (17576000 + 511) / 512;
+static const uint64_t RANK_INDEX_SELECT_SAMPLE_RATE = 8192;
+
+class SeenSetRankIndex final {
+public:
+	SeenSetRankIndex() noexcept = default;
+	SeenSetRankIndex(const SeenSetRankIndex&) = delete;
+	SeenSetRankIndex& operator= (const SeenSetRankIndex&) = delete;
+	~SeenSetRankIndex() noexcept { this->destroy(); }
+
+	// Builds the index over the bitset (SEEN_SET_NUM_BITS bits), blocks split among numThreads
+	bool build(const uint64_t* bitset, uint32_t numThreads = 3) noexcept;
+	void destroy() noexcept;
+
+	bool isBuilt() const noexcept { return mBitset != nullptr; }
+	uint64_t numSetBits() const noexcept { return mNumSetBits; }
+
+	bool contains(uint32_t number) const noexcept
+	{
+		return (mBitset[number >> 6u] & (uint64_t(1) << (number & 0x0000003Fu))) != uint64_t(0);
+	}
+
+	// Number of codes with an index less than number, number may be SEEN_SET_NUM_BITS
+	uint64_t rank(uint32_t number) const noexcept;
+
+	// Number of codes in [firstNumber, lastNumber], inclusive
+	uint64_t countRange(uint32_t firstNumber, uint32_t lastNumber) const noexcept
+	{
+		return lastNumber < firstNumber ? 0 : (this->rank(lastNumber + 1) - this->rank(firstNumber));
+	}
+
+	// Writes the index of the k-th smallest code (0 is the smallest) to numberOut, returns false if
+	// k >= numSetBits()
+	bool select(uint64_t k, uint32_t& numberOut) const noexcept;
+
+private:
+	const uint64_t* mBitset = nullptr;
+	std::vector<uint32_t> mBlockRanks; // RANK_INDEX_NUM_BLOCKS + 1 entries, last is numSetBits
+	std::vector<uint32_t> mSelectSamples; // Block of set bit i * RANK_INDEX_SELECT_SAMPLE_RATE
+	uint64_t mNumSetBits = 0;
+};
+
+// Builds the seen-set of the specified file and an index over it, prints build times, example
+// queries and query times compared to scanning the bitset
+void printRankIndexStats(const char* filePath) noexcept;
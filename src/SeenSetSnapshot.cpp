@@ -0,0 +1,351 @@
+// Copyright(c) Peter Hillerstrm(skipifzero.com, peter@hstroem.se)
+
+#include "SeenSetSnapshot.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#include <immintrin.h>
+
+#include "Crc32c.hpp"
+
+using namespace std;
+
+// Constants
+// ------------------------------------------------------------------------------------------------
+
+static const uint64_t NUM_BITSET_WORDS = SEEN_SET_NUM_BYTES / sizeof(uint64_t);
+static_assert((SEEN_SET_NUM_BITS % 64) == 0, "Bitset must be whole words");
+
+// Max bytes of a LEB128 varint holding a 64 bit value
+static const uint64_t MAX_VARINT_BYTES = 10;
+
+// Helpers
+// ------------------------------------------------------------------------------------------------
+
+static uint64_t countSetBits(const uint64_t* bitset) noexcept
+{
+	uint64_t numSetBits = 0;
+	for (uint64_t i = 0; i < NUM_BITSET_WORDS; i++) {
+		numSetBits += uint64_t(_mm_popcnt_u64(bitset[i]));
+	}
+	return numSetBits;
+}
+
+static bool validHeader(const SeenSetSnapshotHeader& header, uint64_t fileSize) noexcept
+{
+	bool valid = header.magic == SEEN_SET_SNAPSHOT_MAGIC &&
+	             header.version == SEEN_SET_SNAPSHOT_VERSION &&
+	             header.numBits == SEEN_SET_NUM_BITS &&
+	             header.numSetBits <= SEEN_SET_NUM_BITS &&
+	             header.payloadOffset >= sizeof(SeenSetSnapshotHeader) &&
+	             header.payloadOffset <= fileSize &&
+	             header.payloadBytes == (fileSize - header.payloadOffset);
+	if (header.encoding == uint32_t(SeenSetEncoding::RAW)) {
+		valid = valid && header.payloadOffset == SEEN_SET_RAW_PAYLOAD_OFFSET &&
+		        header.payloadBytes == SEEN_SET_NUM_BYTES;
+	}
+	else if (header.encoding != uint32_t(SeenSetEncoding::RLE)) {
+		valid = false;
+	}
+	return valid;
+}
+
+// Run-length encoding
+// ------------------------------------------------------------------------------------------------
+
+// First position >= pos where the bit equals value, or SEEN_SET_NUM_BITS if there is none
+static uint64_t findNextBit(const uint64_t* bitset, uint64_t pos, bool value) noexcept
+{
+	const uint64_t invertMask = value ? uint64_t(0) : ~uint64_t(0);
+	uint64_t wordIndex = pos >> 6;
+	if (wordIndex >= NUM_BITSET_WORDS) return SEEN_SET_NUM_BITS;
+
+	// Ignore bits before pos in the first word
+	uint64_t word = (bitset[wordIndex] ^ invertMask) & (~uint64_t(0) << (pos & 63));
+	while (word == 0) {
+		wordIndex += 1;
+		if (wordIndex >= NUM_BITSET_WORDS) return SEEN_SET_NUM_BITS;
+		word = bitset[wordIndex] ^ invertMask;
+	}
+	return (wordIndex << 6) + uint64_t(_tzcnt_u64(word));
+}
+
+// Sets the bits in [first, last)
+static void setBitRange(uint64_t* bitset, uint64_t first, uint64_t last) noexcept
+{
+	if (first >= last) return;
+	uint64_t firstWord = first >> 6;
+	uint64_t lastWord = (last - 1) >> 6;
+	uint64_t firstMask = ~uint64_t(0) << (first & 63);
+	uint64_t lastMask = ~uint64_t(0) >> (63 - ((last - 1) & 63));
+	if (firstWord == lastWord) {
+		bitset[firstWord] |= firstMask & lastMask;
+		return;
+	}
+	bitset[firstWord] |= firstMask;
+	for (uint64_t i = firstWord + 1; i < lastWord; i++) {
+		bitset[i] = ~uint64_t(0);
+	}
+	bitset[lastWord] |= lastMask;
+}
+
+static void writeVarint(vector<uint8_t>& out, uint64_t value) noexcept
+{
+	while (value >= 0x80) {
+		out.push_back(uint8_t(value | 0x80));
+		value >>= 7;
+	}
+	out.push_back(uint8_t(value));
+}
+
+static bool readVarint(const uint8_t* data, uint64_t size, uint64_t& pos, uint64_t& valueOut) noexcept
+{
+	uint64_t value = 0;
+	for (uint64_t i = 0; i < MAX_VARINT_BYTES && pos < size; i++) {
+		uint8_t byte = data[pos++];
+		value |= uint64_t(byte & 0x7F) << (7 * i);
+		if ((byte & 0x80) == 0) {
+			valueOut = value;
+			return true;
+		}
+	}
+	return false;
+}
+
+static void encodeRle(const uint64_t* bitset, vector<uint8_t>& payloadOut) noexcept
+{
+	payloadOut.clear();
+	uint64_t pos = 0;
+	bool value = false;
+	while (pos < SEEN_SET_NUM_BITS) {
+		uint64_t runEnd = findNextBit(bitset, pos, !value);
+		writeVarint(payloadOut, runEnd - pos);
+		pos = runEnd;
+		value = !value;
+	}
+}
+
+// Decodes into a cleared bitset, fails if the runs don't add up to exactly SEEN_SET_NUM_BITS
+static bool decodeRle(const uint8_t* payload, uint64_t payloadBytes, uint64_t* bitset) noexcept
+{
+	uint64_t payloadPos = 0;
+	uint64_t pos = 0;
+	bool value = false;
+	while (payloadPos < payloadBytes) {
+		uint64_t runLength = 0;
+		if (!readVarint(payload, payloadBytes, payloadPos, runLength)) return false;
+		if (runLength > (SEEN_SET_NUM_BITS - pos)) return false;
+		if (value) setBitRange(bitset, pos, pos + runLength);
+		pos += runLength;
+		value = !value;
+	}
+	return pos == SEEN_SET_NUM_BITS;
+}
+
+// Saving
+// ------------------------------------------------------------------------------------------------
+
+bool saveSeenSet(const char* path, const uint64_t* bitset, SeenSetEncoding encoding) noexcept
+{
+	// Encode payload
+	const uint8_t* payload = reinterpret_cast<const uint8_t*>(bitset);
+	uint64_t payloadBytes = SEEN_SET_NUM_BYTES;
+	uint64_t payloadOffset = SEEN_SET_RAW_PAYLOAD_OFFSET;
+	vector<uint8_t> rlePayload;
+	if (encoding == SeenSetEncoding::RLE) {
+		encodeRle(bitset, rlePayload);
+		payload = rlePayload.data();
+		payloadBytes = rlePayload.size();
+		payloadOffset = sizeof(SeenSetSnapshotHeader);
+	}
+
+	// Create header, padded with zeroes up to the payload
+	vector<uint8_t> headerBytes(payloadOffset, 0);
+	SeenSetSnapshotHeader header;
+	header.magic = SEEN_SET_SNAPSHOT_MAGIC;
+	header.version = SEEN_SET_SNAPSHOT_VERSION;
+	header.encoding = uint32_t(encoding);
+	header.checksum = crc32c(payload, payloadBytes);
+	header.numBits = SEEN_SET_NUM_BITS;
+	header.numSetBits = countSetBits(bitset);
+	header.payloadOffset = payloadOffset;
+	header.payloadBytes = payloadBytes;
+	memcpy(headerBytes.data(), &header, sizeof(SeenSetSnapshotHeader));
+
+	// Write snapshot to a temporary file next to the destination, so an existing snapshot is only
+	// replaced once the new one is complete
+	string tmpPath = string(path) + ".tmp";
+	HANDLE file = CreateFile(tmpPath.c_str(), GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE) {
+		printf("CreateFile() failed\n");
+		return false;
+	}
+	DWORD numWritten = 0;
+	bool success = WriteFile(file, headerBytes.data(), DWORD(payloadOffset), &numWritten, NULL) &&
+	               numWritten == DWORD(payloadOffset);
+	success = success && WriteFile(file, payload, DWORD(payloadBytes), &numWritten, NULL) &&
+	          numWritten == DWORD(payloadBytes);
+	if (!success) {
+		printf("WriteFile() failed\n");
+	}
+
+	// Flush so the snapshot is durable before it replaces the old one
+	if (success && !FlushFileBuffers(file)) {
+		printf("FlushFileBuffers() failed\n");
+		success = false;
+	}
+	CloseHandle(file);
+
+	// Replace destination
+	if (success && !MoveFileEx(tmpPath.c_str(), path, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH)) {
+		printf("MoveFileEx() failed\n");
+		success = false;
+	}
+	if (!success) DeleteFile(tmpPath.c_str());
+	return success;
+}
+
+// Loading
+// ------------------------------------------------------------------------------------------------
+
+bool loadSeenSet(const char* path, uint64_t* bitsetOut) noexcept
+{
+	// Read file
+	HANDLE file = CreateFile(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+	                         FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (file == INVALID_HANDLE_VALUE) {
+		printf("CreateFile() failed\n");
+		return false;
+	}
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize) || uint64_t(fileSize.QuadPart) < sizeof(SeenSetSnapshotHeader)) {
+		printf("File too small to be a seen-set snapshot\n");
+		CloseHandle(file);
+		return false;
+	}
+	vector<uint8_t> contents(size_t(fileSize.QuadPart));
+	DWORD numRead = 0;
+	bool success = ReadFile(file, contents.data(), DWORD(contents.size()), &numRead, NULL) &&
+	               numRead == DWORD(contents.size());
+	CloseHandle(file);
+	if (!success) {
+		printf("ReadFile() failed\n");
+		return false;
+	}
+
+	// Validate header and checksum
+	SeenSetSnapshotHeader header;
+	memcpy(&header, contents.data(), sizeof(SeenSetSnapshotHeader));
+	if (!validHeader(header, contents.size())) {
+		printf("Invalid seen-set snapshot header\n");
+		return false;
+	}
+	const uint8_t* payload = contents.data() + header.payloadOffset;
+	if (crc32c(payload, header.payloadBytes) != header.checksum) {
+		printf("Seen-set snapshot checksum mismatch\n");
+		return false;
+	}
+
+	// Decode payload into a temporary bitset for RLE, so the output is untouched on failure
+	if (header.encoding == uint32_t(SeenSetEncoding::RLE)) {
+		vector<uint64_t> decoded(NUM_BITSET_WORDS, 0);
+		if (!decodeRle(payload, header.payloadBytes, decoded.data()) ||
+		    countSetBits(decoded.data()) != header.numSetBits) {
+			printf("Invalid seen-set snapshot payload\n");
+			return false;
+		}
+		memcpy(bitsetOut, decoded.data(), SEEN_SET_NUM_BYTES);
+	}
+	else {
+		if (countSetBits(reinterpret_cast<const uint64_t*>(payload)) != header.numSetBits) {
+			printf("Invalid seen-set snapshot payload\n");
+			return false;
+		}
+		memcpy(bitsetOut, payload, SEEN_SET_NUM_BYTES);
+	}
+	return true;
+}
+
+// Mapped seen-set
+// ------------------------------------------------------------------------------------------------
+
+bool MappedSeenSet::open(const char* path, bool verifyChecksum) noexcept
+{
+	this->close();
+
+	// Open file
+	HANDLE file = CreateFile(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+	                         FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE) {
+		printf("CreateFile() failed\n");
+		return false;
+	}
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize) || uint64_t(fileSize.QuadPart) < sizeof(SeenSetSnapshotHeader)) {
+		printf("File too small to be a seen-set snapshot\n");
+		CloseHandle(file);
+		return false;
+	}
+
+	// Create copy-on-write mapping
+	HANDLE mapping = CreateFileMapping(file, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+	if (!mapping) {
+		printf("CreateFileMapping() failed\n");
+		CloseHandle(file);
+		return false;
+	}
+	void* view = MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, uint64_t(fileSize.QuadPart));
+	if (!view) {
+		printf("MapViewOfFile() failed\n");
+		CloseHandle(mapping);
+		CloseHandle(file);
+		return false;
+	}
+	mFile = file;
+	mMapping = mapping;
+	mView = view;
+
+	// Validate header, only RAW snapshots can be mapped
+	SeenSetSnapshotHeader header;
+	memcpy(&header, view, sizeof(SeenSetSnapshotHeader));
+	if (!validHeader(header, uint64_t(fileSize.QuadPart)) || header.encoding != uint32_t(SeenSetEncoding::RAW)) {
+		printf("Invalid or non RAW seen-set snapshot\n");
+		this->close();
+		return false;
+	}
+	uint8_t* payload = static_cast<uint8_t*>(view) + header.payloadOffset;
+	if (verifyChecksum && crc32c(payload, header.payloadBytes) != header.checksum) {
+		printf("Seen-set snapshot checksum mismatch\n");
+		this->close();
+		return false;
+	}
+	if (verifyChecksum && countSetBits(reinterpret_cast<const uint64_t*>(payload)) != header.numSetBits) {
+		printf("Invalid seen-set snapshot payload\n");
+		this->close();
+		return false;
+	}
+
+	mBitset = reinterpret_cast<uint64_t*>(payload);
+	mNumSetBits = header.numSetBits;
+	return true;
+}
+
+void MappedSeenSet::close() noexcept
+{
+	if (mView != nullptr) UnmapViewOfFile(mView);
+	if (mMapping != nullptr) CloseHandle(mMapping);
+	if (mFile != nullptr) CloseHandle(mFile);
+	mFile = nullptr;
+	mMapping = nullptr;
+	mView = nullptr;
+	mBitset = nullptr;
+	mNumSetBits = 0;
+}
@@ -0,0 +1,84 @@
+// Copyright(c) Peter Hillerstrm(skipifzero.com, peter@hstroem.se)
+
+#pragma once
+
+#include <cstdint>
+
+// Seen-set snapshot format
+// ------------------------------------------------------------------------------------------------
+
+// A seen-set is the bitset used by all the algorithms, 17576000 bits (2197000 bytes) where bit i
+// is set if the code with index i has been seen. A snapshot of a seen-set lets a process resume
+// from an earlier state without rescanning the codes it was built from.
+//
+// A snapshot file consists of a SeenSetSnapshotHeader followed by a payload at payloadOffset. Two
+// encodings are available:
+// * RAW: The bitset as is. The payload starts at SEEN_SET_RAW_PAYLOAD_OFFSET so it is page aligned
+//        in the file, and the snapshot can be mapped directly (see MappedSeenSet).
+// * RLE: Lengths of alternating runs of clear and set bits, starting with clear bits. Each length
+//        is a LEB128 varint (7 bits per byte, high bit set on all but the last byte). Small for
+//        sparse sets and for sets built from consecutive codes, but
+//        up to ~4x larger than RAW for dense random sets.
+
+static const uint32_t SEEN_SET_SNAPSHOT_MAGIC = 0x4E454553u; // "SEEN"
+static const uint32_t SEEN_SET_SNAPSHOT_VERSION = 1;
+
+static const uint64_t SEEN_SET_NUM_BITS = 17576000;
+static const uint64_t SEEN_SET_NUM_BYTES = SEEN_SET_NUM_BITS / 8;
+static const uint64_t SEEN_SET_RAW_PAYLOAD_OFFSET = 4096;
+
+enum class SeenSetEncoding : uint32_t {
+	RAW = 0,
+	RLE = 1
+};
+
+struct SeenSetSnapshotHeader final {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t encoding;
+	uint32_t checksum; // CRC-32C of the payload
+	uint64_t numBits; // Always SEEN_SET_NUM_BITS
+	uint64_t numSetBits;
+	uint64_t payloadOffset;
+	uint64_t payloadBytes;
+};
+static_assert(sizeof(SeenSetSnapshotHeader) == 48, "SeenSetSnapshotHeader is padded");
+
+// Writes a snapshot of the bitset (SEEN_SET_NUM_BYTES bytes) to the specified path. The snapshot is
+// written to "<path>.tmp" and then moved into place, so an existing snapshot at the path is either
+// kept or fully replaced.
+bool saveSeenSet(const char* path, const uint64_t* bitset, SeenSetEncoding encoding) noexcept;
+
+// Reads a snapshot of any encoding into the bitset (SEEN_SET_NUM_BYTES bytes), verifying the
+// header and checksum. The bitset is unmodified on failure.
+bool loadSeenSet(const char* path, uint64_t* bitsetOut) noexcept;
+
+// Mapped seen-set
+// ------------------------------------------------------------------------------------------------
+
+// A RAW snapshot mapped copy-on-write, loading is instant since pages are read on first access.
+// The bitset may be modified, modified pages become private to the process and the file is left
+// untouched.
+class MappedSeenSet final {
+public:
+	MappedSeenSet() noexcept = default;
+	MappedSeenSet(const MappedSeenSet&) = delete;
+	MappedSeenSet& operator= (const MappedSeenSet&) = delete;
+	~MappedSeenSet() noexcept { this->close(); }
+
+	// Verifying the checksum (and the number of set bits) reads the entire payload, which defeats
+	// the lazy loading
+	bool open(const char* path, bool verifyChecksum) noexcept;
+	void close() noexcept;
+
+	bool isOpen() const noexcept { return mView != nullptr; }
+	uint64_t* bitset() const noexcept { return mBitset; }
+	uint64_t numSetBits() const noexcept { return mNumSetBits; }
+
+private:
+	void* mFile = nullptr;
+	void* mMapping = nullptr;
+	void* mView = nullptr;
+	uint64_t* mBitset = nullptr;
+	uint64_t mNumSetBits = 0;
+};
@@ -0,0 +1,150 @@
+// Copyright(c) Peter Hillerstrm(skipifzero.com, peter@hstroem.se)
+
+#include "SeenSetSnapshotBenchmark.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+
+#include "PlateDecoders.hpp"
+#include "SeenSetSnapshot.hpp"
+
+using namespace std;
+
+// Constants
+// ------------------------------------------------------------------------------------------------
+
+static const uint64_t BYTES_PER_CODE = 8;
+static const uint64_t NUM_BITSET_WORDS = SEEN_SET_NUM_BYTES / sizeof(uint64_t);
+
+static const char* RAW_SNAPSHOT_PATH = "SeenSetBenchmark.raw.snapshot";
+static const char* RLE_SNAPSHOT_PATH = "SeenSetBenchmark.rle.snapshot";
+
+typedef chrono::high_resolution_clock Clock;
+
+// Helpers
+// ------------------------------------------------------------------------------------------------
+
+static double millisecondsSince(Clock::time_point start) noexcept
+{
+	return chrono::duration<double, milli>(Clock::now() - start).count();
+}
+
+static double toMiB(uint64_t numBytes) noexcept
+{
+	return double(numBytes) / (1024.0 * 1024.0);
+}
+
+static uint64_t fileSizeOf(const char* path) noexcept
+{
+	HANDLE file = CreateFile(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE) return 0;
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize)) fileSize.QuadPart = 0;
+	CloseHandle(file);
+	return uint64_t(fileSize.QuadPart);
+}
+
+// Reads the text file and inserts all its codes into the cleared bitset, returns the number of
+// bytes read or 0 on failure
+static uint64_t rebuildFromText(const char* filePath, uint64_t* bitset) noexcept
+{
+	FILE* file = fopen(filePath, "rb");
+	if (file == nullptr) return 0;
+	vector<uint8_t> text;
+	uint8_t buffer[4096];
+	size_t numRead;
+	while ((numRead = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+		text.insert(text.end(), buffer, buffer + numRead);
+	}
+	fclose(file);
+
+	uint64_t numCodes = text.size() / BYTES_PER_CODE;
+	for (uint64_t i = 0; i < numCodes; i++) {
+		uint32_t number = decodeScalar(text.data() + i * BYTES_PER_CODE);
+		bitset[number >> 6u] |= uint64_t(1) << (number & 0x0000003Fu);
+	}
+	return text.size();
+}
+
+static void printResult(const char* name, double milliseconds, uint64_t memoryBytes, bool correct) noexcept
+{
+	printf("  %-22s %8.2f ms, %6.2f MiB%s\n", name, milliseconds, toMiB(memoryBytes),
+	       correct ? "" : " (INCORRECT)");
+}
+
+// Exposed function
+// ------------------------------------------------------------------------------------------------
+
+void benchmarkSeenSetSnapshots(const char* filePath) noexcept
+{
+	vector<uint64_t> reference(NUM_BITSET_WORDS, 0);
+	vector<uint64_t> loaded(NUM_BITSET_WORDS, 0);
+
+	// Rebuild from text, the baseline. Memory is the text plus the bitset.
+	Clock::time_point startTime = Clock::now();
+	uint64_t textBytes = rebuildFromText(filePath, reference.data());
+	double rebuildMilliseconds = millisecondsSince(startTime);
+	if (textBytes == 0) {
+		printf("Could not read \"%s\" for seen-set snapshot benchmark\n", filePath);
+		return;
+	}
+
+	// Save snapshots
+	startTime = Clock::now();
+	bool savedRaw = saveSeenSet(RAW_SNAPSHOT_PATH, reference.data(), SeenSetEncoding::RAW);
+	double saveRawMilliseconds = millisecondsSince(startTime);
+	startTime = Clock::now();
+	bool savedRle = saveSeenSet(RLE_SNAPSHOT_PATH, reference.data(), SeenSetEncoding::RLE);
+	double saveRleMilliseconds = millisecondsSince(startTime);
+	if (!savedRaw || !savedRle) {
+		printf("Could not save seen-set snapshots\n");
+		DeleteFile(RAW_SNAPSHOT_PATH);
+		DeleteFile(RLE_SNAPSHOT_PATH);
+		return;
+	}
+	uint64_t rawBytes = fileSizeOf(RAW_SNAPSHOT_PATH);
+	uint64_t rleBytes = fileSizeOf(RLE_SNAPSHOT_PATH);
+
+	printf("Seen-set snapshots of \"%s\"\n", filePath);
+	printf("  Saved RAW in %.2f ms (%.2f MiB), RLE in %.2f ms (%.2f MiB)\n",
+	       saveRawMilliseconds, toMiB(rawBytes), saveRleMilliseconds, toMiB(rleBytes));
+	printResult("Rebuild from text", rebuildMilliseconds, textBytes + SEEN_SET_NUM_BYTES, true);
+
+	// Load RAW, the file is read into a temporary buffer and copied into the bitset
+	memset(loaded.data(), 0, SEEN_SET_NUM_BYTES);
+	startTime = Clock::now();
+	bool success = loadSeenSet(RAW_SNAPSHOT_PATH, loaded.data());
+	double milliseconds = millisecondsSince(startTime);
+	printResult("Load RAW", milliseconds, rawBytes + SEEN_SET_NUM_BYTES, success && loaded == reference);
+
+	// Load RLE, decoded into a temporary bitset and copied
+	memset(loaded.data(), 0, SEEN_SET_NUM_BYTES);
+	startTime = Clock::now();
+	success = loadSeenSet(RLE_SNAPSHOT_PATH, loaded.data());
+	milliseconds = millisecondsSince(startTime);
+	printResult("Load RLE", milliseconds, rleBytes + 2 * SEEN_SET_NUM_BYTES, success && loaded == reference);
+
+	// Map RAW, pages are shared with the file cache until written to so no private memory is used.
+	// The first access of every page is timed separately through the comparison.
+	for (bool verifyChecksum : { false, true }) {
+		MappedSeenSet mapped;
+		startTime = Clock::now();
+		success = mapped.open(RAW_SNAPSHOT_PATH, verifyChecksum);
+		double openMilliseconds = millisecondsSince(startTime);
+		startTime = Clock::now();
+		bool correct = success && memcmp(mapped.bitset(), reference.data(), SEEN_SET_NUM_BYTES) == 0;
+		double touchMilliseconds = millisecondsSince(startTime);
+		printResult(verifyChecksum ? "Map RAW (verified)" : "Map RAW", openMilliseconds, 0, correct);
+		printf("  %-22s %8.2f ms to touch all pages\n", "", touchMilliseconds);
+	}
+
+	DeleteFile(RAW_SNAPSHOT_PATH);
+	DeleteFile(RLE_SNAPSHOT_PATH);
+}
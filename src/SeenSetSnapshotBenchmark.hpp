@@ -0,0 +1,8 @@
+// Copyright(c) Peter Hillerstrm(skipifzero.com, peter@hstroem.se)
+
+#pragma once
+
+// Builds the seen-set of the codes in the specified file and compares rebuilding it from the text
+// against reloading it from the snapshots of SeenSetSnapshot.hpp. Prints time, file size and memory
+// used by each method, and verifies that every reloaded seen-set equals the rebuilt one.
+void benchmarkSeenSetSnapshots(const char* filePath) noexcept;
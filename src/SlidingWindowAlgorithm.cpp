@@ -0,0 +1,267 @@
+// Copyright(c) Peter Hillerstrm(skipifzero.com, peter@hstroem.se)
+
+#include "SlidingWindowAlgorithm.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#include <immintrin.h>
+
+#include "PlateDecoders.hpp"
+
+using namespace std;
+
+// Constants
+// ------------------------------------------------------------------------------------------------
+
+static const uint64_t MAX_NUMBER_CODES = 17576000;
+static const uint64_t BYTES_PER_CODE = 8; // Assumes Windows file endings (2 bytes per newline)
+static const uint64_t NUM_LAST_SEEN_BYTES = MAX_NUMBER_CODES * sizeof(uint32_t);
+
+static const uint32_t NUM_THREADS = 3;
+static const uint64_t NUM_CODES_MULTI_THREADED_THRESHOLD = 600000;
+
+// Number of codes decoded (and their last seen entries prefetched) ahead of the code currently
+// being checked, as in PrefetchAlgorithm. Must be a power of two.
+static const uint64_t PREFETCH_DISTANCE = 16;
+static_assert((PREFETCH_DISTANCE & (PREFETCH_DISTANCE - 1)) == 0, "Must be power of two");
+
+// Number of codes between each check of whether another thread found a repeat
+static const uint64_t STOP_CHECK_INTERVAL = 4096;
+
+static const uint32_t PRINTED_WINDOWS[] = { 1000, 100000, SLIDING_WINDOW_UNBOUNDED };
+
+// Sliding window index
+// ------------------------------------------------------------------------------------------------
+
+bool SlidingWindowIndex::create() noexcept
+{
+	this->destroy();
+	mLastSeen = static_cast<uint32_t*>(VirtualAlloc(NULL, NUM_LAST_SEEN_BYTES, MEM_RESERVE | MEM_COMMIT,
+	                                                PAGE_READWRITE));
+	if (mLastSeen == nullptr) {
+		printf("VirtualAlloc() failed\n");
+		return false;
+	}
+	return true;
+}
+
+void SlidingWindowIndex::destroy() noexcept
+{
+	if (mLastSeen != nullptr) VirtualFree(mLastSeen, 0, MEM_RELEASE);
+	mLastSeen = nullptr;
+}
+
+// Search
+// ------------------------------------------------------------------------------------------------
+
+// Records the codes in range [firstCode, lastCode), reporting repeats within the window for the
+// codes from reportFrom. Stops at the first repeat if stopAtFirst, or when stop is set.
+static void scanRange(const uint8_t* __restrict fileView, SlidingWindowIndex& index, uint64_t firstCode,
+                      uint64_t reportFrom, uint64_t lastCode, uint32_t window, bool stopAtFirst,
+                      atomic_bool& stop, vector<WindowRepeat>& repeatsOut) noexcept
+{
+	const uint32_t* lastSeen = index.lastSeen();
+
+	// Ring buffer of decoded numbers that have been prefetched but not yet checked
+	uint32_t pipeline[PREFETCH_DISTANCE];
+	uint64_t numAhead = min(PREFETCH_DISTANCE, lastCode - firstCode);
+	for (uint64_t i = 0; i < numAhead; i++) {
+		uint32_t number = decodeScalar(fileView + (firstCode + i) * BYTES_PER_CODE);
+		_mm_prefetch(reinterpret_cast<const char*>(lastSeen + number), _MM_HINT_T0);
+		pipeline[i] = number;
+	}
+
+	for (uint64_t i = firstCode; i < lastCode; i++) {
+		if (((i - firstCode) % STOP_CHECK_INTERVAL) == 0 && stop.load(memory_order_relaxed)) return;
+
+		uint32_t slot = uint32_t(i - firstCode) & uint32_t(PREFETCH_DISTANCE - 1);
+		uint32_t number = pipeline[slot];
+
+		// Decode and prefetch code PREFETCH_DISTANCE ahead, reusing the slot just emptied
+		uint64_t aheadIndex = i + PREFETCH_DISTANCE;
+		if (aheadIndex < lastCode) {
+			uint32_t aheadNumber = decodeScalar(fileView + aheadIndex * BYTES_PER_CODE);
+			_mm_prefetch(reinterpret_cast<const char*>(lastSeen + aheadNumber), _MM_HINT_T0);
+			pipeline[slot] = aheadNumber;
+		}
+
+		// Records are stamped with their index, files are smaller than 2^32 records
+		uint32_t previous = index.exchange(number, uint32_t(i));
+		if (previous == SLIDING_WINDOW_NEVER_SEEN || i < reportFrom) continue;
+		if ((uint32_t(i) - previous) <= window) {
+			WindowRepeat repeat;
+			repeat.index = i;
+			repeat.previousIndex = previous;
+			repeatsOut.push_back(repeat);
+			if (stopAtFirst) {
+				stop = true;
+				return;
+			}
+		}
+	}
+}
+
+static bool windowedSearch(const uint8_t* __restrict fileView, uint64_t numCodes, uint32_t window,
+                           uint32_t numThreads, bool stopAtFirst, vector<WindowRepeat>& repeatsOut) noexcept
+{
+	repeatsOut.clear();
+	atomic_bool stop(false);
+
+	// Every thread replays up to window records before its chunk, only worth it for short windows
+	uint64_t chunkSize = (numCodes + numThreads - 1) / max(numThreads, 1u);
+	if (numThreads <= 1 || numCodes <= NUM_CODES_MULTI_THREADED_THRESHOLD || uint64_t(window) >= (chunkSize / 2)) {
+		SlidingWindowIndex index;
+		if (!index.create()) return false;
+		scanRange(fileView, index, 0, 0, numCodes, window, stopAtFirst, stop, repeatsOut);
+		return true;
+	}
+
+	// Parallel variant, chunk i is checked by thread i after warming up on the window before it
+	vector<SlidingWindowIndex> indices(numThreads);
+	vector<vector<WindowRepeat>> threadRepeats(numThreads);
+	for (SlidingWindowIndex& index : indices) {
+		if (!index.create()) return false;
+	}
+	vector<thread> threads;
+	for (uint32_t i = 0; i < numThreads; i++) {
+		uint64_t chunkStart = min(i * chunkSize, numCodes);
+		uint64_t chunkEnd = min(chunkStart + chunkSize, numCodes);
+		uint64_t warmUpStart = chunkStart - min(chunkStart, uint64_t(window));
+		threads.emplace_back([&, i, chunkStart, chunkEnd, warmUpStart]() {
+			scanRange(fileView, indices[i], warmUpStart, chunkStart, chunkEnd, window, stopAtFirst, stop,
+			          threadRepeats[i]);
+		});
+	}
+	for (thread& t : threads) {
+		t.join();
+	}
+
+	// Concatenate in chunk order, which is file order
+	for (const vector<WindowRepeat>& repeats : threadRepeats) {
+		repeatsOut.insert(repeatsOut.end(), repeats.begin(), repeats.end());
+	}
+	return true;
+}
+
+static bool searchFile(const char* filePath, uint32_t window, uint32_t numThreads, bool stopAtFirst,
+                       vector<WindowRepeat>& repeatsOut) noexcept
+{
+	// Open file
+	HANDLE file = CreateFile(filePath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+	                         FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (file == INVALID_HANDLE_VALUE) {
+		printf("CreateFile() failed\n");
+		return false;
+	}
+
+	// Get size of file
+	uint64_t fileSize = static_cast<uint64_t>(GetFileSize(file, NULL));
+	uint64_t numCodes = numCodesInText(fileSize, BYTES_PER_CODE);
+	if (numCodes == 0) {
+		CloseHandle(file);
+		repeatsOut.clear();
+		return true;
+	}
+
+	// Create mapped file
+	HANDLE mappedFile = CreateFileMapping(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (!mappedFile) {
+		printf("CreateFileMapping() failed\n");
+		CloseHandle(file);
+		return false;
+	}
+
+	// Create mapped file view
+	void* fileView = MapViewOfFile(mappedFile, FILE_MAP_READ, 0, 0, fileSize);
+	if (!fileView) {
+		printf("MapViewOfFile() failed\n");
+		CloseHandle(mappedFile);
+		CloseHandle(file);
+		return false;
+	}
+
+	// Search
+	bool success = windowedSearch(static_cast<const uint8_t*>(fileView), numCodes, window, numThreads,
+	                              stopAtFirst, repeatsOut);
+
+	// Unmap mapped file view
+	if (!UnmapViewOfFile(fileView)) {
+		printf("UnmapViewOfFile() failed\n");
+		CloseHandle(mappedFile);
+		CloseHandle(file);
+		return false;
+	}
+
+	// Close mapped file
+	if (!CloseHandle(mappedFile)) {
+		printf("CloseHandle() failed for mappedFile\n");
+		return false;
+	}
+
+	// Close file
+	if (!CloseHandle(file)) {
+		printf("CloseHandle() failed for file\n");
+		return false;
+	}
+
+	return success;
+}
+
+// Exposed functions
+// ------------------------------------------------------------------------------------------------
+
+bool slidingWindowSearch(const char* filePath, uint32_t windowRecords, uint32_t numThreads,
+                         vector<WindowRepeat>& repeatsOut) noexcept
+{
+	return searchFile(filePath, windowRecords, numThreads, false, repeatsOut);
+}
+
+bool slidingWindowAlgorithm(const char* filePath) noexcept
+{
+	// Large file fast path, only valid since the window is unbounded
+	HANDLE file = CreateFile(filePath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+	                         FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (file == INVALID_HANDLE_VALUE) {
+		printf("CreateFile() failed\n");
+		return false;
+	}
+	uint64_t fileSize = static_cast<uint64_t>(GetFileSize(file, NULL));
+	CloseHandle(file);
+	if (fileSize >= ((MAX_NUMBER_CODES + 1) * BYTES_PER_CODE)) return true;
+
+	vector<WindowRepeat> repeats;
+	if (!searchFile(filePath, SLIDING_WINDOW_UNBOUNDED, NUM_THREADS, true, repeats)) return false;
+	return !repeats.empty();
+}
+
+void printSlidingWindowStats(const char* filePath) noexcept
+{
+	printf("Sliding window repeats in \"%s\":\n", filePath);
+	for (uint32_t window : PRINTED_WINDOWS) {
+		vector<WindowRepeat> repeats[2];
+		double milliseconds[2];
+		for (uint32_t i = 0; i < 2; i++) {
+			auto startTime = chrono::high_resolution_clock::now();
+			slidingWindowSearch(filePath, window, i == 0 ? 1 : NUM_THREADS, repeats[i]);
+			milliseconds[i] = chrono::duration<double, milli>(chrono::high_resolution_clock::now() - startTime).count();
+		}
+		bool equal = repeats[0].size() == repeats[1].size() &&
+		             std::equal(repeats[0].begin(), repeats[0].end(), repeats[1].begin(),
+		                        [](const WindowRepeat& a, const WindowRepeat& b) {
+		                            return a.index == b.index && a.previousIndex == b.previousIndex;
+		                        });
+		printf("  Window %10u: %6zu repeats, 1 thread %.2f ms, %u threads %.2f ms%s\n", window, repeats[0].size(),
+		       milliseconds[0], NUM_THREADS, milliseconds[1], equal ? "" : " (MISMATCH)");
+	}
+	printf("\n");
+}
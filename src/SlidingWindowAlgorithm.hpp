@@ -0,0 +1,75 @@
+// Copyright(c) Peter Hillerstrm(skipifzero.com, peter@hstroem.se)
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// Sliding window index
+// ------------------------------------------------------------------------------------------------
+
+// Detects codes repeating within a window, e.g. the same plate read twice within the last W
+// readings or T seconds, rather than anywhere in the input. Keeps a direct-indexed array with the
+// last stamp each of the 17576000 codes was seen at. A stamp is a 32 bit sequence number in any
+// unit, record indices for windows in readings or timestamps for windows in time.
+//
+// The 70 MB array is allocated with VirtualAlloc(), whose pages are zeroed on first access, so
+// only pages holding codes actually seen use physical memory. Stamps are stored plus one, with 0
+// meaning never seen, so the largest usable stamp is 0xFFFFFFFE. Differences are computed modulo
+// 2^32, i.e. a code last seen more than 2^32 stamps ago may be reported as a repeat.
+
+static const uint32_t SLIDING_WINDOW_NEVER_SEEN = 0xFFFFFFFFu;
+static const uint32_t SLIDING_WINDOW_UNBOUNDED = 0xFFFFFFFFu;
+
+class SlidingWindowIndex final {
+public:
+	SlidingWindowIndex() noexcept = default;
+	SlidingWindowIndex(const SlidingWindowIndex&) = delete;
+	SlidingWindowIndex& operator= (const SlidingWindowIndex&) = delete;
+	~SlidingWindowIndex() noexcept { this->destroy(); }
+
+	bool create() noexcept;
+	void destroy() noexcept;
+
+	// Records the code as seen at the stamp, returns the stamp it was previously seen at or
+	// SLIDING_WINDOW_NEVER_SEEN
+	uint32_t exchange(uint32_t number, uint32_t stamp) noexcept
+	{
+		uint32_t previous = mLastSeen[number];
+		mLastSeen[number] = stamp + 1;
+		return previous - 1;
+	}
+
+	// Records the code and returns whether it was seen at most window stamps before
+	bool checkAndRecord(uint32_t number, uint32_t stamp, uint32_t window) noexcept
+	{
+		uint32_t previous = this->exchange(number, stamp);
+		return previous != SLIDING_WINDOW_NEVER_SEEN && uint32_t(stamp - previous) <= window;
+	}
+
+	const uint32_t* lastSeen() const noexcept { return mLastSeen; }
+
+private:
+	uint32_t* mLastSeen = nullptr;
+};
+
+// Windowed search
+// ------------------------------------------------------------------------------------------------
+
+struct WindowRepeat final {
+	uint64_t index; // Index of the repeating record
+	uint64_t previousIndex; // Index of the previous record with the same code
+};
+
+// Finds every record whose code also occurs at most windowRecords records earlier, in file order.
+// The parallel variant splits the file into one chunk per thread, each thread first replaying the
+// windowRecords records before its chunk without reporting, so results equal the single threaded
+// search. Returns false if the file can't be searched.
+bool slidingWindowSearch(const char* filePath, uint32_t windowRecords, uint32_t numThreads,
+                         std::vector<WindowRepeat>& repeatsOut) noexcept;
+
+// Unbounded window stopping at the first repeat, i.e. the same result as the other algorithms
+bool slidingWindowAlgorithm(const char* filePath) noexcept;
+
+// Prints number of repeats and time for a range of windows, single and multi-threaded
+void printSlidingWindowStats(const char* filePath) noexcept;
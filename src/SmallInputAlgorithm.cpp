@@ -0,0 +1,463 @@
+// Copyright(c) Peter Hillerstrm(skipifzero.com, peter@hstroem.se)
+
+#include "SmallInputAlgorithm.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#include <immintrin.h>
+#include <intrin.h>
+#include <malloc.h>
+
+#include "PlateDecoders.hpp"
+
+using namespace std;
+
+// Constants
+// ------------------------------------------------------------------------------------------------
+
+static const uint64_t MAX_NUMBER_CODES = 17576000;
+static const uint64_t BYTES_PER_CODE = 8; // Assumes Windows file endings (2 bytes per newline)
+static const uint64_t NUM_BITSET_BYTES = (MAX_NUMBER_CODES / 8);
+
+static const uint64_t NUM_THREADS = 3;
+static const uint64_t CODE_ALLOCATION_BATCH_SIZE = 4096;
+static const uint64_t NUM_CODES_MULTI_THREADED_THRESHOLD = 600000;
+
+// Files with at most this many codes are checked with the hash set instead of the bitset. The
+// measured crossover (unique codes, full scan) was between 128k and 256k codes. The threshold is
+// set below that so the hash set (at most 512 KiB) stays L2 resident, at 64k codes the hash set
+// was still about 1.7x as fast as the bitset.
+static const uint64_t NUM_CODES_HASH_SET_THRESHOLD = 65536;
+
+// Hash set constants
+static const uint32_t HASH_SET_EMPTY_SLOT = 0xFFFFFFFFu;
+static const uint64_t HASH_SET_SLOTS_PER_BUCKET = 8;
+static const uint64_t HASH_SET_MIN_NUM_BUCKETS = 8;
+
+// Small input variant
+// ------------------------------------------------------------------------------------------------
+
+// Open addressing hash set of code numbers. Each bucket is 8 slots (32 bytes), which are probed
+// together with AVX2 by comparing against both the number and the empty marker. Full buckets are
+// resolved with linear probing to the next bucket. The number of slots is a power of two at least
+// twice the number of codes, so buckets rarely fill up.
+static bool hashSetSearch(const uint8_t* __restrict fileView, uint64_t numCodes) noexcept
+{
+	// Calculate number of buckets, power of two with at least 2 slots per code
+	uint64_t numBuckets = HASH_SET_MIN_NUM_BUCKETS;
+	while ((numBuckets * HASH_SET_SLOTS_PER_BUCKET) < (numCodes * 2)) numBuckets *= 2;
+	const uint64_t bucketIndexMask = numBuckets - 1;
+
+	// Number of bits to shift the hash down to get a bucket index
+	unsigned long log2NumBuckets = 0;
+	_BitScanForward64(&log2NumBuckets, numBuckets);
+	const uint32_t hashShift = 32u - uint32_t(log2NumBuckets);
+
+	// Allocate slots and mark them as empty
+	const uint64_t numSlotBytes = numBuckets * HASH_SET_SLOTS_PER_BUCKET * sizeof(uint32_t);
+	uint32_t* slots = static_cast<uint32_t*>(_aligned_malloc(numSlotBytes, 32));
+	memset(slots, 0xFF, numSlotBytes);
+
+	// Variable containing whether a copy was found or not
+	bool foundCopy = false;
+
+	const __m256i EMPTY_SLOTS = _mm256_set1_epi32(int32_t(HASH_SET_EMPTY_SLOT));
+	for (uint64_t i = 0; i < (numCodes * BYTES_PER_CODE); i += BYTES_PER_CODE) {
+		uint8_t let3 = fileView[i];
+		uint8_t let2 = fileView[i + 1];
+		uint8_t let1 = fileView[i + 2];
+		uint8_t no3 = fileView[i + 3];
+		uint8_t no2 = fileView[i + 4];
+		uint8_t no1 = fileView[i + 5];
+
+		// Calculate corresponding number for code
+		uint32_t number = uint32_t(let3 - 'A') * 676000u +
+		                  uint32_t(let2 - 'A') * 26000u +
+		                  uint32_t(let1 - 'A') * 1000u +
+		                  uint32_t(no3 - '0') * 100u +
+		                  uint32_t(no2 - '0') * 10u +
+		                  uint32_t(no1 - '0');
+
+		// Fibonacci hashing, the high bits of the product are the best mixed
+		uint64_t bucketIndex = (number * 0x9E3779B1u) >> hashShift;
+		const __m256i numberVec = _mm256_set1_epi32(int32_t(number));
+
+		while (true) {
+			uint32_t* bucket = slots + bucketIndex * HASH_SET_SLOTS_PER_BUCKET;
+			const __m256i bucketVec = _mm256_load_si256(reinterpret_cast<const __m256i*>(bucket));
+
+			// Number already in set
+			const __m256i equal = _mm256_cmpeq_epi32(bucketVec, numberVec);
+			if (!_mm256_testz_si256(equal, equal)) {
+				foundCopy = true;
+				break;
+			}
+
+			// Insert number in first empty slot if there is one, slots are filled in order so
+			// there can't be a copy after an empty slot
+			uint32_t emptyMask = uint32_t(_mm256_movemask_ps(
+				_mm256_castsi256_ps(_mm256_cmpeq_epi32(bucketVec, EMPTY_SLOTS))));
+			if (emptyMask != 0) {
+				unsigned long slotIndex = 0;
+				_BitScanForward(&slotIndex, emptyMask);
+				bucket[slotIndex] = number;
+				break;
+			}
+
+			// Bucket full, try next one
+			bucketIndex = (bucketIndex + 1) & bucketIndexMask;
+		}
+
+		if (foundCopy) break;
+	}
+
+	// Free allocated hash set memory
+	_aligned_free(slots);
+
+	// Return result
+	return foundCopy;
+}
+
+// Single threaded variant
+// ------------------------------------------------------------------------------------------------
+
+static bool singleThreadedSearch(const uint8_t* __restrict fileView, uint64_t fileSize) noexcept
+{
+	// Allocate bitset buffer for whether a number is found or not, and clear it
+	uint64_t* isFoundBitset = static_cast<uint64_t*>(_aligned_malloc(NUM_BITSET_BYTES, 32));
+	memset(isFoundBitset, 0, NUM_BITSET_BYTES);
+
+	// Variable containing whether a copy was found or not
+	bool foundCopy = false;
+
+	for (size_t i = 0; i < fileSize; i += BYTES_PER_CODE) {
+		char let3 = fileView[i];
+		char let2 = fileView[i + 1];
+		char let1 = fileView[i + 2];
+		char no3 = fileView[i + 3];
+		char no2 = fileView[i + 4];
+		char no1 = fileView[i + 5];
+
+		// Calculate corresponding number for code
+		uint32_t number = uint32_t(let3 - 'A') * 676000u +
+		                  uint32_t(let2 - 'A') * 26000u +
+		                  uint32_t(let1 - 'A') * 1000u +
+		                  uint32_t(no3 - '0') * 100u +
+		                  uint32_t(no2 - '0') * 10u +
+		                  uint32_t(no1 - '0');
+
+		uint32_t bitsetChunkIndex = number >> 6u; // number / 64;
+		uint32_t bitIndex = number & 0x0000003Fu; // number % 64;
+
+		uint64_t chunk = isFoundBitset[bitsetChunkIndex];
+		uint64_t bitMask = uint64_t(1) << bitIndex;
+		
+		bool exists = (bitMask & chunk) != 0;
+
+		if (exists) {
+			foundCopy = true;
+			break;
+		}
+
+		chunk = bitMask | chunk;
+		isFoundBitset[bitsetChunkIndex] = chunk;
+	}
+
+	// Free allocated bitset memory
+	_aligned_free(isFoundBitset);
+
+	// Return result
+	return foundCopy;
+}
+
+// Multi-threaded variant
+// ------------------------------------------------------------------------------------------------
+
+static bool mergeBitsets(uint64_t* bitsets[NUM_THREADS]) noexcept
+{
+	if (NUM_THREADS == 2) {
+		for (size_t i = 0; i < (NUM_BITSET_BYTES / sizeof(uint64_t)); i++) {
+			uint64_t b1 = bitsets[0][i];
+			uint64_t b2 = bitsets[1][i];
+			if ((b1 & b2) != uint64_t(0)) return true;
+		}
+	}
+
+	else if (NUM_THREADS == 3) {
+		for (size_t i = 0; i < (NUM_BITSET_BYTES / sizeof(uint64_t)); i++) {
+			uint64_t b1 = bitsets[0][i];
+			uint64_t b2 = bitsets[1][i];
+			uint64_t b3 = bitsets[2][i];
+			bool found = ((b1 & b2) | (b1 & b3) | (b2 & b3)) != uint64_t(0);
+			if (found) return true;
+		}
+	}
+
+	else if (NUM_THREADS == 4) {
+		for (size_t i = 0; i < (NUM_BITSET_BYTES / sizeof(uint64_t)); i++) {
+			uint64_t b1 = bitsets[0][i];
+			uint64_t b2 = bitsets[1][i];
+			uint64_t b3 = bitsets[2][i];
+			uint64_t b4 = bitsets[3][i];
+			
+			bool found = ((b1 & b2) | (b1 & b3) | (b1 & b4) | (b2 & b3) | (b2 & b4) | (b3 & b4)) != uint64_t(0);
+			if (found) {
+				return true;
+			}
+		}
+	}
+		
+	else if (NUM_THREADS == 8) {
+		for (size_t i = 0; i < (NUM_BITSET_BYTES / sizeof(uint64_t)); i++) {
+			uint64_t b1 = bitsets[0][i];
+			uint64_t b2 = bitsets[1][i];
+			uint64_t b3 = bitsets[2][i];
+			uint64_t b4 = bitsets[3][i];
+			uint64_t b5 = bitsets[4][i];
+			uint64_t b6 = bitsets[5][i];
+			uint64_t b7 = bitsets[6][i];
+			uint64_t b8 = bitsets[7][i];
+
+			uint64_t val =
+			(b1 & b2) |
+			(b1 & b3) |
+			(b1 & b4) |
+			(b1 & b5) |
+			(b1 & b6) |
+			(b1 & b7) |
+			(b1 & b8) |
+
+			(b2 & b3) |
+			(b2 & b4) |
+			(b2 & b5) |
+			(b2 & b6) |
+			(b2 & b7) |
+			(b2 & b8) |
+			
+			(b3 & b4) |
+			(b3 & b5) |
+			(b3 & b6) |
+			(b3 & b7) |
+			(b3 & b8) |
+
+			(b4 & b5) |
+			(b4 & b6) |
+			(b4 & b7) |
+			(b4 & b8) |
+			
+			(b5 & b6) |
+			(b5 & b7) |
+			(b5 & b8) |
+
+			(b6 & b7) |
+			(b6 & b8) |
+
+			(b7 & b8);
+
+			if (val != uint64_t(0)) {
+				return true;
+			}
+		}
+	}
+
+	else {
+		printf("FATAL ERROR: NUM_THREADS may only be 2, 3, 4 or 8\n");
+	}
+
+	return false;
+}
+
+static void workerFunction(const uint8_t* __restrict fileView,
+                           uint64_t* __restrict isFoundBitset,
+                           bool* foundCopy,
+                           size_t numCodes,
+                           atomic_size_t* nextFreeCodeIndex) noexcept
+{
+	// Clear bitset
+	memset(isFoundBitset, 0, NUM_BITSET_BYTES);
+
+	while (true) {
+
+		// Allocate codes from shared array
+		size_t codeIndex = atomic_fetch_add(nextFreeCodeIndex, CODE_ALLOCATION_BATCH_SIZE);
+		if (codeIndex >= numCodes) return;
+		size_t codesToCheck = min(size_t(CODE_ALLOCATION_BATCH_SIZE), numCodes - codeIndex);
+		
+		// Loop over all allocated codes
+		size_t start = codeIndex * BYTES_PER_CODE;
+		size_t end = (codeIndex + codesToCheck) * BYTES_PER_CODE;
+		for (size_t i = start; i < end; i += BYTES_PER_CODE) {
+			
+			uint8_t let3 = fileView[i];
+			uint8_t let2 = fileView[i + 1];
+			uint8_t let1 = fileView[i + 2];
+			uint8_t no3 = fileView[i + 3];
+			uint8_t no2 = fileView[i + 4];
+			uint8_t no1 = fileView[i + 5];
+
+			// Calculate corresponding number for code
+			uint32_t number = uint32_t(let3 - 'A') * 676000u +
+			                  uint32_t(let2 - 'A') * 26000u +
+			                  uint32_t(let1 - 'A') * 1000u +
+			                  uint32_t(no3 - '0') * 100u +
+			                  uint32_t(no2 - '0') * 10u +
+			                  uint32_t(no1 - '0');
+
+			uint32_t bitsetChunkIndex = number >> 6u; // number / 64;
+			uint32_t bitIndex = number & 0x0000003Fu; // number % 64;
+
+			uint64_t chunk = isFoundBitset[bitsetChunkIndex];
+			uint64_t bitMask = uint64_t(1) << bitIndex;
+		
+			bool exists = (bitMask & chunk) != 0;
+
+			if (exists) {
+
+				// Allocate rest of rays so the other threads can stop
+				atomic_fetch_add(nextFreeCodeIndex, numCodes);
+
+				// Signal that the copy is found and exit thread
+				*foundCopy = true;
+				return;
+			}
+
+			chunk = bitMask | chunk;
+			isFoundBitset[bitsetChunkIndex] = chunk;
+		}
+	}
+}
+
+static bool multiThreadedSearch(const uint8_t* __restrict fileView, uint64_t numCodes) noexcept
+{
+	// Variable containing whether a copy was found or not
+	bool foundCopy = false;
+
+	// Counter used for allocating codes
+	atomic_size_t nextFreeCodeIndex = 0;
+
+	// Start threads
+	uint64_t* bitsets[NUM_THREADS];
+	thread threads[NUM_THREADS];
+	for (size_t i = 0; i < NUM_THREADS; i++) {
+
+		// Allocate memory for bitset, cleared in worker function
+		bitsets[i] = static_cast<uint64_t*>(_aligned_malloc(NUM_BITSET_BYTES, 32));
+
+		// Start worker thread
+		threads[i] = thread(workerFunction, fileView, bitsets[i], &foundCopy, numCodes, &nextFreeCodeIndex);
+	}
+
+	// Wait for threads to finish working
+	for (thread& t : threads) {
+		t.join();
+	}
+
+	// Compare all threads tables
+	if (!foundCopy) {
+		foundCopy = mergeBitsets(bitsets);
+	}
+
+	// Free memory
+	for (uint64_t* bitset : bitsets) {
+		_aligned_free(bitset);
+	}
+
+	// Return result
+	return foundCopy;
+}
+
+// Exposed function
+// ------------------------------------------------------------------------------------------------
+
+bool smallInputAlgorithm(const char* filePath) noexcept
+{
+	// Open file
+	HANDLE file = CreateFile(filePath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+	                         FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (file == INVALID_HANDLE_VALUE) {
+		printf("CreateFile() failed\n");
+		return false;
+	}
+
+	// Get size of file
+	uint64_t fileSize = static_cast<uint64_t>(GetFileSize(file, NULL));
+
+	// Large file fast path
+	// There are a total of 17 576 000 different codes. If the file contains more codes than that
+	// it must also by definition contain a copy.
+	if (fileSize >= ((MAX_NUMBER_CODES + 1) * BYTES_PER_CODE)) {
+		CloseHandle(file);
+		return true;
+	}
+
+	// Create mapped file
+	HANDLE mappedFile = CreateFileMapping(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (!mappedFile) {
+		printf("CreateFileMapping() failed\n");
+		CloseHandle(file);
+		return false;
+	}
+
+	// Create mapped file view
+	uint64_t offset = 0;
+	uint32_t offsetLow  = uint32_t(offset & uint64_t(0xFFFFFFFF));
+	uint32_t offsetHigh = uint32_t(offset >> uint64_t(32));
+	uint64_t numBytesToMap = fileSize;
+	void* fileView = MapViewOfFile(mappedFile, FILE_MAP_READ, offsetLow, offsetHigh, numBytesToMap);
+	if (!fileView) {
+		printf("MapViewOfFile() failed\n");
+		CloseHandle(mappedFile);
+		CloseHandle(file);
+		return false;
+	}
+
+	// Result variable
+	bool foundCopy = false;
+
+	// Small input path
+	uint64_t numCodes = numCodesInText(fileSize, BYTES_PER_CODE);
+	if (numCodes <= NUM_CODES_HASH_SET_THRESHOLD) {
+		foundCopy = hashSetSearch(static_cast<const uint8_t*>(fileView), numCodes);
+	}
+
+	// Single threaded path
+	else if (numCodes <= NUM_CODES_MULTI_THREADED_THRESHOLD) {
+		foundCopy = singleThreadedSearch(static_cast<const uint8_t*>(fileView), fileSize);
+	}
+	
+	// Multi-threaded path
+	else {
+		foundCopy = multiThreadedSearch(static_cast<const uint8_t*>(fileView), numCodes);
+	}
+
+	// Unmap mapped file view
+	if (!UnmapViewOfFile(fileView)) {
+		printf("UnmapViewOfFile() failed\n");
+		CloseHandle(mappedFile);
+		CloseHandle(file);
+		return false;
+	}
+
+	// Close mapped file
+	if (!CloseHandle(mappedFile)) {
+		printf("CloseHandle() failed for mappedFile\n");
+		return false;
+	}
+
+	// Close file
+	if (!CloseHandle(file)) {
+		printf("CloseHandle() failed for file\n");
+		return false;
+	}
+
+	// Return result
+	return foundCopy;
+}
@@ -0,0 +1,8 @@
+// Copyright(c) Peter Hillerstrm(skipifzero.com, peter@hstroem.se)
+
+#pragma once
+
+// Same as optimizedSmartAlgorithm7(), but files with few codes are checked using a small cache
+// resident hash set instead of the 2.2 MB bitset, which is more expensive to allocate and clear
+// than scanning a small file.
+bool smallInputAlgorithm(const char* filePath) noexcept;
@@ -0,0 +1,461 @@
+// Copyright(c) Peter Hillerstrm(skipifzero.com, peter@hstroem.se)
+
+#include "SortedInputAlgorithm.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#include <malloc.h>
+
+#include <immintrin.h>
+
+#include "PlateDecoders.hpp"
+
+using namespace std;
+
+// Constants
+// ------------------------------------------------------------------------------------------------
+
+static const uint64_t MAX_NUMBER_CODES = 17576000;
+static const uint64_t BYTES_PER_CODE = 8; // Assumes Windows file endings (2 bytes per newline)
+static const uint64_t NUM_BITSET_BYTES = (MAX_NUMBER_CODES / 8);
+
+static const uint64_t NUM_THREADS = 3;
+static const uint64_t CODE_ALLOCATION_BATCH_SIZE = 4096;
+static const uint64_t NUM_CODES_MULTI_THREADED_THRESHOLD = 600000;
+
+// Sorted input variant
+// ------------------------------------------------------------------------------------------------
+
+enum class SortedScanResult {
+	NO_COPY,
+	COPY_FOUND,
+	NOT_SORTED
+};
+
+// Decodes 8 codes (64 bytes) into 8 numbers using AVX2
+static __m256i decode8Codes(const uint8_t* __restrict codes) noexcept
+{
+	// Each code: [L3, L2, L1, N3, N2, N1, '\r', '\n'] -> [0-25, 0-25, 0-25, 0-9, 0-9, 0-9, 0, 0]
+	const __m256i SUBTRACT_CHARS = _mm256_set1_epi64x(0x0A0D303030414141);
+	const __m256i raw0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(codes));
+	const __m256i raw1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(codes + 32));
+	const __m256i digits0 = _mm256_sub_epi8(raw0, SUBTRACT_CHARS);
+	const __m256i digits1 = _mm256_sub_epi8(raw1, SUBTRACT_CHARS);
+
+	// u16 pairs per code: [L3 * 26 + L2, L1 * 10 + N3, N2 * 10 + N1, 0]
+	const __m256i PAIR_FACTORS = _mm256_set1_epi64x(0x0000010A010A011A);
+	const __m256i pairs0 = _mm256_maddubs_epi16(digits0, PAIR_FACTORS);
+	const __m256i pairs1 = _mm256_maddubs_epi16(digits1, PAIR_FACTORS);
+
+	// u32 pairs per code: [(L3 * 26 + L2) * 26000 + (L1 * 10 + N3) * 100, N2 * 10 + N1]
+	const __m256i QUAD_FACTORS = _mm256_set1_epi64x(0x0000000100646590);
+	const __m256i quads0 = _mm256_madd_epi16(pairs0, QUAD_FACTORS);
+	const __m256i quads1 = _mm256_madd_epi16(pairs1, QUAD_FACTORS);
+
+	// Final number in low u32 of each u64
+	const __m256i numbers0 = _mm256_add_epi32(quads0, _mm256_srli_epi64(quads0, 32));
+	const __m256i numbers1 = _mm256_add_epi32(quads1, _mm256_srli_epi64(quads1, 32));
+
+	// Pack into [0, 1, 4, 5, 2, 3, 6, 7] and then permute into order
+	const __m256i packed = _mm256_castps_si256(_mm256_shuffle_ps(_mm256_castsi256_ps(numbers0),
+	                                           _mm256_castsi256_ps(numbers1), _MM_SHUFFLE(2, 0, 2, 0)));
+	return _mm256_permute4x64_epi64(packed, _MM_SHUFFLE(3, 1, 2, 0));
+}
+
+static uint32_t decodeCode(const uint8_t* __restrict code) noexcept
+{
+	return uint32_t(code[0] - 'A') * 676000u +
+	       uint32_t(code[1] - 'A') * 26000u +
+	       uint32_t(code[2] - 'A') * 1000u +
+	       uint32_t(code[3] - '0') * 100u +
+	       uint32_t(code[4] - '0') * 10u +
+	       uint32_t(code[5] - '0');
+}
+
+// Scans the file assuming it is sorted, in which case any copy must be adjacent to the original.
+// Each number is compared to the number before it, if it is equal a copy is found. If it is lower
+// the file is not sorted and the scan is aborted so the caller can fall back to the bitset.
+static SortedScanResult sortedScan(const uint8_t* __restrict fileView, uint64_t numCodes) noexcept
+{
+	const __m256i ROTATE_RIGHT = _mm256_setr_epi32(7, 0, 1, 2, 3, 4, 5, 6);
+
+	// Start of with impossible previous number (-1), never equal or larger than any number
+	__m256i previous = _mm256_set1_epi32(-1);
+
+	uint64_t numBlocks = numCodes / 8;
+	for (uint64_t block = 0; block < numBlocks; block++) {
+		const __m256i numbers = decode8Codes(fileView + block * 8 * BYTES_PER_CODE);
+
+		// [previous[7], numbers[0], ..., numbers[6]]
+		const __m256i shifted = _mm256_blend_epi32(_mm256_permutevar8x32_epi32(numbers, ROTATE_RIGHT),
+		                                           _mm256_permutevar8x32_epi32(previous, ROTATE_RIGHT), 0x01);
+
+		// Numbers are at most 25 bits, so signed comparison is fine
+		const __m256i equal = _mm256_cmpeq_epi32(numbers, shifted);
+		const __m256i descending = _mm256_cmpgt_epi32(shifted, numbers);
+		if (!_mm256_testz_si256(_mm256_or_si256(equal, descending), _mm256_or_si256(equal, descending))) {
+			if (!_mm256_testz_si256(equal, equal)) return SortedScanResult::COPY_FOUND;
+			return SortedScanResult::NOT_SORTED;
+		}
+
+		previous = numbers;
+	}
+
+	// Remaining codes
+	uint32_t lastNumber = uint32_t(_mm256_extract_epi32(previous, 7));
+	for (uint64_t i = numBlocks * 8; i < numCodes; i++) {
+		uint32_t number = decodeCode(fileView + i * BYTES_PER_CODE);
+		if (number == lastNumber) return SortedScanResult::COPY_FOUND;
+		if (int32_t(number) < int32_t(lastNumber)) return SortedScanResult::NOT_SORTED;
+		lastNumber = number;
+	}
+
+	return SortedScanResult::NO_COPY;
+}
+
+// Single threaded variant
+// ------------------------------------------------------------------------------------------------
+
+static bool singleThreadedSearch(const uint8_t* __restrict fileView, uint64_t fileSize) noexcept
+{
+	// Allocate bitset buffer for whether a number is found or not, and clear it
+	uint64_t* isFoundBitset = static_cast<uint64_t*>(_aligned_malloc(NUM_BITSET_BYTES, 32));
+	memset(isFoundBitset, 0, NUM_BITSET_BYTES);
+
+	// Variable containing whether a copy was found or not
+	bool foundCopy = false;
+
+	for (size_t i = 0; i < fileSize; i += BYTES_PER_CODE) {
+		char let3 = fileView[i];
+		char let2 = fileView[i + 1];
+		char let1 = fileView[i + 2];
+		char no3 = fileView[i + 3];
+		char no2 = fileView[i + 4];
+		char no1 = fileView[i + 5];
+
+		// Calculate corresponding number for code
+		uint32_t number = uint32_t(let3 - 'A') * 676000u +
+		                  uint32_t(let2 - 'A') * 26000u +
+		                  uint32_t(let1 - 'A') * 1000u +
+		                  uint32_t(no3 - '0') * 100u +
+		                  uint32_t(no2 - '0') * 10u +
+		                  uint32_t(no1 - '0');
+
+		uint32_t bitsetChunkIndex = number >> 6u; // number / 64;
+		uint32_t bitIndex = number & 0x0000003Fu; // number % 64;
+
+		uint64_t chunk = isFoundBitset[bitsetChunkIndex];
+		uint64_t bitMask = uint64_t(1) << bitIndex;
+		
+		bool exists = (bitMask & chunk) != 0;
+
+		if (exists) {
+			foundCopy = true;
+			break;
+		}
+
+		chunk = bitMask | chunk;
+		isFoundBitset[bitsetChunkIndex] = chunk;
+	}
+
+	// Free allocated bitset memory
+	_aligned_free(isFoundBitset);
+
+	// Return result
+	return foundCopy;
+}
+
+// Multi-threaded variant
+// ------------------------------------------------------------------------------------------------
+
+static bool mergeBitsets(uint64_t* bitsets[NUM_THREADS]) noexcept
+{
+	if (NUM_THREADS == 2) {
+		for (size_t i = 0; i < (NUM_BITSET_BYTES / sizeof(uint64_t)); i++) {
+			uint64_t b1 = bitsets[0][i];
+			uint64_t b2 = bitsets[1][i];
+			if ((b1 & b2) != uint64_t(0)) return true;
+		}
+	}
+
+	else if (NUM_THREADS == 3) {
+		for (size_t i = 0; i < (NUM_BITSET_BYTES / sizeof(uint64_t)); i++) {
+			uint64_t b1 = bitsets[0][i];
+			uint64_t b2 = bitsets[1][i];
+			uint64_t b3 = bitsets[2][i];
+			bool found = ((b1 & b2) | (b1 & b3) | (b2 & b3)) != uint64_t(0);
+			if (found) return true;
+		}
+	}
+
+	else if (NUM_THREADS == 4) {
+		for (size_t i = 0; i < (NUM_BITSET_BYTES / sizeof(uint64_t)); i++) {
+			uint64_t b1 = bitsets[0][i];
+			uint64_t b2 = bitsets[1][i];
+			uint64_t b3 = bitsets[2][i];
+			uint64_t b4 = bitsets[3][i];
+			
+			bool found = ((b1 & b2) | (b1 & b3) | (b1 & b4) | (b2 & b3) | (b2 & b4) | (b3 & b4)) != uint64_t(0);
+			if (found) {
+				return true;
+			}
+		}
+	}
+		
+	else if (NUM_THREADS == 8) {
+		for (size_t i = 0; i < (NUM_BITSET_BYTES / sizeof(uint64_t)); i++) {
+			uint64_t b1 = bitsets[0][i];
+			uint64_t b2 = bitsets[1][i];
+			uint64_t b3 = bitsets[2][i];
+			uint64_t b4 = bitsets[3][i];
+			uint64_t b5 = bitsets[4][i];
+			uint64_t b6 = bitsets[5][i];
+			uint64_t b7 = bitsets[6][i];
+			uint64_t b8 = bitsets[7][i];
+
+			uint64_t val =
+			(b1 & b2) |
+			(b1 & b3) |
+			(b1 & b4) |
+			(b1 & b5) |
+			(b1 & b6) |
+			(b1 & b7) |
+			(b1 & b8) |
+
+			(b2 & b3) |
+			(b2 & b4) |
+			(b2 & b5) |
+			(b2 & b6) |
+			(b2 & b7) |
+			(b2 & b8) |
+			
+			(b3 & b4) |
+			(b3 & b5) |
+			(b3 & b6) |
+			(b3 & b7) |
+			(b3 & b8) |
+
+			(b4 & b5) |
+			(b4 & b6) |
+			(b4 & b7) |
+			(b4 & b8) |
+			
+			(b5 & b6) |
+			(b5 & b7) |
+			(b5 & b8) |
+
+			(b6 & b7) |
+			(b6 & b8) |
+
+			(b7 & b8);
+
+			if (val != uint64_t(0)) {
+				return true;
+			}
+		}
+	}
+
+	else {
+		printf("FATAL ERROR: NUM_THREADS may only be 2, 3, 4 or 8\n");
+	}
+
+	return false;
+}
+
+static void workerFunction(const uint8_t* __restrict fileView,
+                           uint64_t* __restrict isFoundBitset,
+                           bool* foundCopy,
+                           size_t numCodes,
+                           atomic_size_t* nextFreeCodeIndex) noexcept
+{
+	// Clear bitset
+	memset(isFoundBitset, 0, NUM_BITSET_BYTES);
+
+	while (true) {
+
+		// Allocate codes from shared array
+		size_t codeIndex = atomic_fetch_add(nextFreeCodeIndex, CODE_ALLOCATION_BATCH_SIZE);
+		if (codeIndex >= numCodes) return;
+		size_t codesToCheck = min(size_t(CODE_ALLOCATION_BATCH_SIZE), numCodes - codeIndex);
+		
+		// Loop over all allocated codes
+		size_t start = codeIndex * BYTES_PER_CODE;
+		size_t end = (codeIndex + codesToCheck) * BYTES_PER_CODE;
+		for (size_t i = start; i < end; i += BYTES_PER_CODE) {
+			
+			uint8_t let3 = fileView[i];
+			uint8_t let2 = fileView[i + 1];
+			uint8_t let1 = fileView[i + 2];
+			uint8_t no3 = fileView[i + 3];
+			uint8_t no2 = fileView[i + 4];
+			uint8_t no1 = fileView[i + 5];
+
+			// Calculate corresponding number for code
+			uint32_t number = uint32_t(let3 - 'A') * 676000u +
+			                  uint32_t(let2 - 'A') * 26000u +
+			                  uint32_t(let1 - 'A') * 1000u +
+			                  uint32_t(no3 - '0') * 100u +
+			                  uint32_t(no2 - '0') * 10u +
+			                  uint32_t(no1 - '0');
+
+			uint32_t bitsetChunkIndex = number >> 6u; // number / 64;
+			uint32_t bitIndex = number & 0x0000003Fu; // number % 64;
+
+			uint64_t chunk = isFoundBitset[bitsetChunkIndex];
+			uint64_t bitMask = uint64_t(1) << bitIndex;
+		
+			bool exists = (bitMask & chunk) != 0;
+
+			if (exists) {
+
+				// Allocate rest of rays so the other threads can stop
+				atomic_fetch_add(nextFreeCodeIndex, numCodes);
+
+				// Signal that the copy is found and exit thread
+				*foundCopy = true;
+				return;
+			}
+
+			chunk = bitMask | chunk;
+			isFoundBitset[bitsetChunkIndex] = chunk;
+		}
+	}
+}
+
+static bool multiThreadedSearch(const uint8_t* __restrict fileView, uint64_t numCodes) noexcept
+{
+	// Variable containing whether a copy was found or not
+	bool foundCopy = false;
+
+	// Counter used for allocating codes
+	atomic_size_t nextFreeCodeIndex = 0;
+
+	// Start threads
+	uint64_t* bitsets[NUM_THREADS];
+	thread threads[NUM_THREADS];
+	for (size_t i = 0; i < NUM_THREADS; i++) {
+
+		// Allocate memory for bitset, cleared in worker function
+		bitsets[i] = static_cast<uint64_t*>(_aligned_malloc(NUM_BITSET_BYTES, 32));
+
+		// Start worker thread
+		threads[i] = thread(workerFunction, fileView, bitsets[i], &foundCopy, numCodes, &nextFreeCodeIndex);
+	}
+
+	// Wait for threads to finish working
+	for (thread& t : threads) {
+		t.join();
+	}
+
+	// Compare all threads tables
+	if (!foundCopy) {
+		foundCopy = mergeBitsets(bitsets);
+	}
+
+	// Free memory
+	for (uint64_t* bitset : bitsets) {
+		_aligned_free(bitset);
+	}
+
+	// Return result
+	return foundCopy;
+}
+
+// Exposed function
+// ------------------------------------------------------------------------------------------------
+
+bool sortedInputAlgorithm(const char* filePath) noexcept
+{
+	// Open file
+	HANDLE file = CreateFile(filePath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+	                         FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (!file) {
+		printf("CreateFile() failed\n");
+		return false;
+	}
+
+	// Get size of file
+	uint64_t fileSize = static_cast<uint64_t>(GetFileSize(file, NULL));
+
+	// Large file fast path
+	// There are a total of 17 576 000 different codes. If the file contains more codes than that
+	// it must also by definition contain a copy.
+	if (fileSize >= ((MAX_NUMBER_CODES + 1) * BYTES_PER_CODE)) {
+		CloseHandle(file);
+		return true;
+	}
+
+	// Create mapped file
+	HANDLE mappedFile = CreateFileMapping(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (!mappedFile) {
+		printf("CreateFileMapping() failed\n");
+		CloseHandle(file);
+		return false;
+	}
+
+	// Create mapped file view
+	uint64_t offset = 0;
+	uint32_t offsetLow  = uint32_t(offset & uint64_t(0xFFFFFFFF));
+	uint32_t offsetHigh = uint32_t(offset >> uint64_t(32));
+	uint64_t numBytesToMap = fileSize;
+	void* fileView = MapViewOfFile(mappedFile, FILE_MAP_READ, offsetLow, offsetHigh, numBytesToMap);
+	if (!fileView) {
+		printf("MapViewOfFile() failed\n");
+		CloseHandle(mappedFile);
+		CloseHandle(file);
+		return false;
+	}
+
+	// Result variable
+	bool foundCopy = false;
+
+	// Sorted path
+	// Scanning stops at the first number that is out of order, so for unsorted input only a few
+	// codes are decoded before falling back to the bitset.
+	uint64_t numCodes = numCodesInText(fileSize, BYTES_PER_CODE);
+	SortedScanResult sortedResult = sortedScan(static_cast<const uint8_t*>(fileView), numCodes);
+	if (sortedResult != SortedScanResult::NOT_SORTED) {
+		foundCopy = sortedResult == SortedScanResult::COPY_FOUND;
+	}
+
+	// Single threaded path
+	else if (numCodes <= NUM_CODES_MULTI_THREADED_THRESHOLD) {
+		foundCopy = singleThreadedSearch(static_cast<const uint8_t*>(fileView), fileSize);
+	}
+	
+	// Multi-threaded path
+	else {
+		foundCopy = multiThreadedSearch(static_cast<const uint8_t*>(fileView), numCodes);
+	}
+
+	// Unmap mapped file view
+	if (!UnmapViewOfFile(fileView)) {
+		printf("UnmapViewOfFile() failed\n");
+		CloseHandle(mappedFile);
+		CloseHandle(file);
+		return false;
+	}
+
+	// Close mapped file
+	if (!CloseHandle(mappedFile)) {
+		printf("CloseHandle() failed for mappedFile\n");
+		return false;
+	}
+
+	// Close file
+	if (!CloseHandle(file)) {
+		printf("CloseHandle() failed for file\n");
+		return false;
+	}
+
+	// Return result
+	return foundCopy;
+}
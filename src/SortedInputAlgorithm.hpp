@@ -0,0 +1,5 @@
+// Copyright(c) Peter Hillerstrm(skipifzero.com, peter@hstroem.se)
+
+#pragma once
+
+bool sortedInputAlgorithm(const char* filePath) noexcept;
@@ -26,19 +26,14 @@ static vector<char> readFile(const char* path) noexcept
 		return vector<char>();
 	}
 
-	// Create array with enough capacity to fit file
+	// Create array with enough space to fit file
 	vector<char> temp;
-	temp.reserve(size + 1);
+	temp.resize(size_t(size));
 
-	// Read the file into the array
-	char buffer[BUFSIZ];
-	size_t readSize;
-	size_t currOffs = 0;
-	while ((readSize = std::fread(buffer, 1, BUFSIZ, file)) > 0) {
-		for (size_t i = 0; i < readSize; i++) {
-			temp.push_back(buffer[i]);
-		}
-	}
+	// Read the file directly into the array, the number of bytes read may be smaller than the size
+	// of the file since newlines are converted in text mode
+	size_t readSize = std::fread(temp.data(), 1, temp.size(), file);
+	temp.resize(readSize);
 
 	std::fclose(file);
 	return std::move(temp);
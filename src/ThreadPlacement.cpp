@@ -0,0 +1,259 @@
+// Copyright(c) Peter Hillerstrm(skipifzero.com, peter@hstroem.se)
+
+#include "ThreadPlacement.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+
+using namespace std;
+
+// Constants
+// ------------------------------------------------------------------------------------------------
+
+// Highest processor id accepted in a cpu set if the topology could not be discovered, 64 groups
+static const uint32_t CPU_SET_MAX_ID = 64 * 64 - 1;
+
+// Statics
+// ------------------------------------------------------------------------------------------------
+
+// Calls function(processorId) for each processor in the group affinity mask
+template<typename Function>
+static void forEachProcessor(const GROUP_AFFINITY& affinity, const Function& function) noexcept
+{
+	for (uint32_t i = 0; i < 64; i++) {
+		if ((uint64_t(affinity.Mask) & (uint64_t(1) << i)) != 0) {
+			function(uint32_t(affinity.Group) * 64u + i);
+		}
+	}
+}
+
+static LogicalProcessor* findProcessor(CpuTopology& topology, uint32_t id) noexcept
+{
+	for (LogicalProcessor& processor : topology.processors) {
+		if (processor.id() == id) return &processor;
+	}
+	return nullptr;
+}
+
+// Returns all processor information entries of the specified relationship
+static vector<uint8_t> queryProcessorInformation(LOGICAL_PROCESSOR_RELATIONSHIP relationship) noexcept
+{
+	DWORD numBytes = 0;
+	GetLogicalProcessorInformationEx(relationship, nullptr, &numBytes);
+	if (GetLastError() != ERROR_INSUFFICIENT_BUFFER || numBytes == 0) return vector<uint8_t>();
+
+	vector<uint8_t> buffer(numBytes);
+	SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX* info =
+		reinterpret_cast<SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX*>(buffer.data());
+	if (!GetLogicalProcessorInformationEx(relationship, info, &numBytes)) return vector<uint8_t>();
+	buffer.resize(numBytes);
+	return buffer;
+}
+
+// Calls function(info) for each entry in a buffer returned by queryProcessorInformation()
+template<typename Function>
+static void forEachEntry(const vector<uint8_t>& buffer, const Function& function) noexcept
+{
+	size_t offset = 0;
+	while (offset < buffer.size()) {
+		const SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX* info =
+			reinterpret_cast<const SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX*>(buffer.data() + offset);
+		if (info->Size == 0) break;
+		function(*info);
+		offset += info->Size;
+	}
+}
+
+// CPU topology
+// ------------------------------------------------------------------------------------------------
+
+bool discoverCpuTopology(CpuTopology& topologyOut) noexcept
+{
+	CpuTopology topology;
+
+	// Physical cores, each with one or more logical processors (SMT siblings)
+	vector<uint8_t> cores = queryProcessorInformation(RelationProcessorCore);
+	if (cores.empty()) {
+		printf("GetLogicalProcessorInformationEx() failed for RelationProcessorCore\n");
+		return false;
+	}
+	forEachEntry(cores, [&](const SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX& info) {
+		uint32_t coreIndex = topology.numCores;
+		uint32_t smtIndex = 0;
+		for (WORD i = 0; i < info.Processor.GroupCount; i++) {
+			forEachProcessor(info.Processor.GroupMask[i], [&](uint32_t id) {
+				LogicalProcessor processor;
+				processor.group = uint16_t(id / 64);
+				processor.number = uint8_t(id % 64);
+				processor.coreIndex = coreIndex;
+				processor.smtIndex = smtIndex++;
+				topology.processors.push_back(processor);
+			});
+		}
+		topology.numCores += 1;
+	});
+	sort(topology.processors.begin(), topology.processors.end(),
+	     [](const LogicalProcessor& a, const LogicalProcessor& b) { return a.id() < b.id(); });
+
+	// L2 caches, if not reported each core is assumed to have its own
+	vector<uint8_t> caches = queryProcessorInformation(RelationCache);
+	forEachEntry(caches, [&](const SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX& info) {
+		if (info.Cache.Level != 2 || info.Cache.Type == CacheInstruction) return;
+		forEachProcessor(info.Cache.GroupMask, [&](uint32_t id) {
+			LogicalProcessor* processor = findProcessor(topology, id);
+			if (processor != nullptr) processor->l2Index = topology.numL2Caches;
+		});
+		uint32_t cacheBytes = uint32_t(info.Cache.CacheSize);
+		if (cacheBytes != 0 && (topology.l2CacheBytes == 0 || cacheBytes < topology.l2CacheBytes)) {
+			topology.l2CacheBytes = cacheBytes;
+		}
+		topology.numL2Caches += 1;
+	});
+	if (topology.numL2Caches == 0) {
+		for (LogicalProcessor& processor : topology.processors) {
+			processor.l2Index = processor.coreIndex;
+		}
+		topology.numL2Caches = topology.numCores;
+	}
+
+	// NUMA nodes, if not reported all processors are assumed to be on node 0
+	vector<uint8_t> numaNodes = queryProcessorInformation(RelationNumaNode);
+	forEachEntry(numaNodes, [&](const SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX& info) {
+		uint32_t node = uint32_t(info.NumaNode.NodeNumber);
+		forEachProcessor(info.NumaNode.GroupMask, [&](uint32_t id) {
+			LogicalProcessor* processor = findProcessor(topology, id);
+			if (processor != nullptr) processor->numaNode = node;
+		});
+		topology.numNumaNodes = max(topology.numNumaNodes, node + 1);
+	});
+
+	topologyOut = topology;
+	return true;
+}
+
+const CpuTopology& cpuTopology() noexcept
+{
+	static const CpuTopology topology = []() {
+		CpuTopology tmp;
+		discoverCpuTopology(tmp);
+		return tmp;
+	}();
+	return topology;
+}
+
+// Thread placement
+// ------------------------------------------------------------------------------------------------
+
+vector<LogicalProcessor> placeThreads(const CpuTopology& topology, PlacementPolicy policy,
+                                      const vector<uint32_t>& cpuSet, uint32_t maxThreads) noexcept
+{
+	vector<LogicalProcessor> placement;
+	uint32_t defaultNumThreads = 0;
+
+	if (policy == PlacementPolicy::PHYSICAL_CORES_FIRST) {
+		// Rank of each core among the cores sharing its L2
+		vector<uint32_t> coreRankInL2(topology.numCores, 0);
+		for (const LogicalProcessor& a : topology.processors) {
+			if (a.smtIndex != 0) continue;
+			for (const LogicalProcessor& b : topology.processors) {
+				if (b.smtIndex == 0 && b.l2Index == a.l2Index && b.coreIndex < a.coreIndex) {
+					coreRankInL2[a.coreIndex] += 1;
+				}
+			}
+		}
+
+		// First SMT sibling of every core, then second sibling of every core, etc. Within each
+		// level cores are spread over the L2 caches before any L2 gets a second thread.
+		placement = topology.processors;
+		stable_sort(placement.begin(), placement.end(),
+		            [&](const LogicalProcessor& a, const LogicalProcessor& b) {
+			if (a.smtIndex != b.smtIndex) return a.smtIndex < b.smtIndex;
+			return coreRankInL2[a.coreIndex] < coreRankInL2[b.coreIndex];
+		});
+		defaultNumThreads = max(topology.numCores, 2u) - 1;
+	}
+
+	else if (policy == PlacementPolicy::ONE_PER_L2) {
+		// Lowest processor (which is the first SMT sibling of its core) sharing each L2
+		vector<bool> l2Used(topology.numL2Caches, false);
+		for (const LogicalProcessor& processor : topology.processors) {
+			if (processor.l2Index < l2Used.size() && !l2Used[processor.l2Index]) {
+				l2Used[processor.l2Index] = true;
+				placement.push_back(processor);
+			}
+		}
+		defaultNumThreads = uint32_t(placement.size());
+	}
+
+	else if (policy == PlacementPolicy::CPU_SET) {
+		for (uint32_t id : cpuSet) {
+			for (const LogicalProcessor& processor : topology.processors) {
+				if (processor.id() == id) placement.push_back(processor);
+			}
+		}
+		defaultNumThreads = uint32_t(placement.size());
+	}
+
+	uint32_t numThreads = maxThreads == 0 ? defaultNumThreads : maxThreads;
+	if (placement.size() > numThreads) placement.resize(numThreads);
+	return placement;
+}
+
+bool parseCpuSet(const char* str, vector<uint32_t>& cpuSetOut) noexcept
+{
+	cpuSetOut.clear();
+	if (str == nullptr) return false;
+
+	// Ids above the highest existing processor are rejected, which also bounds the ranges
+	const CpuTopology& topology = cpuTopology();
+	const unsigned long maxId =
+		topology.processors.empty() ? CPU_SET_MAX_ID : topology.processors.back().id();
+
+	// Parses an id, strtoul() alone would also accept whitespace and a sign
+	auto parseId = [&](const char*& curr, unsigned long& idOut) {
+		if (*curr < '0' || *curr > '9') return false;
+		char* end = nullptr;
+		idOut = strtoul(curr, &end, 10);
+		curr = end;
+		return idOut <= maxId;
+	};
+
+	// Every item, including the one after the last comma, must be non-empty
+	const char* curr = str;
+	while (true) {
+		unsigned long first = 0;
+		if (!parseId(curr, first)) return false;
+		unsigned long last = first;
+		if (*curr == '-') {
+			curr += 1;
+			if (!parseId(curr, last) || last < first) return false;
+		}
+
+		for (unsigned long id = first; id <= last; id++) {
+			cpuSetOut.push_back(uint32_t(id));
+		}
+
+		if (*curr == '\0') return true;
+		if (*curr != ',') return false;
+		curr += 1;
+	}
+}
+
+bool pinCurrentThread(const LogicalProcessor& processor) noexcept
+{
+	GROUP_AFFINITY affinity;
+	memset(&affinity, 0, sizeof(GROUP_AFFINITY));
+	affinity.Group = processor.group;
+	affinity.Mask = KAFFINITY(uint64_t(1) << processor.number);
+	if (!SetThreadGroupAffinity(GetCurrentThread(), &affinity, nullptr)) {
+		printf("SetThreadGroupAffinity() failed\n");
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,66 @@
+// Copyright(c) Peter Hillerstrm(skipifzero.com, peter@hstroem.se)
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// CPU topology
+// ------------------------------------------------------------------------------------------------
+
+struct LogicalProcessor final {
+	uint16_t group = 0; // Processor group
+	uint8_t number = 0; // Number within processor group
+	uint32_t coreIndex = 0; // Index of physical core
+	uint32_t l2Index = 0; // Index of L2 cache
+	uint32_t smtIndex = 0; // Index among the SMT siblings of the physical core
+	uint32_t numaNode = 0; // NUMA node number
+
+	// Unique id of the processor, (group * 64) + number
+	uint32_t id() const noexcept { return uint32_t(group) * 64u + uint32_t(number); }
+};
+
+struct CpuTopology final {
+	std::vector<LogicalProcessor> processors; // Sorted by id
+	uint32_t numCores = 0;
+	uint32_t numL2Caches = 0;
+	uint32_t l2CacheBytes = 0; // Size of the smallest L2 cache, 0 if not reported
+	uint32_t numNumaNodes = 1; // Highest NUMA node number + 1
+};
+
+// Discovers the topology of the machine through GetLogicalProcessorInformationEx()
+bool discoverCpuTopology(CpuTopology& topologyOut) noexcept;
+
+// The topology of the machine, discovered on first call. Empty if discovery failed.
+const CpuTopology& cpuTopology() noexcept;
+
+// Thread placement
+// ------------------------------------------------------------------------------------------------
+
+enum class PlacementPolicy : uint8_t {
+	// One thread per physical core, SMT siblings are only used once all cores have a thread
+	PHYSICAL_CORES_FIRST,
+
+	// At most one thread per L2 cache, so threads never share an L2
+	ONE_PER_L2,
+
+	// The processors in a user supplied cpu set, in the order given
+	CPU_SET
+};
+
+// Returns the processor each thread should run on, the number of threads is the size of the
+// returned vector. A maxThreads of 0 means the default thread count for the policy:
+// PHYSICAL_CORES_FIRST: One less than the number of physical cores, leaving room for the OS and
+//                       other tenants (3 on the original 4 core machine).
+// ONE_PER_L2: The number of L2 caches.
+// CPU_SET: The number of processors in the cpu set, processors that don't exist are ignored.
+std::vector<LogicalProcessor> placeThreads(const CpuTopology& topology, PlacementPolicy policy,
+                                           const std::vector<uint32_t>& cpuSet,
+                                           uint32_t maxThreads = 0) noexcept;
+
+// Parses a cpu set on the form "0-3,8,10-11" into processor ids. Returns false on syntax error, an
+// empty item or an id above the highest processor id of cpuTopology().
+bool parseCpuSet(const char* str, std::vector<uint32_t>& cpuSetOut) noexcept;
+
+// Pins the calling thread to the specified processor using SetThreadGroupAffinity()
+bool pinCurrentThread(const LogicalProcessor& processor) noexcept;
@@ -0,0 +1,407 @@
+// Copyright(c) Peter Hillerstrm(skipifzero.com, peter@hstroem.se)
+
+#include "TouchedBlockAlgorithm.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <thread>
+
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#include <immintrin.h>
+#include <malloc.h>
+
+#include "PlateDecoders.hpp"
+
+using namespace std;
+
+// Constants
+// ------------------------------------------------------------------------------------------------
+
+static const uint64_t MAX_NUMBER_CODES = 17576000;
+static const uint64_t BYTES_PER_CODE = 8; // Assumes Windows file endings (2 bytes per newline)
+
+static const uint64_t NUM_THREADS = 3;
+static const uint64_t CODE_ALLOCATION_BATCH_SIZE = 4096;
+static const uint64_t NUM_CODES_MULTI_THREADED_THRESHOLD = 600000;
+
+// A block is 512 bits, i.e. one cache line or 8 words of the bitset
+static const uint64_t NUM_BLOCKS = TOUCHED_BLOCK_NUM_BLOCKS;
+static const uint64_t BLOCK_BYTES = 64;
+static const uint64_t NUM_PADDED_BITSET_BYTES = NUM_BLOCKS * BLOCK_BYTES;
+static const uint64_t NUM_SUMMARY_WORDS = (NUM_BLOCKS + 63) / 64;
+
+static const uint64_t STATS_PREFIX_SIZES[] = { 1000, 10000, 100000, ~uint64_t(0) };
+
+// Thread bitsets
+// ------------------------------------------------------------------------------------------------
+
+struct ThreadBitset final {
+	uint64_t* bitset; // NUM_BLOCKS whole blocks, all clear between searches
+	uint64_t* summary; // Bit i is set if block i may be non-zero
+};
+
+// Persistent bitsets, only the first search pays for allocating and clearing them. Returns nullptr
+// if the allocation fails, in which case the next search tries again.
+static ThreadBitset* threadBitsets() noexcept
+{
+	static ThreadBitset bitsets[NUM_THREADS] = {};
+	if (bitsets[0].bitset == nullptr) {
+		bool allocated = true;
+		for (ThreadBitset& b : bitsets) {
+			b.bitset = static_cast<uint64_t*>(_aligned_malloc(NUM_PADDED_BITSET_BYTES, 64));
+			b.summary = static_cast<uint64_t*>(_aligned_malloc(NUM_SUMMARY_WORDS * sizeof(uint64_t), 64));
+			if (b.bitset == nullptr || b.summary == nullptr) {
+				allocated = false;
+				break;
+			}
+			memset(b.bitset, 0, NUM_PADDED_BITSET_BYTES);
+			memset(b.summary, 0, NUM_SUMMARY_WORDS * sizeof(uint64_t));
+		}
+		if (!allocated) {
+			printf("_aligned_malloc() failed\n");
+			for (ThreadBitset& b : bitsets) {
+				_aligned_free(b.bitset);
+				_aligned_free(b.summary);
+				b = ThreadBitset();
+			}
+			return nullptr;
+		}
+	}
+	return bitsets;
+}
+
+static mutex searchMutex;
+
+using time_point = chrono::high_resolution_clock::time_point;
+
+static double millisecondsBetween(time_point start, time_point end) noexcept
+{
+	return chrono::duration<double, milli>(end - start).count();
+}
+
+// Search
+// ------------------------------------------------------------------------------------------------
+
+// Checks the codes in range [firstCode, lastCode) against and inserts them into the bitset
+static bool searchRange(const uint8_t* __restrict fileView,
+                        uint64_t* __restrict isFoundBitset,
+                        uint64_t* __restrict summary,
+                        uint64_t firstCode,
+                        uint64_t lastCode) noexcept
+{
+	for (uint64_t i = firstCode; i < lastCode; i++) {
+		const uint8_t* code = fileView + i * BYTES_PER_CODE;
+		uint32_t number = uint32_t(code[0] - 'A') * 676000u +
+		                  uint32_t(code[1] - 'A') * 26000u +
+		                  uint32_t(code[2] - 'A') * 1000u +
+		                  uint32_t(code[3] - '0') * 100u +
+		                  uint32_t(code[4] - '0') * 10u +
+		                  uint32_t(code[5] - '0');
+
+		uint32_t bitsetChunkIndex = number >> 6u; // number / 64;
+		uint32_t bitIndex = number & 0x0000003Fu; // number % 64;
+
+		uint64_t chunk = isFoundBitset[bitsetChunkIndex];
+		uint64_t bitMask = uint64_t(1) << bitIndex;
+
+		if ((bitMask & chunk) != uint64_t(0)) {
+			return true;
+		}
+
+		isFoundBitset[bitsetChunkIndex] = bitMask | chunk;
+
+		// Mark block (number / 512) in summary, 64 blocks per summary word
+		summary[number >> 15u] |= uint64_t(1) << ((number >> 9u) & 0x0000003Fu);
+	}
+	return false;
+}
+
+// Merge, stats and clear
+// ------------------------------------------------------------------------------------------------
+
+// Returns whether any bit is set in at least two of the bitsets, visiting only the blocks marked
+// in the union summary
+static bool mergeBlocks(const ThreadBitset* bitsets, const uint64_t* unionSummary) noexcept
+{
+	static_assert(NUM_THREADS == 3, "mergeBlocks() assumes 3 threads");
+	for (uint64_t w = 0; w < NUM_SUMMARY_WORDS; w++) {
+		uint64_t touched = unionSummary[w];
+		while (touched != 0) {
+			uint64_t wordIndex = (w * 64 + _tzcnt_u64(touched)) * (BLOCK_BYTES / sizeof(uint64_t));
+			touched = _blsr_u64(touched);
+			for (uint64_t i = wordIndex; i < wordIndex + 8; i += 4) {
+				__m256i b1 = _mm256_load_si256(reinterpret_cast<const __m256i*>(bitsets[0].bitset + i));
+				__m256i b2 = _mm256_load_si256(reinterpret_cast<const __m256i*>(bitsets[1].bitset + i));
+				__m256i b3 = _mm256_load_si256(reinterpret_cast<const __m256i*>(bitsets[2].bitset + i));
+				__m256i found = _mm256_or_si256(_mm256_and_si256(b1, b2),
+				                _mm256_or_si256(_mm256_and_si256(b1, b3), _mm256_and_si256(b2, b3)));
+				if (!_mm256_testz_si256(found, found)) return true;
+			}
+		}
+	}
+	return false;
+}
+
+// Number of bits set in any of the bitsets
+static uint64_t countDistinct(const ThreadBitset* bitsets, const uint64_t* unionSummary) noexcept
+{
+	uint64_t numDistinct = 0;
+	for (uint64_t w = 0; w < NUM_SUMMARY_WORDS; w++) {
+		uint64_t touched = unionSummary[w];
+		while (touched != 0) {
+			uint64_t wordIndex = (w * 64 + _tzcnt_u64(touched)) * (BLOCK_BYTES / sizeof(uint64_t));
+			touched = _blsr_u64(touched);
+			for (uint64_t i = wordIndex; i < wordIndex + 8; i++) {
+				uint64_t word = bitsets[0].bitset[i] | bitsets[1].bitset[i] | bitsets[2].bitset[i];
+				numDistinct += uint64_t(_mm_popcnt_u64(word));
+			}
+		}
+	}
+	return numDistinct;
+}
+
+// Clears the touched blocks and the summary, restoring the all clear state between searches
+static void clearTouchedBlocks(ThreadBitset& b) noexcept
+{
+	const __m256i zero = _mm256_setzero_si256();
+	for (uint64_t w = 0; w < NUM_SUMMARY_WORDS; w++) {
+		uint64_t touched = b.summary[w];
+		while (touched != 0) {
+			uint64_t* block = b.bitset + (w * 64 + _tzcnt_u64(touched)) * (BLOCK_BYTES / sizeof(uint64_t));
+			touched = _blsr_u64(touched);
+			_mm256_store_si256(reinterpret_cast<__m256i*>(block), zero);
+			_mm256_store_si256(reinterpret_cast<__m256i*>(block + 4), zero);
+		}
+		b.summary[w] = 0;
+	}
+}
+
+// Single threaded variant
+// ------------------------------------------------------------------------------------------------
+
+static bool singleThreadedSearch(const uint8_t* __restrict fileView, uint64_t numCodes,
+                                 ThreadBitset* bitsets) noexcept
+{
+	ThreadBitset& b = bitsets[0];
+	bool foundCopy = searchRange(fileView, b.bitset, b.summary, 0, numCodes);
+	clearTouchedBlocks(b);
+	return foundCopy;
+}
+
+// Multi-threaded variant
+// ------------------------------------------------------------------------------------------------
+
+static void workerFunction(const uint8_t* __restrict fileView,
+                           ThreadBitset* threadBitset,
+                           atomic_bool* foundCopy,
+                           size_t numCodes,
+                           atomic_size_t* nextFreeCodeIndex) noexcept
+{
+	while (true) {
+
+		// Allocate codes from shared array
+		size_t codeIndex = atomic_fetch_add(nextFreeCodeIndex, CODE_ALLOCATION_BATCH_SIZE);
+		if (codeIndex >= numCodes) return;
+		size_t codesToCheck = min(size_t(CODE_ALLOCATION_BATCH_SIZE), numCodes - codeIndex);
+
+		// Check all allocated codes
+		if (searchRange(fileView, threadBitset->bitset, threadBitset->summary, codeIndex,
+		                codeIndex + codesToCheck)) {
+
+			// Allocate rest of codes so the other threads can stop
+			atomic_fetch_add(nextFreeCodeIndex, numCodes);
+
+			// Signal that the copy is found and exit thread
+			*foundCopy = true;
+			return;
+		}
+	}
+}
+
+static bool multiThreadedSearch(const uint8_t* __restrict fileView, uint64_t numCodes,
+                                ThreadBitset* bitsets, TouchedBlockStats* statsOut) noexcept
+{
+	// Variable containing whether a copy was found or not
+	atomic_bool foundCopy(false);
+
+	// Counter used for allocating codes
+	atomic_size_t nextFreeCodeIndex(0);
+
+	// Start threads, bitsets are already clear
+	thread threads[NUM_THREADS];
+	for (size_t i = 0; i < NUM_THREADS; i++) {
+		threads[i] = thread(workerFunction, fileView, &bitsets[i], &foundCopy, numCodes, &nextFreeCodeIndex);
+	}
+
+	// Wait for threads to finish working
+	for (thread& t : threads) {
+		t.join();
+	}
+
+	// Compare all threads tables, only in blocks touched by some thread
+	time_point startTime = chrono::high_resolution_clock::now();
+	uint64_t unionSummary[NUM_SUMMARY_WORDS];
+	for (uint64_t w = 0; w < NUM_SUMMARY_WORDS; w++) {
+		unionSummary[w] = bitsets[0].summary[w] | bitsets[1].summary[w] | bitsets[2].summary[w];
+	}
+	bool result = foundCopy || mergeBlocks(bitsets, unionSummary);
+	time_point mergeEndTime = chrono::high_resolution_clock::now();
+
+	// Stats, including a merge visiting every block as reference
+	if (statsOut != nullptr) {
+		statsOut->numCodes = numCodes;
+		statsOut->mergeTimeMs = millisecondsBetween(startTime, mergeEndTime);
+		for (uint64_t w = 0; w < NUM_SUMMARY_WORDS; w++) {
+			statsOut->numTouchedBlocks += uint64_t(_mm_popcnt_u64(unionSummary[w]));
+		}
+		time_point statsStartTime = chrono::high_resolution_clock::now();
+		statsOut->numDistinctCodes = result ? 0 : countDistinct(bitsets, unionSummary);
+		statsOut->statsTimeMs = millisecondsBetween(statsStartTime, chrono::high_resolution_clock::now());
+
+		uint64_t allBlocks[NUM_SUMMARY_WORDS];
+		memset(allBlocks, 0xFF, sizeof(allBlocks));
+		allBlocks[NUM_SUMMARY_WORDS - 1] = ~uint64_t(0) >> (NUM_SUMMARY_WORDS * 64 - NUM_BLOCKS);
+		time_point fullStartTime = chrono::high_resolution_clock::now();
+		bool fullResult = mergeBlocks(bitsets, allBlocks);
+		statsOut->fullMergeTimeMs = millisecondsBetween(fullStartTime, chrono::high_resolution_clock::now());
+		if (!foundCopy && fullResult != result) printf("ERROR: Touched block merge disagrees with full merge\n");
+	}
+
+	// Restore clear bitsets for the next search
+	time_point clearStartTime = chrono::high_resolution_clock::now();
+	for (size_t i = 0; i < NUM_THREADS; i++) {
+		clearTouchedBlocks(bitsets[i]);
+	}
+	if (statsOut != nullptr) {
+		statsOut->clearTimeMs = millisecondsBetween(clearStartTime, chrono::high_resolution_clock::now());
+	}
+
+	// Return result
+	return result;
+}
+
+// Search
+// ------------------------------------------------------------------------------------------------
+
+static bool touchedBlockSearch(const char* filePath, uint64_t maxNumCodes, TouchedBlockStats* statsOut) noexcept
+{
+	lock_guard<mutex> lock(searchMutex);
+	bool forceMultiThreaded = statsOut != nullptr;
+
+	// Open file
+	HANDLE file = CreateFile(filePath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+	                         FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (file == INVALID_HANDLE_VALUE) {
+		printf("CreateFile() failed\n");
+		return false;
+	}
+
+	// Get size of file
+	uint64_t fileSize = static_cast<uint64_t>(GetFileSize(file, NULL));
+
+	// Large file fast path
+	// There are a total of 17 576 000 different codes. If the file contains more codes than that
+	// it must also by definition contain a copy.
+	if (!forceMultiThreaded && fileSize >= ((MAX_NUMBER_CODES + 1) * BYTES_PER_CODE)) {
+		CloseHandle(file);
+		return true;
+	}
+
+	// Get bitsets, allocated by the first search
+	ThreadBitset* bitsets = threadBitsets();
+	if (bitsets == nullptr) {
+		CloseHandle(file);
+		return false;
+	}
+
+	// Create mapped file
+	HANDLE mappedFile = CreateFileMapping(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (!mappedFile) {
+		printf("CreateFileMapping() failed\n");
+		CloseHandle(file);
+		return false;
+	}
+
+	// Create mapped file view
+	void* fileView = MapViewOfFile(mappedFile, FILE_MAP_READ, 0, 0, fileSize);
+	if (!fileView) {
+		printf("MapViewOfFile() failed\n");
+		CloseHandle(mappedFile);
+		CloseHandle(file);
+		return false;
+	}
+
+	// Result variable
+	bool foundCopy = false;
+
+	// Single threaded path
+	uint64_t numCodes = min(numCodesInText(fileSize, BYTES_PER_CODE), maxNumCodes);
+	if (!forceMultiThreaded && numCodes <= NUM_CODES_MULTI_THREADED_THRESHOLD) {
+		foundCopy = singleThreadedSearch(static_cast<const uint8_t*>(fileView), numCodes, bitsets);
+	}
+
+	// Multi-threaded path
+	else {
+		foundCopy = multiThreadedSearch(static_cast<const uint8_t*>(fileView), numCodes, bitsets, statsOut);
+	}
+
+	// Unmap mapped file view
+	if (!UnmapViewOfFile(fileView)) {
+		printf("UnmapViewOfFile() failed\n");
+		CloseHandle(mappedFile);
+		CloseHandle(file);
+		return false;
+	}
+
+	// Close mapped file
+	if (!CloseHandle(mappedFile)) {
+		printf("CloseHandle() failed for mappedFile\n");
+		return false;
+	}
+
+	// Close file
+	if (!CloseHandle(file)) {
+		printf("CloseHandle() failed for file\n");
+		return false;
+	}
+
+	// Return result
+	return foundCopy;
+}
+
+// Exposed functions
+// ------------------------------------------------------------------------------------------------
+
+bool touchedBlockAlgorithm(const char* filePath) noexcept
+{
+	return touchedBlockSearch(filePath, ~uint64_t(0), nullptr);
+}
+
+bool touchedBlockSearchWithStats(const char* filePath, uint64_t maxNumCodes, TouchedBlockStats& statsOut) noexcept
+{
+	statsOut = TouchedBlockStats();
+	return touchedBlockSearch(filePath, maxNumCodes, &statsOut);
+}
+
+void printTouchedBlockStats(const char* filePath) noexcept
+{
+	printf("Touched block stats on \"%s\":\n", filePath);
+	for (uint64_t maxNumCodes : STATS_PREFIX_SIZES) {
+		TouchedBlockStats stats;
+		bool foundCopy = touchedBlockSearchWithStats(filePath, maxNumCodes, stats);
+		printf("  %8llu codes: %5llu/%llu blocks touched, %8llu distinct%s, merge %.3f ms (full %.3f ms), "
+		       "stats %.3f ms, clear %.3f ms\n",
+		       (unsigned long long)stats.numCodes, (unsigned long long)stats.numTouchedBlocks,
+		       (unsigned long long)NUM_BLOCKS, (unsigned long long)stats.numDistinctCodes,
+		       foundCopy ? " (copy found)" : "", stats.mergeTimeMs, stats.fullMergeTimeMs,
+		       stats.statsTimeMs, stats.clearTimeMs);
+	}
+	printf("\n");
+}
@@ -0,0 +1,33 @@
+// Copyright(c) Peter Hillerstrm(skipifzero.com, peter@hstroem.se)
+
+#pragma once
+
+#include <cstdint>
+
+// Same as optimizedSmartAlgorithm7(), but each thread keeps a summary bitmap next to its bitset
+// with one bit per 512 bit (64 byte) block, set whenever the block is written. The merge, the
+// clear and the stats pass only visit blocks marked in some summary, so their cost is proportional
+// to the number of codes rather than to the 17576000 bit universe.
+//
+// The bitsets are allocated once and kept clear between runs by clearing only the touched blocks
+// after each search, so no run starts with a full memset. Calls are serialized.
+
+static const uint64_t TOUCHED_BLOCK_NUM_BLOCKS = (17576000 + 511) / 512;
+
+struct TouchedBlockStats final {
+	uint64_t numCodes = 0;
+	uint64_t numDistinctCodes = 0; // Only counted if no copy was found
+	uint64_t numTouchedBlocks = 0; // Blocks marked in any thread's summary
+	double mergeTimeMs = 0.0;
+	double statsTimeMs = 0.0;
+	double clearTimeMs = 0.0;
+	double fullMergeTimeMs = 0.0; // Merge visiting every block, for comparison
+};
+
+bool touchedBlockAlgorithm(const char* filePath) noexcept;
+
+// Runs the multi-threaded search on the first maxNumCodes codes of the file regardless of its size
+bool touchedBlockSearchWithStats(const char* filePath, uint64_t maxNumCodes, TouchedBlockStats& statsOut) noexcept;
+
+// Prints stats for growing prefixes of the specified file
+void printTouchedBlockStats(const char* filePath) noexcept;
@@ -0,0 +1,501 @@
+// Copyright(c) Peter Hillerstrm(skipifzero.com, peter@hstroem.se)
+
+#include "ValidatingAlgorithm.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#include <malloc.h>
+
+#include <immintrin.h>
+
+#include "PlateDecoders.hpp"
+
+using namespace std;
+
+// Constants
+// ------------------------------------------------------------------------------------------------
+
+static const uint64_t MAX_NUMBER_CODES = 17576000;
+static const uint64_t BYTES_PER_CODE = 8; // Assumes Windows file endings (2 bytes per newline)
+static const uint64_t NUM_BITSET_BYTES = (MAX_NUMBER_CODES / 8);
+
+static const uint64_t NUM_THREADS = 3;
+static const uint64_t CODE_ALLOCATION_BATCH_SIZE = 4096;
+static const uint64_t NUM_CODES_MULTI_THREADED_THRESHOLD = 600000;
+
+// Number of codes decoded and validated before any of them are inserted into the bitset
+static const uint64_t VALIDATION_BLOCK_SIZE = 64;
+static_assert((VALIDATION_BLOCK_SIZE % 8) == 0, "Must be multiple of 8");
+static_assert((CODE_ALLOCATION_BATCH_SIZE % VALIDATION_BLOCK_SIZE) == 0, "Must be multiple of block size");
+
+// Validation
+// ------------------------------------------------------------------------------------------------
+
+// CODE_MIN_CHARS, CODE_CHAR_RANGES and isValidCode() are shared, see PlateDecoders.hpp
+
+// Slow path, finds the exact location of the first invalid character in the file
+static InputError findFirstError(const uint8_t* __restrict fileView, uint64_t fileSize) noexcept
+{
+	InputError error;
+	for (uint64_t i = 0; i < fileSize; i++) {
+		uint64_t column = i % BYTES_PER_CODE;
+		if (uint8_t(fileView[i] - CODE_MIN_CHARS[column]) > CODE_CHAR_RANGES[column]) {
+			error.line = (i / BYTES_PER_CODE) + 1;
+			error.column = column + 1;
+			return error;
+		}
+	}
+
+	// All characters are valid, so the last line must be incomplete
+	if ((fileSize % BYTES_PER_CODE) != 0) {
+		error.line = (fileSize / BYTES_PER_CODE) + 1;
+		error.column = (fileSize % BYTES_PER_CODE) + 1;
+	}
+	return error;
+}
+
+// Decodes 8 codes (64 bytes) into 8 numbers using AVX2. Every byte outside of its valid range is
+// OR:ed into errors as a non-zero byte.
+static __m256i decodeAndValidate8Codes(const uint8_t* __restrict codes, __m256i& errors) noexcept
+{
+	// Each code: [L3, L2, L1, N3, N2, N1, '\r', '\n'] -> [0-25, 0-25, 0-25, 0-9, 0-9, 0-9, 0, 0]
+	const __m256i SUBTRACT_CHARS = _mm256_set1_epi64x(0x0A0D303030414141);
+	const __m256i raw0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(codes));
+	const __m256i raw1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(codes + 32));
+	const __m256i digits0 = _mm256_sub_epi8(raw0, SUBTRACT_CHARS);
+	const __m256i digits1 = _mm256_sub_epi8(raw1, SUBTRACT_CHARS);
+
+	// Characters below their minimum wrap around, so a single unsigned saturating subtraction of
+	// the allowed range is non-zero exactly for the invalid bytes.
+	const __m256i CHAR_RANGES = _mm256_set1_epi64x(0x0000090909191919);
+	errors = _mm256_or_si256(errors, _mm256_subs_epu8(digits0, CHAR_RANGES));
+	errors = _mm256_or_si256(errors, _mm256_subs_epu8(digits1, CHAR_RANGES));
+
+	// u16 pairs per code: [L3 * 26 + L2, L1 * 10 + N3, N2 * 10 + N1, 0]
+	const __m256i PAIR_FACTORS = _mm256_set1_epi64x(0x0000010A010A011A);
+	const __m256i pairs0 = _mm256_maddubs_epi16(digits0, PAIR_FACTORS);
+	const __m256i pairs1 = _mm256_maddubs_epi16(digits1, PAIR_FACTORS);
+
+	// u32 pairs per code: [(L3 * 26 + L2) * 26000 + (L1 * 10 + N3) * 100, N2 * 10 + N1]
+	const __m256i QUAD_FACTORS = _mm256_set1_epi64x(0x0000000100646590);
+	const __m256i quads0 = _mm256_madd_epi16(pairs0, QUAD_FACTORS);
+	const __m256i quads1 = _mm256_madd_epi16(pairs1, QUAD_FACTORS);
+
+	// Final number in low u32 of each u64
+	const __m256i numbers0 = _mm256_add_epi32(quads0, _mm256_srli_epi64(quads0, 32));
+	const __m256i numbers1 = _mm256_add_epi32(quads1, _mm256_srli_epi64(quads1, 32));
+
+	// Pack into [0, 1, 4, 5, 2, 3, 6, 7] and then permute into order
+	const __m256i packed = _mm256_castps_si256(_mm256_shuffle_ps(_mm256_castsi256_ps(numbers0),
+	                                           _mm256_castsi256_ps(numbers1), _MM_SHUFFLE(2, 0, 2, 0)));
+	return _mm256_permute4x64_epi64(packed, _MM_SHUFFLE(3, 1, 2, 0));
+}
+
+static uint32_t decodeCode(const uint8_t* __restrict code) noexcept
+{
+	return uint32_t(code[0] - 'A') * 676000u +
+	       uint32_t(code[1] - 'A') * 26000u +
+	       uint32_t(code[2] - 'A') * 1000u +
+	       uint32_t(code[3] - '0') * 100u +
+	       uint32_t(code[4] - '0') * 10u +
+	       uint32_t(code[5] - '0');
+}
+
+// Decodes and validates up to VALIDATION_BLOCK_SIZE codes. Returns false if any code is invalid,
+// in which case none of the decoded numbers may be used.
+static bool decodeBlock(const uint8_t* __restrict codes, uint64_t numCodes,
+                        uint32_t* __restrict numbersOut) noexcept
+{
+	__m256i errors = _mm256_setzero_si256();
+	uint64_t numVectorCodes = numCodes & ~uint64_t(7);
+	for (uint64_t i = 0; i < numVectorCodes; i += 8) {
+		const __m256i numbers = decodeAndValidate8Codes(codes + i * BYTES_PER_CODE, errors);
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(numbersOut + i), numbers);
+	}
+	bool valid = _mm256_testz_si256(errors, errors) != 0;
+
+	// Remaining codes
+	for (uint64_t i = numVectorCodes; i < numCodes; i++) {
+		valid &= isValidCode(codes + i * BYTES_PER_CODE);
+		numbersOut[i] = decodeCode(codes + i * BYTES_PER_CODE);
+	}
+
+	return valid;
+}
+
+// Validates the codes in range [firstCode, lastCode) without decoding them, used for the part of
+// the file after a copy has been found
+static bool validateRange(const uint8_t* __restrict fileView, uint64_t firstCode,
+                          uint64_t lastCode) noexcept
+{
+	uint32_t allValid = 0xFFu;
+	uint64_t i = firstCode;
+	for (; (i + 8) <= lastCode; i += 8) {
+		allValid &= validCodesMask8Avx2(fileView + i * BYTES_PER_CODE);
+	}
+	for (; i < lastCode; i++) {
+		allValid &= isValidCode(fileView + i * BYTES_PER_CODE) ? 0xFFu : 0u;
+	}
+	return allValid == 0xFFu;
+}
+
+enum class SearchResult {
+	NO_COPY,
+	COPY_FOUND,
+	INVALID_INPUT
+};
+
+// Validates and checks the codes in range [firstCode, lastCode) against and inserts them into the
+// bitset. Each block is validated before any of its codes touch the bitset, so invalid input can
+// never cause an out of bounds write. The rest of the range is still validated after a copy, so
+// invalid input is found regardless of where the copy is.
+static SearchResult searchRange(const uint8_t* __restrict fileView,
+                                uint64_t* __restrict isFoundBitset,
+                                uint64_t firstCode,
+                                uint64_t lastCode) noexcept
+{
+	alignas(32) uint32_t numbers[VALIDATION_BLOCK_SIZE];
+	for (uint64_t blockStart = firstCode; blockStart < lastCode; blockStart += VALIDATION_BLOCK_SIZE) {
+		uint64_t numCodes = min(VALIDATION_BLOCK_SIZE, lastCode - blockStart);
+		if (!decodeBlock(fileView + blockStart * BYTES_PER_CODE, numCodes, numbers)) {
+			return SearchResult::INVALID_INPUT;
+		}
+
+		for (uint64_t i = 0; i < numCodes; i++) {
+			uint32_t number = numbers[i];
+
+			uint32_t bitsetChunkIndex = number >> 6u; // number / 64;
+			uint32_t bitIndex = number & 0x0000003Fu; // number % 64;
+
+			uint64_t chunk = isFoundBitset[bitsetChunkIndex];
+			uint64_t bitMask = uint64_t(1) << bitIndex;
+
+			if ((bitMask & chunk) != uint64_t(0)) {
+				bool valid = validateRange(fileView, blockStart + numCodes, lastCode);
+				return valid ? SearchResult::COPY_FOUND : SearchResult::INVALID_INPUT;
+			}
+
+			chunk = bitMask | chunk;
+			isFoundBitset[bitsetChunkIndex] = chunk;
+		}
+	}
+	return SearchResult::NO_COPY;
+}
+
+// Single threaded variant
+// ------------------------------------------------------------------------------------------------
+
+static SearchResult singleThreadedSearch(const uint8_t* __restrict fileView, uint64_t numCodes) noexcept
+{
+	// Allocate bitset buffer for whether a number is found or not, and clear it
+	uint64_t* isFoundBitset = static_cast<uint64_t*>(_aligned_malloc(NUM_BITSET_BYTES, 32));
+	memset(isFoundBitset, 0, NUM_BITSET_BYTES);
+
+	// Check all codes in file
+	SearchResult result = searchRange(fileView, isFoundBitset, 0, numCodes);
+
+	// Free allocated bitset memory
+	_aligned_free(isFoundBitset);
+
+	// Return result
+	return result;
+}
+
+// Multi-threaded variant
+// ------------------------------------------------------------------------------------------------
+
+static bool mergeBitsets(uint64_t* bitsets[NUM_THREADS]) noexcept
+{
+	if (NUM_THREADS == 2) {
+		for (size_t i = 0; i < (NUM_BITSET_BYTES / sizeof(uint64_t)); i++) {
+			uint64_t b1 = bitsets[0][i];
+			uint64_t b2 = bitsets[1][i];
+			if ((b1 & b2) != uint64_t(0)) return true;
+		}
+	}
+
+	else if (NUM_THREADS == 3) {
+		for (size_t i = 0; i < (NUM_BITSET_BYTES / sizeof(uint64_t)); i++) {
+			uint64_t b1 = bitsets[0][i];
+			uint64_t b2 = bitsets[1][i];
+			uint64_t b3 = bitsets[2][i];
+			bool found = ((b1 & b2) | (b1 & b3) | (b2 & b3)) != uint64_t(0);
+			if (found) return true;
+		}
+	}
+
+	else if (NUM_THREADS == 4) {
+		for (size_t i = 0; i < (NUM_BITSET_BYTES / sizeof(uint64_t)); i++) {
+			uint64_t b1 = bitsets[0][i];
+			uint64_t b2 = bitsets[1][i];
+			uint64_t b3 = bitsets[2][i];
+			uint64_t b4 = bitsets[3][i];
+			
+			bool found = ((b1 & b2) | (b1 & b3) | (b1 & b4) | (b2 & b3) | (b2 & b4) | (b3 & b4)) != uint64_t(0);
+			if (found) {
+				return true;
+			}
+		}
+	}
+		
+	else if (NUM_THREADS == 8) {
+		for (size_t i = 0; i < (NUM_BITSET_BYTES / sizeof(uint64_t)); i++) {
+			uint64_t b1 = bitsets[0][i];
+			uint64_t b2 = bitsets[1][i];
+			uint64_t b3 = bitsets[2][i];
+			uint64_t b4 = bitsets[3][i];
+			uint64_t b5 = bitsets[4][i];
+			uint64_t b6 = bitsets[5][i];
+			uint64_t b7 = bitsets[6][i];
+			uint64_t b8 = bitsets[7][i];
+
+			uint64_t val =
+			(b1 & b2) |
+			(b1 & b3) |
+			(b1 & b4) |
+			(b1 & b5) |
+			(b1 & b6) |
+			(b1 & b7) |
+			(b1 & b8) |
+
+			(b2 & b3) |
+			(b2 & b4) |
+			(b2 & b5) |
+			(b2 & b6) |
+			(b2 & b7) |
+			(b2 & b8) |
+			
+			(b3 & b4) |
+			(b3 & b5) |
+			(b3 & b6) |
+			(b3 & b7) |
+			(b3 & b8) |
+
+			(b4 & b5) |
+			(b4 & b6) |
+			(b4 & b7) |
+			(b4 & b8) |
+			
+			(b5 & b6) |
+			(b5 & b7) |
+			(b5 & b8) |
+
+			(b6 & b7) |
+			(b6 & b8) |
+
+			(b7 & b8);
+
+			if (val != uint64_t(0)) {
+				return true;
+			}
+		}
+	}
+
+	else {
+		printf("FATAL ERROR: NUM_THREADS may only be 2, 3, 4 or 8\n");
+	}
+
+	return false;
+}
+
+static void workerFunction(const uint8_t* __restrict fileView,
+                           uint64_t* __restrict isFoundBitset,
+                           atomic_bool* foundCopy,
+                           atomic_bool* foundInvalidInput,
+                           size_t numCodes,
+                           atomic_size_t* nextFreeCodeIndex) noexcept
+{
+	// Clear bitset
+	memset(isFoundBitset, 0, NUM_BITSET_BYTES);
+
+	while (true) {
+
+		// Allocate codes from shared array
+		size_t codeIndex = atomic_fetch_add(nextFreeCodeIndex, CODE_ALLOCATION_BATCH_SIZE);
+		if (codeIndex >= numCodes) return;
+		size_t codesToCheck = min(size_t(CODE_ALLOCATION_BATCH_SIZE), numCodes - codeIndex);
+
+		// Check all allocated codes, once any thread has found a copy the rest of the file only
+		// needs to be validated. Which thread finds the copy first is timing dependent, so the
+		// whole file is always validated to keep the result deterministic.
+		SearchResult result = SearchResult::NO_COPY;
+		if (*foundCopy) {
+			if (!validateRange(fileView, codeIndex, codeIndex + codesToCheck)) {
+				result = SearchResult::INVALID_INPUT;
+			}
+		}
+		else {
+			result = searchRange(fileView, isFoundBitset, codeIndex, codeIndex + codesToCheck);
+		}
+		if (result == SearchResult::COPY_FOUND) {
+			*foundCopy = true;
+		}
+
+		// Invalid input takes precedence, allocate rest of codes so the other threads can stop
+		else if (result == SearchResult::INVALID_INPUT) {
+			atomic_fetch_add(nextFreeCodeIndex, numCodes);
+			*foundInvalidInput = true;
+			return;
+		}
+	}
+}
+
+// If the file is known to contain a copy only validation is done
+static SearchResult multiThreadedSearch(const uint8_t* __restrict fileView, uint64_t numCodes,
+                                        bool knownCopy) noexcept
+{
+	// Variables containing whether a copy or invalid input was found or not
+	atomic_bool foundCopy(knownCopy);
+	atomic_bool foundInvalidInput(false);
+
+	// Counter used for allocating codes
+	atomic_size_t nextFreeCodeIndex(0);
+
+	// Start threads
+	uint64_t* bitsets[NUM_THREADS];
+	thread threads[NUM_THREADS];
+	for (size_t i = 0; i < NUM_THREADS; i++) {
+
+		// Allocate memory for bitset, cleared in worker function
+		bitsets[i] = static_cast<uint64_t*>(_aligned_malloc(NUM_BITSET_BYTES, 32));
+
+		// Start worker thread
+		threads[i] = thread(workerFunction, fileView, bitsets[i], &foundCopy, &foundInvalidInput,
+		                    numCodes, &nextFreeCodeIndex);
+	}
+
+	// Wait for threads to finish working
+	for (thread& t : threads) {
+		t.join();
+	}
+
+	// Compare all threads tables
+	SearchResult result = SearchResult::NO_COPY;
+	if (foundInvalidInput) {
+		result = SearchResult::INVALID_INPUT;
+	}
+	else if (foundCopy || mergeBitsets(bitsets)) {
+		result = SearchResult::COPY_FOUND;
+	}
+
+	// Free memory
+	for (uint64_t* bitset : bitsets) {
+		_aligned_free(bitset);
+	}
+
+	// Return result
+	return result;
+}
+
+// Exposed functions
+// ------------------------------------------------------------------------------------------------
+
+bool validatingAlgorithm(const char* filePath) noexcept
+{
+	InputError error;
+	bool foundCopy = validatingAlgorithm(filePath, error);
+	if (error.line != 0) {
+		printf("Invalid input in \"%s\" at line %llu, column %llu\n", filePath,
+		       (unsigned long long)error.line, (unsigned long long)error.column);
+	}
+	return foundCopy;
+}
+
+bool validatingAlgorithm(const char* filePath, InputError& errorOut) noexcept
+{
+	errorOut = InputError();
+
+	// Open file
+	HANDLE file = CreateFile(filePath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+	                         FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (file == INVALID_HANDLE_VALUE) {
+		printf("CreateFile() failed\n");
+		return false;
+	}
+
+	// Get size of file
+	uint64_t fileSize = static_cast<uint64_t>(GetFileSize(file, NULL));
+
+	// Large file fast path
+	// There are a total of 17 576 000 different codes. If the file contains more codes than that
+	// it must also by definition contain a copy, but it still has to be validated.
+	bool knownCopy = fileSize >= ((MAX_NUMBER_CODES + 1) * BYTES_PER_CODE);
+
+	// Create mapped file
+	HANDLE mappedFile = CreateFileMapping(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (!mappedFile) {
+		printf("CreateFileMapping() failed\n");
+		CloseHandle(file);
+		return false;
+	}
+
+	// Create mapped file view
+	uint64_t offset = 0;
+	uint32_t offsetLow  = uint32_t(offset & uint64_t(0xFFFFFFFF));
+	uint32_t offsetHigh = uint32_t(offset >> uint64_t(32));
+	uint64_t numBytesToMap = fileSize;
+	void* fileView = MapViewOfFile(mappedFile, FILE_MAP_READ, offsetLow, offsetHigh, numBytesToMap);
+	if (!fileView) {
+		printf("MapViewOfFile() failed\n");
+		CloseHandle(mappedFile);
+		CloseHandle(file);
+		return false;
+	}
+
+	// Result variable
+	SearchResult result = SearchResult::NO_COPY;
+
+	// Incomplete last line, can not be caught by the block validation
+	uint64_t numCodes = fileSize / BYTES_PER_CODE;
+	if ((fileSize % BYTES_PER_CODE) != 0) {
+		result = SearchResult::INVALID_INPUT;
+	}
+
+	// Single threaded path
+	else if (numCodes <= NUM_CODES_MULTI_THREADED_THRESHOLD) {
+		result = singleThreadedSearch(static_cast<const uint8_t*>(fileView), numCodes);
+	}
+
+	// Multi-threaded path
+	else {
+		result = multiThreadedSearch(static_cast<const uint8_t*>(fileView), numCodes, knownCopy);
+	}
+
+	// Slow path, locate first invalid character, which is the lowest invalid line regardless of
+	// where the threads found it
+	if (result == SearchResult::INVALID_INPUT) {
+		errorOut = findFirstError(static_cast<const uint8_t*>(fileView), fileSize);
+	}
+	bool foundCopy = result == SearchResult::COPY_FOUND;
+
+	// Unmap mapped file view
+	if (!UnmapViewOfFile(fileView)) {
+		printf("UnmapViewOfFile() failed\n");
+		CloseHandle(mappedFile);
+		CloseHandle(file);
+		return false;
+	}
+
+	// Close mapped file
+	if (!CloseHandle(mappedFile)) {
+		printf("CloseHandle() failed for mappedFile\n");
+		return false;
+	}
+
+	// Close file
+	if (!CloseHandle(file)) {
+		printf("CloseHandle() failed for file\n");
+		return false;
+	}
+
+	// Return result
+	return foundCopy;
+}
@@ -0,0 +1,21 @@
+// Copyright(c) Peter Hillerstrm(skipifzero.com, peter@hstroem.se)
+
+#pragma once
+
+#include <cstdint>
+
+// Location of the first invalid character in a file, line and column are 1-indexed. A line of 0
+// means that no invalid character was found.
+struct InputError final {
+	uint64_t line = 0;
+	uint64_t column = 0;
+};
+
+// Checks file for duplicates while validating that every line is a code on the form "AAA000\r\n".
+// Invalid input anywhere in the file is reported as no duplicates and the location of the first
+// invalid character is printed, so the result does not depend on where a copy is or on how the work
+// was split between threads.
+bool validatingAlgorithm(const char* filePath) noexcept;
+
+// Same as above, but returns the location of the first invalid character instead of printing it.
+bool validatingAlgorithm(const char* filePath, InputError& errorOut) noexcept;